@@ -0,0 +1,28 @@
+/* contrib/pg_wait_sampling/pg_wait_sampling--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION pg_wait_sampling" to load this file. \quit
+
+-- Register functions.
+CREATE FUNCTION pg_wait_sampling_reset_profile()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+CREATE FUNCTION pg_wait_sampling_profile(
+    OUT event_type text,
+    OUT event text,
+    OUT count int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+-- Register a view on the function for ease of use.
+CREATE VIEW pg_wait_sampling_profile AS
+  SELECT * FROM pg_wait_sampling_profile();
+
+GRANT SELECT ON pg_wait_sampling_profile TO PUBLIC;
+
+-- Don't want this to be available to non-superusers.
+REVOKE ALL ON FUNCTION pg_wait_sampling_reset_profile() FROM PUBLIC;
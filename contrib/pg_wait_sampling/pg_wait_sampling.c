@@ -0,0 +1,469 @@
+/* -------------------------------------------------------------------------
+ *
+ * pg_wait_sampling.c
+ *		Periodically sample the wait events of all processes, and aggregate
+ *		the samples into a profile in shared memory.
+ *
+ * pg_stat_activity shows what each process is waiting for at the moment it
+ * is looked at, which is rarely the moment that matters.  This module starts
+ * a background worker that looks at the wait_event_info of every PGPROC
+ * every pg_wait_sampling.period milliseconds, and counts how often each
+ * wait event was seen.  The counts approximate how much time the server as
+ * a whole has spent in each kind of wait, and can be read through the
+ * pg_wait_sampling_profile view.
+ *
+ * The module must be loaded via shared_preload_libraries.
+ *
+ * Copyright (c) 2013, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		contrib/pg_wait_sampling/pg_wait_sampling.c
+ *
+ * -------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "pgstat.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+PG_MODULE_MAGIC;
+
+/*
+ * Maximum number of distinct wait events in the profile.  There are far
+ * fewer than this in the core code; events beyond the limit are not counted.
+ */
+#define PGWS_MAX_EVENTS		1024
+
+/*
+ * Profile hashtable entry
+ */
+typedef struct pgwsEntry
+{
+	uint32		wait_event_info;	/* hash key of entry - MUST BE FIRST */
+	int64		count;			/* number of samples that saw this event */
+} pgwsEntry;
+
+/*
+ * Global shared state
+ */
+typedef struct pgwsSharedState
+{
+	LWLockId	lock;			/* protects hashtable search/modification */
+} pgwsSharedState;
+
+/*---- Local variables ----*/
+
+/* Saved hook values in case of unload */
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+/* Links to shared memory state */
+static pgwsSharedState *pgws = NULL;
+static HTAB *pgws_hash = NULL;
+
+/* Sampler's buffer for the events seen in one sample, one per PGPROC */
+static uint32 *pgws_sample = NULL;
+
+/* flags set by signal handlers */
+static volatile sig_atomic_t got_sighup = false;
+static volatile sig_atomic_t got_sigterm = false;
+
+/*---- GUC variables ----*/
+
+static int	pgws_period;		/* sampling period, in milliseconds */
+
+/*---- Function declarations ----*/
+
+void		_PG_init(void);
+void		_PG_fini(void);
+
+Datum		pg_wait_sampling_reset_profile(PG_FUNCTION_ARGS);
+Datum		pg_wait_sampling_profile(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(pg_wait_sampling_reset_profile);
+PG_FUNCTION_INFO_V1(pg_wait_sampling_profile);
+
+static void pgws_shmem_startup(void);
+static Size pgws_memsize(void);
+static void pgws_main(Datum main_arg);
+static void pgws_take_sample(void);
+
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	BackgroundWorker worker;
+
+	/*
+	 * In order to create our shared memory area, we have to be loaded via
+	 * shared_preload_libraries.  If not, fall out without hooking into any of
+	 * the main system.  (We don't throw error here because it seems useful to
+	 * allow the pg_wait_sampling functions to be created even when the module
+	 * isn't active.  The functions must protect themselves against being
+	 * called then, however.)
+	 */
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	DefineCustomIntVariable("pg_wait_sampling.period",
+			   "Sets the interval between wait event samples.",
+							NULL,
+							&pgws_period,
+							10,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	EmitWarningsOnPlaceholders("pg_wait_sampling");
+
+	/*
+	 * Request additional shared resources.  (These are no-ops if we're not in
+	 * the postmaster process.)  We'll allocate or attach to the shared
+	 * resources in pgws_shmem_startup().
+	 */
+	RequestAddinShmemSpace(pgws_memsize());
+	RequestAddinLWLocks(1);
+
+	/*
+	 * Install hooks.
+	 */
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = pgws_shmem_startup;
+
+	/*
+	 * Register the sampler.  It needs shared memory, but no database, so it
+	 * can run from the moment the server accepts read-only connections.
+	 */
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = 10;
+	worker.bgw_main = pgws_main;
+	worker.bgw_main_arg = (Datum) 0;
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_wait_sampling collector");
+
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Module unload callback
+ */
+void
+_PG_fini(void)
+{
+	/* Uninstall hooks. */
+	shmem_startup_hook = prev_shmem_startup_hook;
+}
+
+/*
+ * shmem_startup hook: allocate or attach to shared memory
+ */
+static void
+pgws_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	/* reset in case this is a restart within the postmaster */
+	pgws = NULL;
+	pgws_hash = NULL;
+
+	/*
+	 * Create or attach to the shared memory state, including hash table
+	 */
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	pgws = ShmemInitStruct("pg_wait_sampling",
+						   sizeof(pgwsSharedState),
+						   &found);
+
+	if (!found)
+	{
+		/* First time through ... */
+		pgws->lock = LWLockAssign();
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(uint32);
+	info.entrysize = sizeof(pgwsEntry);
+	info.hash = tag_hash;
+	pgws_hash = ShmemInitHash("pg_wait_sampling hash",
+							  PGWS_MAX_EVENTS, PGWS_MAX_EVENTS,
+							  &info,
+							  HASH_ELEM | HASH_FUNCTION);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Estimate shared memory space needed.
+ */
+static Size
+pgws_memsize(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(pgwsSharedState));
+	size = add_size(size, hash_estimate_size(PGWS_MAX_EVENTS,
+											 sizeof(pgwsEntry)));
+
+	return size;
+}
+
+/*
+ * Signal handler for SIGTERM
+ *		Set a flag to let the main loop to terminate, and set our latch to wake
+ *		it up.
+ */
+static void
+pgws_sigterm(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sigterm = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Signal handler for SIGHUP
+ *		Set a flag to tell the main loop to reread the config file, and set
+ *		our latch to wake it up.
+ */
+static void
+pgws_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Main loop of the sampler
+ */
+static void
+pgws_main(Datum main_arg)
+{
+	/* Establish signal handlers before unblocking signals. */
+	pqsignal(SIGHUP, pgws_sighup);
+	pqsignal(SIGTERM, pgws_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	pgws_sample = (uint32 *) MemoryContextAlloc(TopMemoryContext,
+								ProcGlobal->allProcCount * sizeof(uint32));
+
+	while (!got_sigterm)
+	{
+		int			rc;
+
+		pgws_take_sample();
+
+		rc = WaitLatch(&MyProc->procLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   pgws_period);
+		ResetLatch(&MyProc->procLatch);
+
+		/* emergency bailout if postmaster has died */
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+	}
+
+	proc_exit(0);
+}
+
+/*
+ * Count the current wait event of every process that is waiting.
+ *
+ * The wait events are read without any locking, so a process may be counted
+ * for a wait it has just finished, or a PGPROC that is being recycled may be
+ * seen half set up.  That only adds a little noise to a statistical profile.
+ * We do take the profile's lock once per sample, not once per process, so
+ * that sampling doesn't turn into a source of contention itself.
+ */
+static void
+pgws_take_sample(void)
+{
+	uint32	   *events = pgws_sample;
+	int			nevents = 0;
+	int			i;
+
+	for (i = 0; i < ProcGlobal->allProcCount; i++)
+	{
+		volatile PGPROC *proc = &ProcGlobal->allProcs[i];
+		uint32		wait_event_info;
+
+		/* skip unused slots, prepared transactions, and ourselves */
+		if (proc->pid == 0 || proc == MyProc)
+			continue;
+
+		wait_event_info = proc->wait_event_info;
+		if (wait_event_info != 0)
+			events[nevents++] = wait_event_info;
+	}
+
+	if (nevents == 0)
+		return;
+
+	LWLockAcquire(pgws->lock, LW_EXCLUSIVE);
+
+	for (i = 0; i < nevents; i++)
+	{
+		pgwsEntry  *entry;
+		bool		found;
+
+		entry = (pgwsEntry *) hash_search(pgws_hash, &events[i],
+										  HASH_ENTER_NULL, &found);
+		if (entry == NULL)
+			continue;			/* profile is full */
+		if (!found)
+			entry->count = 0;
+		entry->count++;
+	}
+
+	LWLockRelease(pgws->lock);
+}
+
+/*
+ * Reset the wait event profile.
+ */
+Datum
+pg_wait_sampling_reset_profile(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgwsEntry  *entry;
+
+	if (!pgws || !pgws_hash)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_wait_sampling must be loaded via shared_preload_libraries")));
+
+	LWLockAcquire(pgws->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, pgws_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		hash_search(pgws_hash, &entry->wait_event_info, HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(pgws->lock);
+
+	PG_RETURN_VOID();
+}
+
+#define PG_WAIT_SAMPLING_PROFILE_COLS	3
+
+/*
+ * Retrieve the wait event profile.
+ */
+Datum
+pg_wait_sampling_profile(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	pgwsEntry  *entry;
+
+	if (!pgws || !pgws_hash)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_wait_sampling must be loaded via shared_preload_libraries")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(pgws->lock, LW_SHARED);
+
+	hash_seq_init(&hash_seq, pgws_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[PG_WAIT_SAMPLING_PROFILE_COLS];
+		bool		nulls[PG_WAIT_SAMPLING_PROFILE_COLS];
+		const char *event_type;
+		const char *event;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, 0, sizeof(nulls));
+
+		event_type = pgstat_get_wait_event_type(entry->wait_event_info);
+		event = pgstat_get_wait_event(entry->wait_event_info);
+
+		if (event_type)
+			values[0] = CStringGetTextDatum(event_type);
+		else
+			nulls[0] = true;
+		if (event)
+			values[1] = CStringGetTextDatum(event);
+		else
+			nulls[1] = true;
+		values[2] = Int64GetDatum(entry->count);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(pgws->lock);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
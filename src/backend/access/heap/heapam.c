@@ -60,6 +60,7 @@
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
@@ -76,6 +77,8 @@
 bool		synchronize_seqscans = true;
 
 
+static Buffer heapgetpage_readahead(HeapScanDesc scan, BlockNumber page);
+static void heap_release_readahead(HeapScanDesc scan);
 static HeapScanDesc heap_beginscan_internal(Relation relation,
 						Snapshot snapshot,
 						int nkeys, ScanKey key,
@@ -108,6 +111,12 @@ static void MultiXactIdWait(MultiXactId multi, MultiXactStatus status,
 static bool ConditionalMultiXactIdWait(MultiXactId multi,
 						   MultiXactStatus status, int *remaining,
 						   uint16 infomask);
+static void GetTupleLockTid(Page page, ItemPointer tid, ItemPointer locktid);
+static void CarryTupleLock(Relation relation, ItemPointer locktid,
+			   LockTupleMode mode);
+static bool AdoptCarriedTupleLock(Relation relation, Page page,
+					  ItemPointer tid, LockTupleMode mode,
+					  ItemPointer locktid);
 
 
 /*
@@ -167,6 +176,36 @@ static const struct
 #define ConditionalLockTupleTuplock(rel, tup, mode) \
 	ConditionalLockTuple((rel), (tup), tupleLockExtraInfo[mode].hwlock)
 
+/*
+ * Acquire a heavyweight tuple lock, waiting if necessary, and count it in
+ * the table's n_tup_lock_waits if we actually had to wait.  The conditional
+ * attempt costs an extra lock table lookup only when the lock is contended.
+ */
+#define WaitLockTupleTuplock(rel, tup, mode) \
+	do { \
+		if (!ConditionalLockTupleTuplock((rel), (tup), (mode))) \
+		{ \
+			pgstat_count_tuple_lock_wait(rel); \
+			LockTupleTuplock((rel), (tup), (mode)); \
+		} \
+	} while (0)
+
+/*
+ * A tuple lock that was kept across a HeapTupleUpdated return, so that the
+ * next attempt on a newer version of the same row can keep its place in
+ * line.  See GetTupleLockTid and README.tuplock.
+ */
+typedef struct CarriedTupleLock
+{
+	bool		held;			/* is a lock being carried? */
+	LOCKTAG		tag;			/* the tuple lock's tag */
+	LockTupleMode mode;			/* ... and strength */
+	LocalTransactionId lxid;	/* transaction that took it */
+	SubTransactionId subxid;	/* ... and subtransaction */
+} CarriedTupleLock;
+
+static CarriedTupleLock carriedTupleLock;
+
 /*
  * This table maps tuple lock strength values for each particular
  * MultiXactStatus value.
@@ -273,6 +312,8 @@ initscan(HeapScanDesc scan, ScanKey key, bool is_rescan)
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_nrabufs = 0;
+	scan->rs_prefetchend = InvalidBlockNumber;
 
 	/* we don't have a marked position... */
 	ItemPointerSetInvalid(&(scan->rs_mctid));
@@ -328,9 +369,16 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	/*
+	 * Read page using selected strategy.  Bulk reads going forwards fetch the
+	 * following pages too, in the same I/O.
+	 */
+	if (scan->rs_strategy != NULL &&
+		(!BlockNumberIsValid(scan->rs_cblock) || page > scan->rs_cblock))
+		scan->rs_cbuf = heapgetpage_readahead(scan, page);
+	else
+		scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
+										   RBM_NORMAL, scan->rs_strategy);
 	scan->rs_cblock = page;
 
 	if (!scan->rs_pageatatime)
@@ -410,6 +458,98 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	scan->rs_ntuples = ntup;
 }
 
+/*
+ * heapgetpage_readahead - subroutine for heapgetpage()
+ *
+ * Returns a pinned buffer for the specified page, reading it together with
+ * up to MAX_BUFFERS_PER_READ - 1 following pages if it is not the next page
+ * of the current read-ahead run.  The rest of the run stays pinned in
+ * rs_rabufs until heapgetpage asks for it, or the scan ends or is rescanned.
+ *
+ * Each time a new run is read, we also issue prefetch requests for the
+ * target_prefetch_pages runs after it, so that the kernel keeps that many
+ * reads in flight ahead of the scan.
+ */
+static Buffer
+heapgetpage_readahead(HeapScanDesc scan, BlockNumber page)
+{
+	BlockNumber scanend;
+	BlockNumber endblock;
+	Buffer		buffer;
+
+	if (scan->rs_nrabufs > 0)
+	{
+		if (page == scan->rs_rablock)
+		{
+			buffer = scan->rs_rabufs[scan->rs_raindex];
+			scan->rs_raindex++;
+			scan->rs_nrabufs--;
+			scan->rs_rablock++;
+			return buffer;
+		}
+
+		/* The scan went elsewhere, so the rest of the run is useless */
+		heap_release_readahead(scan);
+	}
+
+	/*
+	 * Don't read past the end of the scan: that's the end of the relation,
+	 * or, once a synchronized scan has wrapped around, its starting block.
+	 */
+	scanend = scan->rs_nblocks;
+	if (page < scan->rs_startblock)
+		scanend = scan->rs_startblock;
+	endblock = Min(scanend, page + MAX_BUFFERS_PER_READ);
+
+	ReadBuffersExtended(scan->rs_rd, MAIN_FORKNUM, page, endblock - page,
+						scan->rs_rabufs, scan->rs_strategy);
+
+	scan->rs_raindex = 1;
+	scan->rs_nrabufs = endblock - page - 1;
+	scan->rs_rablock = page + 1;
+
+	/* Keep the prefetch window ahead of the run we just read */
+	if (target_prefetch_pages > 0 && endblock < scanend)
+	{
+		BlockNumber windowend;
+		BlockNumber prefetchstart;
+
+		windowend = Min(scanend,
+						endblock + target_prefetch_pages * MAX_BUFFERS_PER_READ);
+
+		/*
+		 * Don't prefetch the same blocks twice; but if the window has moved
+		 * somewhere else entirely (the scan wrapped around), start over.
+		 */
+		prefetchstart = endblock;
+		if (BlockNumberIsValid(scan->rs_prefetchend) &&
+			scan->rs_prefetchend > endblock &&
+			scan->rs_prefetchend <= windowend)
+			prefetchstart = scan->rs_prefetchend;
+
+		if (prefetchstart < windowend)
+			PrefetchBufferRange(scan->rs_rd, MAIN_FORKNUM, prefetchstart,
+								windowend - prefetchstart);
+		scan->rs_prefetchend = windowend;
+	}
+
+	return scan->rs_rabufs[0];
+}
+
+/*
+ * heap_release_readahead - drop the pins on any unused read-ahead buffers
+ */
+static void
+heap_release_readahead(HeapScanDesc scan)
+{
+	while (scan->rs_nrabufs > 0)
+	{
+		ReleaseBuffer(scan->rs_rabufs[scan->rs_raindex]);
+		scan->rs_raindex++;
+		scan->rs_nrabufs--;
+	}
+}
+
 /* ----------------
  *		heapgettup - fetch next heap tuple
  *
@@ -1385,6 +1525,7 @@ heap_rescan(HeapScanDesc scan,
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_release_readahead(scan);
 
 	/*
 	 * reinitialize scan descriptor
@@ -1409,6 +1550,7 @@ heap_endscan(HeapScanDesc scan)
 	 */
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
+	heap_release_readahead(scan);
 
 	/*
 	 * decrement relation reference count and free scan descriptor storage
@@ -2543,6 +2685,7 @@ heap_delete(Relation relation, ItemPointer tid,
 	uint16		new_infomask,
 				new_infomask2;
 	bool		have_tuple_lock = false;
+	ItemPointerData locktid;
 	bool		iscombo;
 	bool		all_visible_cleared = false;
 
@@ -2583,6 +2726,9 @@ heap_delete(Relation relation, ItemPointer tid,
 	tp.t_len = ItemIdGetLength(lp);
 	tp.t_self = *tid;
 
+	have_tuple_lock = AdoptCarriedTupleLock(relation, page, &tp.t_self,
+											LockTupleExclusive, &locktid);
+
 l1:
 	result = HeapTupleSatisfiesUpdate(tp.t_data, cid, buffer);
 
@@ -2599,6 +2745,8 @@ l1:
 		/* must copy state data before unlocking buffer */
 		xwait = HeapTupleHeaderGetRawXmax(tp.t_data);
 		infomask = tp.t_data->t_infomask;
+		if (!have_tuple_lock)
+			GetTupleLockTid(page, &tp.t_self, &locktid);
 
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
@@ -2613,7 +2761,7 @@ l1:
 		 */
 		if (!have_tuple_lock)
 		{
-			LockTupleTuplock(relation, &(tp.t_self), LockTupleExclusive);
+			WaitLockTupleTuplock(relation, &locktid, LockTupleExclusive);
 			have_tuple_lock = true;
 		}
 
@@ -2690,6 +2838,8 @@ l1:
 
 	if (result != HeapTupleMayBeUpdated)
 	{
+		bool		carry_lock;
+
 		Assert(result == HeapTupleSelfUpdated ||
 			   result == HeapTupleUpdated ||
 			   result == HeapTupleBeingUpdated);
@@ -2700,9 +2850,13 @@ l1:
 			hufd->cmax = HeapTupleHeaderGetCmax(tp.t_data);
 		else
 			hufd->cmax = 0;		/* for lack of an InvalidCommandId value */
+		carry_lock = (have_tuple_lock && result == HeapTupleUpdated &&
+					  HeapTupleHeaderIsHotUpdated(tp.t_data));
 		UnlockReleaseBuffer(buffer);
-		if (have_tuple_lock)
-			UnlockTupleTuplock(relation, &(tp.t_self), LockTupleExclusive);
+		if (carry_lock)
+			CarryTupleLock(relation, &locktid, LockTupleExclusive);
+		else if (have_tuple_lock)
+			UnlockTupleTuplock(relation, &locktid, LockTupleExclusive);
 		if (vmbuffer != InvalidBuffer)
 			ReleaseBuffer(vmbuffer);
 		return result;
@@ -2829,7 +2983,7 @@ l1:
 	 * Release the lmgr tuple lock, if we had it.
 	 */
 	if (have_tuple_lock)
-		UnlockTupleTuplock(relation, &(tp.t_self), LockTupleExclusive);
+		UnlockTupleTuplock(relation, &locktid, LockTupleExclusive);
 
 	pgstat_count_heap_delete(relation);
 
@@ -2932,6 +3086,7 @@ heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 	Size		newtupsize,
 				pagefree;
 	bool		have_tuple_lock = false;
+	ItemPointerData locktid;
 	bool		iscombo;
 	bool		satisfies_hot;
 	bool		satisfies_key;
@@ -3055,6 +3210,9 @@ heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 	 * use otid anymore.
 	 */
 
+	have_tuple_lock = AdoptCarriedTupleLock(relation, page, &(oldtup.t_self),
+											*lockmode, &locktid);
+
 l2:
 	checked_lockers = false;
 	locker_remains = false;
@@ -3092,6 +3250,8 @@ l2:
 		/* must copy state data before unlocking buffer */
 		xwait = HeapTupleHeaderGetRawXmax(oldtup.t_data);
 		infomask = oldtup.t_data->t_infomask;
+		if (!have_tuple_lock)
+			GetTupleLockTid(page, &(oldtup.t_self), &locktid);
 
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
@@ -3106,7 +3266,7 @@ l2:
 		 */
 		if (!have_tuple_lock)
 		{
-			LockTupleTuplock(relation, &(oldtup.t_self), *lockmode);
+			WaitLockTupleTuplock(relation, &locktid, *lockmode);
 			have_tuple_lock = true;
 		}
 
@@ -3235,6 +3395,8 @@ l2:
 
 	if (result != HeapTupleMayBeUpdated)
 	{
+		bool		carry_lock;
+
 		Assert(result == HeapTupleSelfUpdated ||
 			   result == HeapTupleUpdated ||
 			   result == HeapTupleBeingUpdated);
@@ -3245,9 +3407,13 @@ l2:
 			hufd->cmax = HeapTupleHeaderGetCmax(oldtup.t_data);
 		else
 			hufd->cmax = 0;		/* for lack of an InvalidCommandId value */
+		carry_lock = (have_tuple_lock && result == HeapTupleUpdated &&
+					  HeapTupleHeaderIsHotUpdated(oldtup.t_data));
 		UnlockReleaseBuffer(buffer);
-		if (have_tuple_lock)
-			UnlockTupleTuplock(relation, &(oldtup.t_self), *lockmode);
+		if (carry_lock)
+			CarryTupleLock(relation, &locktid, *lockmode);
+		else if (have_tuple_lock)
+			UnlockTupleTuplock(relation, &locktid, *lockmode);
 		if (vmbuffer != InvalidBuffer)
 			ReleaseBuffer(vmbuffer);
 		bms_free(hot_attrs);
@@ -3613,7 +3779,7 @@ l2:
 	 * Release the lmgr tuple lock, if we had it.
 	 */
 	if (have_tuple_lock)
-		UnlockTupleTuplock(relation, &(oldtup.t_self), *lockmode);
+		UnlockTupleTuplock(relation, &locktid, *lockmode);
 
 	pgstat_count_heap_update(relation, use_hot_update);
 
@@ -3920,6 +4086,7 @@ heap_lock_tuple(Relation relation, HeapTuple tuple,
 				new_infomask,
 				new_infomask2;
 	bool		have_tuple_lock = false;
+	ItemPointerData locktid;
 
 	*buffer = ReadBuffer(relation, ItemPointerGetBlockNumber(tid));
 	LockBuffer(*buffer, BUFFER_LOCK_EXCLUSIVE);
@@ -3932,6 +4099,9 @@ heap_lock_tuple(Relation relation, HeapTuple tuple,
 	tuple->t_len = ItemIdGetLength(lp);
 	tuple->t_tableOid = RelationGetRelid(relation);
 
+	have_tuple_lock = AdoptCarriedTupleLock(relation, page, tid, mode,
+											&locktid);
+
 l3:
 	result = HeapTupleSatisfiesUpdate(tuple->t_data, cid, *buffer);
 
@@ -3953,6 +4123,8 @@ l3:
 		infomask = tuple->t_data->t_infomask;
 		infomask2 = tuple->t_data->t_infomask2;
 		ItemPointerCopy(&tuple->t_data->t_ctid, &t_ctid);
+		if (!have_tuple_lock)
+			GetTupleLockTid(page, tid, &locktid);
 
 		LockBuffer(*buffer, BUFFER_LOCK_UNLOCK);
 
@@ -3987,7 +4159,7 @@ l3:
 					if (membermode >= mode)
 					{
 						if (have_tuple_lock)
-							UnlockTupleTuplock(relation, tid, mode);
+							UnlockTupleTuplock(relation, &locktid, mode);
 
 						pfree(members);
 						return HeapTupleMayBeUpdated;
@@ -4011,14 +4183,14 @@ l3:
 		{
 			if (nowait)
 			{
-				if (!ConditionalLockTupleTuplock(relation, tid, mode))
+				if (!ConditionalLockTupleTuplock(relation, &locktid, mode))
 					ereport(ERROR,
 							(errcode(ERRCODE_LOCK_NOT_AVAILABLE),
 					errmsg("could not obtain lock on row in relation \"%s\"",
 						   RelationGetRelationName(relation))));
 			}
 			else
-				LockTupleTuplock(relation, tid, mode);
+				WaitLockTupleTuplock(relation, &locktid, mode);
 			have_tuple_lock = true;
 		}
 
@@ -4347,6 +4519,8 @@ l3:
 failed:
 	if (result != HeapTupleMayBeUpdated)
 	{
+		bool		carry_lock;
+
 		Assert(result == HeapTupleSelfUpdated || result == HeapTupleUpdated);
 		Assert(!(tuple->t_data->t_infomask & HEAP_XMAX_INVALID));
 		hufd->ctid = tuple->t_data->t_ctid;
@@ -4355,9 +4529,13 @@ failed:
 			hufd->cmax = HeapTupleHeaderGetCmax(tuple->t_data);
 		else
 			hufd->cmax = 0;		/* for lack of an InvalidCommandId value */
+		carry_lock = (have_tuple_lock && result == HeapTupleUpdated &&
+					  HeapTupleHeaderIsHotUpdated(tuple->t_data));
 		LockBuffer(*buffer, BUFFER_LOCK_UNLOCK);
-		if (have_tuple_lock)
-			UnlockTupleTuplock(relation, tid, mode);
+		if (carry_lock)
+			CarryTupleLock(relation, &locktid, mode);
+		else if (have_tuple_lock)
+			UnlockTupleTuplock(relation, &locktid, mode);
 		return result;
 	}
 
@@ -4391,7 +4569,7 @@ failed:
 		LockBuffer(*buffer, BUFFER_LOCK_UNLOCK);
 		/* Probably can't hold tuple lock here, but may as well check */
 		if (have_tuple_lock)
-			UnlockTupleTuplock(relation, tid, mode);
+			UnlockTupleTuplock(relation, &locktid, mode);
 		return HeapTupleMayBeUpdated;
 	}
 
@@ -4499,11 +4677,133 @@ failed:
 	 * release the lmgr tuple lock, if we had it.
 	 */
 	if (have_tuple_lock)
-		UnlockTupleTuplock(relation, tid, mode);
+		UnlockTupleTuplock(relation, &locktid, mode);
 
 	return HeapTupleMayBeUpdated;
 }
 
+/*
+ * GetTupleLockTid - determine which TID to take the tuple lock on
+ *
+ * The tuple lock of a heap-only tuple is taken on the root line pointer of
+ * its HOT chain rather than on the tuple itself.  That way, all versions of
+ * a frequently updated row share one wait queue in the lock manager, and
+ * because the lock manager grants a released lock to waiters in FIFO order,
+ * the lock is handed directly to whoever has waited longest for the row,
+ * no matter which version of it they originally found.  Otherwise, waiters
+ * that arrived on different versions would queue separately, and each
+ * update of the row would start a new race between them.
+ *
+ * Caller must hold at least a share lock on the buffer containing the page.
+ */
+static void
+GetTupleLockTid(Page page, ItemPointer tid, ItemPointer locktid)
+{
+	OffsetNumber offnum = ItemPointerGetOffsetNumber(tid);
+	ItemId		lp = PageGetItemId(page, offnum);
+
+	ItemPointerCopy(tid, locktid);
+
+	if (ItemIdIsNormal(lp) &&
+		HeapTupleHeaderIsHeapOnly((HeapTupleHeader) PageGetItem(page, lp)))
+	{
+		OffsetNumber root_offsets[MaxHeapTuplesPerPage];
+
+		heap_get_root_tuples(page, root_offsets);
+
+		/* a tuple not reachable from any root keeps its own TID */
+		if (root_offsets[offnum - 1] != InvalidOffsetNumber)
+			ItemPointerSetOffsetNumber(locktid, root_offsets[offnum - 1]);
+	}
+}
+
+/*
+ * CarryTupleLock - keep a tuple lock across a HeapTupleUpdated return
+ *
+ * When the tuple we waited for turns out to have been HOT-updated, the
+ * caller is going to follow the update chain (see EvalPlanQual) and try
+ * again on the newer version, whose tuple lock has the same tag.  Instead of
+ * releasing our tuple lock and queueing up behind everyone else who is
+ * waiting for the row, we hang on to it, and let the next heap_delete,
+ * heap_update or heap_lock_tuple call adopt it.
+ */
+static void
+CarryTupleLock(Relation relation, ItemPointer locktid, LockTupleMode mode)
+{
+	heap_release_carried_tuple_lock();
+
+	SET_LOCKTAG_TUPLE(carriedTupleLock.tag,
+					  relation->rd_lockInfo.lockRelId.dbId,
+					  relation->rd_lockInfo.lockRelId.relId,
+					  ItemPointerGetBlockNumber(locktid),
+					  ItemPointerGetOffsetNumber(locktid));
+	carriedTupleLock.mode = mode;
+	carriedTupleLock.lxid = MyProc->lxid;
+	carriedTupleLock.subxid = GetCurrentSubTransactionId();
+	carriedTupleLock.held = true;
+}
+
+/*
+ * AdoptCarriedTupleLock - take over a tuple lock left by CarryTupleLock
+ *
+ * Returns true, and sets *locktid, if the carried lock is for the tuple at
+ * tid in the given mode, in which case the caller now holds it.  Any other
+ * carried lock is released.  Caller must hold a lock on the buffer containing
+ * the page.
+ */
+static bool
+AdoptCarriedTupleLock(Relation relation, Page page, ItemPointer tid,
+					  LockTupleMode mode, ItemPointer locktid)
+{
+	LOCKTAG		tag;
+
+	if (!carriedTupleLock.held)
+		return false;
+
+	GetTupleLockTid(page, tid, locktid);
+	SET_LOCKTAG_TUPLE(tag,
+					  relation->rd_lockInfo.lockRelId.dbId,
+					  relation->rd_lockInfo.lockRelId.relId,
+					  ItemPointerGetBlockNumber(locktid),
+					  ItemPointerGetOffsetNumber(locktid));
+
+	if (carriedTupleLock.mode == mode &&
+		carriedTupleLock.lxid == MyProc->lxid &&
+		carriedTupleLock.subxid == GetCurrentSubTransactionId() &&
+		memcmp(&carriedTupleLock.tag, &tag, sizeof(LOCKTAG)) == 0)
+	{
+		carriedTupleLock.held = false;
+		return true;
+	}
+
+	heap_release_carried_tuple_lock();
+	return false;
+}
+
+/*
+ * heap_release_carried_tuple_lock - release a tuple lock kept by
+ *		CarryTupleLock, if there is one
+ *
+ * Callers that follow an update chain and give up before calling
+ * heap_lock_tuple on the newer version must call this, so that the lock
+ * isn't held until end of transaction.  If the transaction or subtransaction
+ * that took the lock is gone, the lock manager has already released it (or,
+ * for a committed subtransaction, will release it at the end of the top
+ * transaction), so we just forget about it.
+ */
+void
+heap_release_carried_tuple_lock(void)
+{
+	if (!carriedTupleLock.held)
+		return;
+
+	carriedTupleLock.held = false;
+	if (carriedTupleLock.lxid == MyProc->lxid &&
+		carriedTupleLock.subxid == GetCurrentSubTransactionId())
+		LockRelease(&carriedTupleLock.tag,
+					tupleLockExtraInfo[carriedTupleLock.mode].hwlock, false);
+}
+
 
 /*
  * Given an original set of Xmax and infomask, and a transaction (identified by
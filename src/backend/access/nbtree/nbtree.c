@@ -332,7 +332,11 @@ btgettuple(PG_FUNCTION_ARGS)
 
 		/* If we have a tuple, return it ... */
 		if (res)
+		{
+			if (scan->xs_heap_prefetch)
+				_bt_prefetch_heap(scan, dir);
 			break;
+		}
 		/* ... otherwise see if we have more array keys to deal with */
 	} while (so->numArrayKeys && _bt_advance_array_keys(scan, dir));
 
@@ -432,6 +436,7 @@ btbeginscan(PG_FUNCTION_ARGS)
 
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
+	so->prefetchTarget = 0;
 
 	/*
 	 * We don't know yet whether the scan will be index-only, so we do not
@@ -477,6 +482,7 @@ btrescan(PG_FUNCTION_ARGS)
 		so->markPos.buf = InvalidBuffer;
 	}
 	so->markItemIndex = -1;
+	so->prefetchTarget = 0;
 
 	/*
 	 * Allocate tuple workspace arrays, if needed for an index-only scan and
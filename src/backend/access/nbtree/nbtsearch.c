@@ -19,6 +19,7 @@
 #include "access/relscan.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/bufmgr.h"
 #include "storage/predicate.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
@@ -1112,6 +1113,7 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 		so->currPos.firstItem = 0;
 		so->currPos.lastItem = itemIndex - 1;
 		so->currPos.itemIndex = 0;
+		so->currPos.prefetchItem = 0;
 	}
 	else
 	{
@@ -1143,11 +1145,101 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 		so->currPos.firstItem = itemIndex;
 		so->currPos.lastItem = MaxIndexTuplesPerPage - 1;
 		so->currPos.itemIndex = MaxIndexTuplesPerPage - 1;
+		so->currPos.prefetchItem = MaxIndexTuplesPerPage - 1;
 	}
 
+	/* nothing on the new page has been prefetched yet */
+	so->currPos.prefetchPages = 0;
+	so->currPos.prefetchBlock = InvalidBlockNumber;
+	so->currPos.heapBlock = InvalidBlockNumber;
+
 	return (so->currPos.firstItem <= so->currPos.lastItem);
 }
 
+/*
+ *	_bt_prefetch_heap() -- prefetch heap blocks of upcoming items
+ *
+ * Called after each item is returned to the caller of an index scan that
+ * will fetch every heap tuple (scan->xs_heap_prefetch).  We keep up to
+ * so->prefetchTarget distinct heap blocks of the items that follow on the
+ * current index page prefetched, so that the heap fetches for them don't
+ * each have to wait for a synchronous read.  As in bitmap heap scans, the
+ * distance starts small and ramps up to target_prefetch_pages, so that a
+ * scan that stops after a few tuples doesn't issue a lot of useless I/O.
+ *
+ * We only look at the current index page; we don't try to prefetch across
+ * page boundaries.
+ */
+void
+_bt_prefetch_heap(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTScanPos	pos = &so->currPos;
+	BlockNumber curblock;
+
+	if (target_prefetch_pages <= 0 || scan->heapRelation == NULL)
+		return;
+
+	curblock = ItemPointerGetBlockNumber(&pos->items[pos->itemIndex].heapTid);
+
+	/*
+	 * Moving to a new heap block uses up one of the blocks we prefetched,
+	 * and is a good time to widen the prefetch distance.
+	 */
+	if (curblock != pos->heapBlock)
+	{
+		pos->heapBlock = curblock;
+		if (pos->prefetchPages > 0)
+			pos->prefetchPages--;
+
+		if (so->prefetchTarget >= target_prefetch_pages)
+			 /* don't increase any further */ ;
+		else if (so->prefetchTarget >= target_prefetch_pages / 2)
+			so->prefetchTarget = target_prefetch_pages;
+		else if (so->prefetchTarget > 0)
+			so->prefetchTarget *= 2;
+		else
+			so->prefetchTarget++;
+	}
+
+	/*
+	 * Don't let the prefetch cursor fall behind the scan; this also takes
+	 * care of the caller reversing the scan direction.
+	 */
+	if (ScanDirectionIsForward(dir))
+	{
+		if (pos->prefetchItem <= pos->itemIndex)
+			pos->prefetchItem = pos->itemIndex + 1;
+	}
+	else
+	{
+		if (pos->prefetchItem >= pos->itemIndex)
+			pos->prefetchItem = pos->itemIndex - 1;
+	}
+
+	while (pos->prefetchPages < so->prefetchTarget &&
+		   pos->prefetchItem >= pos->firstItem &&
+		   pos->prefetchItem <= pos->lastItem)
+	{
+		BlockNumber blkno;
+
+		blkno = ItemPointerGetBlockNumber(&pos->items[pos->prefetchItem].heapTid);
+
+		if (ScanDirectionIsForward(dir))
+			pos->prefetchItem++;
+		else
+			pos->prefetchItem--;
+
+		/* Runs of items pointing into the same heap block are common */
+		if (blkno == curblock || blkno == pos->prefetchBlock)
+			continue;
+
+		PrefetchBuffer(scan->heapRelation, MAIN_FORKNUM, blkno);
+		pos->prefetchBlock = blkno;
+		pos->prefetchPages++;
+	}
+}
+
 /* Save an index item into so->currPos.items[itemIndex] */
 static void
 _bt_saveitem(BTScanOpaque so, int itemIndex,
@@ -89,6 +89,9 @@ xlog_desc(StringInfo buf, uint8 xl_info, char *rec)
 		appendStringInfo(buf, "full-page image: %s block %u",
 						 relpathperm(bkp->node, bkp->fork),
 						 bkp->block);
+		if (bkp->flags & BKPBLOCK_COMPRESSED)
+			appendStringInfo(buf, " (compressed to %u bytes)",
+							 bkp->block_len);
 	}
 	else if (info == XLOG_BACKUP_END)
 	{
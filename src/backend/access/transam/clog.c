@@ -76,6 +76,9 @@ static SlruCtlData ClogCtlData;
 
 #define ClogCtl (&ClogCtlData)
 
+/* GUC variable: number of CLOG buffers, or 0 to size automatically */
+int			clog_buffers = 0;
+
 
 static int	ZeroCLOGPage(int pageno, bool writeXlog);
 static bool CLOGPagePrecedes(int page1, int page2);
@@ -418,26 +421,23 @@ TransactionIdGetStatus(TransactionId xid, XLogRecPtr *lsn)
  * large multi-processor system, it was possible to have more CLOG page
  * requests in flight at one time than the numebr of CLOG buffers which existed
  * at that time, which was hardcoded to 8.	Further testing revealed that
- * performance dropped off with more than 32 CLOG buffers, possibly because
- * the linear buffer search algorithm doesn't scale well.
- *
- * Unconditionally increasing the number of CLOG buffers to 32 did not seem
- * like a good idea, because it would increase the minimum amount of shared
- * memory required to start, which could be a problem for people running very
- * small configurations.  The following formula seems to represent a reasonable
- * compromise: people with very low values for shared_buffers will get fewer
- * CLOG buffers as well, and everyone else will get 32.
+ * performance dropped off with more than 32 CLOG buffers, because of the
+ * linear buffer search algorithm.  slru.c now searches only one bank of
+ * buffers at a time, so that limit no longer applies.
  *
- * It is likely that some further work will be needed here in future releases;
- * for example, on a 64-core server, the maximum number of CLOG requests that
- * can be simultaneously in flight will be even larger.  But that will
- * apparently require more than just changing the formula, so for now we take
- * the easy way out.
+ * Unless clog_buffers says otherwise, people with very low values for
+ * shared_buffers get fewer CLOG buffers, so as not to increase the minimum
+ * amount of shared memory required to start, and everyone else gets one
+ * buffer per 512 shared buffers, up to 128 (1MB).  Systems with long-running
+ * transactions and a wide range of XIDs in play may want more, to keep
+ * TransactionIdGetStatus() from having to read pg_clog pages from disk.
  */
 Size
 CLOGShmemBuffers(void)
 {
-	return Min(32, Max(4, NBuffers / 512));
+	if (clog_buffers > 0)
+		return clog_buffers;
+	return Min(128, Max(4, NBuffers / 512));
 }
 
 /*
@@ -0,0 +1,414 @@
+/*-------------------------------------------------------------------------
+ *
+ * csnlog.c
+ *		Commit sequence number log manager
+ *
+ * The pg_csnlog manager is a pg_clog-like manager that stores the commit
+ * sequence number (CSN) of each committed transaction.  CSNs are handed out
+ * from ShmemVariableCache->nextCommitSeqNo while a committing transaction
+ * is removed from the ProcArray, so a snapshot can be represented by the
+ * value of the counter at the time it was taken: a transaction is visible
+ * to the snapshot if and only if it has a CSN older than the snapshot's.
+ * That makes an MVCC visibility check one comparison plus a lookup here,
+ * rather than a search of the snapshot's xip arrays.
+ *
+ * A committing transaction takes its CSN under ProcArrayLock, as it leaves
+ * the ProcArray; it brings the CSN log page into memory beforehand so that
+ * this seldom needs I/O.  Only the top-level XID gets its CSN that way.
+ * The committing backend marks its subtransactions with CommitSeqNoSubTrans
+ * beforehand, meaning "look up the top-level transaction in pg_subtrans",
+ * and fills in their real CSN once the top-level XID has one.  An XID with
+ * no CSN at all is still running, or aborted.
+ *
+ * Like pg_subtrans, we only need to remember CSNs for transactions that
+ * some snapshot might still consider running, so there is no need to
+ * preserve data over a crash and restart, and no XLOG interaction.  During
+ * database startup, we force the currently-active pages to zeroes, and mark
+ * the XIDs on them that pg_clog shows as committed with CommitSeqNoFrozen,
+ * which every snapshot sees as committed.
+ *
+ * This is only compiled when USE_CSN_SNAPSHOTS is defined; see
+ * pg_config_manual.h.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/backend/access/transam/csnlog.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/csnlog.h"
+#include "access/slru.h"
+#include "access/transam.h"
+
+#ifdef USE_CSN_SNAPSHOTS
+
+/*
+ * Defines for CSNLog page sizes.  A page is the same BLCKSZ as is used
+ * everywhere else in Postgres.
+ *
+ * CommitSeqNos are 32 bits wide, the same as TransactionIds, so page and
+ * segment numbering wrap around exactly as in pg_subtrans.  We need take no
+ * explicit notice of that fact in this module, except when comparing segment
+ * and page numbers in TruncateCSNLOG (see CSNLogPagePrecedes).
+ */
+
+/* We need four bytes per xact */
+#define CSNLOG_XACTS_PER_PAGE (BLCKSZ / sizeof(CommitSeqNo))
+
+#define TransactionIdToPage(xid) ((xid) / (TransactionId) CSNLOG_XACTS_PER_PAGE)
+#define TransactionIdToEntry(xid) ((xid) % (TransactionId) CSNLOG_XACTS_PER_PAGE)
+
+
+/*
+ * Link to shared-memory data structures for CSNLog control
+ */
+static SlruCtlData CSNLogCtlData;
+
+#define CSNLogCtl  (&CSNLogCtlData)
+
+/* GUC variable: number of SLRU buffers to use for the CSN log */
+int			csnlog_buffers = 32;
+
+
+static int	ZeroCSNLOGPage(int pageno);
+static bool CSNLogPagePrecedes(int page1, int page2);
+
+
+/*
+ * Make sure the CSN log page of a committing transaction is in a buffer.
+ *
+ * Called before taking ProcArrayLock to end the transaction, so that
+ * CSNLogAssignCommitSeqNo() seldom has to do I/O while that lock is held.
+ * ExtendCSNLOG normally left the page in memory anyway, but it may since
+ * have been evicted.
+ */
+void
+CSNLogPrepareCommitSeqNo(TransactionId xid)
+{
+	Assert(TransactionIdIsNormal(xid));
+
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+	(void) SimpleLruReadPage(CSNLogCtl, TransactionIdToPage(xid), true, xid);
+	LWLockRelease(CSNLogControlLock);
+}
+
+/*
+ * Give a committed top-level transaction the next CSN.
+ *
+ * This is called while holding ProcArrayLock in exclusive mode, at the
+ * moment the transaction stops being shown as running in the ProcArray.
+ * GetSnapshotData() reads nextCommitSeqNo under ProcArrayLock too, so no
+ * snapshot can see the new counter value while the XID is still running.
+ */
+void
+CSNLogAssignCommitSeqNo(TransactionId xid)
+{
+	int			pageno = TransactionIdToPage(xid);
+	int			entryno = TransactionIdToEntry(xid);
+	int			slotno;
+	CommitSeqNo *ptr;
+
+	Assert(TransactionIdIsNormal(xid));
+
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+	slotno = SimpleLruReadPage(CSNLogCtl, pageno, true, xid);
+	ptr = (CommitSeqNo *) CSNLogCtl->shared->page_buffer[slotno];
+	ptr[entryno] = ShmemVariableCache->nextCommitSeqNo;
+
+	CSNLogCtl->shared->page_dirty[slotno] = true;
+
+	LWLockRelease(CSNLogControlLock);
+
+	CommitSeqNoAdvance(ShmemVariableCache->nextCommitSeqNo);
+}
+
+/*
+ * Record a given CSN for a single transaction, e.g. CommitSeqNoFrozen.
+ */
+void
+CSNLogSetCommitSeqNo(TransactionId xid, CommitSeqNo csn)
+{
+	int			pageno = TransactionIdToPage(xid);
+	int			entryno = TransactionIdToEntry(xid);
+	int			slotno;
+	CommitSeqNo *ptr;
+
+	Assert(TransactionIdIsNormal(xid));
+
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+	slotno = SimpleLruReadPage(CSNLogCtl, pageno, true, xid);
+	ptr = (CommitSeqNo *) CSNLogCtl->shared->page_buffer[slotno];
+	ptr[entryno] = csn;
+
+	CSNLogCtl->shared->page_dirty[slotno] = true;
+
+	LWLockRelease(CSNLogControlLock);
+}
+
+/*
+ * Record the same CSN, or CommitSeqNoSubTrans, for a set of subtransactions.
+ *
+ * Consecutive subxids nearly always fall on the same page, so we only look
+ * up a page again when we move off the current one.
+ */
+void
+CSNLogSetCommitSeqNoTree(int nsubxids, TransactionId *subxids,
+						 CommitSeqNo csn)
+{
+	int			curpageno = -1;
+	int			slotno = -1;
+	int			i;
+
+	if (nsubxids == 0)
+		return;
+
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+	for (i = 0; i < nsubxids; i++)
+	{
+		int			pageno = TransactionIdToPage(subxids[i]);
+		CommitSeqNo *ptr;
+
+		if (pageno != curpageno)
+		{
+			slotno = SimpleLruReadPage(CSNLogCtl, pageno, true, subxids[i]);
+			curpageno = pageno;
+		}
+
+		ptr = (CommitSeqNo *) CSNLogCtl->shared->page_buffer[slotno];
+		ptr[TransactionIdToEntry(subxids[i])] = csn;
+
+		CSNLogCtl->shared->page_dirty[slotno] = true;
+	}
+
+	LWLockRelease(CSNLogControlLock);
+}
+
+/*
+ * Interrogate the CSN of a transaction in the CSN log.
+ *
+ * The caller is responsible for resolving CommitSeqNoSubTrans, and must not
+ * ask about an XID that might precede the oldest xmin of any running
+ * transaction, since its page might have been truncated away.  (Unlike
+ * SubTransGetParent, we can't Assert against TransactionXmin: COMMIT
+ * PREPARED asks about a prepared XID that is typically older than that.)
+ */
+CommitSeqNo
+CSNLogGetCommitSeqNo(TransactionId xid)
+{
+	int			pageno = TransactionIdToPage(xid);
+	int			entryno = TransactionIdToEntry(xid);
+	int			slotno;
+	CommitSeqNo csn;
+
+	/* lock is acquired by SimpleLruReadPage_ReadOnly */
+
+	slotno = SimpleLruReadPage_ReadOnly(CSNLogCtl, pageno, xid);
+	csn = ((CommitSeqNo *) CSNLogCtl->shared->page_buffer[slotno])[entryno];
+
+	LWLockRelease(CSNLogControlLock);
+
+	return csn;
+}
+
+
+/*
+ * Initialization of shared memory for CSNLOG
+ */
+Size
+CSNLOGShmemSize(void)
+{
+	return SimpleLruShmemSize(csnlog_buffers, 0);
+}
+
+void
+CSNLOGShmemInit(void)
+{
+	CSNLogCtl->PagePrecedes = CSNLogPagePrecedes;
+	SimpleLruInit(CSNLogCtl, "CSNLOG Ctl", csnlog_buffers, 0,
+				  CSNLogControlLock, "pg_csnlog");
+	/* Override default assumption that writes should be fsync'd */
+	CSNLogCtl->do_fsync = false;
+}
+
+/*
+ * Initialize (or reinitialize) a page of CSNLOG to zeroes.
+ *
+ * The page is not actually written, just set up in shared memory.
+ * The slot number of the new page is returned.
+ *
+ * Control lock must be held at entry, and will be held at exit.
+ */
+static int
+ZeroCSNLOGPage(int pageno)
+{
+	return SimpleLruZeroPage(CSNLogCtl, pageno);
+}
+
+/*
+ * This must be called ONCE during postmaster or standalone-backend startup,
+ * at the end of recovery, before any new XIDs are assigned.
+ *
+ * oldestActiveXID is the oldest XID of any prepared transaction, or nextXid
+ * if there are none.
+ */
+void
+StartupCSNLOG(TransactionId oldestActiveXID)
+{
+	TransactionId nextXid = ShmemVariableCache->nextXid;
+	TransactionId xid;
+	int			startPage;
+	int			endPage;
+
+	/*
+	 * Since we don't expect pg_csnlog to be valid across crashes, we
+	 * initialize the currently-active page(s) to zeroes during startup.
+	 * Whenever we advance into a new page, ExtendCSNLOG will likewise zero
+	 * the new page without regard to whatever was previously on disk.
+	 */
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+	startPage = TransactionIdToPage(oldestActiveXID);
+	endPage = TransactionIdToPage(nextXid);
+
+	while (startPage != endPage)
+	{
+		(void) ZeroCSNLOGPage(startPage);
+		startPage++;
+	}
+	(void) ZeroCSNLOGPage(startPage);
+
+	LWLockRelease(CSNLogControlLock);
+
+	/*
+	 * XIDs between the oldest prepared transaction and nextXid may have
+	 * committed before the restart.  Snapshots taken from now on can have
+	 * an xmin that old, so those XIDs need a CSN that all of them see as
+	 * committed; a zero would make them look like they're still running.
+	 * The prepared transactions themselves, and everything that aborted,
+	 * are left at zero.  pg_clog and pg_subtrans have already been started
+	 * up, so TransactionIdDidCommit() works.
+	 */
+	xid = oldestActiveXID;
+	while (TransactionIdPrecedes(xid, nextXid))
+	{
+		if (TransactionIdDidCommit(xid))
+			CSNLogSetCommitSeqNo(xid, CommitSeqNoFrozen);
+		TransactionIdAdvance(xid);
+	}
+}
+
+/*
+ * This must be called ONCE during postmaster or standalone-backend shutdown
+ */
+void
+ShutdownCSNLOG(void)
+{
+	/*
+	 * Flush dirty CSNLOG pages to disk
+	 *
+	 * This is not actually necessary from a correctness point of view. We do
+	 * it merely as a debugging aid.
+	 */
+	SimpleLruFlush(CSNLogCtl, false);
+}
+
+/*
+ * Perform a checkpoint --- either during shutdown, or on-the-fly
+ */
+void
+CheckPointCSNLOG(void)
+{
+	/*
+	 * Flush dirty CSNLOG pages to disk
+	 *
+	 * This is not actually necessary from a correctness point of view. We do
+	 * it merely to improve the odds that writing of dirty pages is done by
+	 * the checkpoint process and not by backends.
+	 */
+	SimpleLruFlush(CSNLogCtl, true);
+}
+
+
+/*
+ * Make sure that CSNLOG has room for a newly-allocated XID.
+ *
+ * NB: this is called while holding XidGenLock.  We want it to be very fast
+ * most of the time; even when it's not so fast, no actual I/O need happen
+ * unless we're forced to write out a dirty CSNLOG page to make room
+ * in shared memory.
+ */
+void
+ExtendCSNLOG(TransactionId newestXact)
+{
+	int			pageno;
+
+	/*
+	 * No work except at first XID of a page.  But beware: just after
+	 * wraparound, the first XID of page zero is FirstNormalTransactionId.
+	 */
+	if (TransactionIdToEntry(newestXact) != 0 &&
+		!TransactionIdEquals(newestXact, FirstNormalTransactionId))
+		return;
+
+	pageno = TransactionIdToPage(newestXact);
+
+	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+	/* Zero the page */
+	ZeroCSNLOGPage(pageno);
+
+	LWLockRelease(CSNLogControlLock);
+}
+
+
+/*
+ * Remove all CSNLOG segments before the one holding the passed transaction ID
+ *
+ * This is normally called during checkpoint, with oldestXact being the
+ * oldest TransactionXmin of any running transaction.
+ */
+void
+TruncateCSNLOG(TransactionId oldestXact)
+{
+	int			cutoffPage;
+
+	/*
+	 * The cutoff point is the start of the segment containing oldestXact. We
+	 * pass the *page* containing oldestXact to SimpleLruTruncate.
+	 */
+	cutoffPage = TransactionIdToPage(oldestXact);
+
+	SimpleLruTruncate(CSNLogCtl, cutoffPage);
+}
+
+
+/*
+ * Decide which of two CSNLOG page numbers is "older" for truncation purposes.
+ *
+ * We need to use comparison of TransactionIds here in order to do the right
+ * thing with wraparound XID arithmetic.  However, if we are asked about
+ * page number zero, we don't want to hand InvalidTransactionId to
+ * TransactionIdPrecedes: it'll get weird about permanent xact IDs.  So,
+ * offset both xids by FirstNormalTransactionId to avoid that.
+ */
+static bool
+CSNLogPagePrecedes(int page1, int page2)
+{
+	TransactionId xid1;
+	TransactionId xid2;
+
+	xid1 = ((TransactionId) page1) * CSNLOG_XACTS_PER_PAGE;
+	xid1 += FirstNormalTransactionId;
+	xid2 = ((TransactionId) page2) * CSNLOG_XACTS_PER_PAGE;
+	xid2 += FirstNormalTransactionId;
+
+	return TransactionIdPrecedes(xid1, xid2);
+}
+
+#endif   /* USE_CSN_SNAPSHOTS */
@@ -7,11 +7,15 @@
  * buffers.  Under ordinary circumstances we expect that write
  * traffic will occur mostly to the latest page (and to the just-prior
  * page, soon after a page transition).  Read traffic will probably touch
- * a larger span of pages, but in any case a fairly small number of page
- * buffers should be sufficient.  So, we just search the buffers using plain
- * linear search; there's no need for a hashtable or anything fancy.
- * The management algorithm is straight LRU except that we will never swap
- * out the latest page (since we know it's going to be hit again eventually).
+ * a larger span of pages; with long-running transactions, CLOG lookups can
+ * touch a great many pages, so the number of buffers is configurable and
+ * may be large.  To keep lookups cheap regardless, the buffers are divided
+ * into banks of SLRU_BANK_SIZE slots, and a page can only ever be stored in
+ * the bank that its page number hashes to.  Finding a page, or a victim
+ * slot to replace, is then a linear search of a single bank.
+ * The management algorithm is straight LRU within the bank, except that we
+ * will never swap out the latest page (since we know it's going to be hit
+ * again eventually).
  *
  * We use a control LWLock to protect the shared data structures, plus
  * per-buffer LWLocks that synchronize I/O for each buffer.  The control lock
@@ -54,6 +58,7 @@
 #include "access/slru.h"
 #include "access/transam.h"
 #include "access/xlog.h"
+#include "pgstat.h"
 #include "storage/fd.h"
 #include "storage/shmem.h"
 #include "miscadmin.h"
@@ -80,6 +85,19 @@ typedef struct SlruFlushData
 
 typedef struct SlruFlushData *SlruFlush;
 
+/*
+ * Compute the range of slots [start, end) that page pageno may be stored in.
+ * The last bank absorbs any slots left over when num_slots isn't a multiple
+ * of the bank size.
+ */
+#define SlruBankRange(shared, pageno, start, end) \
+	do { \
+		int		bankno = (uint32) (pageno) % (shared)->num_banks; \
+		(start) = bankno * (shared)->bank_size; \
+		(end) = (bankno == (shared)->num_banks - 1) ? \
+			(shared)->num_slots : (start) + (shared)->bank_size; \
+	} while (0)
+
 /*
  * Macro to mark a buffer slot "most recently used".  Note multiple evaluation
  * of arguments!
@@ -186,6 +204,18 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 		shared->num_slots = nslots;
 		shared->lsn_groups_per_page = nlsns;
 
+		/* Small SLRUs are a single bank */
+		if (nslots >= 2 * SLRU_BANK_SIZE)
+		{
+			shared->bank_size = SLRU_BANK_SIZE;
+			shared->num_banks = nslots / SLRU_BANK_SIZE;
+		}
+		else
+		{
+			shared->bank_size = nslots;
+			shared->num_banks = 1;
+		}
+
 		shared->cur_lru_count = 0;
 
 		/* shared->latest_page_number will be set later */
@@ -218,7 +248,7 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 			shared->page_status[slotno] = SLRU_PAGE_EMPTY;
 			shared->page_dirty[slotno] = false;
 			shared->page_lru_count[slotno] = 0;
-			shared->buffer_locks[slotno] = LWLockAssign();
+			shared->buffer_locks[slotno] = LWLockAssignTranche(LWTRANCHE_SLRU_BUFFERS);
 			ptr += BLCKSZ;
 		}
 	}
@@ -231,6 +261,7 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 	 */
 	ctl->shared = shared;
 	ctl->do_fsync = true;		/* default behavior */
+	ctl->stats_index = pgstat_slru_index(name);
 	StrNCpy(ctl->Dir, subdir, sizeof(ctl->Dir));
 }
 
@@ -270,6 +301,8 @@ SimpleLruZeroPage(SlruCtl ctl, int pageno)
 	/* Assume this page is now the latest active page */
 	shared->latest_page_number = pageno;
 
+	pgstat_count_slru_page_zeroed(ctl->stats_index);
+
 	return slotno;
 }
 
@@ -387,6 +420,7 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 			}
 			/* Otherwise, it's ready to use */
 			SlruRecentlyUsed(shared, slotno);
+			pgstat_count_slru_page_hit(ctl->stats_index);
 			return slotno;
 		}
 
@@ -408,6 +442,7 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 
 		/* Do the read */
 		ok = SlruPhysicalReadPage(ctl, pageno, slotno);
+		pgstat_count_slru_page_read(ctl->stats_index);
 
 		/* Set the LSNs for this newly read-in page to zero */
 		SimpleLruZeroLSNs(ctl, slotno);
@@ -451,12 +486,15 @@ SimpleLruReadPage_ReadOnly(SlruCtl ctl, int pageno, TransactionId xid)
 {
 	SlruShared	shared = ctl->shared;
 	int			slotno;
+	int			bankstart;
+	int			bankend;
 
 	/* Try to find the page while holding only shared lock */
 	LWLockAcquire(shared->ControlLock, LW_SHARED);
 
 	/* See if page is already in a buffer */
-	for (slotno = 0; slotno < shared->num_slots; slotno++)
+	SlruBankRange(shared, pageno, bankstart, bankend);
+	for (slotno = bankstart; slotno < bankend; slotno++)
 	{
 		if (shared->page_number[slotno] == pageno &&
 			shared->page_status[slotno] != SLRU_PAGE_EMPTY &&
@@ -464,6 +502,7 @@ SimpleLruReadPage_ReadOnly(SlruCtl ctl, int pageno, TransactionId xid)
 		{
 			/* See comments for SlruRecentlyUsed macro */
 			SlruRecentlyUsed(shared, slotno);
+			pgstat_count_slru_page_hit(ctl->stats_index);
 			return slotno;
 		}
 	}
@@ -524,6 +563,7 @@ SlruInternalWritePage(SlruCtl ctl, int slotno, SlruFlush fdata)
 
 	/* Do the write */
 	ok = SlruPhysicalWritePage(ctl, pageno, slotno, fdata);
+	pgstat_count_slru_page_written(ctl->stats_index);
 
 	/* If we failed, and we're in a flush, better close the files */
 	if (!ok && fdata)
@@ -580,6 +620,8 @@ SimpleLruDoesPhysicalPageExist(SlruCtl ctl, int pageno)
 	bool		result;
 	off_t		endpos;
 
+	pgstat_count_slru_page_exists(ctl->stats_index);
+
 	SlruFileName(ctl, path, segno);
 
 	fd = OpenTransientFile(path, O_RDWR | PG_BINARY, S_IRUSR | S_IWUSR);
@@ -933,7 +975,7 @@ SlruReportIOError(SlruCtl ctl, int pageno, TransactionId xid)
  * any slot already holds the target page, and return that slot if so.
  * Thus, the returned slot is *either* a slot already holding the pageno
  * (could be any state except EMPTY), *or* a freeable slot (state EMPTY
- * or CLEAN).
+ * or CLEAN).  Either way, it's in the page's bank.
  *
  * Control lock must be held at entry, and will be held at exit.
  */
@@ -953,9 +995,12 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		int			bestinvalidslot = 0;		/* keep compiler quiet */
 		int			best_invalid_delta = -1;
 		int			best_invalid_page_number = 0;		/* keep compiler quiet */
+		int			bankstart;
+		int			bankend;
 
 		/* See if page already has a buffer assigned */
-		for (slotno = 0; slotno < shared->num_slots; slotno++)
+		SlruBankRange(shared, pageno, bankstart, bankend);
+		for (slotno = bankstart; slotno < bankend; slotno++)
 		{
 			if (shared->page_number[slotno] == pageno &&
 				shared->page_status[slotno] != SLRU_PAGE_EMPTY)
@@ -990,7 +1035,7 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		 * multiple pages with the same lru_count.
 		 */
 		cur_count = (shared->cur_lru_count)++;
-		for (slotno = 0; slotno < shared->num_slots; slotno++)
+		for (slotno = bankstart; slotno < bankend; slotno++)
 		{
 			int			this_delta;
 			int			this_page_number;
@@ -1040,11 +1085,11 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		}
 
 		/*
-		 * If all pages (except possibly the latest one) are I/O busy, we'll
-		 * have to wait for an I/O to complete and then retry.	In that
-		 * unhappy case, we choose to wait for the I/O on the least recently
-		 * used slot, on the assumption that it was likely initiated first of
-		 * all the I/Os in progress and may therefore finish first.
+		 * If all pages in the bank (except possibly the latest one) are I/O
+		 * busy, we'll have to wait for an I/O to complete and then retry.  In
+		 * that unhappy case, we choose to wait for the I/O on the least
+		 * recently used slot, on the assumption that it was likely initiated
+		 * first of all the I/Os in progress and may therefore finish first.
 		 */
 		if (best_valid_delta < 0)
 		{
@@ -1084,6 +1129,8 @@ SimpleLruFlush(SlruCtl ctl, bool checkpoint)
 	int			i;
 	bool		ok;
 
+	pgstat_count_slru_flush(ctl->stats_index);
+
 	/*
 	 * Find and write dirty pages
 	 */
@@ -1143,6 +1190,8 @@ SimpleLruTruncate(SlruCtl ctl, int cutoffPage)
 	SlruShared	shared = ctl->shared;
 	int			slotno;
 
+	pgstat_count_slru_truncate(ctl->stats_index);
+
 	/*
 	 * The cutoff point is the start of the segment containing cutoffPage.
 	 */
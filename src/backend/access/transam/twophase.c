@@ -41,6 +41,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "access/csnlog.h"
 #include "access/htup_details.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
@@ -245,6 +246,8 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 	GlobalTransaction gxact;
 	PGPROC	   *proc;
 	PGXACT	   *pgxact;
+	uint64	   *fpLockBits;
+	Oid		   *fpRelId;
 	int			i;
 
 	if (strlen(gid) >= GIDSIZE)
@@ -309,8 +312,17 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 	proc = &ProcGlobal->allProcs[gxact->pgprocno];
 	pgxact = &ProcGlobal->allPgXact[gxact->pgprocno];
 
-	/* Initialize the PGPROC entry */
+	/*
+	 * Initialize the PGPROC entry, keeping the fast-path lock arrays that
+	 * InitProcGlobal assigned to it.  Any fast-path locks of the prepared
+	 * transaction have been transferred to the main lock table by now, so
+	 * the arrays themselves are empty.
+	 */
+	fpLockBits = proc->fpLockBits;
+	fpRelId = proc->fpRelId;
 	MemSet(proc, 0, sizeof(PGPROC));
+	proc->fpLockBits = fpLockBits;
+	proc->fpRelId = fpRelId;
 	proc->pgprocno = gxact->pgprocno;
 	SHMQueueElemInit(&(proc->links));
 	proc->waitStatus = STATUS_OK;
@@ -1330,8 +1342,21 @@ FinishPreparedTransaction(const char *gid, bool isCommit)
 									   hdr->nsubxacts, children,
 									   hdr->nabortrels, abortrels);
 
+#ifdef USE_CSN_SNAPSHOTS
+	/* Subtransactions get their CSN after the parent; see CommitTransaction */
+	if (isCommit)
+		CSNLogSetCommitSeqNoTree(hdr->nsubxacts, children,
+								 CommitSeqNoSubTrans);
+#endif
+
 	ProcArrayRemove(proc, latestXid);
 
+#ifdef USE_CSN_SNAPSHOTS
+	if (isCommit && hdr->nsubxacts > 0)
+		CSNLogSetCommitSeqNoTree(hdr->nsubxacts, children,
+								 CSNLogGetCommitSeqNo(xid));
+#endif
+
 	/*
 	 * In case we fail while running the callbacks, mark the gxact invalid so
 	 * no one else will try to commit/rollback, and so it can be recycled
@@ -14,6 +14,7 @@
 #include "postgres.h"
 
 #include "access/clog.h"
+#include "access/csnlog.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/xact.h"
@@ -161,6 +162,9 @@ GetNewTransactionId(bool isSubXact)
 	 */
 	ExtendCLOG(xid);
 	ExtendSUBTRANS(xid);
+#ifdef USE_CSN_SNAPSHOTS
+	ExtendCSNLOG(xid);
+#endif
 
 	/*
 	 * Now advance the nextXid counter.  This must not happen until after we
@@ -20,6 +20,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "access/csnlog.h"
 #include "access/multixact.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
@@ -1815,6 +1816,10 @@ CommitTransaction(void)
 {
 	TransactionState s = CurrentTransactionState;
 	TransactionId latestXid;
+#ifdef USE_CSN_SNAPSHOTS
+	int			nchildren = 0;
+	TransactionId *children;
+#endif
 
 	ShowTransactionState("CommitTransaction");
 
@@ -1902,6 +1907,20 @@ CommitTransaction(void)
 
 	TRACE_POSTGRESQL_TRANSACTION_COMMIT(MyProc->lxid);
 
+#ifdef USE_CSN_SNAPSHOTS
+
+	/*
+	 * Our subtransactions get their commit sequence number only after our
+	 * top-level XID has one; until then, make snapshots look them up through
+	 * pg_subtrans.
+	 */
+	if (TransactionIdIsValid(latestXid))
+	{
+		nchildren = xactGetCommittedChildren(&children);
+		CSNLogSetCommitSeqNoTree(nchildren, children, CommitSeqNoSubTrans);
+	}
+#endif
+
 	/*
 	 * Let others know about no transaction in progress by me. Note that this
 	 * must be done _before_ releasing locks we hold and _after_
@@ -1909,6 +1928,13 @@ CommitTransaction(void)
 	 */
 	ProcArrayEndTransaction(MyProc, latestXid);
 
+#ifdef USE_CSN_SNAPSHOTS
+	/* Now we have a CSN; give it to our subtransactions too */
+	if (TransactionIdIsValid(latestXid) && nchildren > 0)
+		CSNLogSetCommitSeqNoTree(nchildren, children,
+						CSNLogGetCommitSeqNo(GetTopTransactionIdIfAny()));
+#endif
+
 	/*
 	 * This is all post-commit cleanup.  Note that if an error is raised here,
 	 * it's too late to abort the transaction.  This should be just
@@ -2286,6 +2312,9 @@ AbortTransaction(void)
 	 */
 	LWLockReleaseAll();
 
+	/* If we errored out of any kind of wait, we aren't waiting anymore */
+	pgstat_report_wait_end();
+
 	/* Clean up buffer I/O and buffer context locks, too */
 	AbortBufferIO();
 	UnlockBuffers();
@@ -4214,6 +4243,8 @@ AbortSubTransaction(void)
 	 */
 	LWLockReleaseAll();
 
+	pgstat_report_wait_end();
+
 	AbortBufferIO();
 	UnlockBuffers();
 
@@ -635,3 +635,99 @@ pg_backup_start_time(PG_FUNCTION_ARGS)
 
 	PG_RETURN_DATUM(xtime);
 }
+
+/*
+ * Returns the number of full-page images that have been written to WAL in
+ * compressed form since server start, and the number of bytes saved by
+ * compressing them.  See wal_compression.
+ */
+Datum
+pg_xlog_compression_stats(PG_FUNCTION_ARGS)
+{
+	uint64		nblocks;
+	uint64		saved;
+	Datum		values[2];
+	bool		isnull[2];
+	TupleDesc	resultTupleDesc;
+	HeapTuple	resultHeapTuple;
+
+	/*
+	 * Construct a tuple descriptor for the result row.  This must match this
+	 * function's pg_proc entry!
+	 */
+	resultTupleDesc = CreateTemplateTupleDesc(2, false);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 1, "compressed_images",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 2, "bytes_saved",
+					   INT8OID, -1, 0);
+	resultTupleDesc = BlessTupleDesc(resultTupleDesc);
+
+	GetXLogCompressionStats(&nblocks, &saved);
+
+	values[0] = Int64GetDatum((int64) nblocks);
+	isnull[0] = false;
+	values[1] = Int64GetDatum((int64) saved);
+	isnull[1] = false;
+
+	resultHeapTuple = heap_form_tuple(resultTupleDesc, values, isnull);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(resultHeapTuple));
+}
+
+/*
+ * Report group commit statistics: how many WAL flushes XLogFlush leaders
+ * did, how many flush requests they served, and how long leaders slept to
+ * gather more requests.  Times are in milliseconds.  Only flushes done while
+ * adaptive_commit_delay is on and commit_delay is nonzero are counted.
+ */
+Datum
+pg_xlog_group_commit_stats(PG_FUNCTION_ARGS)
+{
+	XLogGroupCommitStats stats;
+	Datum		values[8];
+	bool		isnull[8];
+	TupleDesc	resultTupleDesc;
+	HeapTuple	resultHeapTuple;
+
+	/*
+	 * Construct a tuple descriptor for the result row.  This must match this
+	 * function's pg_proc entry!
+	 */
+	resultTupleDesc = CreateTemplateTupleDesc(8, false);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 1, "flushes",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 2, "requests",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 3, "avg_batch_size",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 4, "delays",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 5, "delay_time",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 6, "avg_flush_time",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 7, "avg_request_interval",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(resultTupleDesc, (AttrNumber) 8, "current_delay",
+					   FLOAT8OID, -1, 0);
+	resultTupleDesc = BlessTupleDesc(resultTupleDesc);
+
+	GetXLogGroupCommitStats(&stats);
+
+	MemSet(isnull, false, sizeof(isnull));
+	values[0] = Int64GetDatum((int64) stats.flushes);
+	values[1] = Int64GetDatum((int64) stats.requests);
+	if (stats.flushes > 0)
+		values[2] = Float8GetDatum((double) stats.requests / stats.flushes);
+	else
+		isnull[2] = true;
+	values[3] = Int64GetDatum((int64) stats.delays);
+	values[4] = Float8GetDatum(stats.delayTime / 1000.0);
+	values[5] = Float8GetDatum(stats.avgFlushTime / 1000.0);
+	values[6] = Float8GetDatum(stats.avgRequestInterval / 1000.0);
+	values[7] = Float8GetDatum(stats.currentDelay / 1000.0);
+
+	resultHeapTuple = heap_form_tuple(resultTupleDesc, values, isnull);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(resultHeapTuple));
+}
@@ -0,0 +1,562 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching support for recovery.
+ *
+ * Replaying WAL after a crash, or on a standby whose working set doesn't fit
+ * in shared_buffers, spends most of its time waiting for synchronous reads
+ * of the data blocks that the records modify, one at a time.  To hide that
+ * latency, the startup process keeps a second XLogReader running some
+ * distance ahead of the record being replayed.  For each record it decodes,
+ * we work out which blocks the redo routine is going to read, and issue a
+ * prefetch hint (posix_fadvise) for those that aren't in shared buffers yet,
+ * so that by the time replay reaches the record the I/O has hopefully
+ * completed.
+ *
+ * Blocks that the record carries a full-page image of don't need to be read
+ * at all, and neither do later references to such a block in the look-ahead
+ * window, since replay will find it in shared buffers by then.  The same
+ * goes for pages that a record reinitializes from scratch.
+ *
+ * The WAL format doesn't record generically which blocks a record touches;
+ * only the resource manager knows.  We decode the most common heap and
+ * btree records here, which cover the bulk of the random reads in a typical
+ * recovery.  Records we don't understand are simply not prefetched for.
+ *
+ * The look-ahead reader reads WAL segments from pg_xlog directly and never
+ * waits for more WAL to arrive.  If it hits the end of the available WAL, a
+ * missing segment (as when replaying from the archive) or anything else it
+ * doesn't like, it gives up and starts over once replay has caught up with
+ * it.  Since a prefetch is only a hint, reading a recycled or half-written
+ * segment is harmless as long as the record checks in xlogreader.c reject
+ * it, which they do.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/backend/access/transam/xlogprefetch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/heapam_xlog.h"
+#include "access/nbtree.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "storage/buf_internals.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+
+
+/*
+ * Number of recently prefetched (or full-page-imaged) blocks we remember,
+ * to avoid issuing repeated hints for the same block.  Consecutive records
+ * very often touch the same page, so even a small window catches most
+ * repeats.
+ */
+#define XLOGPREFETCHER_RECENT	64
+
+/* Maximum number of block references we decode from a single record */
+#define XLOGPREFETCHER_MAX_REFS	4
+
+struct XLogPrefetcher
+{
+	XLogReaderState *reader;
+
+	/* Is the reader positioned somewhere ahead of replay? */
+	bool		active;
+
+	/* If not, don't start over until replay has reached this point */
+	XLogRecPtr	resumeAt;
+
+	/* Timeline of the WAL files we read, as told by the caller */
+	TimeLineID	tli;
+
+	/* Currently open WAL segment */
+	int			readFile;
+	XLogSegNo	readSegNo;
+	TimeLineID	readFileTLI;
+
+	/* Ring of recently seen blocks */
+	BufferTag	recent[XLOGPREFETCHER_RECENT];
+	int			recent_next;
+	int			recent_used;
+
+	/* Statistics, reported at the end of recovery */
+	uint64		records;
+	uint64		prefetched;
+	uint64		skip_fpw;
+	uint64		skip_init;
+	uint64		skip_recent;
+	uint64		restarts;
+};
+
+/* GUC variable: how far ahead of replay to read, in kB */
+int			recovery_prefetch_distance = 0;
+
+static int XLogPrefetcherReadPage(XLogReaderState *reader,
+					   XLogRecPtr targetPagePtr, int reqLen,
+					   XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI);
+static void XLogPrefetcherCloseFile(XLogPrefetcher *prefetcher);
+static void XLogPrefetchRecord(XLogPrefetcher *prefetcher,
+				   XLogRecord *record);
+static int XLogPrefetchGetBlockRefs(XLogRecord *record, BufferTag *refs,
+						 int *ninit);
+static bool XLogPrefetcherSeenRecently(XLogPrefetcher *prefetcher,
+						   BufferTag *tag);
+
+
+/*
+ * Create a prefetcher.  It doesn't read anything until XLogPrefetch() is
+ * called.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(void)
+{
+	XLogPrefetcher *prefetcher;
+
+	prefetcher = (XLogPrefetcher *) palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(&XLogPrefetcherReadPage,
+											prefetcher);
+	if (prefetcher->reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+			errdetail("Failed while allocating an XLog reading processor.")));
+	prefetcher->readFile = -1;
+
+	return prefetcher;
+}
+
+/*
+ * Release a prefetcher, after reporting what it did.
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->records > 0)
+		ereport(DEBUG1,
+				(errmsg("recovery prefetch: looked ahead at " UINT64_FORMAT " records, prefetched " UINT64_FORMAT " blocks",
+						prefetcher->records, prefetcher->prefetched),
+				 errdetail("Skipped " UINT64_FORMAT " full-page images, " UINT64_FORMAT " reinitialized pages and " UINT64_FORMAT " repeated blocks; restarted " UINT64_FORMAT " times.",
+						   prefetcher->skip_fpw, prefetcher->skip_init,
+						   prefetcher->skip_recent, prefetcher->restarts)));
+
+	XLogPrefetcherCloseFile(prefetcher);
+	XLogReaderFree(prefetcher->reader);
+	pfree(prefetcher);
+}
+
+/*
+ * Called by the startup process before replaying the record at
+ * ReadRecPtr..EndRecPtr.  Reads ahead until we're recovery_prefetch_distance
+ * bytes beyond EndRecPtr, or until we run out of WAL.  tli is the timeline
+ * that replay is currently reading WAL from.
+ */
+void
+XLogPrefetch(XLogPrefetcher *prefetcher, XLogRecPtr ReadRecPtr,
+			 XLogRecPtr EndRecPtr, TimeLineID tli)
+{
+#ifdef USE_PREFETCH
+	XLogReaderState *reader = prefetcher->reader;
+	XLogRecPtr	target;
+
+	if (recovery_prefetch_distance <= 0)
+		return;
+
+	/* Start over if replay moved to a different timeline */
+	if (prefetcher->active && prefetcher->tli != tli)
+		prefetcher->active = false;
+
+	/* If we've fallen behind replay, start over from the current record */
+	if (prefetcher->active && reader->EndRecPtr <= ReadRecPtr)
+		prefetcher->active = false;
+
+	if (!prefetcher->active)
+	{
+		char	   *errormsg;
+
+		/* If we gave up earlier, wait until replay gets past that point */
+		if (ReadRecPtr < prefetcher->resumeAt && prefetcher->tli == tli)
+			return;
+
+		if (prefetcher->resumeAt != InvalidXLogRecPtr)
+			prefetcher->restarts++;
+		prefetcher->tli = tli;
+
+		/* This returns the record being replayed, which needs no prefetch */
+		if (XLogReadRecord(reader, ReadRecPtr, &errormsg) == NULL)
+		{
+			XLogSegNo	segno;
+
+			/*
+			 * The segment isn't in pg_xlog, most likely because replay is
+			 * reading it from the archive.  Don't try again until the next
+			 * segment.
+			 */
+			XLogPrefetcherCloseFile(prefetcher);
+			XLByteToSeg(ReadRecPtr, segno);
+			XLogSegNoOffsetToRecPtr(segno + 1, 0, prefetcher->resumeAt);
+			return;
+		}
+		prefetcher->active = true;
+	}
+
+	target = EndRecPtr + (XLogRecPtr) recovery_prefetch_distance * 1024;
+	while (reader->EndRecPtr < target)
+	{
+		XLogRecPtr	lastEndRecPtr = reader->EndRecPtr;
+		XLogRecord *record;
+		char	   *errormsg;
+
+		record = XLogReadRecord(reader, InvalidXLogRecPtr, &errormsg);
+		if (record == NULL)
+		{
+			/*
+			 * End of available WAL, or something we can't read.  Try again
+			 * once replay has caught up with us.
+			 */
+			XLogPrefetcherCloseFile(prefetcher);
+			prefetcher->active = false;
+			prefetcher->resumeAt = lastEndRecPtr;
+			break;
+		}
+
+		XLogPrefetchRecord(prefetcher, record);
+	}
+#endif   /* USE_PREFETCH */
+}
+
+/*
+ * Issue prefetch hints for the blocks that replaying a record will read.
+ */
+static void
+XLogPrefetchRecord(XLogPrefetcher *prefetcher, XLogRecord *record)
+{
+	BufferTag	refs[XLOGPREFETCHER_MAX_REFS];
+	int			nrefs;
+	int			ninit;
+	int			i;
+
+	prefetcher->records++;
+
+	/*
+	 * Remember the blocks that the record carries full-page images of.
+	 * Replay restores those without reading them, and later records in the
+	 * look-ahead window will find them in shared buffers.
+	 */
+	if (record->xl_info & XLR_BKP_BLOCK_MASK)
+	{
+		char	   *blk = (char *) XLogRecGetData(record) + record->xl_len;
+
+		for (i = 0; i < XLR_MAX_BKP_BLOCKS; i++)
+		{
+			BkpBlock	bkpb;
+
+			if (!(record->xl_info & XLR_BKP_BLOCK(i)))
+				continue;
+
+			memcpy(&bkpb, blk, sizeof(BkpBlock));
+			blk += sizeof(BkpBlock) + bkpb.block_len;
+
+			INIT_BUFFERTAG(refs[0], bkpb.node, bkpb.fork, bkpb.block);
+			if (!XLogPrefetcherSeenRecently(prefetcher, &refs[0]))
+				prefetcher->skip_fpw++;
+		}
+	}
+
+	/* The first ninit references are pages that replay reinitializes */
+	nrefs = XLogPrefetchGetBlockRefs(record, refs, &ninit);
+	for (i = 0; i < nrefs; i++)
+	{
+		if (XLogPrefetcherSeenRecently(prefetcher, &refs[i]))
+		{
+			prefetcher->skip_recent++;
+			continue;
+		}
+		if (i < ninit)
+		{
+			prefetcher->skip_init++;
+			continue;
+		}
+
+		PrefetchBufferWithoutRelcache(refs[i].rnode, refs[i].forkNum,
+									  refs[i].blockNum);
+		prefetcher->prefetched++;
+	}
+}
+
+/*
+ * Decode the blocks that replaying a record will access.  Fills refs[] and
+ * returns the number of entries; the first *ninit of them are pages that
+ * replay zeroes out rather than reads.  Blocks that the record carries
+ * full-page images of may be included, too.  Returns 0 for records we don't
+ * know how to decode.
+ */
+static int
+XLogPrefetchGetBlockRefs(XLogRecord *record, BufferTag *refs, int *ninit)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *data = XLogRecGetData(record);
+	int			nrefs = 0;
+
+	*ninit = 0;
+
+	if (record->xl_rmid == RM_HEAP_ID)
+	{
+		bool		isinit = (info & XLOG_HEAP_INIT_PAGE) != 0;
+		xl_heaptid *target;
+
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP_INSERT:
+				target = &((xl_heap_insert *) data)->target;
+				break;
+			case XLOG_HEAP_DELETE:
+				target = &((xl_heap_delete *) data)->target;
+				break;
+			case XLOG_HEAP_LOCK:
+				target = &((xl_heap_lock *) data)->target;
+				break;
+			case XLOG_HEAP_INPLACE:
+				target = &((xl_heap_inplace *) data)->target;
+				break;
+			case XLOG_HEAP_UPDATE:
+			case XLOG_HEAP_HOT_UPDATE:
+				{
+					xl_heap_update *xlrec = (xl_heap_update *) data;
+					BlockNumber oldblk;
+					BlockNumber newblk;
+
+					oldblk = ItemPointerGetBlockNumber(&xlrec->target.tid);
+					newblk = ItemPointerGetBlockNumber(&xlrec->newtid);
+
+					/* INIT_PAGE applies to the new page, so put it first */
+					if (newblk != oldblk)
+					{
+						INIT_BUFFERTAG(refs[nrefs], xlrec->target.node,
+									   MAIN_FORKNUM, newblk);
+						nrefs++;
+						if (isinit)
+							*ninit = 1;
+					}
+					INIT_BUFFERTAG(refs[nrefs], xlrec->target.node,
+								   MAIN_FORKNUM, oldblk);
+					nrefs++;
+					return nrefs;
+				}
+			default:
+				/* XLOG_HEAP_NEWPAGE writes the page without reading it */
+				return 0;
+		}
+
+		INIT_BUFFERTAG(refs[0], target->node, MAIN_FORKNUM,
+					   ItemPointerGetBlockNumber(&target->tid));
+		if (isinit)
+			*ninit = 1;
+		return 1;
+	}
+	else if (record->xl_rmid == RM_HEAP2_ID)
+	{
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP2_CLEAN:
+				{
+					xl_heap_clean *xlrec = (xl_heap_clean *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			case XLOG_HEAP2_FREEZE:
+				{
+					xl_heap_freeze *xlrec = (xl_heap_freeze *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			case XLOG_HEAP2_FREEZE_PAGE:
+				{
+					xl_heap_freeze_page *xlrec = (xl_heap_freeze_page *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			case XLOG_HEAP2_VISIBLE:
+				{
+					xl_heap_visible *xlrec = (xl_heap_visible *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			case XLOG_HEAP2_MULTI_INSERT:
+				{
+					xl_heap_multi_insert *xlrec = (xl_heap_multi_insert *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->blkno);
+					if (info & XLOG_HEAP_INIT_PAGE)
+						*ninit = 1;
+					return 1;
+				}
+			case XLOG_HEAP2_LOCK_UPDATED:
+				{
+					xl_heap_lock_updated *xlrec = (xl_heap_lock_updated *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->target.node, MAIN_FORKNUM,
+								 ItemPointerGetBlockNumber(&xlrec->target.tid));
+					return 1;
+				}
+			default:
+				return 0;
+		}
+	}
+	else if (record->xl_rmid == RM_BTREE_ID)
+	{
+		switch (info)
+		{
+			case XLOG_BTREE_INSERT_LEAF:
+			case XLOG_BTREE_INSERT_UPPER:
+			case XLOG_BTREE_INSERT_META:
+				{
+					xl_btree_insert *xlrec = (xl_btree_insert *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->target.node, MAIN_FORKNUM,
+								 ItemPointerGetBlockNumber(&xlrec->target.tid));
+					return 1;
+				}
+			case XLOG_BTREE_SPLIT_L:
+			case XLOG_BTREE_SPLIT_R:
+			case XLOG_BTREE_SPLIT_L_ROOT:
+			case XLOG_BTREE_SPLIT_R_ROOT:
+				{
+					xl_btree_split *xlrec = (xl_btree_split *) data;
+
+					/* The new right sibling is built from scratch */
+					INIT_BUFFERTAG(refs[nrefs], xlrec->node, MAIN_FORKNUM,
+								   xlrec->rightsib);
+					nrefs++;
+					*ninit = 1;
+					INIT_BUFFERTAG(refs[nrefs], xlrec->node, MAIN_FORKNUM,
+								   xlrec->leftsib);
+					nrefs++;
+					if (xlrec->rnext != P_NONE)
+					{
+						INIT_BUFFERTAG(refs[nrefs], xlrec->node, MAIN_FORKNUM,
+									   xlrec->rnext);
+						nrefs++;
+					}
+					return nrefs;
+				}
+			case XLOG_BTREE_VACUUM:
+				{
+					xl_btree_vacuum *xlrec = (xl_btree_vacuum *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			case XLOG_BTREE_DELETE:
+				{
+					xl_btree_delete *xlrec = (xl_btree_delete *) data;
+
+					INIT_BUFFERTAG(refs[0], xlrec->node, MAIN_FORKNUM,
+								   xlrec->block);
+					return 1;
+				}
+			default:
+				return 0;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Have we seen this block in the look-ahead window recently?  If not,
+ * remember it.
+ */
+static bool
+XLogPrefetcherSeenRecently(XLogPrefetcher *prefetcher, BufferTag *tag)
+{
+	int			i;
+
+	for (i = 0; i < prefetcher->recent_used; i++)
+	{
+		if (BUFFERTAGS_EQUAL(prefetcher->recent[i], *tag))
+			return true;
+	}
+
+	prefetcher->recent[prefetcher->recent_next] = *tag;
+	prefetcher->recent_next = (prefetcher->recent_next + 1) %
+		XLOGPREFETCHER_RECENT;
+	if (prefetcher->recent_used < XLOGPREFETCHER_RECENT)
+		prefetcher->recent_used++;
+
+	return false;
+}
+
+/*
+ * XLogReader page-read callback for the look-ahead reader.
+ *
+ * Reads straight from the segment files in pg_xlog, without waiting for
+ * anything.  Returns -1 if the page isn't available.
+ */
+static int
+XLogPrefetcherReadPage(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) reader->private_data;
+	XLogSegNo	segno;
+	uint32		offset;
+
+	XLByteToSeg(targetPagePtr, segno);
+	offset = targetPagePtr % XLogSegSize;
+
+	if (prefetcher->readFile >= 0 &&
+		(segno != prefetcher->readSegNo ||
+		 prefetcher->tli != prefetcher->readFileTLI))
+		XLogPrefetcherCloseFile(prefetcher);
+
+	if (prefetcher->readFile < 0)
+	{
+		char		path[MAXPGPATH];
+
+		XLogFilePath(path, prefetcher->tli, segno);
+		prefetcher->readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+		if (prefetcher->readFile < 0)
+			return -1;
+		prefetcher->readSegNo = segno;
+		prefetcher->readFileTLI = prefetcher->tli;
+	}
+
+	if (lseek(prefetcher->readFile, (off_t) offset, SEEK_SET) < 0 ||
+		read(prefetcher->readFile, readBuf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
+	{
+		XLogPrefetcherCloseFile(prefetcher);
+		return -1;
+	}
+
+	*pageTLI = prefetcher->tli;
+	return XLOG_BLCKSZ;
+}
+
+static void
+XLogPrefetcherCloseFile(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->readFile >= 0)
+	{
+		close(prefetcher->readFile);
+		prefetcher->readFile = -1;
+	}
+}
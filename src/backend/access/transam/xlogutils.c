@@ -21,6 +21,8 @@
 #include "access/xlogutils.h"
 #include "catalog/catalog.h"
 #include "common/relpath.h"
+#include "miscadmin.h"
+#include "storage/lwlock.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
@@ -335,17 +337,41 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		if (mode == RBM_NORMAL_NO_LOG)
 			return InvalidBuffer;
 		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
+
+		/*
+		 * We do this in recovery only, so no rel-extension lock is needed as
+		 * long as the startup process is the only one replaying.  Parallel
+		 * redo workers may extend the same relation concurrently, though, so
+		 * they serialize on RedoExtendLock, and must look at the size again
+		 * once they hold it: another worker may have extended the relation
+		 * past our block in the meantime.
+		 */
 		Assert(InRecovery);
-		buffer = InvalidBuffer;
-		do
+		if (AmRedoWorkerProcess())
 		{
-			if (buffer != InvalidBuffer)
-				ReleaseBuffer(buffer);
-			buffer = ReadBufferWithoutRelcache(rnode, forknum,
-											   P_NEW, mode, NULL);
+			LWLockAcquire(RedoExtendLock, LW_EXCLUSIVE);
+			lastblock = smgrnblocks(smgr, forknum);
+		}
+		if (blkno < lastblock)
+		{
+			/* somebody else extended it for us */
+			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
+											   mode, NULL);
+		}
+		else
+		{
+			buffer = InvalidBuffer;
+			do
+			{
+				if (buffer != InvalidBuffer)
+					ReleaseBuffer(buffer);
+				buffer = ReadBufferWithoutRelcache(rnode, forknum,
+												   P_NEW, mode, NULL);
+			}
+			while (BufferGetBlockNumber(buffer) < blkno);
 		}
-		while (BufferGetBlockNumber(buffer) < blkno);
+		if (AmRedoWorkerProcess())
+			LWLockRelease(RedoExtendLock);
 		/* Handle the corner case that P_NEW returns non-consecutive pages */
 		if (BufferGetBlockNumber(buffer) != blkno)
 		{
@@ -30,6 +30,7 @@
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/redoworker.h"
 #include "postmaster/startup.h"
 #include "postmaster/walwriter.h"
 #include "replication/walreceiver.h"
@@ -328,6 +329,9 @@ AuxiliaryProcessMain(int argc, char *argv[])
 			case WalReceiverProcess:
 				statmsg = "wal receiver process";
 				break;
+			case RedoWorkerProcess:
+				statmsg = "redo worker process";
+				break;
 			default:
 				statmsg = "??? process";
 				break;
@@ -359,7 +363,10 @@ AuxiliaryProcessMain(int argc, char *argv[])
 
 	/* Initialize MaxBackends (if under postmaster, was done already) */
 	if (!IsUnderPostmaster)
+	{
 		InitializeMaxBackends();
+		InitializeFastPathLocks();
+	}
 
 	BaseInit();
 
@@ -387,9 +394,11 @@ AuxiliaryProcessMain(int argc, char *argv[])
 		 * auxiliary process.
 		 *
 		 * This will need rethinking if we ever want more than one of a
-		 * particular auxiliary process type.
+		 * particular auxiliary process type.  Redo workers are the exception
+		 * so far; nobody needs to send them procsignals, so they go without.
 		 */
-		ProcSignalInit(MaxBackends + MyAuxProcType + 1);
+		if (MyAuxProcType != RedoWorkerProcess)
+			ProcSignalInit(MaxBackends + MyAuxProcType + 1);
 
 		/* finish setting up bufmgr.c */
 		InitBufferPoolBackend();
@@ -442,6 +451,11 @@ AuxiliaryProcessMain(int argc, char *argv[])
 			WalReceiverMain();
 			proc_exit(1);		/* should never return */
 
+		case RedoWorkerProcess:
+			/* don't set signals, redo worker has its own agenda */
+			RedoWorkerMain();
+			proc_exit(1);		/* should never return */
+
 		default:
 			elog(PANIC, "unrecognized process type: %d", (int) MyAuxProcType);
 			proc_exit(1);
@@ -405,6 +405,7 @@ CREATE VIEW pg_stat_all_tables AS
             pg_stat_get_tuples_hot_updated(C.oid) AS n_tup_hot_upd,
             pg_stat_get_live_tuples(C.oid) AS n_live_tup,
             pg_stat_get_dead_tuples(C.oid) AS n_dead_tup,
+            pg_stat_get_tuple_lock_waits(C.oid) AS n_tup_lock_waits,
             pg_stat_get_last_vacuum_time(C.oid) as last_vacuum,
             pg_stat_get_last_autovacuum_time(C.oid) as last_autovacuum,
             pg_stat_get_last_analyze_time(C.oid) as last_analyze,
@@ -584,6 +585,8 @@ CREATE VIEW pg_stat_activity AS
             S.query_start,
             S.state_change,
             S.waiting,
+            S.wait_event_type,
+            S.wait_event,
             S.state,
             S.query
     FROM pg_database D, pg_stat_get_activity(NULL) AS S, pg_authid U
@@ -685,6 +688,37 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_slru AS
+    SELECT
+            s.name,
+            s.blks_zeroed,
+            s.blks_hit,
+            s.blks_read,
+            s.blks_written,
+            s.blks_exists,
+            s.flushes,
+            s.truncates,
+            s.stats_reset
+    FROM pg_stat_get_slru() s;
+
+CREATE VIEW pg_stat_serializable AS
+    SELECT
+            s.page_promotions,
+            s.relation_promotions,
+            s.tuple_conflicts,
+            s.page_conflicts,
+            s.relation_conflicts,
+            s.serialization_failures,
+            s.coarse_serialization_failures
+    FROM pg_stat_get_serializable() s;
+
+CREATE VIEW pg_stat_backend_memory AS
+    SELECT
+            s.pid,
+            s.mem_allocated,
+            s.mem_peak
+    FROM pg_stat_get_backend_memory() s;
+
 CREATE VIEW pg_user_mappings AS
     SELECT
         U.oid       AS umid,
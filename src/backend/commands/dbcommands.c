@@ -50,6 +50,7 @@
 #include "storage/lmgr.h"
 #include "storage/ipc.h"
 #include "storage/procarray.h"
+#include "storage/relsizecache.h"
 #include "storage/smgr.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
@@ -880,6 +881,12 @@ dropdb(const char *dbname, bool missing_ok)
 	 */
 	DropDatabaseBuffers(db_id);
 
+	/*
+	 * Likewise forget any relation sizes cached for it, in case the database
+	 * OID is reused later.
+	 */
+	RelSizeCacheDropDatabase(db_id);
+
 	/*
 	 * Tell the stats collector to forget it immediately, too.
 	 */
@@ -1283,8 +1290,10 @@ movedb(const char *dbname, const char *tblspcname)
 	StartTransactionCommand();
 
 	/*
-	 * Remove files from the old tablespace
+	 * Remove files from the old tablespace, and forget their cached sizes
 	 */
+	RelSizeCacheDropDatabase(db_id);
+
 	if (!rmtree(src_dbpath, true))
 		ereport(WARNING,
 				(errmsg("some useless files may be left behind in old database directory \"%s\"",
@@ -2043,6 +2052,9 @@ dbase_redo(XLogRecPtr lsn, XLogRecord *record)
 		/* Drop pages for this database that are in the shared buffer cache */
 		DropDatabaseBuffers(xlrec->db_id);
 
+		/* Forget any cached relation sizes, too */
+		RelSizeCacheDropDatabase(xlrec->db_id);
+
 		/* Also, clean out any fsync requests that might be pending in md.c */
 		ForgetDatabaseFsyncRequests(xlrec->db_id);
 
@@ -119,6 +119,17 @@ typedef struct LVRelStats
 	bool		lock_waiter_detected;
 } LVRelStats;
 
+/*
+ * Heap pages read ahead by lazy_scan_heap, pinned until it gets to them.
+ */
+typedef struct LVReadAhead
+{
+	BlockNumber next_block;		/* block # of buffers[next] */
+	int			next;			/* index of next unused buffer */
+	int			nbuffers;		/* number of unused buffers left */
+	Buffer		buffers[MAX_BUFFERS_PER_READ];
+} LVReadAhead;
+
 
 /* A few variables that don't seem worth passing around as parameters */
 static int	elevel = -1;
@@ -135,6 +146,9 @@ static void lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			   Relation *Irel, int nindexes, bool scan_all);
 static void lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats);
 static bool lazy_check_needs_freeze(Buffer buf);
+static Buffer lazy_read_heap_page(Relation onerel, BlockNumber blkno,
+					BlockNumber endblock, LVReadAhead *readahead);
+static void lazy_release_readahead(LVReadAhead *readahead);
 static void lazy_vacuum_index(Relation indrel,
 				  IndexBulkDeleteResult **stats,
 				  LVRelStats *vacrelstats);
@@ -427,6 +441,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 	BlockNumber next_not_all_visible_block;
 	bool		skipping_all_visible_blocks;
 	xl_heap_freeze_tuple *frozen;
+	LVReadAhead readahead;
 
 	pg_rusage_init(&ru0);
 
@@ -450,6 +465,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 
 	lazy_space_alloc(vacrelstats, nblocks);
 	frozen = palloc(sizeof(xl_heap_freeze_tuple) * MaxHeapTuplesPerPage);
+	readahead.nbuffers = 0;
 
 	/*
 	 * We want to skip pages that don't require vacuuming according to the
@@ -563,6 +579,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				ReleaseBuffer(vmbuffer);
 				vmbuffer = InvalidBuffer;
 			}
+			lazy_release_readahead(&readahead);
 
 			/* Log cleanup info before we touch indexes */
 			vacuum_log_cleanup_info(onerel, vacrelstats);
@@ -594,8 +611,14 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 */
 		visibilitymap_pin(onerel, blkno, &vmbuffer);
 
-		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, blkno,
-								 RBM_NORMAL, vac_strategy);
+		/*
+		 * Read the page, together with the following ones unless we're about
+		 * to skip over all-visible pages anyway.
+		 */
+		buf = lazy_read_heap_page(onerel, blkno,
+								  (skipping_all_visible_blocks && !scan_all) ?
+								  blkno + 1 : nblocks,
+								  &readahead);
 
 		/* We need buffer cleanup lock so that we can prune HOT chains. */
 		if (!ConditionalLockBufferForCleanup(buf))
@@ -1049,13 +1072,14 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 														 num_tuples);
 
 	/*
-	 * Release any remaining pin on visibility map page.
+	 * Release any remaining pins on visibility map page and read-ahead pages.
 	 */
 	if (BufferIsValid(vmbuffer))
 	{
 		ReleaseBuffer(vmbuffer);
 		vmbuffer = InvalidBuffer;
 	}
+	lazy_release_readahead(&readahead);
 
 	/* If any tuples need to be deleted, perform final vacuum cycle */
 	/* XXX put a threshold on min number of tuples here? */
@@ -1241,6 +1265,61 @@ lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
 	return tupindex;
 }
 
+/*
+ *	lazy_read_heap_page() -- read a heap page for lazy_scan_heap
+ *
+ * If blkno isn't the next page already read ahead, this reads it along with
+ * the following pages, up to MAX_BUFFERS_PER_READ in all but never reaching
+ * endblock, in a single I/O.  The extra pages stay pinned in *readahead.
+ */
+static Buffer
+lazy_read_heap_page(Relation onerel, BlockNumber blkno, BlockNumber endblock,
+					LVReadAhead *readahead)
+{
+	Buffer		buf;
+
+	if (readahead->nbuffers > 0)
+	{
+		if (blkno == readahead->next_block)
+		{
+			buf = readahead->buffers[readahead->next];
+			readahead->next++;
+			readahead->nbuffers--;
+			readahead->next_block++;
+			return buf;
+		}
+
+		/* We skipped some pages, so the rest of the run is useless */
+		lazy_release_readahead(readahead);
+	}
+
+	endblock = Min(endblock, blkno + MAX_BUFFERS_PER_READ);
+	Assert(endblock > blkno);
+
+	ReadBuffersExtended(onerel, MAIN_FORKNUM, blkno, endblock - blkno,
+						readahead->buffers, vac_strategy);
+
+	readahead->next = 1;
+	readahead->nbuffers = endblock - blkno - 1;
+	readahead->next_block = blkno + 1;
+
+	return readahead->buffers[0];
+}
+
+/*
+ *	lazy_release_readahead() -- drop the pins on unused read-ahead pages
+ */
+static void
+lazy_release_readahead(LVReadAhead *readahead)
+{
+	while (readahead->nbuffers > 0)
+	{
+		ReleaseBuffer(readahead->buffers[readahead->next]);
+		readahead->next++;
+		readahead->nbuffers--;
+	}
+}
+
 /*
  *	lazy_check_needs_freeze() -- scan page to see if any tuples
  *					 need to be cleaned to avoid wraparound
@@ -86,6 +86,8 @@ static char *ExecBuildSlotValueDescription(TupleTableSlot *slot,
 							  int maxfieldlen);
 static void EvalPlanQualStart(EPQState *epqstate, EState *parentestate,
 				  Plan *planTree);
+static int	ExecChooseWorkMem(PlannedStmt *plannedstmt);
+static int	ExecCountWorkMemNodes(Plan *plan);
 
 /* end of local decls */
 
@@ -733,6 +735,7 @@ InitPlan(QueryDesc *queryDesc, int eflags)
 	 */
 	estate->es_range_table = rangeTable;
 	estate->es_plannedstmt = plannedstmt;
+	estate->es_work_mem = ExecChooseWorkMem(plannedstmt);
 
 	/*
 	 * initialize result relation stuff, and open/lock the result rels.
@@ -928,6 +931,95 @@ InitPlan(QueryDesc *queryDesc, int eflags)
 	queryDesc->planstate = planstate;
 }
 
+/*
+ * Decide how much memory, in kilobytes, each sort, hash table and the like
+ * in the plan may use.
+ *
+ * Normally that's just work_mem, but if query_work_mem is set, it is a
+ * budget for the query as a whole that's divided evenly among all of them.
+ * We never hand out more than work_mem (the planner costed the plan on that
+ * assumption), nor less than the minimum allowed work_mem setting.
+ */
+static int
+ExecChooseWorkMem(PlannedStmt *plannedstmt)
+{
+	int			nnodes;
+	ListCell   *l;
+
+	if (query_work_mem <= 0)
+		return work_mem;
+
+	nnodes = ExecCountWorkMemNodes(plannedstmt->planTree);
+	foreach(l, plannedstmt->subplans)
+		nnodes += ExecCountWorkMemNodes((Plan *) lfirst(l));
+
+	if (nnodes == 0)
+		return work_mem;
+
+	return Max(Min(query_work_mem / nnodes, work_mem), 64);
+}
+
+/*
+ * Count the plan nodes in a plan tree that use up to work_mem of memory.
+ */
+static int
+ExecCountWorkMemNodes(Plan *plan)
+{
+	int			count = 0;
+	List	   *children = NIL;
+	ListCell   *l;
+
+	if (plan == NULL)
+		return 0;
+
+	switch (nodeTag(plan))
+	{
+		case T_Sort:
+		case T_Material:
+		case T_Hash:
+		case T_WindowAgg:
+		case T_RecursiveUnion:
+		case T_CteScan:
+		case T_BitmapIndexScan:
+			count = 1;
+			break;
+		case T_Agg:
+			if (((Agg *) plan)->aggstrategy == AGG_HASHED)
+				count = 1;
+			break;
+		case T_SetOp:
+			if (((SetOp *) plan)->strategy == SETOP_HASHED)
+				count = 1;
+			break;
+		case T_Append:
+			children = ((Append *) plan)->appendplans;
+			break;
+		case T_MergeAppend:
+			children = ((MergeAppend *) plan)->mergeplans;
+			break;
+		case T_BitmapAnd:
+			children = ((BitmapAnd *) plan)->bitmapplans;
+			break;
+		case T_BitmapOr:
+			children = ((BitmapOr *) plan)->bitmapplans;
+			break;
+		case T_ModifyTable:
+			children = ((ModifyTable *) plan)->plans;
+			break;
+		case T_SubqueryScan:
+			count = ExecCountWorkMemNodes(((SubqueryScan *) plan)->subplan);
+			break;
+		default:
+			break;
+	}
+
+	foreach(l, children)
+		count += ExecCountWorkMemNodes((Plan *) lfirst(l));
+
+	return count + ExecCountWorkMemNodes(plan->lefttree) +
+		ExecCountWorkMemNodes(plan->righttree);
+}
+
 /*
  * Check that a proposed result relation is a legal target for the operation
  *
@@ -1819,7 +1911,11 @@ EvalPlanQual(EState *estate, EPQState *epqstate,
 								  tid, priorXmax);
 
 	if (copyTuple == NULL)
+	{
+		/* let go of the tuple lock heap_update & co may have kept for us */
+		heap_release_carried_tuple_lock();
 		return NULL;
+	}
 
 	/*
 	 * For UPDATE/DELETE we have to return tid of actual row we're executing
@@ -2352,6 +2448,7 @@ EvalPlanQualStart(EPQState *epqstate, EState *parentestate, Plan *planTree)
 	estate->es_rowMarks = parentestate->es_rowMarks;
 	estate->es_top_eflags = parentestate->es_top_eflags;
 	estate->es_instrument = parentestate->es_instrument;
+	estate->es_work_mem = parentestate->es_work_mem;
 	/* es_auxmodifytables must NOT be copied */
 
 	/*
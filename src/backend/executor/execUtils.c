@@ -46,6 +46,7 @@
 #include "access/transam.h"
 #include "catalog/index.h"
 #include "executor/execdebug.h"
+#include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "parser/parsetree.h"
 #include "storage/lmgr.h"
@@ -137,6 +138,7 @@ CreateExecutorState(void)
 
 	estate->es_top_eflags = 0;
 	estate->es_instrument = 0;
+	estate->es_work_mem = work_mem;
 	estate->es_finished = false;
 
 	estate->es_exprcontexts = NIL;
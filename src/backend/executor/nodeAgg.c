@@ -323,14 +323,16 @@ initialize_aggregates(AggState *aggstate,
 									  peraggstate->sortOperators[0],
 									  peraggstate->sortCollations[0],
 									  peraggstate->sortNullsFirst[0],
-									  work_mem, false) :
+									  aggstate->ss.ps.state->es_work_mem,
+									  false) :
 				tuplesort_begin_heap(peraggstate->evaldesc,
 									 peraggstate->numSortCols,
 									 peraggstate->sortColIdx,
 									 peraggstate->sortOperators,
 									 peraggstate->sortCollations,
 									 peraggstate->sortNullsFirst,
-									 work_mem, false);
+									 aggstate->ss.ps.state->es_work_mem,
+									 false);
 		}
 
 		/*
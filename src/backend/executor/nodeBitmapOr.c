@@ -129,7 +129,7 @@ MultiExecBitmapOr(BitmapOrState *node)
 			if (result == NULL) /* first subplan */
 			{
 				/* XXX should we use less than work_mem for this? */
-				result = tbm_create(work_mem * 1024L);
+				result = tbm_create(node->ps.state->es_work_mem * 1024L);
 			}
 
 			((BitmapIndexScanState *) subnode)->biss_result = result;
@@ -168,7 +168,8 @@ ExecHashJoin(HashJoinState *node)
 				 */
 				hashtable = ExecHashTableCreate((Hash *) hashNode->ps.plan,
 												node->hj_HashOperators,
-												HJ_FILL_INNER(node));
+												HJ_FILL_INNER(node),
+												node->js.ps.state->es_work_mem);
 				node->hj_HashTable = hashtable;
 
 				/*
@@ -609,6 +609,13 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 											   indexstate->iss_NumScanKeys,
 											 indexstate->iss_NumOrderByKeys);
 
+	/*
+	 * We are going to visit the heap for every TID the index returns, so ask
+	 * the index AM to prefetch the heap blocks of upcoming TIDs (it only does
+	 * so when effective_io_concurrency allows it).
+	 */
+	indexstate->iss_ScanDesc->xs_heap_prefetch = true;
+
 	/*
 	 * If no run-time keys to calculate, go ahead and pass the scankeys to the
 	 * index AM.
@@ -176,6 +176,7 @@ lnext:
 				if (copyTuple == NULL)
 				{
 					/* Tuple was deleted, so don't return it */
+					heap_release_carried_tuple_lock();
 					goto lnext;
 				}
 				/* remember the actually locked tuple's TID */
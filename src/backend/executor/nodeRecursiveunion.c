@@ -124,8 +124,8 @@ ExecRecursiveUnion(RecursiveUnionState *node)
 			node->working_table = node->intermediate_table;
 
 			/* create new empty intermediate table */
-			node->intermediate_table = tuplestore_begin_heap(false, false,
-															 work_mem);
+			node->intermediate_table =
+				tuplestore_begin_heap(false, false, node->ps.state->es_work_mem);
 			node->intermediate_empty = true;
 
 			/* reset the recursive term */
@@ -186,8 +186,10 @@ ExecInitRecursiveUnion(RecursiveUnion *node, EState *estate, int eflags)
 	/* initialize processing state */
 	rustate->recursing = false;
 	rustate->intermediate_empty = true;
-	rustate->working_table = tuplestore_begin_heap(false, false, work_mem);
-	rustate->intermediate_table = tuplestore_begin_heap(false, false, work_mem);
+	rustate->working_table = tuplestore_begin_heap(false, false,
+												   estate->es_work_mem);
+	rustate->intermediate_table = tuplestore_begin_heap(false, false,
+														estate->es_work_mem);
 
 	/*
 	 * If hashing, we need a per-tuple memory context for comparisons, and a
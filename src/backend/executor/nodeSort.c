@@ -88,7 +88,7 @@ ExecSort(SortState *node)
 											  plannode->sortOperators,
 											  plannode->collations,
 											  plannode->nullsFirst,
-											  work_mem,
+											  estate->es_work_mem,
 											  node->randomAccess);
 		if (node->bounded)
 			tuplesort_set_bound(tuplesortstate, node->bound);
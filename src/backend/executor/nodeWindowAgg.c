@@ -696,7 +696,8 @@ begin_partition(WindowAggState *winstate)
 	}
 
 	/* Create new tuplestore for this partition */
-	winstate->buffer = tuplestore_begin_heap(false, false, work_mem);
+	winstate->buffer = tuplestore_begin_heap(false, false,
+											 winstate->ss.ps.state->es_work_mem);
 
 	/*
 	 * Set up read pointers for the tuplestore.  The current pointer doesn't
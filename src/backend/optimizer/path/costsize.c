@@ -2446,6 +2446,7 @@ initial_cost_hashjoin(PlannerInfo *root, JoinCostWorkspace *workspace,
 	ExecChooseHashTableSize(inner_path_rows,
 							inner_path->parent->width,
 							true,		/* useskew */
+							work_mem,
 							&numbuckets,
 							&numbatches,
 							&num_skew_mcvs);
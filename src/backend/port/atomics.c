@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------------
+ *
+ * atomics.c
+ *	  Non-inline parts of the atomics implementation
+ *
+ * This holds the out-of-line copies of the functions in port/atomics.h for
+ * compilers without inline function support, and the spinlock-based
+ * simulation used on platforms where we have no native atomic operations.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/port/atomics.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+/* See atomics.h */
+#define ATOMICS_INCLUDE_DEFINITIONS
+
+#include "port/atomics.h"
+#include "storage/spin.h"
+
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+
+void
+pg_atomic_init_u32_impl(volatile pg_atomic_uint32 *ptr, uint32 val)
+{
+	/*
+	 * If we're using semaphore-based spinlocks, this must not be called
+	 * before the spinlock semaphores have been set up; see SpinlockSemaInit.
+	 */
+	SpinLockInit(&ptr->sema);
+	ptr->value = val;
+}
+
+void
+pg_atomic_write_u32_impl(volatile pg_atomic_uint32 *ptr, uint32 val)
+{
+	/*
+	 * Take the spinlock even for a plain store: the simulated
+	 * read-modify-write operations would otherwise overwrite it with a value
+	 * derived from what they read before it.
+	 */
+	SpinLockAcquire(&ptr->sema);
+	ptr->value = val;
+	SpinLockRelease(&ptr->sema);
+}
+
+bool
+pg_atomic_compare_exchange_u32_impl(volatile pg_atomic_uint32 *ptr,
+									uint32 *expected, uint32 newval)
+{
+	bool		ret;
+
+	/*
+	 * Do atomic op under a spinlock.  It might look like we could just skip
+	 * the cmpxchg if the lock isn't available, but that'd just emulate a
+	 * 'weak' compare and swap.  I.e. one that might spuriously fail.  That's
+	 * not what our callers expect.
+	 */
+	SpinLockAcquire(&ptr->sema);
+
+	ret = ptr->value == *expected;
+	*expected = ptr->value;
+	if (ret)
+		ptr->value = newval;
+
+	SpinLockRelease(&ptr->sema);
+
+	return ret;
+}
+
+uint32
+pg_atomic_fetch_add_u32_impl(volatile pg_atomic_uint32 *ptr, int32 add_)
+{
+	uint32		oldval;
+
+	SpinLockAcquire(&ptr->sema);
+	oldval = ptr->value;
+	ptr->value += add_;
+	SpinLockRelease(&ptr->sema);
+
+	return oldval;
+}
+
+#endif   /* PG_HAVE_ATOMIC_U32_SIMULATION */
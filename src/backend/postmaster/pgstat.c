@@ -52,7 +52,10 @@
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/latch.h"
+#include "storage/lock.h"
+#include "storage/lwlock.h"
 #include "storage/pg_shmem.h"
+#include "storage/proc.h"
 #include "storage/procsignal.h"
 #include "utils/ascii.h"
 #include "utils/guc.h"
@@ -128,6 +131,41 @@ char	   *pgstat_stat_tmpname = NULL;
  */
 PgStat_MsgBgWriter BgWriterStats;
 
+/*
+ * Where pgstat_report_wait_start/end store our current wait event.  This
+ * points into MyProc once we have one; until then, and after we give it up,
+ * reports go to a local variable that nobody else looks at.
+ */
+static uint32 local_my_wait_event_info;
+uint32	   *my_wait_event_info = &local_my_wait_event_info;
+
+/*
+ * SLRU statistics counters, not yet sent to the collector.  We assume this
+ * inits to zeroes.
+ */
+PgStat_MsgSLRU SLRUStats[SLRU_NUM_ELEMENTS];
+
+/*
+ * Names of the SLRUs we keep separate statistics for, by the name their
+ * shared memory is registered under.  Anything else, such as SLRUs set up by
+ * extensions, is counted under "other", which must come last.
+ */
+static const struct
+{
+	const char *shmem_name;
+	const char *name;
+}	slru_names[] =
+{
+	{"CLOG Ctl", "clog"},
+	{"SUBTRANS Ctl", "subtrans"},
+	{"MultiXactOffset Ctl", "multixact_offset"},
+	{"MultiXactMember Ctl", "multixact_member"},
+	{"Async Ctl", "notify"},
+	{"OldSerXid SLRU Ctl", "oldserxid"},
+	{"CSNLOG Ctl", "csnlog"},
+	{NULL, "other"}
+};
+
 /* ----------
  * Local data
  * ----------
@@ -212,7 +250,7 @@ typedef struct TwoPhasePgStatRecord
  */
 static MemoryContext pgStatLocalContext = NULL;
 static HTAB *pgStatDBHash = NULL;
-static PgBackendStatus *localBackendStatusTable = NULL;
+static LocalPgBackendStatus *localBackendStatusTable = NULL;
 static int	localNumBackends = 0;
 
 /*
@@ -222,6 +260,9 @@ static int	localNumBackends = 0;
  */
 static PgStat_GlobalStats globalStats;
 
+/* SLRU statistics, kept in the stats collector */
+static PgStat_SLRUStats slruStats[SLRU_NUM_ELEMENTS];
+
 /* Write request info for each database */
 typedef struct DBWriteRequest
 {
@@ -271,6 +312,8 @@ static bool pgstat_write_statsfile_needed(void);
 static bool pgstat_db_requested(Oid databaseid);
 
 static void pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg);
+static bool have_slru_stats(void);
+static void pgstat_send_slru(void);
 static void pgstat_send_funcstats(void);
 static HTAB *pgstat_collect_oids(Oid catalogid);
 
@@ -292,6 +335,7 @@ static void pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len);
 static void pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len);
 static void pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len);
 static void pgstat_recv_bgwriter(PgStat_MsgBgWriter *msg, int len);
+static void pgstat_recv_slru(PgStat_MsgSLRU *msg, int len);
 static void pgstat_recv_funcstat(PgStat_MsgFuncstat *msg, int len);
 static void pgstat_recv_funcpurge(PgStat_MsgFuncpurge *msg, int len);
 static void pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len);
@@ -744,7 +788,7 @@ pgstat_report_stat(bool force)
 
 	/* Don't expend a clock check if nothing to do */
 	if ((pgStatTabList == NULL || pgStatTabList->tsa_used == 0) &&
-		!have_function_stats && !force)
+		!have_function_stats && !have_slru_stats() && !force)
 		return;
 
 	/*
@@ -819,6 +863,9 @@ pgstat_report_stat(bool force)
 
 	/* Now, send function statistics */
 	pgstat_send_funcstats();
+
+	/* And SLRU statistics */
+	pgstat_send_slru();
 }
 
 /*
@@ -1245,11 +1292,13 @@ pgstat_reset_shared_counters(const char *target)
 
 	if (strcmp(target, "bgwriter") == 0)
 		msg.m_resettarget = RESET_BGWRITER;
+	else if (strcmp(target, "slru") == 0)
+		msg.m_resettarget = RESET_SLRU;
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("unrecognized reset target: \"%s\"", target),
-				 errhint("Target must be \"bgwriter\".")));
+				 errhint("Target must be \"bgwriter\" or \"slru\".")));
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RESETSHAREDCOUNTER);
 	pgstat_send(&msg, sizeof(msg));
@@ -2283,6 +2332,28 @@ pgstat_fetch_stat_beentry(int beid)
 {
 	pgstat_read_current_status();
 
+	if (beid < 1 || beid > localNumBackends)
+		return NULL;
+
+	return &localBackendStatusTable[beid - 1].backendStatus;
+}
+
+
+/* ----------
+ * pgstat_fetch_stat_local_beentry() -
+ *
+ *	Like pgstat_fetch_stat_beentry() but returns the LocalPgBackendStatus,
+ *	which also holds the backend's wait event.
+ *
+ *	NB: caller is responsible for a check if the user is permitted to see
+ *	this info (especially the querystring).
+ * ----------
+ */
+LocalPgBackendStatus *
+pgstat_fetch_stat_local_beentry(int beid)
+{
+	pgstat_read_current_status();
+
 	if (beid < 1 || beid > localNumBackends)
 		return NULL;
 
@@ -2321,6 +2392,22 @@ pgstat_fetch_global(void)
 	return &globalStats;
 }
 
+/*
+ * ---------
+ * pgstat_fetch_slru() -
+ *
+ *	Support function for the SQL-callable pgstat* functions. Returns
+ *	a pointer to the SLRU statistics, an array of SLRU_NUM_ELEMENTS.
+ * ---------
+ */
+PgStat_SLRUStats *
+pgstat_fetch_slru(void)
+{
+	backend_read_statsfile();
+
+	return slruStats;
+}
+
 
 /* ------------------------------------------------------------
  * Functions for management of the shared-memory PgBackendStatus array
@@ -2528,6 +2615,9 @@ pgstat_bestart(void)
 	beentry->st_appname[NAMEDATALEN - 1] = '\0';
 	beentry->st_activity[pgstat_track_activity_query_size - 1] = '\0';
 
+	/* From now on, memory accounting goes straight into our entry */
+	MemoryContextSetUsageStorage((BackendMemoryUsage *) &beentry->st_memory);
+
 	beentry->st_changecount++;
 	Assert((beentry->st_changecount & 1) == 0);
 
@@ -2570,6 +2660,7 @@ pgstat_beshutdown_hook(int code, Datum arg)
 	beentry->st_changecount++;
 
 	beentry->st_procpid = 0;	/* mark invalid */
+	MemoryContextResetUsageStorage();
 
 	beentry->st_changecount++;
 	Assert((beentry->st_changecount & 1) == 0);
@@ -2734,6 +2825,94 @@ pgstat_report_waiting(bool waiting)
 	beentry->st_waiting = waiting;
 }
 
+/* ----------
+ * pgstat_set_wait_event_storage() -
+ *
+ *	Make wait events be reported into the given location, normally our
+ *	PGPROC's wait_event_info, from now on.
+ * ----------
+ */
+void
+pgstat_set_wait_event_storage(uint32 *wait_event_info)
+{
+	my_wait_event_info = wait_event_info;
+}
+
+/* ----------
+ * pgstat_reset_wait_event_storage() -
+ *
+ *	Go back to reporting wait events into backend-local memory.  Must be
+ *	called before the storage set by pgstat_set_wait_event_storage goes
+ *	away, e.g. when our PGPROC is given back.
+ * ----------
+ */
+void
+pgstat_reset_wait_event_storage(void)
+{
+	my_wait_event_info = &local_my_wait_event_info;
+}
+
+/* ----------
+ * pgstat_get_wait_event_type() -
+ *
+ *	Return the name of the class of a wait event, or NULL if the value
+ *	doesn't represent a wait.
+ * ----------
+ */
+const char *
+pgstat_get_wait_event_type(uint32 wait_event_info)
+{
+	switch (wait_event_info & PG_WAIT_CLASS_MASK)
+	{
+		case PG_WAIT_LWLOCK:
+			return "LWLock";
+		case PG_WAIT_LOCK:
+			return "Lock";
+		case PG_WAIT_LATCH:
+			return "Latch";
+		case PG_WAIT_IO:
+			return "IO";
+		default:
+			return NULL;
+	}
+}
+
+/* ----------
+ * pgstat_get_wait_event() -
+ *
+ *	Return the name of a wait event, or NULL if the value doesn't represent
+ *	a wait.
+ * ----------
+ */
+const char *
+pgstat_get_wait_event(uint32 wait_event_info)
+{
+	uint16		eventId = wait_event_info & PG_WAIT_EVENT_MASK;
+
+	switch (wait_event_info & PG_WAIT_CLASS_MASK)
+	{
+		case PG_WAIT_LWLOCK:
+			return GetLWLockIdentifier(eventId);
+		case PG_WAIT_LOCK:
+			return GetLockNameFromTagType(eventId);
+		case PG_WAIT_LATCH:
+			return "WaitLatch";
+		case PG_WAIT_IO:
+			switch ((WaitEventIO) wait_event_info)
+			{
+				case WAIT_EVENT_FILE_READ:
+					return "FileRead";
+				case WAIT_EVENT_FILE_WRITE:
+					return "FileWrite";
+				case WAIT_EVENT_FILE_SYNC:
+					return "FileSync";
+			}
+			return "unknown I/O";
+		default:
+			return NULL;
+	}
+}
+
 
 /* ----------
  * pgstat_read_current_status() -
@@ -2746,8 +2925,9 @@ static void
 pgstat_read_current_status(void)
 {
 	volatile PgBackendStatus *beentry;
-	PgBackendStatus *localtable;
-	PgBackendStatus *localentry;
+	LocalPgBackendStatus *localtable;
+	LocalPgBackendStatus *localentry;
+	PGPROC	  **procs;
 	char	   *localappname,
 			   *localactivity;
 	int			i;
@@ -2758,9 +2938,9 @@ pgstat_read_current_status(void)
 
 	pgstat_setup_memcxt();
 
-	localtable = (PgBackendStatus *)
+	localtable = (LocalPgBackendStatus *)
 		MemoryContextAlloc(pgStatLocalContext,
-						   sizeof(PgBackendStatus) * MaxBackends);
+						   sizeof(LocalPgBackendStatus) * MaxBackends);
 	localappname = (char *)
 		MemoryContextAlloc(pgStatLocalContext,
 						   NAMEDATALEN * MaxBackends);
@@ -2769,6 +2949,23 @@ pgstat_read_current_status(void)
 						   pgstat_track_activity_query_size * MaxBackends);
 	localNumBackends = 0;
 
+	/*
+	 * Find each backend's PGPROC, by backend ID, so that we can copy its
+	 * wait event along with its status entry without looking it up one
+	 * backend at a time.  The PGPROCs are read without any lock, just as
+	 * their owners update the wait event without one; below we check the
+	 * pid, in case a PGPROC was recycled in the meantime.
+	 */
+	procs = (PGPROC **) palloc0(sizeof(PGPROC *) * MaxBackends);
+	for (i = 0; i < ProcGlobal->allProcCount; i++)
+	{
+		volatile PGPROC *proc = &ProcGlobal->allProcs[i];
+		BackendId	backendId = proc->backendId;
+
+		if (proc->pid != 0 && backendId >= 1 && backendId <= MaxBackends)
+			procs[backendId - 1] = (PGPROC *) proc;
+	}
+
 	beentry = BackendStatusArray;
 	localentry = localtable;
 	for (i = 1; i <= MaxBackends; i++)
@@ -2784,19 +2981,20 @@ pgstat_read_current_status(void)
 		{
 			int			save_changecount = beentry->st_changecount;
 
-			localentry->st_procpid = beentry->st_procpid;
-			if (localentry->st_procpid > 0)
+			localentry->backendStatus.st_procpid = beentry->st_procpid;
+			if (localentry->backendStatus.st_procpid > 0)
 			{
-				memcpy(localentry, (char *) beentry, sizeof(PgBackendStatus));
+				memcpy(&localentry->backendStatus, (char *) beentry,
+					   sizeof(PgBackendStatus));
 
 				/*
 				 * strcpy is safe even if the string is modified concurrently,
 				 * because there's always a \0 at the end of the buffer.
 				 */
 				strcpy(localappname, (char *) beentry->st_appname);
-				localentry->st_appname = localappname;
+				localentry->backendStatus.st_appname = localappname;
 				strcpy(localactivity, (char *) beentry->st_activity);
-				localentry->st_activity = localactivity;
+				localentry->backendStatus.st_activity = localactivity;
 			}
 
 			if (save_changecount == beentry->st_changecount &&
@@ -2809,8 +3007,16 @@ pgstat_read_current_status(void)
 
 		beentry++;
 		/* Only valid entries get included into the local array */
-		if (localentry->st_procpid > 0)
+		if (localentry->backendStatus.st_procpid > 0)
 		{
+			volatile PGPROC *proc = procs[i - 1];
+
+			if (proc != NULL &&
+				proc->pid == localentry->backendStatus.st_procpid)
+				localentry->wait_event_info = proc->wait_event_info;
+			else
+				localentry->wait_event_info = 0;
+
 			localentry++;
 			localappname += NAMEDATALEN;
 			localactivity += pgstat_track_activity_query_size;
@@ -2818,6 +3024,8 @@ pgstat_read_current_status(void)
 		}
 	}
 
+	pfree(procs);
+
 	/* Set the pointer only after completion of a valid table */
 	localBackendStatusTable = localtable;
 }
@@ -3049,6 +3257,99 @@ pgstat_send_bgwriter(void)
 	 * Clear out the statistics buffer, so it can be re-used.
 	 */
 	MemSet(&BgWriterStats, 0, sizeof(BgWriterStats));
+
+	/* The checkpointer and bgwriter write out SLRU pages, too */
+	pgstat_send_slru();
+}
+
+/* ----------
+ * pgstat_slru_index() -
+ *
+ *		Return the index in the SLRU statistics of the SLRU whose shared
+ *		memory is registered under the given name.
+ * ----------
+ */
+int
+pgstat_slru_index(const char *name)
+{
+	int			i;
+
+	StaticAssertStmt(lengthof(slru_names) == SLRU_NUM_ELEMENTS,
+					 "slru_names[] doesn't match SLRU_NUM_ELEMENTS");
+
+	for (i = 0; i < SLRU_NUM_ELEMENTS - 1; i++)
+	{
+		if (strcmp(slru_names[i].shmem_name, name) == 0)
+			return i;
+	}
+
+	/* the last entry is for all the others */
+	return SLRU_NUM_ELEMENTS - 1;
+}
+
+/* ----------
+ * pgstat_slru_name() -
+ *
+ *		Return the user-visible name of an SLRU statistics entry.
+ * ----------
+ */
+const char *
+pgstat_slru_name(int slru_idx)
+{
+	Assert(slru_idx >= 0 && slru_idx < SLRU_NUM_ELEMENTS);
+
+	return slru_names[slru_idx].name;
+}
+
+/*
+ * Are there any SLRU statistics waiting to be sent?
+ */
+static bool
+have_slru_stats(void)
+{
+	int			i;
+
+	for (i = 0; i < SLRU_NUM_ELEMENTS; i++)
+	{
+		PgStat_MsgSLRU *msg = &SLRUStats[i];
+
+		if (msg->m_blocks_zeroed != 0 || msg->m_blocks_hit != 0 ||
+			msg->m_blocks_read != 0 || msg->m_blocks_written != 0 ||
+			msg->m_blocks_exists != 0 || msg->m_flush != 0 ||
+			msg->m_truncate != 0)
+			return true;
+	}
+	return false;
+}
+
+/* ----------
+ * pgstat_send_slru() -
+ *
+ *		Send SLRU statistics to the collector, one message per SLRU that
+ *		has anything to report.
+ * ----------
+ */
+static void
+pgstat_send_slru(void)
+{
+	/* We assume this initializes to zeroes */
+	static const PgStat_MsgSLRU all_zeroes;
+	int			i;
+
+	for (i = 0; i < SLRU_NUM_ELEMENTS; i++)
+	{
+		PgStat_MsgSLRU *msg = &SLRUStats[i];
+
+		/* m_hdr and m_index are still zero when there's nothing to send */
+		if (memcmp(msg, &all_zeroes, sizeof(PgStat_MsgSLRU)) == 0)
+			continue;
+
+		msg->m_index = i;
+		pgstat_setheader(&msg->m_hdr, PGSTAT_MTYPE_SLRU);
+		pgstat_send(msg, sizeof(PgStat_MsgSLRU));
+
+		MemSet(msg, 0, sizeof(PgStat_MsgSLRU));
+	}
 }
 
 
@@ -3266,6 +3567,10 @@ PgstatCollectorMain(int argc, char *argv[])
 					pgstat_recv_bgwriter((PgStat_MsgBgWriter *) &msg, len);
 					break;
 
+				case PGSTAT_MTYPE_SLRU:
+					pgstat_recv_slru((PgStat_MsgSLRU *) &msg, len);
+					break;
+
 				case PGSTAT_MTYPE_FUNCSTAT:
 					pgstat_recv_funcstat((PgStat_MsgFuncstat *) &msg, len);
 					break;
@@ -3474,6 +3779,7 @@ pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry, Oid tableoid, bool create)
 		result->changes_since_analyze = 0;
 		result->blocks_fetched = 0;
 		result->blocks_hit = 0;
+		result->tuple_lock_waits = 0;
 		result->vacuum_timestamp = 0;
 		result->vacuum_count = 0;
 		result->autovac_vacuum_timestamp = 0;
@@ -3546,6 +3852,12 @@ pgstat_write_statsfiles(bool permanent, bool allDbs)
 	rc = fwrite(&globalStats, sizeof(globalStats), 1, fpout);
 	(void) rc;					/* we'll check for error with ferror */
 
+	/*
+	 * Write SLRU stats
+	 */
+	rc = fwrite(slruStats, sizeof(slruStats), 1, fpout);
+	(void) rc;					/* we'll check for error with ferror */
+
 	/*
 	 * Walk through the database table.
 	 */
@@ -3793,6 +4105,7 @@ pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
 	FILE	   *fpin;
 	int32		format_id;
 	bool		found;
+	int			i;
 	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
 
 	/*
@@ -3823,6 +4136,11 @@ pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
 	 */
 	globalStats.stat_reset_timestamp = GetCurrentTimestamp();
 
+	/* Likewise for the SLRU statistics */
+	memset(slruStats, 0, sizeof(slruStats));
+	for (i = 0; i < SLRU_NUM_ELEMENTS; i++)
+		slruStats[i].stat_reset_timestamp = globalStats.stat_reset_timestamp;
+
 	/*
 	 * Try to open the stats file. If it doesn't exist, the backends simply
 	 * return zero for anything and the collector simply starts from scratch
@@ -3863,6 +4181,16 @@ pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
 		goto done;
 	}
 
+	/*
+	 * Read SLRU stats
+	 */
+	if (fread(slruStats, 1, sizeof(slruStats), fpin) != sizeof(slruStats))
+	{
+		ereport(pgStatRunningInCollector ? LOG : WARNING,
+				(errmsg("corrupted statistics file \"%s\"", statfile)));
+		goto done;
+	}
+
 	/*
 	 * We found an existing collector stats file. Read it and put all the
 	 * hashtable entries into place.
@@ -4545,6 +4873,7 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 			tabentry->changes_since_analyze = tabmsg->t_counts.t_changed_tuples;
 			tabentry->blocks_fetched = tabmsg->t_counts.t_blocks_fetched;
 			tabentry->blocks_hit = tabmsg->t_counts.t_blocks_hit;
+			tabentry->tuple_lock_waits = tabmsg->t_counts.t_tuple_lock_waits;
 
 			tabentry->vacuum_timestamp = 0;
 			tabentry->vacuum_count = 0;
@@ -4572,6 +4901,7 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 			tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
 			tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
 			tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
+			tabentry->tuple_lock_waits += tabmsg->t_counts.t_tuple_lock_waits;
 		}
 
 		/* Clamp n_live_tuples in case of negative delta_live_tuples */
@@ -4722,6 +5052,16 @@ pgstat_recv_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len)
 		memset(&globalStats, 0, sizeof(globalStats));
 		globalStats.stat_reset_timestamp = GetCurrentTimestamp();
 	}
+	else if (msg->m_resettarget == RESET_SLRU)
+	{
+		/* Reset the statistics of all the SLRUs */
+		TimestampTz now = GetCurrentTimestamp();
+		int			i;
+
+		memset(slruStats, 0, sizeof(slruStats));
+		for (i = 0; i < SLRU_NUM_ELEMENTS; i++)
+			slruStats[i].stat_reset_timestamp = now;
+	}
 
 	/*
 	 * Presumably the sender of this message validated the target, don't
@@ -4873,6 +5213,30 @@ pgstat_recv_bgwriter(PgStat_MsgBgWriter *msg, int len)
 	globalStats.buf_alloc += msg->m_buf_alloc;
 }
 
+/* ----------
+ * pgstat_recv_slru() -
+ *
+ *	Process a SLRU message.
+ * ----------
+ */
+static void
+pgstat_recv_slru(PgStat_MsgSLRU *msg, int len)
+{
+	PgStat_SLRUStats *stats;
+
+	if (msg->m_index < 0 || msg->m_index >= SLRU_NUM_ELEMENTS)
+		return;
+
+	stats = &slruStats[msg->m_index];
+	stats->blocks_zeroed += msg->m_blocks_zeroed;
+	stats->blocks_hit += msg->m_blocks_hit;
+	stats->blocks_read += msg->m_blocks_read;
+	stats->blocks_written += msg->m_blocks_written;
+	stats->blocks_exists += msg->m_blocks_exists;
+	stats->flush += msg->m_flush;
+	stats->truncate += msg->m_truncate;
+}
+
 /* ----------
  * pgstat_recv_recoveryconflict() -
  *
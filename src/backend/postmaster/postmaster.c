@@ -107,6 +107,7 @@
 #include "postmaster/fork_process.h"
 #include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/redoworker.h"
 #include "postmaster/syslogger.h"
 #include "replication/walsender.h"
 #include "storage/fd.h"
@@ -271,6 +272,9 @@ static pid_t StartupPID = 0,
 			PgStatPID = 0,
 			SysLoggerPID = 0;
 
+/* PIDs of parallel redo workers; 0 when not running */
+static pid_t RedoWorkerPIDs[MAX_REDO_WORKERS];
+
 /* Startup/shutdown state */
 #define			NoShutdown		0
 #define			SmartShutdown	1
@@ -426,6 +430,9 @@ static bool SignalUnconnectedWorkers(int signal);
 
 static int	CountChildren(int target);
 static int	CountUnconnectedWorkers(void);
+static void SignalRedoWorkers(int signal);
+static int	CountRedoWorkers(void);
+static void StartRedoWorkers(void);
 static void maybe_start_bgworker(void);
 static bool CreateOptsFile(int argc, char *argv[], char *fullprogname);
 static pid_t StartChildProcess(AuxProcType type);
@@ -502,6 +509,7 @@ typedef struct
 	bool		IsBinaryUpgrade;
 	int			max_safe_fds;
 	int			MaxBackends;
+	int			FastPathLockGroupsPerBackend;
 #ifdef WIN32
 	HANDLE		PostmasterHandle;
 	HANDLE		initial_signal_pipe;
@@ -536,6 +544,7 @@ static BackgroundWorker *find_bgworker_entry(int cookie);
 #define StartCheckpointer()		StartChildProcess(CheckpointerProcess)
 #define StartWalWriter()		StartChildProcess(WalWriterProcess)
 #define StartWalReceiver()		StartChildProcess(WalReceiverProcess)
+#define StartRedoWorker()		StartChildProcess(RedoWorkerProcess)
 
 /* Macros to check exit status of a child process */
 #define EXIT_STATUS_0(st)  ((st) == 0)
@@ -900,6 +909,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	InitializeMaxBackends();
 
+	/* ... and the size of the fast-path lock arrays, which depends on GUCs */
+	InitializeFastPathLocks();
+
 	/*
 	 * Establish input sockets.
 	 */
@@ -2302,6 +2314,7 @@ SIGHUP_handler(SIGNAL_ARGS)
 			signal_child(WalWriterPID, SIGHUP);
 		if (WalReceiverPID != 0)
 			signal_child(WalReceiverPID, SIGHUP);
+		SignalRedoWorkers(SIGHUP);
 		if (AutoVacPID != 0)
 			signal_child(AutoVacPID, SIGHUP);
 		if (PgArchPID != 0)
@@ -2416,6 +2429,7 @@ pmdie(SIGNAL_ARGS)
 
 			if (StartupPID != 0)
 				signal_child(StartupPID, SIGTERM);
+			SignalRedoWorkers(SIGTERM);
 			if (BgWriterPID != 0)
 				signal_child(BgWriterPID, SIGTERM);
 			if (WalReceiverPID != 0)
@@ -2424,10 +2438,10 @@ pmdie(SIGNAL_ARGS)
 			if (pmState == PM_RECOVERY)
 			{
 				/*
-				 * Only startup, bgwriter, walreceiver, unconnected bgworkers,
-				 * and/or checkpointer should be active in this state; we just
-				 * signaled the first four, and we don't want to kill
-				 * checkpointer yet.
+				 * Only startup, redo workers, bgwriter, walreceiver,
+				 * unconnected bgworkers, and/or checkpointer should be active
+				 * in this state; we just signaled the first five, and we
+				 * don't want to kill checkpointer yet.
 				 */
 				pmState = PM_WAIT_BACKENDS;
 			}
@@ -2472,6 +2486,7 @@ pmdie(SIGNAL_ARGS)
 			SignalChildren(SIGQUIT);
 			if (StartupPID != 0)
 				signal_child(StartupPID, SIGQUIT);
+			SignalRedoWorkers(SIGQUIT);
 			if (BgWriterPID != 0)
 				signal_child(BgWriterPID, SIGQUIT);
 			if (CheckpointerPID != 0)
@@ -2505,6 +2520,7 @@ reaper(SIGNAL_ARGS)
 	int			save_errno = errno;
 	int			pid;			/* process id of dead child process */
 	int			exitstatus;		/* its exit status */
+	int			i;
 
 	PG_SETMASK(&BlockSig);
 
@@ -2604,6 +2620,25 @@ reaper(SIGNAL_ARGS)
 			continue;
 		}
 
+		/*
+		 * Was it a parallel redo worker?  Normal exit is expected at the end
+		 * of recovery or on shutdown; any other exit condition is treated as
+		 * a crash, since records queued for the worker are lost.
+		 */
+		for (i = 0; i < MAX_REDO_WORKERS; i++)
+		{
+			if (pid == RedoWorkerPIDs[i])
+				break;
+		}
+		if (i < MAX_REDO_WORKERS)
+		{
+			RedoWorkerPIDs[i] = 0;
+			if (!EXIT_STATUS_0(exitstatus))
+				HandleChildCrash(pid, exitstatus,
+								 _("redo worker process"));
+			continue;
+		}
+
 		/*
 		 * Was it the bgwriter?  Normal exit can be ignored; we'll start a new
 		 * one at the next iteration of the postmaster's main loop, if
@@ -2961,6 +2996,7 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 	dlist_mutable_iter iter;
 	slist_iter	siter;
 	Backend    *bp;
+	int			i;
 
 	/*
 	 * Make log entry unless there was a previous crash (if so, nonzero exit
@@ -3087,6 +3123,21 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 		signal_child(StartupPID, (SendStop ? SIGSTOP : SIGQUIT));
 	}
 
+	/* Take care of the redo workers too */
+	for (i = 0; i < MAX_REDO_WORKERS; i++)
+	{
+		if (pid == RedoWorkerPIDs[i])
+			RedoWorkerPIDs[i] = 0;
+		else if (RedoWorkerPIDs[i] != 0 && !FatalError)
+		{
+			ereport(DEBUG2,
+					(errmsg_internal("sending %s to process %d",
+									 (SendStop ? "SIGSTOP" : "SIGQUIT"),
+									 (int) RedoWorkerPIDs[i])));
+			signal_child(RedoWorkerPIDs[i], (SendStop ? SIGSTOP : SIGQUIT));
+		}
+	}
+
 	/* Take care of the bgwriter too */
 	if (pid == BgWriterPID)
 		BgWriterPID = 0;
@@ -3293,6 +3344,7 @@ PostmasterStateMachine(void)
 		{
 			if (StartupPID != 0)
 				signal_child(StartupPID, SIGTERM);
+			SignalRedoWorkers(SIGTERM);
 			if (WalReceiverPID != 0)
 				signal_child(WalReceiverPID, SIGTERM);
 			pmState = PM_WAIT_BACKENDS;
@@ -3319,6 +3371,7 @@ PostmasterStateMachine(void)
 		if (CountChildren(BACKEND_TYPE_NORMAL | BACKEND_TYPE_WORKER) == 0 &&
 			CountUnconnectedWorkers() == 0 &&
 			StartupPID == 0 &&
+			CountRedoWorkers() == 0 &&
 			WalReceiverPID == 0 &&
 			BgWriterPID == 0 &&
 			(CheckpointerPID == 0 || !FatalError) &&
@@ -3415,6 +3468,7 @@ PostmasterStateMachine(void)
 		{
 			/* These other guys should be dead already */
 			Assert(StartupPID == 0);
+			Assert(CountRedoWorkers() == 0);
 			Assert(WalReceiverPID == 0);
 			Assert(BgWriterPID == 0);
 			Assert(CheckpointerPID == 0);
@@ -4720,6 +4774,15 @@ sigusr1_handler(SIGNAL_ARGS)
 		WalReceiverPID = StartWalReceiver();
 	}
 
+	if (CheckPostmasterSignal(PMSIGNAL_START_REDO_WORKERS) &&
+		StartupPID != 0 &&
+		(pmState == PM_RECOVERY || pmState == PM_HOT_STANDBY) &&
+		Shutdown == NoShutdown)
+	{
+		/* Startup process wants parallel redo workers. */
+		StartRedoWorkers();
+	}
+
 	if (CheckPostmasterSignal(PMSIGNAL_ADVANCE_STATE_MACHINE) &&
 		(pmState == PM_WAIT_BACKUP || pmState == PM_WAIT_BACKENDS))
 	{
@@ -4838,6 +4901,64 @@ PostmasterRandom(void)
 	return random();
 }
 
+/*
+ * Send a signal to all running parallel redo workers
+ */
+static void
+SignalRedoWorkers(int signal)
+{
+	int			i;
+
+	for (i = 0; i < MAX_REDO_WORKERS; i++)
+	{
+		if (RedoWorkerPIDs[i] != 0)
+			signal_child(RedoWorkerPIDs[i], signal);
+	}
+}
+
+/*
+ * Count up number of running parallel redo workers
+ */
+static int
+CountRedoWorkers(void)
+{
+	int			i;
+	int			cnt = 0;
+
+	for (i = 0; i < MAX_REDO_WORKERS; i++)
+	{
+		if (RedoWorkerPIDs[i] != 0)
+			cnt++;
+	}
+	return cnt;
+}
+
+/*
+ * Launch parallel_redo_workers redo worker processes, in response to a
+ * request from the startup process.  Workers still running from an earlier
+ * request are left alone.
+ */
+static void
+StartRedoWorkers(void)
+{
+	int			i;
+	int			nstarted = CountRedoWorkers();
+
+	for (i = 0; i < MAX_REDO_WORKERS && nstarted < parallel_redo_workers; i++)
+	{
+		if (RedoWorkerPIDs[i] != 0)
+			continue;
+		RedoWorkerPIDs[i] = StartRedoWorker();
+		if (RedoWorkerPIDs[i] == 0)
+		{
+			/* fork failed; let the startup process replay serially */
+			RedoWorkerLaunchFailed();
+			break;
+		}
+		nstarted++;
+	}
+}
+
 /*
  * Count up number of worker processes that did not request backend connections
  * See SignalUnconnectedWorkers for why this is interesting.
@@ -4992,6 +5113,10 @@ StartChildProcess(AuxProcType type)
 				ereport(LOG,
 						(errmsg("could not fork WAL receiver process: %m")));
 				break;
+			case RedoWorkerProcess:
+				ereport(LOG,
+						(errmsg("could not fork redo worker process: %m")));
+				break;
 			default:
 				ereport(LOG,
 						(errmsg("could not fork process: %m")));
@@ -5870,6 +5995,7 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->max_safe_fds = max_safe_fds;
 
 	param->MaxBackends = MaxBackends;
+	param->FastPathLockGroupsPerBackend = FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	param->PostmasterHandle = PostmasterHandle;
@@ -6097,6 +6223,7 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	max_safe_fds = param->max_safe_fds;
 
 	MaxBackends = param->MaxBackends;
+	FastPathLockGroupsPerBackend = param->FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	PostmasterHandle = param->PostmasterHandle;
@@ -0,0 +1,1011 @@
+/*-------------------------------------------------------------------------
+ *
+ * redoworker.c
+ *
+ * Parallel WAL redo on standby servers.
+ *
+ * Normally the startup process replays every WAL record itself.  When
+ * parallel_redo_workers > 0, a standby that has reached a consistent state
+ * asks the postmaster to launch that many redo worker processes, and from
+ * then on the startup process acts as a dispatcher: records that modify a
+ * single heap block are copied into the queue of the worker chosen by
+ * hashing the block, and the worker replays them in queue order.  Since all
+ * records touching a given block go to the same worker, per-block ordering
+ * is the same as in serial replay.
+ *
+ * Everything else is a barrier: the startup process waits until all queues
+ * have been drained, and then replays the record itself.  That covers
+ * commit and abort records (so that a transaction's changes are all applied
+ * before hot standby sessions can see it as committed), records touching
+ * more than one block, records that can cause hot standby conflicts
+ * (pruning, freezing, visibility map changes), records that modify system
+ * catalogs, and all non-heap resource managers, whose redo routines may keep
+ * private state in the startup process.  The queues are also drained before recovery pauses or ends.
+ *
+ * Workers are only used after reachedConsistency is set.  Before that,
+ * replay of a record may legitimately reference pages that don't exist yet,
+ * and the startup process's invalid-page bookkeeping has to see them all.
+ *
+ * Each worker has a fixed-size ring buffer in shared memory.  The startup
+ * process is the only producer and the worker the only consumer; head and
+ * tail positions are protected by a per-worker spinlock, and the two sides
+ * wake each other through their process latches.
+ *
+ * Redo workers are auxiliary processes.  If one exits unexpectedly, the
+ * postmaster treats it as a crash, just like for the startup process.  If
+ * the postmaster can't fork one in the first place, the startup process
+ * stops the others and goes on replaying serially.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/redoworker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "access/hash.h"
+#include "access/heapam_xlog.h"
+#include "access/rmgr.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "access/xlog_internal.h"
+#include "catalog/pg_tablespace.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "postmaster/redoworker.h"
+#include "postmaster/startup.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/pmsignal.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+
+/*
+ * GUC parameters
+ */
+int			parallel_redo_workers = 0;
+
+/*
+ * Size of each worker's record queue.  Records larger than a quarter of the
+ * queue are replayed by the startup process instead.
+ */
+#define REDO_QUEUE_SIZE			(512 * 1024)
+#define REDO_MAX_ENTRY_SIZE		(REDO_QUEUE_SIZE / 4)
+
+/*
+ * How long the startup process sleeps at most while waiting for a worker,
+ * in milliseconds.  The workers set its latch when they make progress; the
+ * timeout is only there so that we notice shutdown requests, since the
+ * startup process's signal handlers don't set its process latch.
+ */
+#define REDO_WAIT_TIMEOUT		100L
+
+/*
+ * Each queued record is preceded by one of these.  An entry with len == 0,
+ * or less than a header's worth of space before the end of the ring,
+ * means the rest of the ring is unused and the next entry is at the start.
+ */
+typedef struct RedoQueueEntry
+{
+	uint32		len;			/* total entry length, including header */
+	XLogRecPtr	EndRecPtr;		/* end+1 of the record */
+	/* XLogRecord follows, MAXALIGN'd */
+} RedoQueueEntry;
+
+#define RedoQueueEntryHeaderSize	MAXALIGN(sizeof(RedoQueueEntry))
+
+typedef struct RedoWorkerSlot
+{
+	slock_t		mutex;			/* protects the fields below */
+	uint64		head;			/* bytes ever inserted, by startup */
+	uint64		tail;			/* bytes ever consumed, by worker */
+	bool		sleeping;		/* worker is waiting for new records */
+	bool		startupWaiting; /* startup is waiting for tail to advance */
+	Latch	   *latch;			/* worker's process latch */
+	Size		queue_offset;	/* offset of ring buffer from RedoWorkerCtl */
+	pid_t		pid;			/* worker's PID, or 0; protected by
+								 * RedoWorkerCtl->mutex */
+} RedoWorkerSlot;
+
+typedef struct RedoWorkerCtlData
+{
+	slock_t		mutex;			/* protects nattached, shutdown, slot pids */
+	int			nworkers;		/* number of slots */
+	int			nattached;		/* number of slots with a running worker */
+	bool		shutdown;		/* workers should exit once idle */
+	Latch	   *startupLatch;	/* startup process's process latch */
+
+	/*
+	 * Set by the postmaster if it couldn't fork one of the workers.  The
+	 * postmaster doesn't take spinlocks in shared memory, so this is written
+	 * and read without the mutex; a stale read only delays the fallback to
+	 * serial replay until the next record.
+	 */
+	volatile bool launchFailed;
+
+	/*
+	 * Incremented by the startup process whenever it replays a record that
+	 * might unlink or truncate relation files; workers then close their smgr
+	 * handles so that they don't keep using stale file descriptors.  It is
+	 * only changed while all queues are empty.
+	 */
+	uint64		smgrGeneration;
+
+	RedoWorkerSlot slots[1];	/* VARIABLE LENGTH ARRAY */
+} RedoWorkerCtlData;
+
+static RedoWorkerCtlData *RedoWorkerCtl = NULL;
+
+#define RedoWorkerQueue(slot) \
+	(((char *) RedoWorkerCtl) + (slot)->queue_offset)
+
+/* State of parallel redo, as seen by the startup process */
+typedef enum
+{
+	PARALLEL_REDO_OFF,			/* not in use; replay everything serially */
+	PARALLEL_REDO_STARTING,		/* workers requested, not all attached yet */
+	PARALLEL_REDO_ACTIVE		/* dispatching records to workers */
+} ParallelRedoState;
+
+static ParallelRedoState redoState = PARALLEL_REDO_OFF;
+static uint64 redoDispatched = 0;
+static uint64 redoBarriers = 0;
+
+/* Redo worker's own slot */
+static RedoWorkerSlot *MyRedoSlot = NULL;
+
+/*
+ * Flags set by interrupt handlers for later service in the main loop.
+ */
+static volatile sig_atomic_t got_SIGHUP = false;
+static volatile sig_atomic_t shutdown_requested = false;
+
+/* Signal handlers */
+static void redoworker_quickdie(SIGNAL_ARGS);
+static void RedoWorkerSigHupHandler(SIGNAL_ARGS);
+static void RedoWorkerShutdownHandler(SIGNAL_ARGS);
+static void redoworker_sigusr1_handler(SIGNAL_ARGS);
+
+static bool RedoRecordGetBlock(XLogRecord *record, RelFileNode *rnode,
+				   BlockNumber *blkno);
+static bool RedoRelFileNodeIsUserRelation(RelFileNode *rnode);
+static bool RedoRecordMayDropFiles(XLogRecord *record);
+static void RedoQueueInsert(RedoWorkerSlot *slot, XLogRecPtr EndRecPtr,
+				XLogRecord *record);
+static void RedoWaitForWorkers(void);
+static void RedoWorkerDetach(int code, Datum arg);
+static void RedoWorkerApply(RedoQueueEntry *entry, uint64 *smgrGeneration);
+static void redo_worker_error_callback(void *arg);
+
+
+/*
+ * Compute space needed for the redo worker control structure and queues
+ */
+Size
+RedoWorkerShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(RedoWorkerCtlData, slots);
+	size = add_size(size, mul_size(Max(parallel_redo_workers, 1),
+								   sizeof(RedoWorkerSlot)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(parallel_redo_workers, REDO_QUEUE_SIZE));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize the redo worker control structure and queues
+ */
+void
+RedoWorkerShmemInit(void)
+{
+	bool		found;
+	Size		offset;
+	int			i;
+
+	RedoWorkerCtl = (RedoWorkerCtlData *)
+		ShmemInitStruct("Redo Worker Ctl", RedoWorkerShmemSize(), &found);
+
+	if (found)
+		return;
+
+	SpinLockInit(&RedoWorkerCtl->mutex);
+	RedoWorkerCtl->nworkers = parallel_redo_workers;
+	RedoWorkerCtl->nattached = 0;
+	RedoWorkerCtl->shutdown = false;
+	RedoWorkerCtl->startupLatch = NULL;
+	RedoWorkerCtl->launchFailed = false;
+	RedoWorkerCtl->smgrGeneration = 0;
+
+	offset = MAXALIGN(offsetof(RedoWorkerCtlData, slots) +
+					  Max(parallel_redo_workers, 1) * sizeof(RedoWorkerSlot));
+	for (i = 0; i < parallel_redo_workers; i++)
+	{
+		RedoWorkerSlot *slot = &RedoWorkerCtl->slots[i];
+
+		SpinLockInit(&slot->mutex);
+		slot->head = 0;
+		slot->tail = 0;
+		slot->sleeping = false;
+		slot->startupWaiting = false;
+		slot->latch = NULL;
+		slot->queue_offset = offset + i * REDO_QUEUE_SIZE;
+		slot->pid = 0;
+	}
+}
+
+
+/* --------------------------------
+ *		startup process side
+ * --------------------------------
+ */
+
+/*
+ * Called by the startup process once recovery has reached a consistent
+ * state on a standby.  Asks the postmaster to launch the redo workers;
+ * dispatching begins once all of them have attached.
+ */
+void
+ParallelRedoStart(void)
+{
+	if (parallel_redo_workers == 0 || redoState != PARALLEL_REDO_OFF ||
+		!IsUnderPostmaster)
+		return;
+
+	SpinLockAcquire(&RedoWorkerCtl->mutex);
+	RedoWorkerCtl->shutdown = false;
+	RedoWorkerCtl->startupLatch = &MyProc->procLatch;
+	RedoWorkerCtl->launchFailed = false;
+	SpinLockRelease(&RedoWorkerCtl->mutex);
+
+	redoState = PARALLEL_REDO_STARTING;
+	SendPostmasterSignal(PMSIGNAL_START_REDO_WORKERS);
+
+	ereport(DEBUG1,
+			(errmsg("requesting %d parallel redo workers",
+					parallel_redo_workers)));
+}
+
+/*
+ * Hand a WAL record over to a redo worker.
+ *
+ * Returns true if the record was queued for a worker.  Returns false if the
+ * caller must replay the record itself; in that case all previously queued
+ * records have been replayed when we return.
+ */
+bool
+ParallelRedoDispatch(XLogRecPtr EndRecPtr, XLogRecord *record)
+{
+	RelFileNode rnode;
+	BlockNumber blkno;
+	uint32		hash;
+
+	if (redoState == PARALLEL_REDO_OFF)
+		return false;
+
+	if (redoState == PARALLEL_REDO_STARTING)
+	{
+		bool		ready;
+
+		SpinLockAcquire(&RedoWorkerCtl->mutex);
+		ready = (RedoWorkerCtl->nattached == RedoWorkerCtl->nworkers);
+		SpinLockRelease(&RedoWorkerCtl->mutex);
+
+		if (!ready)
+		{
+			/*
+			 * If the postmaster couldn't launch all the workers, give up on
+			 * parallel redo: tell the ones that did start to exit, and replay
+			 * everything ourselves from now on.
+			 */
+			if (RedoWorkerCtl->launchFailed)
+			{
+				ereport(LOG,
+						(errmsg("could not start parallel redo workers, continuing with serial replay")));
+				ParallelRedoShutdown();
+			}
+			return false;
+		}
+
+		ereport(DEBUG1,
+				(errmsg("parallel redo started with %d workers",
+						RedoWorkerCtl->nworkers)));
+		redoState = PARALLEL_REDO_ACTIVE;
+	}
+
+	if (!RedoRecordGetBlock(record, &rnode, &blkno) ||
+		RedoQueueEntryHeaderSize + MAXALIGN(record->xl_tot_len) >
+		REDO_MAX_ENTRY_SIZE)
+	{
+		/* Barrier: wait for the workers, and let the caller replay it */
+		ParallelRedoDrain();
+		if (RedoRecordMayDropFiles(record))
+			RedoWorkerCtl->smgrGeneration++;
+		redoBarriers++;
+		return false;
+	}
+
+	hash = DatumGetUInt32(hash_uint32(blkno ^
+									  DatumGetUInt32(hash_uint32(rnode.relNode))));
+	RedoQueueInsert(&RedoWorkerCtl->slots[hash % RedoWorkerCtl->nworkers],
+					EndRecPtr, record);
+	redoDispatched++;
+
+	return true;
+}
+
+/*
+ * Called by the postmaster when it fails to fork a redo worker.
+ */
+void
+RedoWorkerLaunchFailed(void)
+{
+	RedoWorkerCtl->launchFailed = true;
+}
+
+/*
+ * Wait until the workers have replayed every record queued so far.
+ */
+void
+ParallelRedoDrain(void)
+{
+	if (redoState != PARALLEL_REDO_ACTIVE)
+		return;
+
+	for (;;)
+	{
+		bool		drained = true;
+		int			i;
+
+		ResetLatch(&MyProc->procLatch);
+
+		for (i = 0; i < RedoWorkerCtl->nworkers; i++)
+		{
+			RedoWorkerSlot *slot = &RedoWorkerCtl->slots[i];
+
+			SpinLockAcquire(&slot->mutex);
+			if (slot->tail != slot->head)
+			{
+				slot->startupWaiting = true;
+				drained = false;
+			}
+			SpinLockRelease(&slot->mutex);
+		}
+
+		if (drained)
+			break;
+
+		RedoWaitForWorkers();
+	}
+}
+
+/*
+ * Called by the startup process at the end of the redo loop.  Waits for the
+ * queues to drain and for the workers to exit.
+ */
+void
+ParallelRedoShutdown(void)
+{
+	int			i;
+
+	if (redoState == PARALLEL_REDO_OFF)
+		return;
+
+	ParallelRedoDrain();
+
+	SpinLockAcquire(&RedoWorkerCtl->mutex);
+	RedoWorkerCtl->shutdown = true;
+	SpinLockRelease(&RedoWorkerCtl->mutex);
+
+	for (;;)
+	{
+		int			nattached;
+
+		ResetLatch(&MyProc->procLatch);
+
+		SpinLockAcquire(&RedoWorkerCtl->mutex);
+		nattached = RedoWorkerCtl->nattached;
+		SpinLockRelease(&RedoWorkerCtl->mutex);
+
+		if (nattached == 0)
+			break;
+
+		for (i = 0; i < RedoWorkerCtl->nworkers; i++)
+		{
+			RedoWorkerSlot *slot = &RedoWorkerCtl->slots[i];
+			Latch	   *latch;
+
+			SpinLockAcquire(&slot->mutex);
+			latch = slot->latch;
+			SpinLockRelease(&slot->mutex);
+
+			if (latch)
+				SetLatch(latch);
+		}
+
+		(void) WaitLatch(&MyProc->procLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+						 REDO_WAIT_TIMEOUT);
+		HandleStartupProcInterrupts();
+	}
+
+	elog(DEBUG1, "parallel redo stopped: " UINT64_FORMAT " records replayed by workers, " UINT64_FORMAT " barrier records",
+		 redoDispatched, redoBarriers);
+
+	redoState = PARALLEL_REDO_OFF;
+}
+
+/*
+ * Sleep until a worker makes progress, or a timeout elapses.  Errors out if
+ * a worker has gone away, since records queued for it would never be
+ * replayed.
+ */
+static void
+RedoWaitForWorkers(void)
+{
+	int			nattached;
+
+	/* a worker exiting because of a shutdown request isn't an error */
+	HandleStartupProcInterrupts();
+
+	SpinLockAcquire(&RedoWorkerCtl->mutex);
+	nattached = RedoWorkerCtl->nattached;
+	SpinLockRelease(&RedoWorkerCtl->mutex);
+
+	if (nattached < RedoWorkerCtl->nworkers)
+		ereport(FATAL,
+				(errmsg("parallel redo worker exited unexpectedly")));
+
+	(void) WaitLatch(&MyProc->procLatch,
+					 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					 REDO_WAIT_TIMEOUT);
+}
+
+/*
+ * Append a copy of a record to a worker's queue, waiting for space if
+ * necessary.
+ */
+static void
+RedoQueueInsert(RedoWorkerSlot *slot, XLogRecPtr EndRecPtr,
+				XLogRecord *record)
+{
+	char	   *queue = RedoWorkerQueue(slot);
+	uint32		entlen;
+	uint64		head;
+	Size		offset;
+	Size		pad = 0;
+	RedoQueueEntry *entry;
+	bool		wakeup;
+
+	entlen = RedoQueueEntryHeaderSize + MAXALIGN(record->xl_tot_len);
+
+	/* Only we advance head, so no need for the lock to read it */
+	head = slot->head;
+	offset = head % REDO_QUEUE_SIZE;
+	if (REDO_QUEUE_SIZE - offset < entlen)
+		pad = REDO_QUEUE_SIZE - offset;
+
+	/* Wait for the worker to free enough space */
+	for (;;)
+	{
+		bool		full;
+
+		ResetLatch(&MyProc->procLatch);
+
+		SpinLockAcquire(&slot->mutex);
+		full = (head + pad + entlen - slot->tail > REDO_QUEUE_SIZE);
+		if (full)
+			slot->startupWaiting = true;
+		SpinLockRelease(&slot->mutex);
+
+		if (!full)
+			break;
+
+		RedoWaitForWorkers();
+	}
+
+	if (pad > 0)
+	{
+		/* mark the remainder of the ring as unused, and wrap around */
+		if (pad >= RedoQueueEntryHeaderSize)
+			((RedoQueueEntry *) (queue + offset))->len = 0;
+		head += pad;
+		offset = 0;
+	}
+
+	entry = (RedoQueueEntry *) (queue + offset);
+	entry->len = entlen;
+	entry->EndRecPtr = EndRecPtr;
+	memcpy((char *) entry + RedoQueueEntryHeaderSize, record,
+		   record->xl_tot_len);
+	head += entlen;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->head = head;
+	wakeup = slot->sleeping;
+	slot->sleeping = false;
+	SpinLockRelease(&slot->mutex);
+
+	if (wakeup)
+		SetLatch(slot->latch);
+}
+
+/*
+ * Decide whether a record can be replayed by a worker.  If so, return true
+ * and the block it touches in *rnode and *blkno.
+ *
+ * Only heap records that modify exactly one heap page, and that don't
+ * generate recovery conflicts in hot standby, qualify.  Such records can
+ * still clear a bit in the visibility map or update the free space map, but
+ * those changes are commutative and done under buffer locks.
+ *
+ * Changes to system catalogs are kept serial too, so that catalog contents
+ * always advance in WAL order relative to everything else the startup
+ * process replays, such as the invalidations that go with them.  Without
+ * catalog access we can't tell a catalog from its relfilenode for sure, so
+ * we treat every relation in the global tablespace, and every relfilenode
+ * below FirstNormalObjectId, as one.  That covers all catalogs, their
+ * indexes and TOAST tables, except those rewritten by VACUUM FULL or
+ * CLUSTER, which get a new, normal relfilenode.
+ */
+static bool
+RedoRecordGetBlock(XLogRecord *record, RelFileNode *rnode,
+				   BlockNumber *blkno)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *data = XLogRecGetData(record);
+	xl_heaptid *target;
+
+	if (record->xl_rmid == RM_HEAP_ID)
+	{
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP_INSERT:
+				target = &((xl_heap_insert *) data)->target;
+				break;
+			case XLOG_HEAP_DELETE:
+				target = &((xl_heap_delete *) data)->target;
+				break;
+			case XLOG_HEAP_UPDATE:
+			case XLOG_HEAP_HOT_UPDATE:
+				{
+					xl_heap_update *xlrec = (xl_heap_update *) data;
+
+					if (ItemPointerGetBlockNumber(&xlrec->target.tid) !=
+						ItemPointerGetBlockNumber(&xlrec->newtid))
+						return false;
+					target = &xlrec->target;
+					break;
+				}
+			case XLOG_HEAP_LOCK:
+				target = &((xl_heap_lock *) data)->target;
+				break;
+			case XLOG_HEAP_NEWPAGE:
+				{
+					xl_heap_newpage *xlrec = (xl_heap_newpage *) data;
+
+					*rnode = xlrec->node;
+					*blkno = xlrec->blkno;
+					return RedoRelFileNodeIsUserRelation(rnode);
+				}
+			default:
+				/* in-place updates are used on catalogs; keep them serial */
+				return false;
+		}
+	}
+	else if (record->xl_rmid == RM_HEAP2_ID)
+	{
+		switch (info & XLOG_HEAP_OPMASK)
+		{
+			case XLOG_HEAP2_MULTI_INSERT:
+				{
+					xl_heap_multi_insert *xlrec = (xl_heap_multi_insert *) data;
+
+					*rnode = xlrec->node;
+					*blkno = xlrec->blkno;
+					return RedoRelFileNodeIsUserRelation(rnode);
+				}
+			case XLOG_HEAP2_LOCK_UPDATED:
+				target = &((xl_heap_lock_updated *) data)->target;
+				break;
+			default:
+				/* pruning, freezing etc. can conflict with standby queries */
+				return false;
+		}
+	}
+	else
+		return false;
+
+	*rnode = target->node;
+	*blkno = ItemPointerGetBlockNumber(&target->tid);
+
+	return RedoRelFileNodeIsUserRelation(rnode);
+}
+
+/*
+ * Can this relfilenode not belong to a system catalog?  See
+ * RedoRecordGetBlock.
+ */
+static bool
+RedoRelFileNodeIsUserRelation(RelFileNode *rnode)
+{
+	return rnode->spcNode != GLOBALTABLESPACE_OID &&
+		rnode->relNode >= FirstNormalObjectId;
+}
+
+/*
+ * Could replaying this record unlink or truncate relation files?
+ */
+static bool
+RedoRecordMayDropFiles(XLogRecord *record)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *data = XLogRecGetData(record);
+
+	switch (record->xl_rmid)
+	{
+		case RM_SMGR_ID:
+		case RM_DBASE_ID:
+		case RM_TBLSPC_ID:
+			return true;
+		case RM_XACT_ID:
+			if (info == XLOG_XACT_COMMIT)
+				return ((xl_xact_commit *) data)->nrels > 0;
+			if (info == XLOG_XACT_ABORT)
+				return ((xl_xact_abort *) data)->nrels > 0;
+			if (info == XLOG_XACT_COMMIT_PREPARED)
+				return ((xl_xact_commit_prepared *) data)->crec.nrels > 0;
+			if (info == XLOG_XACT_ABORT_PREPARED)
+				return ((xl_xact_abort_prepared *) data)->arec.nrels > 0;
+			return false;
+		default:
+			return false;
+	}
+}
+
+
+/* --------------------------------
+ *		redo worker process
+ * --------------------------------
+ */
+
+/*
+ * Main entry point for a redo worker process
+ *
+ * This is invoked from AuxiliaryProcessMain, which has already created the
+ * basic execution environment, but not enabled signals yet.
+ */
+void
+RedoWorkerMain(void)
+{
+	MemoryContext redo_context;
+	uint64		smgrGeneration;
+	int			i;
+
+	/*
+	 * If possible, make this process a group leader, so that the postmaster
+	 * can signal any child processes too.
+	 */
+#ifdef HAVE_SETSID
+	if (setsid() < 0)
+		elog(FATAL, "setsid() failed: %m");
+#endif
+
+	/*
+	 * Properly accept or ignore signals the postmaster might send us
+	 */
+	pqsignal(SIGHUP, RedoWorkerSigHupHandler);	/* set flag to read config
+												 * file */
+	pqsignal(SIGINT, SIG_IGN);
+	pqsignal(SIGTERM, RedoWorkerShutdownHandler);	/* request shutdown */
+	pqsignal(SIGQUIT, redoworker_quickdie);		/* hard crash time */
+	pqsignal(SIGALRM, SIG_IGN);
+	pqsignal(SIGPIPE, SIG_IGN);
+	pqsignal(SIGUSR1, redoworker_sigusr1_handler);
+	pqsignal(SIGUSR2, SIG_IGN);
+
+	/*
+	 * Reset some signals that are accepted by postmaster but not here
+	 */
+	pqsignal(SIGCHLD, SIG_DFL);
+	pqsignal(SIGTTIN, SIG_DFL);
+	pqsignal(SIGTTOU, SIG_DFL);
+	pqsignal(SIGCONT, SIG_DFL);
+	pqsignal(SIGWINCH, SIG_DFL);
+
+	/* We allow SIGQUIT (quickdie) at all times */
+	sigdelset(&BlockSig, SIGQUIT);
+
+	PG_SETMASK(&UnBlockSig);
+
+	/*
+	 * Claim a free slot.  If the startup process has already finished with
+	 * parallel redo, or all slots are taken, there's nothing to do.
+	 */
+	SpinLockAcquire(&RedoWorkerCtl->mutex);
+	if (!RedoWorkerCtl->shutdown)
+	{
+		for (i = 0; i < RedoWorkerCtl->nworkers; i++)
+		{
+			if (RedoWorkerCtl->slots[i].pid == 0)
+			{
+				MyRedoSlot = &RedoWorkerCtl->slots[i];
+				MyRedoSlot->pid = MyProcPid;
+				RedoWorkerCtl->nattached++;
+				break;
+			}
+		}
+	}
+	SpinLockRelease(&RedoWorkerCtl->mutex);
+
+	if (MyRedoSlot == NULL)
+		proc_exit(0);
+
+	on_shmem_exit(RedoWorkerDetach, 0);
+
+	SpinLockAcquire(&MyRedoSlot->mutex);
+	MyRedoSlot->latch = &MyProc->procLatch;
+	SpinLockRelease(&MyRedoSlot->mutex);
+
+	/*
+	 * Act like the startup process does while replaying: we're in recovery,
+	 * and past the consistency point, so references to missing pages are
+	 * errors.  We never enable hot standby conflict processing here, since
+	 * records that need it are replayed by the startup process.
+	 */
+	InRecovery = true;
+	reachedConsistency = true;
+	smgrGeneration = RedoWorkerCtl->smgrGeneration;
+
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "Redo Worker");
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "Redo Worker",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+	MemoryContextSwitchTo(redo_context);
+
+	/*
+	 * Loop forever
+	 */
+	for (;;)
+	{
+		uint64		head;
+		uint64		tail;
+		int			rc;
+
+		/* Clear any already-pending wakeups */
+		ResetLatch(&MyProc->procLatch);
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+		if (shutdown_requested)
+			proc_exit(0);
+
+		SpinLockAcquire(&MyRedoSlot->mutex);
+		head = MyRedoSlot->head;
+		tail = MyRedoSlot->tail;
+		if (head == tail)
+			MyRedoSlot->sleeping = true;
+		SpinLockRelease(&MyRedoSlot->mutex);
+
+		if (head == tail)
+		{
+			bool		shutdown;
+
+			SpinLockAcquire(&RedoWorkerCtl->mutex);
+			shutdown = RedoWorkerCtl->shutdown;
+			SpinLockRelease(&RedoWorkerCtl->mutex);
+
+			/* Normal exit once the startup process is done with us */
+			if (shutdown)
+				proc_exit(0);
+
+			rc = WaitLatch(&MyProc->procLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH, -1L);
+
+			/*
+			 * Emergency bailout if postmaster has died.  This is to avoid the
+			 * necessity for manual cleanup of all postmaster children.
+			 */
+			if (rc & WL_POSTMASTER_DEATH)
+				exit(1);
+			continue;
+		}
+
+		/* Replay everything queued so far */
+		while (tail != head)
+		{
+			char	   *queue = RedoWorkerQueue(MyRedoSlot);
+			Size		offset = tail % REDO_QUEUE_SIZE;
+			RedoQueueEntry *entry = (RedoQueueEntry *) (queue + offset);
+			bool		wakeup;
+
+			if (REDO_QUEUE_SIZE - offset < RedoQueueEntryHeaderSize ||
+				entry->len == 0)
+			{
+				/* skip to the start of the ring */
+				tail += REDO_QUEUE_SIZE - offset;
+				continue;
+			}
+
+			RedoWorkerApply(entry, &smgrGeneration);
+			MemoryContextResetAndDeleteChildren(redo_context);
+			tail += entry->len;
+
+			/* Release the space, and tell the startup process if it waits */
+			SpinLockAcquire(&MyRedoSlot->mutex);
+			MyRedoSlot->tail = tail;
+			wakeup = MyRedoSlot->startupWaiting;
+			MyRedoSlot->startupWaiting = false;
+			SpinLockRelease(&MyRedoSlot->mutex);
+
+			if (wakeup)
+				SetLatch(RedoWorkerCtl->startupLatch);
+		}
+	}
+}
+
+/*
+ * Replay one queued record.
+ */
+static void
+RedoWorkerApply(RedoQueueEntry *entry, uint64 *smgrGeneration)
+{
+	XLogRecord *record;
+	ErrorContextCallback errcallback;
+
+	record = (XLogRecord *) ((char *) entry + RedoQueueEntryHeaderSize);
+
+	/*
+	 * If the startup process has dropped or truncated relations since we
+	 * last looked, forget our open files.
+	 */
+	if (*smgrGeneration != RedoWorkerCtl->smgrGeneration)
+	{
+		smgrcloseall();
+		*smgrGeneration = RedoWorkerCtl->smgrGeneration;
+	}
+
+	/* Setup error traceback support for ereport() */
+	errcallback.callback = redo_worker_error_callback;
+	errcallback.arg = (void *) record;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	RmgrTable[record->xl_rmid].rm_redo(entry->EndRecPtr, record);
+
+	error_context_stack = errcallback.previous;
+}
+
+/*
+ * Error context callback for errors occurring while replaying a record
+ */
+static void
+redo_worker_error_callback(void *arg)
+{
+	XLogRecord *record = (XLogRecord *) arg;
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	RmgrTable[record->xl_rmid].rm_desc(&buf,
+									   record->xl_info,
+									   XLogRecGetData(record));
+
+	/* don't bother emitting empty description */
+	if (buf.len > 0)
+		errcontext("xlog redo (worker) %s", buf.data);
+
+	pfree(buf.data);
+}
+
+/*
+ * on_shmem_exit callback: give up our slot, and wake the startup process in
+ * case it is waiting for us.
+ */
+static void
+RedoWorkerDetach(int code, Datum arg)
+{
+	Latch	   *startupLatch;
+
+	SpinLockAcquire(&MyRedoSlot->mutex);
+	MyRedoSlot->latch = NULL;
+	MyRedoSlot->sleeping = false;
+	SpinLockRelease(&MyRedoSlot->mutex);
+
+	SpinLockAcquire(&RedoWorkerCtl->mutex);
+	MyRedoSlot->pid = 0;
+	RedoWorkerCtl->nattached--;
+	startupLatch = RedoWorkerCtl->startupLatch;
+	SpinLockRelease(&RedoWorkerCtl->mutex);
+
+	if (startupLatch)
+		SetLatch(startupLatch);
+}
+
+
+/* --------------------------------
+ *		signal handler routines
+ * --------------------------------
+ */
+
+/*
+ * redoworker_quickdie() occurs when signalled SIGQUIT by the postmaster.
+ *
+ * Some backend has bought the farm,
+ * so we need to stop what we're doing and exit.
+ */
+static void
+redoworker_quickdie(SIGNAL_ARGS)
+{
+	PG_SETMASK(&BlockSig);
+
+	/*
+	 * We DO NOT want to run proc_exit() callbacks -- we're here because
+	 * shared memory may be corrupted, so we don't want to try to clean up.
+	 * Just nail the windows shut and get out of town.
+	 */
+	on_exit_reset();
+
+	/*
+	 * Note we do exit(2) not exit(0).  This is to force the postmaster into a
+	 * system reset cycle, like for any other backend.
+	 */
+	exit(2);
+}
+
+/* SIGHUP: set flag to re-read config file at next convenient time */
+static void
+RedoWorkerSigHupHandler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/* SIGTERM: set flag to exit */
+static void
+RedoWorkerShutdownHandler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	shutdown_requested = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/* SIGUSR1: used for latch wakeups */
+static void
+redoworker_sigusr1_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	latch_sigusr1_handler();
+
+	errno = save_errno;
+}
@@ -52,6 +52,7 @@
 #include "libpq/pqformat.h"
 #include "miscadmin.h"
 #include "nodes/replnodes.h"
+#include "pgstat.h"
 #include "replication/basebackup.h"
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
@@ -218,6 +219,12 @@ InitWalSender(void)
 void
 WalSndErrorCleanup()
 {
+	/*
+	 * Errors outside a transaction don't go through AbortTransaction, so we
+	 * might have errored out of a wait without having cleared it.
+	 */
+	pgstat_report_wait_end();
+
 	if (sendFile >= 0)
 	{
 		close(sendFile);
@@ -117,8 +117,8 @@ InitBufferPool(void)
 			 */
 			buf->freeNext = i + 1;
 
-			buf->io_in_progress_lock = LWLockAssign();
-			buf->content_lock = LWLockAssign();
+			buf->io_in_progress_lock = LWLockAssignTranche(LWTRANCHE_BUFFER_IO);
+			buf->content_lock = LWLockAssignTranche(LWTRANCHE_BUFFER_CONTENT);
 		}
 
 		/* Correct last entry of linked list */
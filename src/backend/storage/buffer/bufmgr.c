@@ -66,10 +66,14 @@
 
 #define DROP_RELS_BSEARCH_THRESHOLD		20
 
+/* Number of buffers the bgwriter's freelist mode claims from the clock at once */
+#define BGW_CLOCK_CHUNK			32
+
 /* GUC variables */
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
 double		bgwriter_lru_multiplier = 2.0;
+int			bgwriter_freelist_target = 0;
 bool		track_io_timing = false;
 
 /*
@@ -79,9 +83,18 @@ bool		track_io_timing = false;
  */
 int			target_prefetch_pages = 0;
 
-/* local state for StartBufferIO and related functions */
-static volatile BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+/*
+ * local state for StartBufferIO and related functions
+ *
+ * ReadBuffersExtended claims a whole run of buffers for input before issuing
+ * the read, and may have to write out a dirty victim while doing so, so we
+ * must be able to track more than one I/O in progress at a time.
+ */
+#define MAX_IN_PROGRESS_BUFS	(MAX_BUFFERS_PER_READ + 1)
+
+static volatile BufferDesc *InProgressBuf[MAX_IN_PROGRESS_BUFS];
+static bool IsForInput[MAX_IN_PROGRESS_BUFS];
+static int	NumInProgressBufs = 0;
 
 /* local state for LockBufferForCleanup */
 static volatile BufferDesc *PinCountWaitBuf = NULL;
@@ -95,6 +108,7 @@ static bool PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(volatile BufferDesc *buf);
 static void UnpinBuffer(volatile BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
+static bool BgBufferSyncFreelist(uint32 recent_alloc);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used);
 static void WaitIO(volatile BufferDesc *buf);
 static bool StartBufferIO(volatile BufferDesc *buf, bool forInput);
@@ -108,6 +122,13 @@ static volatile BufferDesc *BufferAlloc(SMgrRelation smgr,
 			BlockNumber blockNum,
 			BufferAccessStrategy strategy,
 			bool *foundPtr);
+static void ReadBuffersIO(SMgrRelation smgr, ForkNumber forkNum,
+			  BlockNumber blockNum, volatile BufferDesc **bufHdrs,
+			  int nblocks);
+#ifdef USE_PREFETCH
+static void PrefetchSharedBuffers(SMgrRelation smgr, ForkNumber forkNum,
+					  BlockNumber blockNum, BlockNumber nblocks);
+#endif
 static void FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln);
 static void AtProcExit_Buffers(int code, Datum arg);
 static int	rnode_comparator(const void *p1, const void *p2);
@@ -123,8 +144,25 @@ static int	rnode_comparator(const void *p1, const void *p2);
  */
 void
 PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
+{
+	PrefetchBufferRange(reln, forkNum, blockNum, 1);
+}
+
+/*
+ * PrefetchBufferRange -- initiate asynchronous read of a run of blocks
+ *
+ * Like PrefetchBuffer, for nblocks consecutive blocks starting at blockNum.
+ * Blocks that are already in the buffer pool are left alone, and each run of
+ * uncached blocks is requested from the storage manager in one call, so a
+ * large read-ahead window costs a system call per run rather than per block.
+ */
+void
+PrefetchBufferRange(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+					BlockNumber nblocks)
 {
 #ifdef USE_PREFETCH
+	BlockNumber i;
+
 	Assert(RelationIsValid(reln));
 	Assert(BlockNumberIsValid(blockNum));
 
@@ -140,9 +178,49 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 				errmsg("cannot access temporary tables of other sessions")));
 
 		/* pass it off to localbuf.c */
-		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
+		for (i = 0; i < nblocks; i++)
+			LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum + i);
+		return;
 	}
-	else
+
+	PrefetchSharedBuffers(reln->rd_smgr, forkNum, blockNum, nblocks);
+#endif   /* USE_PREFETCH */
+}
+
+/*
+ * PrefetchBufferWithoutRelcache -- like PrefetchBuffer, but doesn't require
+ *		a relcache entry for the relation.
+ *
+ * This is used by WAL replay, which knows only the RelFileNode.  The block
+ * or even the whole relation may not exist yet; the storage manager quietly
+ * ignores prefetch requests for files that aren't there.
+ */
+void
+PrefetchBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
+							  BlockNumber blockNum)
+{
+#ifdef USE_PREFETCH
+	SMgrRelation smgr = smgropen(rnode, InvalidBackendId);
+
+	Assert(BlockNumberIsValid(blockNum));
+
+	PrefetchSharedBuffers(smgr, forkNum, blockNum, 1);
+#endif   /* USE_PREFETCH */
+}
+
+#ifdef USE_PREFETCH
+/*
+ * PrefetchSharedBuffers -- workhorse for the above, for relations that use
+ *		shared buffers
+ */
+static void
+PrefetchSharedBuffers(SMgrRelation smgr, ForkNumber forkNum,
+					  BlockNumber blockNum, BlockNumber nblocks)
+{
+	BlockNumber i;
+	BlockNumber runlen = 0;
+
+	for (i = 0; i < nblocks; i++)
 	{
 		BufferTag	newTag;		/* identity of requested block */
 		uint32		newHash;	/* hash value for newTag */
@@ -150,8 +228,8 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		int			buf_id;
 
 		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
+		INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node,
+					   forkNum, blockNum + i);
 
 		/* determine its hash code and partition lock ID */
 		newHash = BufTableHashCode(&newTag);
@@ -162,9 +240,12 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		buf_id = BufTableLookup(&newTag, newHash);
 		LWLockRelease(newPartitionLock);
 
-		/* If not in buffers, initiate prefetch */
+		/* If not in buffers, add it to the run to be prefetched */
 		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
+		{
+			runlen++;
+			continue;
+		}
 
 		/*
 		 * If the block *is* in buffers, we do nothing.  This is not really
@@ -177,9 +258,16 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		 * real fix would involve some additional per-buffer state, and it's
 		 * not clear that there's enough of a problem to justify that.
 		 */
+		if (runlen > 0)
+			smgrprefetch(smgr, forkNum, blockNum + i - runlen, runlen);
+		runlen = 0;
 	}
-#endif   /* USE_PREFETCH */
+
+	if (runlen > 0)
+		smgrprefetch(smgr, forkNum, blockNum + nblocks - runlen,
+					 runlen);
 }
+#endif   /* USE_PREFETCH */
 
 
 /*
@@ -260,6 +348,194 @@ ReadBufferExtended(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
 }
 
 
+/*
+ * ReadBuffersExtended -- read a run of consecutive blocks of a relation
+ *
+ * On return, buffers[i] is a pinned buffer holding block blockNum + i, just
+ * as if ReadBufferExtended had been called in RBM_NORMAL mode for each of
+ * the nblocks blocks in turn.  The difference is that the blocks that are
+ * not already in the buffer pool are claimed as victim buffers up front and
+ * then filled with one smgrreadv call per run of consecutive misses, rather
+ * than with one smgrread call apiece.  This is meant for sequential access
+ * with a BufferAccessStrategy, where the caller knows it will visit all of
+ * the blocks shortly.
+ *
+ * All of the blocks must lie before the relation's current EOF, and nblocks
+ * may not exceed MAX_BUFFERS_PER_READ.
+ */
+void
+ReadBuffersExtended(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+					int nblocks, Buffer *buffers, BufferAccessStrategy strategy)
+{
+	volatile BufferDesc *bufHdrs[MAX_BUFFERS_PER_READ];
+	bool		needIO[MAX_BUFFERS_PER_READ];
+	SMgrRelation smgr;
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= MAX_BUFFERS_PER_READ);
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	/* see comments in ReadBufferExtended */
+	if (RELATION_IS_OTHER_TEMP(reln))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot access temporary tables of other sessions")));
+
+	/*
+	 * Local buffers are cheap to fill one at a time, and there's no point
+	 * in the extra bookkeeping for a single block.
+	 */
+	if (RelationUsesLocalBuffers(reln) || nblocks == 1)
+	{
+		for (i = 0; i < nblocks; i++)
+			buffers[i] = ReadBufferExtended(reln, forkNum, blockNum + i,
+											RBM_NORMAL, strategy);
+		return;
+	}
+
+	smgr = reln->rd_smgr;
+
+	/*
+	 * First pin every block of the run.  Blocks that are already valid need
+	 * nothing more; the others come back from BufferAlloc marked
+	 * IO_IN_PROGRESS, so nobody else will try to read them meanwhile.
+	 */
+	for (i = 0; i < nblocks; i++)
+	{
+		bool		found;
+
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNum + i,
+										   smgr->smgr_rnode.node.spcNode,
+										   smgr->smgr_rnode.node.dbNode,
+										   smgr->smgr_rnode.node.relNode,
+										   smgr->smgr_rnode.backend,
+										   false);
+
+		pgstat_count_buffer_read(reln);
+		bufHdrs[i] = BufferAlloc(smgr, reln->rd_rel->relpersistence,
+								 forkNum, blockNum + i, strategy, &found);
+		buffers[i] = BufferDescriptorGetBuffer(bufHdrs[i]);
+		needIO[i] = !found;
+
+		if (found)
+		{
+			pgBufferUsage.shared_blks_hit++;
+			pgstat_count_buffer_hit(reln);
+			VacuumPageHit++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+
+			TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum + i,
+											  smgr->smgr_rnode.node.spcNode,
+											  smgr->smgr_rnode.node.dbNode,
+											  smgr->smgr_rnode.node.relNode,
+											  smgr->smgr_rnode.backend,
+											  false,
+											  true);
+		}
+		else
+			pgBufferUsage.shared_blks_read++;
+	}
+
+	/* Now fill each run of consecutive misses with a single read */
+	i = 0;
+	while (i < nblocks)
+	{
+		int			runlen;
+
+		if (!needIO[i])
+		{
+			i++;
+			continue;
+		}
+		for (runlen = 1; i + runlen < nblocks; runlen++)
+		{
+			if (!needIO[i + runlen])
+				break;
+		}
+
+		ReadBuffersIO(smgr, forkNum, blockNum + i, &bufHdrs[i], runlen);
+		i += runlen;
+	}
+}
+
+/*
+ * ReadBuffersIO -- subroutine for ReadBuffersExtended.  Reads nblocks
+ *		consecutive blocks into buffers that we have pinned and marked
+ *		IO_IN_PROGRESS, verifies them, and marks them valid.
+ */
+static void
+ReadBuffersIO(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
+			  volatile BufferDesc **bufHdrs, int nblocks)
+{
+	char	   *bufBlocks[MAX_BUFFERS_PER_READ];
+	instr_time	io_start,
+				io_time;
+	int			i;
+
+	for (i = 0; i < nblocks; i++)
+	{
+		Assert(!(bufHdrs[i]->flags & BM_VALID));	/* spinlock not needed */
+		bufBlocks[i] = (char *) BufHdrGetBlock(bufHdrs[i]);
+	}
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	smgrreadv(smgr, forkNum, blockNum, bufBlocks, nblocks);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+	}
+
+	for (i = 0; i < nblocks; i++)
+	{
+		/* check for garbage data */
+		if (!PageIsVerified((Page) bufBlocks[i], blockNum + i))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blockNum + i,
+								relpath(smgr->smgr_rnode, forkNum))));
+				MemSet(bufBlocks[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blockNum + i,
+								relpath(smgr->smgr_rnode, forkNum))));
+		}
+
+		/* Set BM_VALID, terminate IO, and wake up any waiters */
+		TerminateBufferIO(bufHdrs[i], false, BM_VALID);
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum + i,
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  false);
+	}
+}
+
 /*
  * ReadBufferWithoutRelcache -- like ReadBufferExtended, but doesn't require
  *		a relcache entry for the relation.
@@ -1349,6 +1625,9 @@ BufferSync(int flags)
  * has been "lapped" and no buffer allocations have occurred recently,
  * or if the bgwriter has been effectively disabled by setting
  * bgwriter_lru_maxpages to 0.)
+ *
+ * If bgwriter_freelist_target is set, the work is instead done by
+ * BgBufferSyncFreelist.
  */
 bool
 BgBufferSync(void)
@@ -1414,6 +1693,16 @@ BgBufferSync(void)
 		return true;
 	}
 
+	/*
+	 * In freelist mode we run the clock sweep ourselves, so the LRU scan's
+	 * saved position would be meaningless if we switched back later.
+	 */
+	if (bgwriter_freelist_target > 0)
+	{
+		saved_info_valid = false;
+		return BgBufferSyncFreelist(recent_alloc);
+	}
+
 	/*
 	 * Compute strategy_delta = how many buffers have been scanned by the
 	 * clock sweep since last time.  If first time through, assume none. Then
@@ -1636,6 +1925,181 @@ BgBufferSync(void)
 	return (bufs_to_lap == 0 && recent_alloc == 0);
 }
 
+/*
+ * BgBufferSyncFreelist -- freelist mode of the background writer.
+ *
+ * Rather than just cleaning buffers ahead of the clock sweep and leaving it
+ * to backends to find them, we run the clock sweep ourselves and put the
+ * clean, unused buffers we find on the freelist, so that a backend needing
+ * a victim normally pops one off the list without scanning or writing.  We
+ * try to keep at least bgwriter_freelist_target buffers there, or more if
+ * the recent allocation rate (scaled by bgwriter_lru_multiplier) says that
+ * more will be needed before our next round.
+ *
+ * How far the sweep must go to produce that many victims depends on how
+ * many buffers have a zero usage_count when the hand reaches them, so we
+ * keep a smoothed histogram of the usage counts seen by the sweep, and size
+ * each round's scan from it.
+ *
+ * recent_alloc is the number of allocations since the previous call.
+ * Returns true if it's OK to hibernate.
+ */
+static bool
+BgBufferSyncFreelist(uint32 recent_alloc)
+{
+	/*
+	 * Smoothed fraction of swept buffers found with each usage_count; the
+	 * extra last bucket counts pinned buffers.
+	 */
+	static float usage_hist[BM_MAX_USAGE_COUNT + 2];
+	static bool usage_hist_valid = false;
+	static float smoothed_alloc = 0;
+
+	float		smoothing_samples = 16;
+	int			scan_hist[BM_MAX_USAGE_COUNT + 2];
+	float		reclaim_yield;
+	int			num_free;
+	int			target;
+	int			deficit;
+	int			num_to_scan;
+	int			num_scanned;
+	int			num_written;
+	int			num_freed;
+	int			i;
+
+	/* Same fast-attack, slow-decline allocation estimate as BgBufferSync */
+	if (smoothed_alloc <= (float) recent_alloc)
+		smoothed_alloc = recent_alloc;
+	else
+		smoothed_alloc += ((float) recent_alloc - smoothed_alloc) /
+			smoothing_samples;
+	if ((int) (smoothed_alloc * bgwriter_lru_multiplier) == 0)
+		smoothed_alloc = 0;
+
+	/*
+	 * Decide how many free buffers we want.  Buffers in the freelist are
+	 * first in line for eviction, so don't let the list claim too much of
+	 * the pool.
+	 */
+	target = Max(bgwriter_freelist_target,
+				 (int) (smoothed_alloc * bgwriter_lru_multiplier));
+	target = Min(target, NBuffers / 4);
+
+	num_free = StrategyFreeListLength();
+	if (num_free >= target)
+		return (recent_alloc == 0);
+	deficit = target - num_free;
+
+	/*
+	 * Each swept buffer is a victim with probability of about usage_hist[0].
+	 * Until we've seen a sweep, guess one in ten.  Never plan to go around
+	 * the whole pool more than once.
+	 */
+	reclaim_yield = usage_hist_valid ? usage_hist[0] : 0.1;
+	if (reclaim_yield * NBuffers <= (float) deficit)
+		num_to_scan = NBuffers;
+	else
+		num_to_scan = Max((int) ((float) deficit / reclaim_yield), 1);
+
+	/* Make sure we can handle the pin inside SyncOneBuffer */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	MemSet(scan_hist, 0, sizeof(scan_hist));
+	num_scanned = 0;
+	num_written = 0;
+	num_freed = 0;
+
+	while (num_scanned < num_to_scan && num_freed < deficit)
+	{
+		int			chunk = Min(num_to_scan - num_scanned, BGW_CLOCK_CHUNK);
+		int			buf_id = StrategyAdvanceClock(chunk);
+
+		/*
+		 * The clock hand has moved past these buffers, so we must process
+		 * all of them, just as StrategyGetBuffer would have.
+		 */
+		for (i = 0; i < chunk; i++)
+		{
+			volatile BufferDesc *bufHdr = &BufferDescriptors[buf_id];
+			int			this_id = buf_id;
+
+			if (++buf_id >= NBuffers)
+				buf_id = 0;
+			num_scanned++;
+
+			LockBufHdr(bufHdr);
+			if (bufHdr->refcount != 0)
+			{
+				scan_hist[BM_MAX_USAGE_COUNT + 1]++;
+				UnlockBufHdr(bufHdr);
+				continue;
+			}
+			scan_hist[bufHdr->usage_count]++;
+			if (bufHdr->usage_count > 0)
+			{
+				bufHdr->usage_count--;
+				UnlockBufHdr(bufHdr);
+				continue;
+			}
+			if (bufHdr->freeNext != FREENEXT_NOT_IN_LIST)
+			{
+				/* already in the freelist */
+				UnlockBufHdr(bufHdr);
+				continue;
+			}
+			UnlockBufHdr(bufHdr);
+
+			/* It's a victim; write it out if need be */
+			if (num_written < bgwriter_lru_maxpages)
+			{
+				if (SyncOneBuffer(this_id, true) & BUF_WRITTEN)
+				{
+					if (++num_written >= bgwriter_lru_maxpages)
+						BgWriterStats.m_maxwritten_clean++;
+				}
+			}
+
+			/* Hand it to the freelist if it's still clean and unused */
+			LockBufHdr(bufHdr);
+			if (bufHdr->refcount == 0 && bufHdr->usage_count == 0 &&
+				!(bufHdr->flags & BM_DIRTY))
+			{
+				UnlockBufHdr(bufHdr);
+				StrategyFreeBuffer(bufHdr);
+				num_freed++;
+			}
+			else
+				UnlockBufHdr(bufHdr);
+		}
+	}
+
+	BgWriterStats.m_buf_written_clean += num_written;
+
+	/* Fold this round's usage_count distribution into the histogram */
+	if (num_scanned > 0)
+	{
+		for (i = 0; i < BM_MAX_USAGE_COUNT + 2; i++)
+		{
+			float		frac = (float) scan_hist[i] / (float) num_scanned;
+
+			if (usage_hist_valid)
+				usage_hist[i] += (frac - usage_hist[i]) / smoothing_samples;
+			else
+				usage_hist[i] = frac;
+		}
+		usage_hist_valid = true;
+	}
+
+#ifdef BGW_DEBUG
+	elog(DEBUG1, "bgwriter freelist: recent_alloc=%u smoothed=%.2f free=%d target=%d yield=%.3f scanned=%d wrote=%d freed=%d",
+		 recent_alloc, smoothed_alloc, num_free, target, reclaim_yield,
+		 num_scanned, num_written, num_freed);
+#endif
+
+	/* Return true if OK to hibernate */
+	return (recent_alloc == 0 && num_freed >= deficit);
+}
+
 /*
  * SyncOneBuffer -- process a single buffer during syncing.
  *
@@ -3008,7 +3472,7 @@ WaitIO(volatile BufferDesc *buf)
 static bool
 StartBufferIO(volatile BufferDesc *buf, bool forInput)
 {
-	Assert(!InProgressBuf);
+	Assert(NumInProgressBufs < MAX_IN_PROGRESS_BUFS);
 
 	for (;;)
 	{
@@ -3048,8 +3512,9 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBuf[NumInProgressBufs] = buf;
+	IsForInput[NumInProgressBufs] = forInput;
+	NumInProgressBufs++;
 
 	return true;
 }
@@ -3075,7 +3540,14 @@ static void
 TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 				  int set_flag_bits)
 {
-	Assert(buf == InProgressBuf);
+	int			i;
+
+	for (i = NumInProgressBufs - 1; i >= 0; i--)
+	{
+		if (InProgressBuf[i] == buf)
+			break;
+	}
+	Assert(i >= 0);
 
 	LockBufHdr(buf);
 
@@ -3087,16 +3559,19 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = NULL;
+	/* Forget it, keeping the array dense */
+	NumInProgressBufs--;
+	InProgressBuf[i] = InProgressBuf[NumInProgressBufs];
+	IsForInput[i] = IsForInput[NumInProgressBufs];
 
 	LWLockRelease(buf->io_in_progress_lock);
 }
 
 /*
- * AbortBufferIO: Clean up any active buffer I/O after an error.
+ * AbortBufferIO: Clean up any active buffer I/Os after an error.
  *
  *	All LWLocks we might have held have been released,
- *	but we haven't yet released buffer pins, so the buffer is still pinned.
+ *	but we haven't yet released buffer pins, so the buffers are still pinned.
  *
  *	If I/O was in progress, we always set BM_IO_ERROR, even though it's
  *	possible the error condition wasn't related to the I/O.
@@ -3104,10 +3579,10 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 void
 AbortBufferIO(void)
 {
-	volatile BufferDesc *buf = InProgressBuf;
-
-	if (buf)
+	while (NumInProgressBufs > 0)
 	{
+		volatile BufferDesc *buf = InProgressBuf[NumInProgressBufs - 1];
+
 		/*
 		 * Since LWLockReleaseAll has already been called, we're not holding
 		 * the buffer's io_in_progress_lock. We have to re-acquire it so that
@@ -3118,7 +3593,7 @@ AbortBufferIO(void)
 
 		LockBufHdr(buf);
 		Assert(buf->flags & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (IsForInput[NumInProgressBufs - 1])
 		{
 			Assert(!(buf->flags & BM_DIRTY));
 			/* We'd better not think buffer is valid yet */
@@ -29,6 +29,7 @@ typedef struct
 
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
+	int			numFreeBuffers; /* Number of buffers in the list */
 
 	/*
 	 * NOTE: lastFreeBuffer is undefined when firstFreeBuffer is -1 (that is,
@@ -168,14 +169,14 @@ StrategyGetBuffer(BufferAccessStrategy strategy, bool *lock_held)
 
 		/* Unconditionally remove buffer from freelist */
 		StrategyControl->firstFreeBuffer = buf->freeNext;
+		StrategyControl->numFreeBuffers--;
 		buf->freeNext = FREENEXT_NOT_IN_LIST;
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
-		 * it; discard it and retry.  (This can only happen if VACUUM put a
-		 * valid buffer in the freelist and then someone else used it before
-		 * we got to it.  It's probably impossible altogether as of 8.3, but
-		 * we'd better check anyway.)
+		 * it; discard it and retry.  (This can happen if the background
+		 * writer, running in freelist mode, put a valid buffer in the
+		 * freelist and then someone else used it before we got to it.)
 		 */
 		LockBufHdr(buf);
 		if (buf->refcount == 0 && buf->usage_count == 0)
@@ -253,6 +254,7 @@ StrategyFreeBuffer(volatile BufferDesc *buf)
 		if (buf->freeNext < 0)
 			StrategyControl->lastFreeBuffer = buf->buf_id;
 		StrategyControl->firstFreeBuffer = buf->buf_id;
+		StrategyControl->numFreeBuffers++;
 	}
 
 	LWLockRelease(BufFreelistLock);
@@ -287,6 +289,52 @@ StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
 	return result;
 }
 
+/*
+ * StrategyFreeListLength -- report the number of buffers in the freelist
+ *
+ * Used by the bgwriter's freelist mode to decide how much to reclaim.  The
+ * count includes buffers that have been reused since they were put in the
+ * list; StrategyGetBuffer discards those when it reaches them.
+ */
+int
+StrategyFreeListLength(void)
+{
+	int			result;
+
+	LWLockAcquire(BufFreelistLock, LW_SHARED);
+	result = StrategyControl->numFreeBuffers;
+	LWLockRelease(BufFreelistLock);
+	return result;
+}
+
+/*
+ * StrategyAdvanceClock -- claim a stretch of the clock sweep
+ *
+ * Advances the clock sweep hand past nbuffers buffers, and returns the index
+ * of the first of them.  The caller is then responsible for giving those
+ * buffers the same treatment StrategyGetBuffer would (decrementing usage
+ * counts, or reclaiming them).  This is used by the bgwriter's freelist mode
+ * to run the clock sweep ahead of the backends.
+ */
+int
+StrategyAdvanceClock(int nbuffers)
+{
+	int			result;
+
+	Assert(nbuffers > 0 && nbuffers <= NBuffers);
+
+	LWLockAcquire(BufFreelistLock, LW_EXCLUSIVE);
+	result = StrategyControl->nextVictimBuffer;
+	StrategyControl->nextVictimBuffer += nbuffers;
+	if (StrategyControl->nextVictimBuffer >= NBuffers)
+	{
+		StrategyControl->nextVictimBuffer -= NBuffers;
+		StrategyControl->completePasses++;
+	}
+	LWLockRelease(BufFreelistLock);
+	return result;
+}
+
 /*
  * StrategyNotifyBgWriter -- set or clear allocation notification latch
  *
@@ -376,6 +424,7 @@ StrategyInitialize(bool init)
 		 */
 		StrategyControl->firstFreeBuffer = 0;
 		StrategyControl->lastFreeBuffer = NBuffers - 1;
+		StrategyControl->numFreeBuffers = NBuffers;
 
 		/* Initialize the clock sweep pointer */
 		StrategyControl->nextVictimBuffer = 0;
@@ -61,6 +61,9 @@
 #include <sys/file.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 #include <unistd.h>
 #include <fcntl.h>
 #ifdef HAVE_SYS_RESOURCE_H
@@ -315,7 +318,14 @@ int
 pg_fsync_no_writethrough(int fd)
 {
 	if (enableFsync)
-		return fsync(fd);
+	{
+		int			rc;
+
+		pgstat_report_wait_start(WAIT_EVENT_FILE_SYNC);
+		rc = fsync(fd);
+		pgstat_report_wait_end();
+		return rc;
+	}
 	else
 		return 0;
 }
@@ -328,14 +338,19 @@ pg_fsync_writethrough(int fd)
 {
 	if (enableFsync)
 	{
+		int			rc;
+
+		pgstat_report_wait_start(WAIT_EVENT_FILE_SYNC);
 #ifdef WIN32
-		return _commit(fd);
+		rc = _commit(fd);
 #elif defined(F_FULLFSYNC)
-		return (fcntl(fd, F_FULLFSYNC, 0) == -1) ? -1 : 0;
+		rc = (fcntl(fd, F_FULLFSYNC, 0) == -1) ? -1 : 0;
 #else
 		errno = ENOSYS;
-		return -1;
+		rc = -1;
 #endif
+		pgstat_report_wait_end();
+		return rc;
 	}
 	else
 		return 0;
@@ -351,11 +366,16 @@ pg_fdatasync(int fd)
 {
 	if (enableFsync)
 	{
+		int			rc;
+
+		pgstat_report_wait_start(WAIT_EVENT_FILE_SYNC);
 #ifdef HAVE_FDATASYNC
-		return fdatasync(fd);
+		rc = fdatasync(fd);
 #else
-		return fsync(fd);
+		rc = fsync(fd);
 #endif
+		pgstat_report_wait_end();
+		return rc;
 	}
 	else
 		return 0;
@@ -1228,7 +1248,9 @@ FileRead(File file, char *buffer, int amount)
 		return returnCode;
 
 retry:
+	pgstat_report_wait_start(WAIT_EVENT_FILE_READ);
 	returnCode = read(VfdCache[file].fd, buffer, amount);
+	pgstat_report_wait_end();
 
 	if (returnCode >= 0)
 		VfdCache[file].seekPos += returnCode;
@@ -1266,6 +1288,81 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileReadV --- read nbuffers consecutive chunks of "amount" bytes each
+ *
+ * This is equivalent to nbuffers successive FileRead calls, but is done
+ * with a single readv() where available, so that a run of consecutive
+ * blocks costs one system call rather than one per block.  The return
+ * value is the total number of bytes read, or -1 with errno set.
+ */
+int
+FileReadV(File file, char **buffers, int nbuffers, int amount)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0 && nbuffers <= PG_MAX_READV_BUFFERS);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d x %d",
+			   file, VfdCache[file].fileName,
+			   (int64) VfdCache[file].seekPos,
+			   nbuffers, amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+#ifndef WIN32
+	{
+		struct iovec iov[PG_MAX_READV_BUFFERS];
+		int			i;
+
+		for (i = 0; i < nbuffers; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = amount;
+		}
+
+retry:
+		pgstat_report_wait_start(WAIT_EVENT_FILE_READ);
+		returnCode = readv(VfdCache[file].fd, iov, nbuffers);
+		pgstat_report_wait_end();
+
+		if (returnCode >= 0)
+			VfdCache[file].seekPos += returnCode;
+		else
+		{
+			/* OK to retry if interrupted */
+			if (errno == EINTR)
+				goto retry;
+
+			/* Trouble, so assume we don't know the file position anymore */
+			VfdCache[file].seekPos = FileUnknownPos;
+		}
+	}
+#else
+	{
+		int			total = 0;
+		int			i;
+
+		/* No readv() here; fall back to one FileRead per chunk */
+		for (i = 0; i < nbuffers; i++)
+		{
+			returnCode = FileRead(file, buffers[i], amount);
+			if (returnCode < 0)
+				return returnCode;
+			total += returnCode;
+			if (returnCode < amount)
+				break;
+		}
+		returnCode = total;
+	}
+#endif
+
+	return returnCode;
+}
+
 int
 FileWrite(File file, char *buffer, int amount)
 {
@@ -1309,7 +1406,9 @@ FileWrite(File file, char *buffer, int amount)
 
 retry:
 	errno = 0;
+	pgstat_report_wait_start(WAIT_EVENT_FILE_WRITE);
 	returnCode = write(VfdCache[file].fd, buffer, amount);
+	pgstat_report_wait_end();
 
 	/* if write didn't set errno, assume problem is no disk space */
 	if (returnCode != amount && errno == 0)
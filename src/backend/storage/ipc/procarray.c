@@ -46,11 +46,14 @@
 #include <signal.h>
 
 #include "access/clog.h"
+#include "access/csnlog.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/xact.h"
 #include "access/twophase.h"
 #include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/barrier.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/spin.h"
@@ -146,6 +149,13 @@ static void DisplayXidCache(void);
 #endif   /* XIDCACHE_DEBUG */
 
 /* Primitives for KnownAssignedXids array handling for standby */
+static inline void ProcArrayEndTransactionInternal(PGPROC *proc,
+								PGXACT *pgxact, TransactionId latestXid);
+static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
+static bool GetSnapshotDataReuse(Snapshot snapshot);
+#ifdef USE_CSN_SNAPSHOTS
+static inline void ProcArrayAssignCommitSeqNo(TransactionId xid);
+#endif
 static void KnownAssignedXidsCompress(bool force);
 static void KnownAssignedXidsAdd(TransactionId from_xid, TransactionId to_xid,
 					 bool exclusive_lock);
@@ -327,16 +337,28 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		DisplayXidCache();
 #endif
 
+#ifdef USE_CSN_SNAPSHOTS
+	if (TransactionIdIsValid(latestXid))
+		CSNLogPrepareCommitSeqNo(allPgXact[proc->pgprocno].xid);
+#endif
+
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 
 	if (TransactionIdIsValid(latestXid))
 	{
 		Assert(TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
 
+#ifdef USE_CSN_SNAPSHOTS
+		ProcArrayAssignCommitSeqNo(allPgXact[proc->pgprocno].xid);
+#endif
+
 		/* Advance global latestCompletedXid while holding the lock */
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		/* Same with xactCompletionCount */
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -393,26 +415,23 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 		 */
 		Assert(TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
 
-		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
-
-		pgxact->xid = InvalidTransactionId;
-		proc->lxid = InvalidLocalTransactionId;
-		pgxact->xmin = InvalidTransactionId;
-		/* must be cleared with xid/xmin: */
-		pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
-		pgxact->delayChkpt = false;		/* be sure this is cleared in abort */
-		proc->recoveryConflictPending = false;
-
-		/* Clear the subtransaction-XID cache too while holding the lock */
-		pgxact->nxids = 0;
-		pgxact->overflowed = false;
-
-		/* Also advance global latestCompletedXid while holding the lock */
-		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
-								  latestXid))
-			ShmemVariableCache->latestCompletedXid = latestXid;
+#ifdef USE_CSN_SNAPSHOTS
+		CSNLogPrepareCommitSeqNo(pgxact->xid);
+#endif
 
-		LWLockRelease(ProcArrayLock);
+		/*
+		 * If we can get ProcArrayLock without waiting, clear our XID
+		 * ourselves.  Otherwise, rather than queueing up on the lock behind
+		 * every other committing backend, join a group of backends whose
+		 * XIDs will be cleared together by whichever of them gets the lock.
+		 */
+		if (LWLockConditionalAcquire(ProcArrayLock, LW_EXCLUSIVE))
+		{
+			ProcArrayEndTransactionInternal(proc, pgxact, latestXid);
+			LWLockRelease(ProcArrayLock);
+		}
+		else
+			ProcArrayGroupClearXid(proc, latestXid);
 	}
 	else
 	{
@@ -435,6 +454,170 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 	}
 }
 
+#ifdef USE_CSN_SNAPSHOTS
+/*
+ * Give a transaction that is leaving the ProcArray the next commit sequence
+ * number, if it committed.  Snapshots taken from now on will see it as
+ * committed, exactly as they will no longer find it among the running XIDs.
+ * Both must happen under the same exclusive ProcArrayLock: HeapTupleSatisfies
+ * routines ask TransactionIdIsInProgress() before XidInMVCCSnapshot(), so a
+ * snapshot that could see the CSN while the XID is still in the ProcArray
+ * would find the transaction in progress first and committed later.
+ *
+ * The caller has already brought the CSN log page in with
+ * CSNLogPrepareCommitSeqNo(), so this seldom needs I/O.
+ *
+ * Caller must hold ProcArrayLock in exclusive mode.
+ */
+static inline void
+ProcArrayAssignCommitSeqNo(TransactionId xid)
+{
+	if (TransactionIdDidCommit(xid))
+		CSNLogAssignCommitSeqNo(xid);
+}
+#endif
+
+/*
+ * Mark a write transaction as no longer running.
+ *
+ * Caller must hold ProcArrayLock in exclusive mode.
+ */
+static inline void
+ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
+								TransactionId latestXid)
+{
+#ifdef USE_CSN_SNAPSHOTS
+	ProcArrayAssignCommitSeqNo(pgxact->xid);
+#endif
+
+	pgxact->xid = InvalidTransactionId;
+	proc->lxid = InvalidLocalTransactionId;
+	pgxact->xmin = InvalidTransactionId;
+	/* must be cleared with xid/xmin: */
+	pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+	pgxact->delayChkpt = false; /* be sure this is cleared in abort */
+	proc->recoveryConflictPending = false;
+
+	/* Clear the subtransaction-XID cache too while holding the lock */
+	pgxact->nxids = 0;
+	pgxact->overflowed = false;
+
+	/* Also advance global latestCompletedXid while holding the lock */
+	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
+							  latestXid))
+		ShmemVariableCache->latestCompletedXid = latestXid;
+
+	/* Same with xactCompletionCount */
+	ShmemVariableCache->xactCompletionCount++;
+}
+
+/*
+ * ProcArrayGroupClearXid -- group XID clearing
+ *
+ * When we cannot immediately acquire ProcArrayLock in exclusive mode at
+ * commit time, add ourselves to a list of processes that need their XIDs
+ * cleared.  The first process to add itself to the list will acquire
+ * ProcArrayLock in exclusive mode and perform ProcArrayEndTransactionInternal
+ * on behalf of all group members.  This avoids a great deal of contention
+ * around ProcArrayLock when many processes are trying to commit at once,
+ * since the lock need not be repeatedly handed off from one committing
+ * process to the next.
+ *
+ * The list is a singly-linked stack of PGPROCs threaded through
+ * procArrayGroupNext, with its head in ProcGlobal.  Pushing onto it and
+ * detaching it only take a spinlock for a few instructions.
+ */
+static void
+ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
+{
+	volatile PROC_HDR *procglobal = ProcGlobal;
+	PGPROC	   *first;
+	PGPROC	   *member;
+	int			extraWaits = 0;
+
+	/* We should definitely have an XID to clear. */
+	Assert(TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
+
+	/* Add ourselves to the list of processes needing a group XID clear. */
+	proc->procArrayGroupMember = true;
+	proc->procArrayGroupMemberXid = latestXid;
+
+	SpinLockAcquire(&procglobal->procArrayGroupLock);
+	first = procglobal->procArrayGroupFirst;
+	proc->procArrayGroupNext = first;
+	procglobal->procArrayGroupFirst = proc;
+	SpinLockRelease(&procglobal->procArrayGroupLock);
+
+	/*
+	 * If the list was not empty, the leader will clear our XID.  It is
+	 * impossible to have followers without a leader because the first process
+	 * that has added itself to the list will always see an empty list.
+	 */
+	if (first != NULL)
+	{
+		/* Sleep until the leader clears our XID. */
+		pgstat_report_wait_start(GetLWLockWaitEvent(ProcArrayLock));
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(&proc->sem, false);
+			if (!proc->procArrayGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(proc->procArrayGroupNext == NULL);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(&proc->sem);
+		return;
+	}
+
+	/* We are the leader.  Acquire the lock on behalf of everyone. */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+	/*
+	 * Now that we've got the lock, clear the list of processes waiting for
+	 * group XID clearing, saving a pointer to the head of the list.  Trying
+	 * to pop elements one at a time could lead to an ABA problem.
+	 */
+	SpinLockAcquire(&procglobal->procArrayGroupLock);
+	first = procglobal->procArrayGroupFirst;
+	procglobal->procArrayGroupFirst = NULL;
+	SpinLockRelease(&procglobal->procArrayGroupLock);
+
+	/* Walk the list and clear all XIDs. */
+	for (member = first; member != NULL; member = member->procArrayGroupNext)
+		ProcArrayEndTransactionInternal(member,
+										&allPgXact[member->pgprocno],
+										member->procArrayGroupMemberXid);
+
+	/* We're done with the lock now. */
+	LWLockRelease(ProcArrayLock);
+
+	/*
+	 * Now that we've released the lock, go back and wake everybody up.  We
+	 * don't do this under the lock so as to keep lock hold times to a
+	 * minimum.  The system calls we need to perform to wake other processes
+	 * up are probably much slower than the simple memory writes we did while
+	 * holding the lock.
+	 */
+	while (first != NULL)
+	{
+		member = first;
+		first = member->procArrayGroupNext;
+
+		member->procArrayGroupNext = NULL;
+		/* ensure all previous writes are visible before follower continues */
+		pg_write_barrier();
+		member->procArrayGroupMember = false;
+
+		if (member != proc)
+			PGSemaphoreUnlock(&member->sem);
+	}
+}
 
 /*
  * ProcArrayClearTransaction -- clear the transaction fields
@@ -450,11 +633,15 @@ ProcArrayClearTransaction(PGPROC *proc)
 	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But our own static snapshots leave
+	 * out our XID, which from now on belongs to the prepared transaction, so
+	 * we must advance xactCompletionCount to keep GetSnapshotData() from
+	 * reusing them.  That requires ProcArrayLock.
 	 */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
 	pgxact->xid = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
@@ -467,6 +654,10 @@ ProcArrayClearTransaction(PGPROC *proc)
 	/* Clear the subtransaction-XID cache too */
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+
+	ShmemVariableCache->xactCompletionCount++;
+
+	LWLockRelease(ProcArrayLock);
 }
 
 /*
@@ -1269,6 +1460,60 @@ GetMaxSnapshotSubxidCount(void)
 	return TOTAL_MAX_CACHED_SUBXIDS;
 }
 
+/*
+ * Helper function for GetSnapshotData() that checks if the bulk of the
+ * visibility information in the snapshot is still valid.  If so, it updates
+ * the fields that need to change and returns true.  Otherwise it returns
+ * false.
+ *
+ * Caller must hold ProcArrayLock.
+ */
+static bool
+GetSnapshotDataReuse(Snapshot snapshot)
+{
+	uint64		curXactCompletionCount;
+
+	if (snapshot->snapXactCompletionCount == 0)
+		return false;
+
+	curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+	if (curXactCompletionCount != snapshot->snapXactCompletionCount)
+		return false;
+
+	/*
+	 * If the current xactCompletionCount is still the same as it was at the
+	 * time the snapshot was built, we can be sure that rebuilding the
+	 * contents of the snapshot the hard way would result in the same
+	 * snapshot contents:
+	 *
+	 * As explained in transam/README, the set of xids considered running by
+	 * GetSnapshotData() cannot change while ProcArrayLock is held. Snapshot
+	 * contents only depend on transactions with xids and xactCompletionCount
+	 * is incremented whenever a transaction with an xid finishes (while
+	 * holding ProcArrayLock exclusively). Thus the xactCompletionCount check
+	 * ensures we would detect if the snapshot would have changed.
+	 *
+	 * As the snapshot contents are the same as it was before, it is safe to
+	 * re-enter the snapshot's xmin into the PGXACT. That's OK, as any
+	 * xids that were running when the snapshot was built are still running,
+	 * so no backend can have computed a global xmin past it.  For the same
+	 * reason RecentGlobalXmin, as last computed by this backend, remains a
+	 * safe (if possibly conservative) horizon and is left alone.
+	 */
+	if (!TransactionIdIsValid(MyPgXact->xmin))
+		MyPgXact->xmin = TransactionXmin = snapshot->xmin;
+
+	RecentXmin = snapshot->xmin;
+	Assert(TransactionIdPrecedesOrEquals(TransactionXmin, RecentXmin));
+
+	snapshot->curcid = GetCurrentCommandId(false);
+	snapshot->active_count = 0;
+	snapshot->regd_count = 0;
+	snapshot->copied = false;
+
+	return true;
+}
+
 /*
  * GetSnapshotData -- returns information about running transactions.
  *
@@ -1299,6 +1544,11 @@ GetMaxSnapshotSubxidCount(void)
  *			running transactions, except those running LAZY VACUUM).  This is
  *			the same computation done by GetOldestXmin(true, true).
  *
+ * If no transaction with an XID has completed since this snapshot was last
+ * filled in, its contents are still accurate, and we skip the scan of the
+ * ProcArray (see GetSnapshotDataReuse).  In that case RecentGlobalXmin is
+ * left as it was.
+ *
  * Note: this function should probably not be called with an argument that's
  * not statically allocated (see xip allocation below).
  */
@@ -1313,6 +1563,7 @@ GetSnapshotData(Snapshot snapshot)
 	int			count = 0;
 	int			subcount = 0;
 	bool		suboverflowed = false;
+	uint64		curXactCompletionCount;
 
 	Assert(snapshot != NULL);
 
@@ -1354,6 +1605,14 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	LWLockAcquire(ProcArrayLock, LW_SHARED);
 
+	if (GetSnapshotDataReuse(snapshot))
+	{
+		LWLockRelease(ProcArrayLock);
+		return snapshot;
+	}
+
+	curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
 	/* xmax is always latestCompletedXid + 1 */
 	xmax = ShmemVariableCache->latestCompletedXid;
 	Assert(TransactionIdIsNormal(xmax));
@@ -1364,6 +1623,17 @@ GetSnapshotData(Snapshot snapshot)
 
 	snapshot->takenDuringRecovery = RecoveryInProgress();
 
+#ifdef USE_CSN_SNAPSHOTS
+	/*
+	 * XIDs committing from now on get this CSN or a later one, and XIDs that
+	 * already have an older one are no longer in the ProcArray.
+	 */
+	if (!snapshot->takenDuringRecovery)
+		snapshot->snapshotcsn = ShmemVariableCache->nextCommitSeqNo;
+	else
+		snapshot->snapshotcsn = InvalidCommitSeqNo;
+#endif
+
 	if (!snapshot->takenDuringRecovery)
 	{
 		int		   *pgprocnos = arrayP->pgprocnos;
@@ -1514,6 +1784,15 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
 
+	/*
+	 * Snapshots taken during recovery are never reused; KnownAssignedXids
+	 * changes without advancing xactCompletionCount.
+	 */
+	if (snapshot->takenDuringRecovery)
+		snapshot->snapXactCompletionCount = 0;
+	else
+		snapshot->snapXactCompletionCount = curXactCompletionCount;
+
 	snapshot->curcid = GetCurrentCommandId(false);
 
 	/*
@@ -18,13 +18,13 @@
 #include <unistd.h>
 
 #include "miscadmin.h"
+#include "port/atomics.h"
 #include "storage/backendid.h"
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "storage/procsignal.h"
 #include "storage/shmem.h"
 #include "storage/sinvaladt.h"
-#include "storage/spin.h"
 
 
 /*
@@ -42,12 +42,11 @@
  * smallest nextMsgNum --- it may lag behind.  We only update it when
  * SICleanupQueue is called, and we try not to do that often.)
  *
- * In reality, the messages are stored in a circular buffer of MAXNUMMESSAGES
- * entries.  We translate MsgNum values into circular-buffer indexes by
- * computing MsgNum % MAXNUMMESSAGES (this should be fast as long as
- * MAXNUMMESSAGES is a constant and a power of 2).	As long as maxMsgNum
- * doesn't exceed minMsgNum by more than MAXNUMMESSAGES, we have enough space
- * in the buffer.  If the buffer does overflow, we recover by setting the
+ * In reality, the messages are stored in a circular buffer of queueSize
+ * entries, sinval_queue_size rounded up to a power of 2.  We translate MsgNum
+ * values into circular-buffer indexes by masking off the high-order bits.
+ * As long as maxMsgNum doesn't exceed minMsgNum by more than queueSize, we
+ * have enough space in the buffer.  If the buffer does overflow, we recover by setting the
  * "reset" flag for each backend that has fallen too far behind.  A backend
  * that is in "reset" state is ignored while determining minMsgNum.  When
  * it does finally attempt to receive inval messages, it must discard all
@@ -69,12 +68,28 @@
  * of "stuck" backends, we won't need a lot of extra interrupts, since ones
  * that aren't stuck will propagate their interrupts to the next guy.
  *
+ * Most messages only concern a single database: a backend connected to
+ * another one has nothing cached that they could invalidate.  Only catalog
+ * changes to shared catalogs, and smgr messages for non-temporary relations
+ * (which any backend may have open to write out a dirty buffer), have to be
+ * processed by everyone.  We exploit that in two ways.  Writers only set the
+ * hasMessages flag of backends that the new messages are relevant to, so
+ * that a burst of DDL in one database doesn't make every backend in the
+ * cluster take SInvalReadLock.  And for each database, we remember the
+ * number of the last message that concerned it (in a small table: databases
+ * that fall out of it are treated as if they were concerned by everything
+ * that has ever fallen out).  A backend that hasn't read the latest messages,
+ * but has read everything that concerns its database, can simply be moved
+ * forward to maxMsgNum by SICleanupQueue, rather than holding back
+ * minMsgNum, being signaled, and eventually being reset.  Backends that
+ * aren't connected to a database yet are sent everything.
+ *
  * We would have problems if the MsgNum values overflow an integer, so
  * whenever minMsgNum exceeds MSGNUMWRAPAROUND, we subtract MSGNUMWRAPAROUND
  * from all the MsgNum variables simultaneously.  MSGNUMWRAPAROUND can be
  * large so that we don't need to do this often.  It must be a multiple of
- * MAXNUMMESSAGES so that the existing circular-buffer entries don't need
- * to be moved when we do it.
+ * queueSize so that the existing circular-buffer entries don't need to be
+ * moved when we do it.
  *
  * Access to the shared sinval array is protected by two locks, SInvalReadLock
  * and SInvalWriteLock.  Readers take SInvalReadLock in shared mode; this
@@ -87,30 +102,24 @@
  * has no need to touch anyone's ProcState, except in the infrequent cases
  * when SICleanupQueue is needed.  The only point of overlap is that
  * the writer wants to change maxMsgNum while readers need to read it.
- * We deal with that by having a spinlock that readers must take for just
- * long enough to read maxMsgNum, while writers take it for just long enough
- * to write maxMsgNum.	(The exact rule is that you need the spinlock to
- * read maxMsgNum if you are not holding SInvalWriteLock, and you need the
- * spinlock to write maxMsgNum unless you are holding both locks.)
- *
- * Note: since maxMsgNum is an int and hence presumably atomically readable/
- * writable, the spinlock might seem unnecessary.  The reason it is needed
- * is to provide a memory barrier: we need to be sure that messages written
- * to the array are actually there before maxMsgNum is increased, and that
- * readers will see that data after fetching maxMsgNum.  Multiprocessors
- * that have weak memory-ordering guarantees can fail without the memory
- * barrier instructions that are included in the spinlock sequences.
+ * maxMsgNum is an atomic variable, so that can be done without any lock,
+ * but we need memory barriers: writers must be sure that messages written
+ * to the array are actually there before maxMsgNum is increased, and
+ * readers must be sure to see that data after fetching maxMsgNum.
+ * Multiprocessors that have weak memory-ordering guarantees can fail
+ * without them.  (You don't need a barrier to read maxMsgNum if you are
+ * holding SInvalWriteLock, since nobody else can change it then.)
  */
 
 
 /*
  * Configurable parameters.
  *
- * MAXNUMMESSAGES: max number of shared-inval messages we can buffer.
- * Must be a power of 2 for speed.
+ * sinval_queue_size (a GUC): max number of shared-inval messages we can
+ * buffer.  Rounded up to a power of 2 for speed, giving segP->queueSize.
  *
  * MSGNUMWRAPAROUND: how often to reduce MsgNum variables to avoid overflow.
- * Must be a multiple of MAXNUMMESSAGES.  Should be large.
+ * Must be a multiple of queueSize.  Should be large.
  *
  * CLEANUP_MIN: the minimum number of messages that must be in the buffer
  * before we bother to call SICleanupQueue.
@@ -125,14 +134,23 @@
  * iteration of SIInsertDataEntries.  Noncritical but should be less than
  * CLEANUP_QUANTUM, because we only consider calling SICleanupQueue once
  * per iteration.
+ *
+ * NUM_SI_DATABASES: the number of databases for which we track the last
+ * message that concerned them.
  */
 
-#define MAXNUMMESSAGES 4096
-#define MSGNUMWRAPAROUND (MAXNUMMESSAGES * 262144)
-#define CLEANUP_MIN (MAXNUMMESSAGES / 2)
-#define CLEANUP_QUANTUM (MAXNUMMESSAGES / 16)
-#define SIG_THRESHOLD (MAXNUMMESSAGES / 2)
+int			sinval_queue_size = 16384;
+
+#define MAX_SINVAL_QUEUE_SIZE (1 << 20)
+#define MSGNUMWRAPAROUND (1 << 30)
+#define CLEANUP_MIN(segP) ((segP)->queueSize / 2)
+#define CLEANUP_QUANTUM(segP) ((segP)->queueSize / 16)
+#define SIG_THRESHOLD(segP) ((segP)->queueSize / 2)
 #define WRITE_QUANTUM 64
+#define NUM_SI_DATABASES 64
+
+#define SIMsgSlot(segP, msgnum) \
+	((segP)->buffer[(msgnum) & ((segP)->queueSize - 1)])
 
 /* Per-backend state in shared invalidation structure */
 typedef struct ProcState
@@ -163,6 +181,13 @@ typedef struct ProcState
 	LocalTransactionId nextLXID;
 } ProcState;
 
+/* Last message that concerned one database; see SIRecordMessageDatabase */
+typedef struct SIDatabaseState
+{
+	Oid			databaseId;		/* InvalidOid if slot is unused */
+	int			msgEnd;			/* number of the last such message, +1 */
+} SIDatabaseState;
+
 /* Shared cache invalidation memory segment */
 typedef struct SISeg
 {
@@ -170,17 +195,26 @@ typedef struct SISeg
 	 * General state information
 	 */
 	int			minMsgNum;		/* oldest message still needed */
-	int			maxMsgNum;		/* next message number to be assigned */
+	pg_atomic_uint32 maxMsgNum; /* next message number to be assigned */
 	int			nextThreshold;	/* # of messages to call SICleanupQueue */
 	int			lastBackend;	/* index of last active procState entry, +1 */
 	int			maxBackends;	/* size of procState array */
+	int			queueSize;		/* size of buffer array, a power of 2 */
 
-	slock_t		msgnumLock;		/* spinlock protecting maxMsgNum */
+	/*
+	 * Where the last message that concerned each database went, for
+	 * SICleanupQueue.  These are protected by SInvalWriteLock.
+	 */
+	int			sharedMsgEnd;	/* last message concerning all databases, +1 */
+	int			overflowMsgEnd; /* ditto, for databases not in the table */
+	int			lastDatabase;	/* index of last entry looked up */
+	SIDatabaseState databases[NUM_SI_DATABASES];
 
 	/*
-	 * Circular buffer holding shared-inval messages
+	 * Circular buffer holding shared-inval messages; it follows the
+	 * procState array in shared memory.
 	 */
-	SharedInvalidationMessage buffer[MAXNUMMESSAGES];
+	SharedInvalidationMessage *buffer;
 
 	/*
 	 * Per-backend state info.
@@ -197,8 +231,25 @@ static SISeg *shmInvalBuffer;	/* pointer to the shared inval buffer */
 static LocalTransactionId nextLocalTransactionId;
 
 static void CleanupInvalidationState(int status, Datum arg);
+static Oid	SIMessageDatabase(const SharedInvalidationMessage *msg);
+static void SIRecordMessageDatabase(SISeg *segP, Oid dbid, int msgnum);
+static int	SIDatabaseMsgEnd(SISeg *segP, Oid dbid);
 
 
+/*
+ * SInvalQueueSize --- sinval_queue_size, rounded up to a power of 2
+ */
+static int
+SInvalQueueSize(void)
+{
+	int			size = 1;
+
+	while (size < sinval_queue_size && size < MAX_SINVAL_QUEUE_SIZE)
+		size <<= 1;
+
+	return size;
+}
+
 /*
  * SInvalShmemSize --- return shared-memory space needed
  */
@@ -209,6 +260,9 @@ SInvalShmemSize(void)
 
 	size = offsetof(SISeg, procState);
 	size = add_size(size, mul_size(sizeof(ProcState), MaxBackends));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(sizeof(SharedInvalidationMessage),
+								   SInvalQueueSize()));
 
 	return size;
 }
@@ -225,23 +279,36 @@ CreateSharedInvalidationState(void)
 	bool		found;
 
 	/* Allocate space in shared memory */
-	size = offsetof(SISeg, procState);
-	size = add_size(size, mul_size(sizeof(ProcState), MaxBackends));
+	size = SInvalShmemSize();
 
 	shmInvalBuffer = (SISeg *)
 		ShmemInitStruct("shmInvalBuffer", size, &found);
 	if (found)
 		return;
 
-	/* Clear message counters, save size of procState array, init spinlock */
+	/* Clear message counters, save size of procState and buffer arrays */
 	shmInvalBuffer->minMsgNum = 0;
-	shmInvalBuffer->maxMsgNum = 0;
-	shmInvalBuffer->nextThreshold = CLEANUP_MIN;
+	pg_atomic_init_u32(&shmInvalBuffer->maxMsgNum, 0);
 	shmInvalBuffer->lastBackend = 0;
 	shmInvalBuffer->maxBackends = MaxBackends;
-	SpinLockInit(&shmInvalBuffer->msgnumLock);
+	shmInvalBuffer->queueSize = SInvalQueueSize();
+	shmInvalBuffer->nextThreshold = CLEANUP_MIN(shmInvalBuffer);
+
+	/* Nothing has concerned any database yet */
+	shmInvalBuffer->sharedMsgEnd = 0;
+	shmInvalBuffer->overflowMsgEnd = 0;
+	shmInvalBuffer->lastDatabase = 0;
+	for (i = 0; i < NUM_SI_DATABASES; i++)
+	{
+		shmInvalBuffer->databases[i].databaseId = InvalidOid;
+		shmInvalBuffer->databases[i].msgEnd = 0;
+	}
 
 	/* The buffer[] array is initially all unused, so we need not fill it */
+	size = offsetof(SISeg, procState);
+	size = add_size(size, mul_size(sizeof(ProcState), MaxBackends));
+	shmInvalBuffer->buffer = (SharedInvalidationMessage *)
+		((char *) shmInvalBuffer + MAXALIGN(size));
 
 	/* Mark all backends inactive, and initialize nextLXID */
 	for (i = 0; i < shmInvalBuffer->maxBackends; i++)
@@ -316,7 +383,7 @@ SharedInvalBackendInit(bool sendOnly)
 	/* mark myself active, with all extant messages already read */
 	stateP->procPid = MyProcPid;
 	stateP->proc = MyProc;
-	stateP->nextMsgNum = segP->maxMsgNum;
+	stateP->nextMsgNum = (int) pg_atomic_read_u32(&segP->maxMsgNum);
 	stateP->resetState = false;
 	stateP->signaled = false;
 	stateP->hasMessages = false;
@@ -424,6 +491,8 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 		int			numMsgs;
 		int			max;
 		int			i;
+		bool		allDatabases = false;
+		Oid			batchDatabase = InvalidOid;
 
 		n -= nthistime;
 
@@ -438,8 +507,9 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 		 */
 		for (;;)
 		{
-			numMsgs = segP->maxMsgNum - segP->minMsgNum;
-			if (numMsgs + nthistime > MAXNUMMESSAGES ||
+			numMsgs = (int) pg_atomic_read_u32(&segP->maxMsgNum) -
+				segP->minMsgNum;
+			if (numMsgs + nthistime > segP->queueSize ||
 				numMsgs >= segP->nextThreshold)
 				SICleanupQueue(true, nthistime);
 			else
@@ -447,37 +517,50 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 		}
 
 		/*
-		 * Insert new message(s) into proper slot of circular buffer
+		 * Insert new message(s) into proper slot of circular buffer, noting
+		 * which databases they concern.
 		 */
-		max = segP->maxMsgNum;
+		max = (int) pg_atomic_read_u32(&segP->maxMsgNum);
 		while (nthistime-- > 0)
 		{
-			segP->buffer[max % MAXNUMMESSAGES] = *data++;
-			max++;
-		}
+			Oid			dbid = SIMessageDatabase(data);
 
-		/* Update current value of maxMsgNum using spinlock */
-		{
-			/* use volatile pointer to prevent code rearrangement */
-			volatile SISeg *vsegP = segP;
+			SIRecordMessageDatabase(segP, dbid, max);
+			if (!OidIsValid(dbid))
+				allDatabases = true;
+			else if (!OidIsValid(batchDatabase))
+				batchDatabase = dbid;
+			else if (dbid != batchDatabase)
+				allDatabases = true;	/* don't bother tracking several */
 
-			SpinLockAcquire(&vsegP->msgnumLock);
-			vsegP->maxMsgNum = max;
-			SpinLockRelease(&vsegP->msgnumLock);
+			SIMsgSlot(segP, max) = *data++;
+			max++;
 		}
 
+		/* Make the messages visible before the new value of maxMsgNum */
+		pg_write_barrier();
+		pg_atomic_write_u32(&segP->maxMsgNum, (uint32) max);
+
 		/*
 		 * Now that the maxMsgNum change is globally visible, we give everyone
-		 * a swift kick to make sure they read the newly added messages.
-		 * Releasing SInvalWriteLock will enforce a full memory barrier, so
-		 * these (unlocked) changes will be committed to memory before we exit
-		 * the function.
+		 * whom the new messages concern a swift kick to make sure they read
+		 * them.  Backends that aren't connected to a database yet have to
+		 * read everything; and a backend in reset state has to be kicked
+		 * whatever happens, so that it notices.  Releasing SInvalWriteLock
+		 * will enforce a full memory barrier, so these (unlocked) changes
+		 * will be committed to memory before we exit the function.
 		 */
 		for (i = 0; i < segP->lastBackend; i++)
 		{
 			ProcState  *stateP = &segP->procState[i];
-
-			stateP->hasMessages = true;
+			Oid			dbid;
+
+			if (stateP->procPid == 0)
+				continue;
+			dbid = ((volatile PGPROC *) stateP->proc)->databaseId;
+			if (allDatabases || !OidIsValid(dbid) ||
+				dbid == batchDatabase || stateP->resetState)
+				stateP->hasMessages = true;
 		}
 
 		LWLockRelease(SInvalWriteLock);
@@ -517,11 +600,13 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 {
 	SISeg	   *segP;
 	ProcState  *stateP;
+	Oid			myDatabaseId;
 	int			max;
 	int			n;
 
 	segP = shmInvalBuffer;
 	stateP = &segP->procState[MyBackendId - 1];
+	myDatabaseId = MyDatabaseId;
 
 	/*
 	 * Before starting to take locks, do a quick, unlocked test to see whether
@@ -549,16 +634,14 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	 * better be certain to reset this flag before exiting!
 	 */
 	stateP->hasMessages = false;
+	pg_memory_barrier();
 
-	/* Fetch current value of maxMsgNum using spinlock */
-	{
-		/* use volatile pointer to prevent code rearrangement */
-		volatile SISeg *vsegP = segP;
-
-		SpinLockAcquire(&vsegP->msgnumLock);
-		max = vsegP->maxMsgNum;
-		SpinLockRelease(&vsegP->msgnumLock);
-	}
+	/*
+	 * Fetch current value of maxMsgNum.  The barrier ensures that we see
+	 * the messages up to there once we've seen it.
+	 */
+	max = (int) pg_atomic_read_u32(&segP->maxMsgNum);
+	pg_read_barrier();
 
 	if (stateP->resetState)
 	{
@@ -581,12 +664,24 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	 * There may be other backends that haven't read the message(s), so we
 	 * cannot delete them here.  SICleanupQueue() will eventually remove them
 	 * from the queue.
+	 *
+	 * Messages concerning only other databases are skipped, unless we're not
+	 * connected to a database yet.
 	 */
 	n = 0;
 	while (n < datasize && stateP->nextMsgNum < max)
 	{
-		data[n++] = segP->buffer[stateP->nextMsgNum % MAXNUMMESSAGES];
+		SharedInvalidationMessage *msg = &SIMsgSlot(segP, stateP->nextMsgNum);
+
 		stateP->nextMsgNum++;
+		if (OidIsValid(myDatabaseId))
+		{
+			Oid			dbid = SIMessageDatabase(msg);
+
+			if (OidIsValid(dbid) && dbid != myDatabaseId)
+				continue;
+		}
+		data[n++] = *msg;
 	}
 
 	/*
@@ -625,7 +720,8 @@ void
 SICleanupQueue(bool callerHasWriteLock, int minFree)
 {
 	SISeg	   *segP = shmInvalBuffer;
-	int			min,
+	int			max,
+				min,
 				minsig,
 				lowbound,
 				numMsgs,
@@ -644,19 +740,37 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 	 * backends here it is possible for them to keep sending messages without
 	 * a problem even when they are the only active backend.
 	 */
-	min = segP->maxMsgNum;
-	minsig = min - SIG_THRESHOLD;
-	lowbound = min - MAXNUMMESSAGES + minFree;
+	max = (int) pg_atomic_read_u32(&segP->maxMsgNum);
+	min = max;
+	minsig = min - SIG_THRESHOLD(segP);
+	lowbound = min - segP->queueSize + minFree;
 
 	for (i = 0; i < segP->lastBackend; i++)
 	{
 		ProcState  *stateP = &segP->procState[i];
 		int			n = stateP->nextMsgNum;
+		Oid			dbid;
 
 		/* Ignore if inactive or already in reset state */
 		if (stateP->procPid == 0 || stateP->resetState || stateP->sendOnly)
 			continue;
 
+		/*
+		 * If none of the messages this backend hasn't read yet concern its
+		 * database, it is as good as caught up: move it forward.  This is
+		 * safe because we hold SInvalReadLock exclusively, so it can't be
+		 * reading at the same time.
+		 */
+		if (n < max)
+		{
+			dbid = ((volatile PGPROC *) stateP->proc)->databaseId;
+			if (OidIsValid(dbid) && n >= SIDatabaseMsgEnd(segP, dbid))
+			{
+				stateP->nextMsgNum = n = max;
+				stateP->signaled = false;
+			}
+		}
+
 		/*
 		 * If we must free some space and this backend is preventing it, force
 		 * him into reset state and then ignore until he catches up.
@@ -689,23 +803,39 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 	if (min >= MSGNUMWRAPAROUND)
 	{
 		segP->minMsgNum -= MSGNUMWRAPAROUND;
-		segP->maxMsgNum -= MSGNUMWRAPAROUND;
+		max -= MSGNUMWRAPAROUND;
+		pg_atomic_write_u32(&segP->maxMsgNum, (uint32) max);
 		for (i = 0; i < segP->lastBackend; i++)
 		{
 			/* we don't bother skipping inactive entries here */
 			segP->procState[i].nextMsgNum -= MSGNUMWRAPAROUND;
 		}
+
+		/*
+		 * Message numbers that are older than anything in the queue just
+		 * mean "long ago"; clamp them so that repeated wraparounds can't
+		 * overflow them.
+		 */
+		segP->sharedMsgEnd = Max(segP->sharedMsgEnd - MSGNUMWRAPAROUND, 0);
+		segP->overflowMsgEnd = Max(segP->overflowMsgEnd - MSGNUMWRAPAROUND, 0);
+		for (i = 0; i < NUM_SI_DATABASES; i++)
+		{
+			SIDatabaseState *db = &segP->databases[i];
+
+			db->msgEnd = Max(db->msgEnd - MSGNUMWRAPAROUND, 0);
+		}
 	}
 
 	/*
 	 * Determine how many messages are still in the queue, and set the
 	 * threshold at which we should repeat SICleanupQueue().
 	 */
-	numMsgs = segP->maxMsgNum - segP->minMsgNum;
-	if (numMsgs < CLEANUP_MIN)
-		segP->nextThreshold = CLEANUP_MIN;
+	numMsgs = max - segP->minMsgNum;
+	if (numMsgs < CLEANUP_MIN(segP))
+		segP->nextThreshold = CLEANUP_MIN(segP);
 	else
-		segP->nextThreshold = (numMsgs / CLEANUP_QUANTUM + 1) * CLEANUP_QUANTUM;
+		segP->nextThreshold = (numMsgs / CLEANUP_QUANTUM(segP) + 1) *
+			CLEANUP_QUANTUM(segP);
 
 	/*
 	 * Lastly, signal anyone who needs a catchup interrupt.  Since
@@ -733,6 +863,117 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 	}
 }
 
+/*
+ * SIMessageDatabase
+ *		Return the database whose backends need to process a message, or
+ *		InvalidOid if every backend needs to.
+ *
+ * Catalog, relcache and relmap messages carry the database they concern, or
+ * InvalidOid for shared catalogs.  An smgr message for a temporary relation
+ * concerns only the database of the backend owning it; but any backend can
+ * have any other relation open at the smgr level, having written out one of
+ * its dirty buffers, so all others concern everybody.
+ */
+static Oid
+SIMessageDatabase(const SharedInvalidationMessage *msg)
+{
+	if (msg->id >= 0)
+		return msg->cc.dbId;
+
+	switch (msg->id)
+	{
+		case SHAREDINVALCATALOG_ID:
+			return msg->cat.dbId;
+		case SHAREDINVALRELCACHE_ID:
+			return msg->rc.dbId;
+		case SHAREDINVALSMGR_ID:
+			{
+				BackendId	backend;
+
+				backend = (msg->sm.backend_hi << 16) | (int) msg->sm.backend_lo;
+				if (backend != InvalidBackendId)
+					return msg->sm.rnode.dbNode;
+				return InvalidOid;
+			}
+		case SHAREDINVALRELMAP_ID:
+			return msg->rm.dbId;
+		default:
+			return InvalidOid;
+	}
+}
+
+/*
+ * SIRecordMessageDatabase
+ *		Remember that message number msgnum concerns database dbid, or all
+ *		databases if dbid is InvalidOid.
+ *
+ * If the database isn't in the table yet and the table is full, we evict
+ * the entry that has gone longest without a message, and fold it into
+ * overflowMsgEnd, which applies to all databases that aren't in the table.
+ *
+ * Caller must hold SInvalWriteLock.
+ */
+static void
+SIRecordMessageDatabase(SISeg *segP, Oid dbid, int msgnum)
+{
+	SIDatabaseState *db;
+	SIDatabaseState *victim;
+	int			i;
+
+	if (!OidIsValid(dbid))
+	{
+		segP->sharedMsgEnd = msgnum + 1;
+		return;
+	}
+
+	/* Messages usually come in runs for the same database */
+	db = &segP->databases[segP->lastDatabase];
+	if (db->databaseId != dbid)
+	{
+		victim = NULL;
+		for (i = 0; i < NUM_SI_DATABASES; i++)
+		{
+			db = &segP->databases[i];
+			if (db->databaseId == dbid)
+				break;
+			if (victim == NULL || !OidIsValid(db->databaseId) ||
+				(OidIsValid(victim->databaseId) &&
+				 db->msgEnd < victim->msgEnd))
+				victim = db;
+		}
+		if (i >= NUM_SI_DATABASES)
+		{
+			db = victim;
+			if (OidIsValid(db->databaseId))
+				segP->overflowMsgEnd = Max(segP->overflowMsgEnd, db->msgEnd);
+			db->databaseId = dbid;
+		}
+		segP->lastDatabase = db - &segP->databases[0];
+	}
+
+	db->msgEnd = msgnum + 1;
+}
+
+/*
+ * SIDatabaseMsgEnd
+ *		Return the number of the last message concerning database dbid, +1.
+ *
+ * Caller must hold SInvalWriteLock.
+ */
+static int
+SIDatabaseMsgEnd(SISeg *segP, Oid dbid)
+{
+	int			i;
+
+	for (i = 0; i < NUM_SI_DATABASES; i++)
+	{
+		if (segP->databases[i].databaseId == dbid)
+			return Max(segP->databases[i].msgEnd, segP->sharedMsgEnd);
+	}
+
+	return Max(segP->overflowMsgEnd, segP->sharedMsgEnd);
+}
+
 
 /*
  * GetNextLocalTransactionId --- allocate a new LocalTransactionId
@@ -16,6 +16,7 @@
  *
  *	Interface:
  *
+ *	DeadLockCheckNeeded()
  *	DeadLockCheck()
  *	DeadLockReport()
  *	RememberSimpleDeadLock()
@@ -185,6 +186,69 @@ InitDeadLockChecking(void)
 	MemoryContextSwitchTo(oldcxt);
 }
 
+/*
+ * DeadLockCheckNeeded -- Cheap test whether DeadLockCheck could find anything
+ *
+ * Every waits-for edge out of a waiting process leads to a holder of the lock
+ * it awaits, or to another waiter for that lock, whose own edges in turn lead
+ * only to holders of and waiters for the same lock.  So a deadlock cycle
+ * through proc must pass through a process that holds proc's awaited lock
+ * and is waiting itself, or through proc as a holder of that lock.  If there
+ * is no such process, there is no deadlock involving proc, and no need to
+ * lock every partition of the lock tables to look for one.
+ *
+ * A cycle that closes after we look will be found by whichever process joins
+ * it last, when that process's own deadlock timeout expires: at that point
+ * the rest of the cycle is already waiting.
+ *
+ * This also returns true if proc is directly blocked by an autovacuum worker,
+ * so that DeadLockCheck gets to report it.
+ *
+ * Caller must hold the partition lock of the lock proc is waiting for, in
+ * shared or exclusive mode.  Other procs' waitLock fields are read without
+ * holding their partition locks; we only care whether they are NULL.
+ */
+bool
+DeadLockCheckNeeded(PGPROC *proc)
+{
+	LOCK	   *lock = proc->waitLock;
+	LockMethod	lockMethodTable;
+	SHM_QUEUE  *procLocks;
+	PROCLOCK   *proclock;
+	int			conflictMask;
+
+	if (lock == NULL)
+		return false;
+	lockMethodTable = GetLocksMethodTable(lock);
+	conflictMask = lockMethodTable->conflictTab[proc->waitLockMode];
+
+	procLocks = &(lock->procLocks);
+	proclock = (PROCLOCK *) SHMQueueNext(procLocks, procLocks,
+										 offsetof(PROCLOCK, lockLink));
+	while (proclock)
+	{
+		PGPROC	   *holder = proclock->tag.myProc;
+
+		if (proclock->holdMask != 0)
+		{
+			/* waiters behind us may be blocked by what we hold */
+			if (holder == proc)
+				return true;
+			if (holder->waitLock != NULL)
+				return true;
+			if ((proclock->holdMask & conflictMask) &&
+				(ProcGlobal->allPgXact[holder->pgprocno].vacuumFlags &
+				 PROC_IS_AUTOVACUUM))
+				return true;
+		}
+
+		proclock = (PROCLOCK *) SHMQueueNext(procLocks, &proclock->lockLink,
+											 offsetof(PROCLOCK, lockLink));
+	}
+
+	return false;
+}
+
 /*
  * DeadLockCheck -- Checks for deadlocks for a given process
  *
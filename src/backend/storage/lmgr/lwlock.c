@@ -10,6 +10,25 @@
  * locking should be done with the full lock manager --- which depends on
  * LWLocks to protect its shared state.
  *
+ * The lock's state lives in a single 32-bit word that is only ever changed
+ * with atomic operations (see port/atomics.h): one bit for an exclusive
+ * holder, a count of shared holders, and flags that tell releasers whether
+ * there are waiters to wake up.  Acquiring or releasing an uncontended lock,
+ * in either mode, is thus one compare-and-exchange or fetch-and-add, and
+ * never touches the spinlock.  The spinlock only protects the queue of
+ * waiting PGPROCs (and the variable of LWLockAcquireWithVar and friends), so
+ * it is only taken by backends that have to sleep and by the backends that
+ * wake them up.
+ *
+ * Since the lock can be acquired without looking at the queue, a backend
+ * that finds it busy can't just enqueue itself and sleep: the holder might
+ * release it in between without noticing the new waiter.  Instead it
+ * enqueues itself, which sets LW_FLAG_HAS_WAITERS, and then tries to get the
+ * lock once more.  If that second attempt fails, the holder is guaranteed to
+ * see the flag when it releases the lock, because both sides update the
+ * state word atomically; if it succeeds, the backend takes itself off the
+ * queue again.
+ *
  *
  * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -22,11 +41,14 @@
 #include "postgres.h"
 
 #include "access/clog.h"
+#include "access/csnlog.h"
 #include "access/multixact.h"
 #include "access/subtrans.h"
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "pgstat.h"
+#include "port/atomics.h"
 #include "storage/ipc.h"
 #include "storage/predicate.h"
 #include "storage/proc.h"
@@ -37,30 +59,53 @@
 extern slock_t *ShmemLock;
 
 
+/*
+ * Layout of LWLock.state.  The shared holder count occupies the low bits;
+ * MAX_BACKENDS is 2^23-1, so it can never carry into LW_VAL_EXCLUSIVE.
+ * LW_FLAG_RELEASE_OK is cleared when waiters have been woken up but haven't
+ * yet had a chance to retry, to avoid waking up more of them in the
+ * meantime; it is set again as they retry.
+ */
+#define LW_FLAG_HAS_WAITERS			((uint32) 1 << 30)
+#define LW_FLAG_RELEASE_OK			((uint32) 1 << 29)
+
+#define LW_VAL_EXCLUSIVE			((uint32) 1 << 24)
+#define LW_VAL_SHARED				1
+
+#define LW_LOCK_MASK				((uint32) ((1 << 25) - 1))
+#define LW_SHARED_MASK				((uint32) ((1 << 24) - 1))
+
 typedef struct LWLock
 {
-	slock_t		mutex;			/* Protects LWLock and queue of PGPROCs */
-	bool		releaseOK;		/* T if ok to release waiters */
-	char		exclusive;		/* # of exclusive holders (0 or 1) */
-	int			shared;			/* # of shared holders (0..MaxBackends) */
+	slock_t		mutex;			/* Protects queue of PGPROCs, and the
+								 * variable of LWLockAcquireWithVar */
+	uint8		tranche;		/* LWLockTranche this lock belongs to */
+	pg_atomic_uint32 state;		/* exclusive/shared holders and flags */
 	PGPROC	   *head;			/* head of list of waiting PGPROCs */
 	PGPROC	   *tail;			/* tail of list of waiting PGPROCs */
 	/* tail is undefined when head is NULL */
 } LWLock;
 
 /*
- * All the LWLock structs are allocated as an array in shared memory.
- * (LWLockIds are indexes into the array.)	We force the array stride to
- * be a power of 2, which saves a few cycles in indexing, but more
- * importantly also ensures that individual LWLocks don't cross cache line
- * boundaries.	This reduces cache contention problems, especially on AMD
- * Opterons.  (Of course, we have to also ensure that the array start
+ * All the LWLock structs are allocated as two arrays in shared memory, one
+ * right after the other.  The first holds the NumFixedLWLocks predefined
+ * locks, indexed by LWLockId; each is padded out to a full cache line, so
+ * that no two of them share one.  Otherwise heavily contended locks that
+ * happen to be neighbours, such as the buffer mapping partition locks, would
+ * bounce the same line between CPUs even when different backends take
+ * different locks.  (Of course, we have to also ensure that the array start
  * address is suitably aligned.)
  *
- * LWLock is between 16 and 32 bytes on all known platforms, so these two
- * cases are sufficient.
+ * The second array holds the dynamically assigned locks, most of which are
+ * the two per shared buffer.  Padding those to a cache line would cost a
+ * noticeable fraction of shared_buffers, and any one of them is seldom hot,
+ * so they are only padded to a power of 2 to keep indexing cheap.  LWLock
+ * is between 16 and 32 bytes on all known platforms, except when both
+ * spinlocks and atomics have to be emulated with semaphores, where it can
+ * be a little more.
  */
-#define LWLOCK_PADDED_SIZE	(sizeof(LWLock) <= 16 ? 16 : 32)
+#define LWLOCK_PADDED_SIZE	PG_CACHE_LINE_SIZE
+#define LWLOCK_MINIMAL_SIZE (sizeof(LWLock) <= 32 ? 32 : 64)
 
 typedef union LWLockPadded
 {
@@ -68,28 +113,55 @@ typedef union LWLockPadded
 	char		pad[LWLOCK_PADDED_SIZE];
 } LWLockPadded;
 
+typedef union LWLockMinimallyPadded
+{
+	LWLock		lock;
+	char		pad[LWLOCK_MINIMAL_SIZE];
+} LWLockMinimallyPadded;
+
 /*
- * This points to the array of LWLocks in shared memory.  Backends inherit
- * the pointer by fork from the postmaster (except in the EXEC_BACKEND case,
- * where we have special measures to pass it down).
+ * This points to the array of fixed LWLocks in shared memory; the dynamic
+ * ones follow it.  Backends inherit the pointer by fork from the postmaster
+ * (except in the EXEC_BACKEND case, where we have special measures to pass
+ * it down).
  */
 NON_EXEC_STATIC LWLockPadded *LWLockArray = NULL;
 
+#define DynamicLWLockArray \
+	((LWLockMinimallyPadded *) (LWLockArray + NumFixedLWLocks))
+
+/* Find the LWLock struct for an LWLockId */
+#define GetLWLock(lockid) \
+	((lockid) < NumFixedLWLocks ? \
+	 &LWLockArray[lockid].lock : \
+	 &DynamicLWLockArray[(lockid) - NumFixedLWLocks].lock)
+
 
 /*
  * We use this structure to keep track of locked LWLocks for release
  * during error recovery.  The maximum size could be determined at runtime
  * if necessary, but it seems unlikely that more than a few locks could
- * ever be held simultaneously.
+ * ever be held simultaneously.  The exception is code that locks all the
+ * buffer mapping partitions at once (e.g., contrib/pg_buffercache), so this
+ * must comfortably exceed NUM_BUFFER_PARTITIONS.
  */
-#define MAX_SIMUL_LWLOCKS	100
+#define MAX_SIMUL_LWLOCKS	200
+
+typedef struct LWLockHandle
+{
+	LWLockId	lockid;
+	LWLockMode	mode;			/* needed to release the lock */
+} LWLockHandle;
 
 static int	num_held_lwlocks = 0;
-static LWLockId held_lwlocks[MAX_SIMUL_LWLOCKS];
+static LWLockHandle held_lwlocks[MAX_SIMUL_LWLOCKS];
 
 static int	lock_addin_request = 0;
 static bool lock_addin_request_allowed = true;
 
+static bool LWLockAcquireCommon(LWLockId lockid, LWLockMode mode,
+					uint64 *valptr, uint64 val);
+
 #ifdef LWLOCK_STATS
 static int	counts_for_pid = 0;
 static int *sh_acquire_counts;
@@ -102,13 +174,20 @@ static int *spin_delay_counts;
 bool		Trace_lwlocks = false;
 
 inline static void
-PRINT_LWDEBUG(const char *where, LWLockId lockid, const volatile LWLock *lock)
+PRINT_LWDEBUG(const char *where, LWLockId lockid, volatile LWLock *lock)
 {
 	if (Trace_lwlocks)
-		elog(LOG, "%s(%d): excl %d shared %d head %p rOK %d",
+	{
+		uint32		state = pg_atomic_read_u32(&lock->state);
+
+		elog(LOG, "%s(%d): excl %u shared %u head %p waiters %u rOK %u",
 			 where, (int) lockid,
-			 (int) lock->exclusive, lock->shared, lock->head,
-			 (int) lock->releaseOK);
+			 (state & LW_VAL_EXCLUSIVE) != 0,
+			 state & LW_SHARED_MASK,
+			 lock->head,
+			 (state & LW_FLAG_HAS_WAITERS) != 0,
+			 (state & LW_FLAG_RELEASE_OK) != 0);
+	}
 }
 
 inline static void
@@ -192,13 +271,18 @@ NumLWLocks(void)
 	numLocks += CLOGShmemBuffers();
 
 	/* subtrans.c needs one per SubTrans buffer */
-	numLocks += NUM_SUBTRANS_BUFFERS;
+	numLocks += subtrans_buffers;
+
+#ifdef USE_CSN_SNAPSHOTS
+	/* csnlog.c needs one per CSNLog buffer */
+	numLocks += csnlog_buffers;
+#endif
 
 	/* multixact.c needs two SLRU areas */
-	numLocks += NUM_MXACTOFFSET_BUFFERS + NUM_MXACTMEMBER_BUFFERS;
+	numLocks += multixact_offset_buffers + multixact_member_buffers;
 
 	/* async.c needs one per Async buffer */
-	numLocks += NUM_ASYNC_BUFFERS;
+	numLocks += notify_buffers;
 
 	/* predicate.c needs one per old serializable xid buffer */
 	numLocks += NUM_OLDSERXID_BUFFERS;
@@ -244,11 +328,13 @@ LWLockShmemSize(void)
 	Size		size;
 	int			numLocks = NumLWLocks();
 
-	/* Space for the LWLock array. */
-	size = mul_size(numLocks, sizeof(LWLockPadded));
+	/* Space for the two LWLock arrays. */
+	size = mul_size(NumFixedLWLocks, sizeof(LWLockPadded));
+	size = add_size(size, mul_size(numLocks - NumFixedLWLocks,
+								   sizeof(LWLockMinimallyPadded)));
 
 	/* Space for dynamic allocation counter, plus room for alignment. */
-	size = add_size(size, 2 * sizeof(int) + LWLOCK_PADDED_SIZE);
+	size = add_size(size, 2 * sizeof(int) + PG_CACHE_LINE_SIZE);
 
 	return size;
 }
@@ -262,7 +348,7 @@ CreateLWLocks(void)
 {
 	int			numLocks = NumLWLocks();
 	Size		spaceLocks = LWLockShmemSize();
-	LWLockPadded *lock;
+	LWLock	   *lock;
 	int		   *LWLockCounter;
 	char	   *ptr;
 	int			id;
@@ -274,21 +360,34 @@ CreateLWLocks(void)
 	ptr += 2 * sizeof(int);
 
 	/* Ensure desired alignment of LWLock array */
-	ptr += LWLOCK_PADDED_SIZE - ((uintptr_t) ptr) % LWLOCK_PADDED_SIZE;
+	ptr += PG_CACHE_LINE_SIZE - ((uintptr_t) ptr) % PG_CACHE_LINE_SIZE;
 
 	LWLockArray = (LWLockPadded *) ptr;
 
 	/*
 	 * Initialize all LWLocks to "unlocked" state
 	 */
-	for (id = 0, lock = LWLockArray; id < numLocks; id++, lock++)
+	for (id = 0; id < numLocks; id++)
 	{
-		SpinLockInit(&lock->lock.mutex);
-		lock->lock.releaseOK = true;
-		lock->lock.exclusive = 0;
-		lock->lock.shared = 0;
-		lock->lock.head = NULL;
-		lock->lock.tail = NULL;
+		lock = GetLWLock(id);
+		SpinLockInit(&lock->mutex);
+		if (id < FirstBufMappingLock)
+			lock->tranche = LWTRANCHE_MAIN;
+		else if (id < FirstLockMgrLock)
+			lock->tranche = LWTRANCHE_BUFFER_MAPPING;
+		else if (id < FirstPredicateLockMgrLock)
+			lock->tranche = LWTRANCHE_LOCK_MANAGER;
+		else if (id < FirstWALInsertLock)
+			lock->tranche = LWTRANCHE_PREDICATE_LOCK_MANAGER;
+		else if (id < FirstRelSizeCacheLock)
+			lock->tranche = LWTRANCHE_WAL_INSERT;
+		else if (id < NumFixedLWLocks)
+			lock->tranche = LWTRANCHE_RELSIZE_CACHE;
+		else
+			lock->tranche = LWTRANCHE_EXTENSION;
+		pg_atomic_init_u32(&lock->state, LW_FLAG_RELEASE_OK);
+		lock->head = NULL;
+		lock->tail = NULL;
 	}
 
 	/*
@@ -304,13 +403,25 @@ CreateLWLocks(void)
 /*
  * LWLockAssign - assign a dynamically-allocated LWLock number
  *
+ * The lock is reported as belonging to LWTRANCHE_EXTENSION; core code should
+ * use LWLockAssignTranche instead.
+ */
+LWLockId
+LWLockAssign(void)
+{
+	return LWLockAssignTranche(LWTRANCHE_EXTENSION);
+}
+
+/*
+ * LWLockAssignTranche - assign a dynamically-allocated LWLock number
+ *
  * We interlock this using the same spinlock that is used to protect
  * ShmemAlloc().  Interlocking is not really necessary during postmaster
  * startup, but it is needed if any user-defined code tries to allocate
  * LWLocks after startup.
  */
 LWLockId
-LWLockAssign(void)
+LWLockAssignTranche(LWLockTranche tranche)
 {
 	LWLockId	result;
 
@@ -326,10 +437,445 @@ LWLockAssign(void)
 	}
 	result = (LWLockId) (LWLockCounter[0]++);
 	SpinLockRelease(ShmemLock);
+
+	GetLWLock(result)->tranche = tranche;
+
 	return result;
 }
 
 
+/*
+ * Names of the individual LWLocks, for wait event reporting.  This must
+ * match the first part of enum LWLockId.
+ */
+static const char *const IndividualLWLockNames[] = {
+	"BufFreelistLock",
+	"ShmemIndexLock",
+	"OidGenLock",
+	"XidGenLock",
+	"ProcArrayLock",
+	"SInvalReadLock",
+	"SInvalWriteLock",
+	"WALBufMappingLock",
+	"WALWriteLock",
+	"ControlFileLock",
+	"CheckpointLock",
+	"CLogControlLock",
+	"SubtransControlLock",
+	"MultiXactGenLock",
+	"MultiXactOffsetControlLock",
+	"MultiXactMemberControlLock",
+	"RelCacheInitLock",
+	"CheckpointerCommLock",
+	"TwoPhaseStateLock",
+	"TablespaceCreateLock",
+	"BtreeVacuumLock",
+	"AddinShmemInitLock",
+	"AutovacuumLock",
+	"AutovacuumScheduleLock",
+	"SyncScanLock",
+	"RelationMappingLock",
+	"AsyncCtlLock",
+	"AsyncQueueLock",
+	"SerializableXactHashLock",
+	"SerializableFinishedListLock",
+	"SerializablePredicateLockListLock",
+	"OldSerXidLock",
+	"SyncRepLock",
+	"RedoExtendLock",
+#ifdef USE_CSN_SNAPSHOTS
+	"CSNLogControlLock",
+#endif
+};
+
+/*
+ * Names of the tranches; must match enum LWLockTranche.  The locks of
+ * LWTRANCHE_MAIN are reported under their own names instead.
+ */
+static const char *const LWLockTrancheNames[] = {
+	"main",
+	"buffer_mapping",
+	"lock_manager",
+	"predicate_lock_manager",
+	"wal_insert",
+	"relsize_cache",
+	"buffer_content",
+	"buffer_io",
+	"proc",
+	"slru_buffers",
+	"extension"
+};
+
+/*
+ * GetLWLockWaitEvent - wait event to report while sleeping on an LWLock
+ *
+ * The event ID is the lock's own ID for the individual locks, which come
+ * first, and is otherwise derived from the lock's tranche.
+ */
+uint32
+GetLWLockWaitEvent(LWLockId lockid)
+{
+	volatile LWLock *lock = GetLWLock(lockid);
+
+	if (lock->tranche == LWTRANCHE_MAIN)
+		return PG_WAIT_LWLOCK | (uint32) lockid;
+	return PG_WAIT_LWLOCK | (uint32) (FirstBufMappingLock + lock->tranche);
+}
+
+/*
+ * GetLWLockIdentifier - name of an LWLock wait event ID
+ */
+const char *
+GetLWLockIdentifier(uint16 eventId)
+{
+	StaticAssertStmt(lengthof(IndividualLWLockNames) == FirstBufMappingLock,
+					 "IndividualLWLockNames must match enum LWLockId");
+	StaticAssertStmt(lengthof(LWLockTrancheNames) == LWTRANCHE_NUM,
+					 "LWLockTrancheNames must match enum LWLockTranche");
+
+	if (eventId < FirstBufMappingLock)
+		return IndividualLWLockNames[eventId];
+	eventId -= FirstBufMappingLock;
+	if (eventId > LWTRANCHE_MAIN && eventId < LWTRANCHE_NUM)
+		return LWLockTrancheNames[eventId];
+	return "unknown";
+}
+
+
+/*
+ * Internal function that tries to atomically acquire the lwlock in the passed
+ * in mode.
+ *
+ * This function will not block waiting for a lock to become free - that's the
+ * caller's job.
+ *
+ * Returns true if the lock isn't free and we need to wait.
+ */
+static bool
+LWLockAttemptLock(volatile LWLock *lock, LWLockMode mode)
+{
+	uint32		old_state;
+
+	Assert(mode == LW_EXCLUSIVE || mode == LW_SHARED);
+
+	/*
+	 * Read once outside the loop, later iterations will get the newer value
+	 * via compare & exchange.
+	 */
+	old_state = pg_atomic_read_u32(&lock->state);
+
+	/* loop until we've determined whether we could acquire the lock or not */
+	for (;;)
+	{
+		uint32		desired_state;
+		bool		lock_free;
+
+		desired_state = old_state;
+
+		if (mode == LW_EXCLUSIVE)
+		{
+			lock_free = (old_state & LW_LOCK_MASK) == 0;
+			if (lock_free)
+				desired_state += LW_VAL_EXCLUSIVE;
+		}
+		else
+		{
+			lock_free = (old_state & LW_VAL_EXCLUSIVE) == 0;
+			if (lock_free)
+				desired_state += LW_VAL_SHARED;
+		}
+
+		/*
+		 * Attempt to swap in the state we are expecting.  If we didn't see
+		 * the lock as free, that's just the old value.  If we saw it as free,
+		 * we'll attempt to mark it acquired.  The reason that we always swap
+		 * in the value is that this doubles as a memory barrier.  We could
+		 * try to be smarter and only swap in values if we saw the lock as
+		 * free, but benchmarks haven't shown it as beneficial so far.
+		 *
+		 * Retry if the value changed since we last looked at it.
+		 */
+		if (pg_atomic_compare_exchange_u32(&lock->state,
+										   &old_state, desired_state))
+			return !lock_free;
+	}
+}
+
+/*
+ * Add ourselves to the end of the queue.
+ *
+ * NB: Mode can be LW_WAIT_UNTIL_FREE here!  Such waiters are added at the
+ * front of the queue instead, so that LWLockUpdateVar can find them without
+ * walking past the lock's other waiters.
+ */
+static void
+LWLockQueueSelf(volatile LWLock *lock, LWLockId lockid, LWLockMode mode)
+{
+	PGPROC	   *proc = MyProc;
+
+	/*
+	 * If we don't have a PGPROC structure, there's no way to wait. This
+	 * should never occur, since MyProc should only be null during shared
+	 * memory initialization.
+	 */
+	if (proc == NULL)
+		elog(PANIC, "cannot wait without a PGPROC structure");
+
+	if (proc->lwWaiting)
+		elog(PANIC, "queueing for lock while waiting on another one");
+
+	/* Acquire mutex.  Time spent holding mutex should be short! */
+#ifdef LWLOCK_STATS
+	spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+	SpinLockAcquire(&lock->mutex);
+#endif
+
+	/* setting the flag is protected by the mutex */
+	pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_HAS_WAITERS);
+
+	proc->lwWaiting = true;
+	proc->lwWaitMode = mode;
+
+	if (mode == LW_WAIT_UNTIL_FREE)
+	{
+		proc->lwWaitLink = lock->head;
+		if (lock->head == NULL)
+			lock->tail = proc;
+		lock->head = proc;
+	}
+	else
+	{
+		proc->lwWaitLink = NULL;
+		if (lock->head == NULL)
+			lock->head = proc;
+		else
+			lock->tail->lwWaitLink = proc;
+		lock->tail = proc;
+	}
+
+	/* Can release the mutex now */
+	SpinLockRelease(&lock->mutex);
+}
+
+/*
+ * Remove ourselves from the waitlist.
+ *
+ * This is used if we queued ourselves because we thought we needed to sleep
+ * but, after further checking, we discovered that we don't actually need to
+ * do so.  Somebody else might have already woken us up, though; in that case
+ * we have to absorb their wakeup.
+ */
+static void
+LWLockDequeueSelf(volatile LWLock *lock, LWLockId lockid)
+{
+	PGPROC	   *proc = MyProc;
+	PGPROC	   *prev = NULL;
+	PGPROC	   *cur;
+	bool		found = false;
+
+#ifdef LWLOCK_STATS
+	spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+	SpinLockAcquire(&lock->mutex);
+#endif
+
+	/*
+	 * Can't just remove ourselves from the list, we need to iterate over all
+	 * entries as somebody else could have unqueued us.
+	 */
+	for (cur = lock->head; cur != NULL; prev = cur, cur = cur->lwWaitLink)
+	{
+		if (cur == proc)
+		{
+			found = true;
+			if (prev == NULL)
+				lock->head = cur->lwWaitLink;
+			else
+				prev->lwWaitLink = cur->lwWaitLink;
+			if (lock->tail == cur)
+				lock->tail = prev;
+			break;
+		}
+	}
+
+	if (lock->head == NULL)
+		pg_atomic_fetch_and_u32(&lock->state, ~LW_FLAG_HAS_WAITERS);
+
+	SpinLockRelease(&lock->mutex);
+
+	if (found)
+	{
+		/* clear waiting state again, nice for debugging */
+		proc->lwWaiting = false;
+		proc->lwWaitLink = NULL;
+	}
+	else
+	{
+		int			extraWaits = 0;
+
+		/*
+		 * Somebody else dequeued us and has or will wake us up.  Deal with
+		 * the superfluous absorption of a wakeup.
+		 */
+
+		/*
+		 * Reset releaseOk if somebody woke us before we removed ourselves -
+		 * they'll have set it to false.
+		 */
+		pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_RELEASE_OK);
+
+		/*
+		 * Now wait for the scheduled wakeup, otherwise our ->lwWaiting would
+		 * get reset at some inconvenient point later.  Most of the time this
+		 * will immediately return.
+		 */
+		pgstat_report_wait_start(GetLWLockWaitEvent(lockid));
+		for (;;)
+		{
+			/* "false" means cannot accept cancel/die interrupt here. */
+			PGSemaphoreLock(&proc->sem, false);
+			if (!proc->lwWaiting)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		/*
+		 * Fix the process wait semaphore's count for any absorbed wakeups.
+		 */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(&proc->sem);
+	}
+}
+
+/*
+ * Wake up all the lockers that currently have a chance to acquire the lock,
+ * and all LW_WAIT_UNTIL_FREE waiters.
+ */
+static void
+LWLockWakeup(volatile LWLock *lock, LWLockId lockid)
+{
+	bool		new_release_ok = true;
+	bool		wokeup_somebody = false;
+	PGPROC	   *wakeup = NULL;
+	PGPROC	   *wakeup_tail = NULL;
+	PGPROC	   *prev = NULL;
+	PGPROC	   *proc;
+	PGPROC	   *next;
+	uint32		old_state;
+
+	/* Acquire mutex.  Time spent holding mutex should be short! */
+#ifdef LWLOCK_STATS
+	spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+	SpinLockAcquire(&lock->mutex);
+#endif
+
+	/*
+	 * Move the PGPROCs to wake up onto a private list.  If the first waiter
+	 * that wants the lock wants it exclusively, it is the only one; otherwise
+	 * all the shared waiters get woken, and the exclusive ones stay queued.
+	 */
+	for (proc = lock->head; proc != NULL; proc = next)
+	{
+		next = proc->lwWaitLink;
+
+		if (wokeup_somebody && proc->lwWaitMode == LW_EXCLUSIVE)
+		{
+			prev = proc;
+			continue;
+		}
+
+		if (prev == NULL)
+			lock->head = next;
+		else
+			prev->lwWaitLink = next;
+		if (lock->tail == proc)
+			lock->tail = prev;
+
+		proc->lwWaitLink = NULL;
+		if (wakeup == NULL)
+			wakeup = proc;
+		else
+			wakeup_tail->lwWaitLink = proc;
+		wakeup_tail = proc;
+
+		if (proc->lwWaitMode != LW_WAIT_UNTIL_FREE)
+		{
+			/*
+			 * Prevent additional wakeups until retryer gets to run. Backends
+			 * that are just waiting for the lock to become free don't retry
+			 * automatically.
+			 */
+			new_release_ok = false;
+
+			/*
+			 * Don't wakeup (further) exclusive locks.
+			 */
+			wokeup_somebody = true;
+		}
+
+		/*
+		 * Once we've woken up an exclusive lock, there's no point in waking
+		 * up anybody else.
+		 */
+		if (proc->lwWaitMode == LW_EXCLUSIVE)
+			break;
+	}
+
+	Assert(wakeup == NULL ||
+		   (pg_atomic_read_u32(&lock->state) & LW_FLAG_HAS_WAITERS) != 0);
+
+	/* unset required flags, and release the mutex in one fell swoop */
+	old_state = pg_atomic_read_u32(&lock->state);
+	for (;;)
+	{
+		uint32		desired_state = old_state;
+
+		/* compute desired flags */
+		if (new_release_ok)
+			desired_state |= LW_FLAG_RELEASE_OK;
+		else
+			desired_state &= ~LW_FLAG_RELEASE_OK;
+
+		if (lock->head == NULL)
+			desired_state &= ~LW_FLAG_HAS_WAITERS;
+
+		if (pg_atomic_compare_exchange_u32(&lock->state, &old_state,
+										   desired_state))
+			break;
+	}
+
+	/* We are done updating shared state of the lock queue. */
+	SpinLockRelease(&lock->mutex);
+
+	/*
+	 * Awaken any waiters I removed from the queue.
+	 */
+	while (wakeup != NULL)
+	{
+		LOG_LWDEBUG("LWLockRelease", lockid, "release waiter");
+		proc = wakeup;
+		wakeup = proc->lwWaitLink;
+		proc->lwWaitLink = NULL;
+
+		/*
+		 * Guarantee that lwWaiting being unset only becomes visible once the
+		 * unlink from the list has completed.  Otherwise the target backend
+		 * could be woken up for some other reason and enqueue for a new lock
+		 * - if that happens before the list unlink happens, the list would
+		 * end up being corrupted.
+		 *
+		 * The barrier pairs with the SpinLockAcquire() when enqueing for
+		 * another lock.
+		 */
+		pg_write_barrier();
+		proc->lwWaiting = false;
+		PGSemaphoreUnlock(&proc->sem);
+	}
+}
+
 /*
  * LWLockAcquire - acquire a lightweight lock in the specified mode
  *
@@ -340,9 +886,33 @@ LWLockAssign(void)
 void
 LWLockAcquire(LWLockId lockid, LWLockMode mode)
 {
-	volatile LWLock *lock = &(LWLockArray[lockid].lock);
+	LWLockAcquireCommon(lockid, mode, NULL, 0);
+}
+
+/*
+ * LWLockAcquireWithVar - like LWLockAcquire, but also sets *valptr = val
+ *
+ * The lock is always acquired in exclusive mode with this function.  The
+ * variable is set while holding the lock's spinlock, so that it appears
+ * atomically to LWLockWaitForVar.
+ *
+ * Returns true if the lock was available immediately, false if we had to
+ * wait for it.
+ */
+bool
+LWLockAcquireWithVar(LWLockId lockid, uint64 *valptr, uint64 val)
+{
+	return LWLockAcquireCommon(lockid, LW_EXCLUSIVE, valptr, val);
+}
+
+/* internal function to implement LWLockAcquire and LWLockAcquireWithVar */
+static bool
+LWLockAcquireCommon(LWLockId lockid, LWLockMode mode, uint64 *valptr,
+					uint64 val)
+{
+	volatile LWLock *lock = GetLWLock(lockid);
 	PGPROC	   *proc = MyProc;
-	bool		retry = false;
+	bool		result = true;
 	int			extraWaits = 0;
 
 	PRINT_LWDEBUG("LWLockAcquire", lockid, lock);
@@ -396,63 +966,43 @@ LWLockAcquire(LWLockId lockid, LWLockMode mode)
 	{
 		bool		mustwait;
 
-		/* Acquire mutex.  Time spent holding mutex should be short! */
-#ifdef LWLOCK_STATS
-		spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
-#else
-		SpinLockAcquire(&lock->mutex);
-#endif
-
-		/* If retrying, allow LWLockRelease to release waiters again */
-		if (retry)
-			lock->releaseOK = true;
+		/*
+		 * Try to grab the lock the first time, we're not in the waitqueue
+		 * yet/anymore.
+		 */
+		mustwait = LWLockAttemptLock(lock, mode);
 
-		/* If I can get the lock, do so quickly. */
-		if (mode == LW_EXCLUSIVE)
+		if (!mustwait)
 		{
-			if (lock->exclusive == 0 && lock->shared == 0)
-			{
-				lock->exclusive++;
-				mustwait = false;
-			}
-			else
-				mustwait = true;
-		}
-		else
-		{
-			if (lock->exclusive == 0)
-			{
-				lock->shared++;
-				mustwait = false;
-			}
-			else
-				mustwait = true;
-		}
-
-		if (!mustwait)
+			LOG_LWDEBUG("LWLockAcquire", lockid, "immediately acquired lock");
 			break;				/* got the lock */
+		}
 
 		/*
-		 * Add myself to wait queue.
-		 *
-		 * If we don't have a PGPROC structure, there's no way to wait. This
-		 * should never occur, since MyProc should only be null during shared
-		 * memory initialization.
+		 * Ok, at this point we couldn't grab the lock on the first try.  We
+		 * cannot simply queue ourselves to the end of the list and wait to be
+		 * woken up because by now the lock could long have been released.
+		 * Instead add us to the queue and try to grab the lock again.  If we
+		 * succeed we need to revert the queuing and be happy, otherwise we
+		 * recheck the lock.  If we still couldn't grab it, we know that the
+		 * other locker will see our queue entries when releasing since they
+		 * existed before we checked for the lock.
 		 */
-		if (proc == NULL)
-			elog(PANIC, "cannot wait without a PGPROC structure");
 
-		proc->lwWaiting = true;
-		proc->lwWaitMode = mode;
-		proc->lwWaitLink = NULL;
-		if (lock->head == NULL)
-			lock->head = proc;
-		else
-			lock->tail->lwWaitLink = proc;
-		lock->tail = proc;
+		/* add to the queue */
+		LWLockQueueSelf(lock, lockid, mode);
 
-		/* Can release the mutex now */
-		SpinLockRelease(&lock->mutex);
+		/* we're now guaranteed to be woken up if necessary */
+		mustwait = LWLockAttemptLock(lock, mode);
+
+		/* ok, grabbed the lock the second time round, need to undo queueing */
+		if (!mustwait)
+		{
+			LOG_LWDEBUG("LWLockAcquire", lockid, "acquired, undoing queue");
+
+			LWLockDequeueSelf(lock, lockid);
+			break;
+		}
 
 		/*
 		 * Wait until awakened.
@@ -474,6 +1024,7 @@ LWLockAcquire(LWLockId lockid, LWLockMode mode)
 
 		TRACE_POSTGRESQL_LWLOCK_WAIT_START(lockid, mode);
 
+		pgstat_report_wait_start(GetLWLockWaitEvent(lockid));
 		for (;;)
 		{
 			/* "false" means cannot accept cancel/die interrupt here. */
@@ -482,28 +1033,44 @@ LWLockAcquire(LWLockId lockid, LWLockMode mode)
 				break;
 			extraWaits++;
 		}
+		pgstat_report_wait_end();
+
+		/* Retrying, allow LWLockRelease to release waiters again. */
+		pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_RELEASE_OK);
 
 		TRACE_POSTGRESQL_LWLOCK_WAIT_DONE(lockid, mode);
 
 		LOG_LWDEBUG("LWLockAcquire", lockid, "awakened");
 
 		/* Now loop back and try to acquire lock again. */
-		retry = true;
+		result = false;
 	}
 
-	/* We are done updating shared state of the lock itself. */
-	SpinLockRelease(&lock->mutex);
+	/* If there's a variable associated with this lock, initialize it */
+	if (valptr)
+	{
+#ifdef LWLOCK_STATS
+		spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+		SpinLockAcquire(&lock->mutex);
+#endif
+		*((volatile uint64 *) valptr) = val;
+		SpinLockRelease(&lock->mutex);
+	}
 
 	TRACE_POSTGRESQL_LWLOCK_ACQUIRE(lockid, mode);
 
 	/* Add lock to list of locks held by this backend */
-	held_lwlocks[num_held_lwlocks++] = lockid;
+	held_lwlocks[num_held_lwlocks].lockid = lockid;
+	held_lwlocks[num_held_lwlocks++].mode = mode;
 
 	/*
 	 * Fix the process wait semaphore's count for any absorbed wakeups.
 	 */
 	while (extraWaits-- > 0)
 		PGSemaphoreUnlock(&proc->sem);
+
+	return result;
 }
 
 /*
@@ -516,7 +1083,7 @@ LWLockAcquire(LWLockId lockid, LWLockMode mode)
 bool
 LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode)
 {
-	volatile LWLock *lock = &(LWLockArray[lockid].lock);
+	volatile LWLock *lock = GetLWLock(lockid);
 	bool		mustwait;
 
 	PRINT_LWDEBUG("LWLockConditionalAcquire", lockid, lock);
@@ -532,33 +1099,8 @@ LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode)
 	 */
 	HOLD_INTERRUPTS();
 
-	/* Acquire mutex.  Time spent holding mutex should be short! */
-	SpinLockAcquire(&lock->mutex);
-
-	/* If I can get the lock, do so quickly. */
-	if (mode == LW_EXCLUSIVE)
-	{
-		if (lock->exclusive == 0 && lock->shared == 0)
-		{
-			lock->exclusive++;
-			mustwait = false;
-		}
-		else
-			mustwait = true;
-	}
-	else
-	{
-		if (lock->exclusive == 0)
-		{
-			lock->shared++;
-			mustwait = false;
-		}
-		else
-			mustwait = true;
-	}
-
-	/* We are done updating shared state of the lock itself. */
-	SpinLockRelease(&lock->mutex);
+	/* Check for the lock */
+	mustwait = LWLockAttemptLock(lock, mode);
 
 	if (mustwait)
 	{
@@ -570,7 +1112,8 @@ LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode)
 	else
 	{
 		/* Add lock to list of locks held by this backend */
-		held_lwlocks[num_held_lwlocks++] = lockid;
+		held_lwlocks[num_held_lwlocks].lockid = lockid;
+		held_lwlocks[num_held_lwlocks++].mode = mode;
 		TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE(lockid, mode);
 	}
 
@@ -594,7 +1137,7 @@ LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode)
 bool
 LWLockAcquireOrWait(LWLockId lockid, LWLockMode mode)
 {
-	volatile LWLock *lock = &(LWLockArray[lockid].lock);
+	volatile LWLock *lock = GetLWLock(lockid);
 	PGPROC	   *proc = MyProc;
 	bool		mustwait;
 	int			extraWaits = 0;
@@ -618,67 +1161,232 @@ LWLockAcquireOrWait(LWLockId lockid, LWLockMode mode)
 	 */
 	HOLD_INTERRUPTS();
 
-	/* Acquire mutex.  Time spent holding mutex should be short! */
-	SpinLockAcquire(&lock->mutex);
+	/*
+	 * NB: We're using nearly the same twice-in-a-row lock acquisition
+	 * protocol as LWLockAcquire().  Check its comments for details.
+	 */
+	mustwait = LWLockAttemptLock(lock, mode);
 
-	/* If I can get the lock, do so quickly. */
-	if (mode == LW_EXCLUSIVE)
+	if (mustwait)
 	{
-		if (lock->exclusive == 0 && lock->shared == 0)
+		LWLockQueueSelf(lock, lockid, LW_WAIT_UNTIL_FREE);
+
+		mustwait = LWLockAttemptLock(lock, mode);
+
+		if (mustwait)
 		{
-			lock->exclusive++;
-			mustwait = false;
+			/*
+			 * Wait until awakened.  Like in LWLockAcquire, be prepared for
+			 * bogus wakeups, because we share the semaphore with
+			 * ProcWaitForSignal.
+			 */
+			LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "waiting");
+
+#ifdef LWLOCK_STATS
+			block_counts[lockid]++;
+#endif
+
+			TRACE_POSTGRESQL_LWLOCK_WAIT_START(lockid, mode);
+
+			pgstat_report_wait_start(GetLWLockWaitEvent(lockid));
+			for (;;)
+			{
+				/* "false" means cannot accept cancel/die interrupt here. */
+				PGSemaphoreLock(&proc->sem, false);
+				if (!proc->lwWaiting)
+					break;
+				extraWaits++;
+			}
+			pgstat_report_wait_end();
+
+			TRACE_POSTGRESQL_LWLOCK_WAIT_DONE(lockid, mode);
+
+			LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "awakened");
 		}
 		else
-			mustwait = true;
-	}
-	else
-	{
-		if (lock->exclusive == 0)
 		{
-			lock->shared++;
-			mustwait = false;
+			LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "acquired, undoing queue");
+
+			/*
+			 * Got lock in the second attempt, undo queueing.  We need to
+			 * treat this as having successfully acquired the lock, otherwise
+			 * we'd not necessarily wake up people we've prevented from
+			 * acquiring the lock.
+			 */
+			LWLockDequeueSelf(lock, lockid);
 		}
-		else
-			mustwait = true;
 	}
 
+	/*
+	 * Fix the process wait semaphore's count for any absorbed wakeups.
+	 */
+	while (extraWaits-- > 0)
+		PGSemaphoreUnlock(&proc->sem);
+
 	if (mustwait)
 	{
+		/* Failed to get lock, so release interrupt holdoff */
+		RESUME_INTERRUPTS();
+		LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "failed");
+		TRACE_POSTGRESQL_LWLOCK_WAIT_UNTIL_FREE_FAIL(lockid, mode);
+	}
+	else
+	{
+		/* Add lock to list of locks held by this backend */
+		held_lwlocks[num_held_lwlocks].lockid = lockid;
+		held_lwlocks[num_held_lwlocks++].mode = mode;
+		TRACE_POSTGRESQL_LWLOCK_WAIT_UNTIL_FREE(lockid, mode);
+	}
+
+	return !mustwait;
+}
+
+/*
+ * Does the lwlock in its current state need to wait for the variable value to
+ * change?
+ *
+ * If we don't need to wait, and it's because the value of the variable has
+ * changed, store the current value in newval.
+ *
+ * *result is set to true if the lock was free, and false otherwise.
+ */
+static bool
+LWLockConflictsWithVar(volatile LWLock *lock, LWLockId lockid,
+					   uint64 *valptr, uint64 oldval, uint64 *newval,
+					   bool *result)
+{
+	bool		mustwait;
+	uint64		value;
+
+	/*
+	 * Test first to see if it the slot is free right now.
+	 *
+	 * XXX: the caller uses a spinlock before this, so we don't need a memory
+	 * barrier here as far as the current usage is concerned.  But that might
+	 * not be safe in general.
+	 */
+	mustwait = (pg_atomic_read_u32(&lock->state) & LW_VAL_EXCLUSIVE) != 0;
+
+	if (!mustwait)
+	{
+		*result = true;
+		return false;
+	}
+
+	*result = false;
+
+	/*
+	 * Read value using the lwlock's mutex, as we can't generally rely on
+	 * atomic 64 bit reads/stores.
+	 */
+#ifdef LWLOCK_STATS
+	spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+	SpinLockAcquire(&lock->mutex);
+#endif
+	value = *((volatile uint64 *) valptr);
+	SpinLockRelease(&lock->mutex);
+
+	if (value != oldval)
+	{
+		mustwait = false;
+		*newval = value;
+	}
+	else
+		mustwait = true;
+
+	return mustwait;
+}
+
+/*
+ * LWLockWaitForVar - Wait until lock is free, or a variable is updated.
+ *
+ * If the lock is held and *valptr equals oldval, waits until the lock is
+ * either freed, or the lock holder updates *valptr by calling
+ * LWLockUpdateVar.  If the lock is free on exit (immediately or after
+ * waiting), returns true.  If the lock is still held, but *valptr no longer
+ * matches oldval, returns false and sets *newval to the current value in
+ * *valptr.
+ *
+ * Note: this function ignores shared lock holders; if the lock is held
+ * in shared mode, returns 'true'.
+ */
+bool
+LWLockWaitForVar(LWLockId lockid, uint64 *valptr, uint64 oldval,
+				 uint64 *newval)
+{
+	volatile LWLock *lock = GetLWLock(lockid);
+	PGPROC	   *proc = MyProc;
+	int			extraWaits = 0;
+	bool		result = false;
+
+	PRINT_LWDEBUG("LWLockWaitForVar", lockid, lock);
+
+	/*
+	 * Lock out cancel/die interrupts while we sleep on the lock.  There is
+	 * no cleanup mechanism to remove us from the wait queue if we got
+	 * interrupted.
+	 */
+	HOLD_INTERRUPTS();
+
+	/*
+	 * Loop here to check the lock's status after each time we are signaled.
+	 */
+	for (;;)
+	{
+		bool		mustwait;
+
+		mustwait = LWLockConflictsWithVar(lock, lockid, valptr, oldval, newval,
+										  &result);
+
+		if (!mustwait)
+			break;				/* the lock was free or value didn't match */
+
 		/*
-		 * Add myself to wait queue.
-		 *
-		 * If we don't have a PGPROC structure, there's no way to wait.  This
-		 * should never occur, since MyProc should only be null during shared
-		 * memory initialization.
+		 * Add myself to wait queue.  Note that this is racy, somebody else
+		 * could wakeup before we're finished queuing.  NB: We're using nearly
+		 * the same twice-in-a-row lock acquisition protocol as
+		 * LWLockAcquire().  Check its comments for details.  The only
+		 * difference is that we also have to check the variable's values
+		 * when checking the state of the lock.
 		 */
-		if (proc == NULL)
-			elog(PANIC, "cannot wait without a PGPROC structure");
+		LWLockQueueSelf(lock, lockid, LW_WAIT_UNTIL_FREE);
 
-		proc->lwWaiting = true;
-		proc->lwWaitMode = LW_WAIT_UNTIL_FREE;
-		proc->lwWaitLink = NULL;
-		if (lock->head == NULL)
-			lock->head = proc;
-		else
-			lock->tail->lwWaitLink = proc;
-		lock->tail = proc;
+		/*
+		 * Set RELEASE_OK flag, to make sure we get woken up as soon as the
+		 * lock is released.
+		 */
+		pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_RELEASE_OK);
 
-		/* Can release the mutex now */
-		SpinLockRelease(&lock->mutex);
+		/*
+		 * We're now guaranteed to be woken up if necessary.  Recheck the lock
+		 * and variables state.
+		 */
+		mustwait = LWLockConflictsWithVar(lock, lockid, valptr, oldval, newval,
+										  &result);
+
+		/* Ok, no conflict after we queued ourselves.  Undo queueing. */
+		if (!mustwait)
+		{
+			LOG_LWDEBUG("LWLockWaitForVar", lockid, "free, undoing queue");
+
+			LWLockDequeueSelf(lock, lockid);
+			break;
+		}
 
 		/*
 		 * Wait until awakened.  Like in LWLockAcquire, be prepared for bogus
-		 * wakups, because we share the semaphore with ProcWaitForSignal.
+		 * wakeups, because we share the semaphore with ProcWaitForSignal.
 		 */
-		LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "waiting");
+		LOG_LWDEBUG("LWLockWaitForVar", lockid, "waiting");
 
 #ifdef LWLOCK_STATS
 		block_counts[lockid]++;
 #endif
 
-		TRACE_POSTGRESQL_LWLOCK_WAIT_START(lockid, mode);
+		TRACE_POSTGRESQL_LWLOCK_WAIT_START(lockid, LW_EXCLUSIVE);
 
+		pgstat_report_wait_start(GetLWLockWaitEvent(lockid));
 		for (;;)
 		{
 			/* "false" means cannot accept cancel/die interrupt here. */
@@ -687,15 +1395,13 @@ LWLockAcquireOrWait(LWLockId lockid, LWLockMode mode)
 				break;
 			extraWaits++;
 		}
+		pgstat_report_wait_end();
 
-		TRACE_POSTGRESQL_LWLOCK_WAIT_DONE(lockid, mode);
+		TRACE_POSTGRESQL_LWLOCK_WAIT_DONE(lockid, LW_EXCLUSIVE);
 
-		LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "awakened");
-	}
-	else
-	{
-		/* We are done updating shared state of the lock itself. */
-		SpinLockRelease(&lock->mutex);
+		LOG_LWDEBUG("LWLockWaitForVar", lockid, "awakened");
+
+		/* Now loop back and check the status of the lock again. */
 	}
 
 	/*
@@ -704,62 +1410,132 @@ LWLockAcquireOrWait(LWLockId lockid, LWLockMode mode)
 	while (extraWaits-- > 0)
 		PGSemaphoreUnlock(&proc->sem);
 
-	if (mustwait)
+	/*
+	 * Now okay to allow cancel/die interrupts.
+	 */
+	RESUME_INTERRUPTS();
+
+	return result;
+}
+
+
+/*
+ * LWLockUpdateVar - Update a variable and wake up waiters atomically
+ *
+ * Sets *valptr to 'val', and wakes up all processes waiting for us with
+ * LWLockWaitForVar().  Setting the value and waking up the processes happen
+ * atomically so that any process calling LWLockWaitForVar() on the same lock
+ * is guaranteed to see the new value, and act accordingly.
+ *
+ * The caller must be holding the lock in exclusive mode.
+ */
+void
+LWLockUpdateVar(LWLockId lockid, uint64 *valptr, uint64 val)
+{
+	volatile LWLock *lock = GetLWLock(lockid);
+	volatile uint64 *valp = valptr;
+	PGPROC	   *head;
+	PGPROC	   *proc;
+	PGPROC	   *next;
+
+	PRINT_LWDEBUG("LWLockUpdateVar", lockid, lock);
+
+	/* Acquire mutex.  Time spent holding mutex should be short! */
+#ifdef LWLOCK_STATS
+	spin_delay_counts[lockid] += SpinLockAcquire(&lock->mutex);
+#else
+	SpinLockAcquire(&lock->mutex);
+#endif
+
+	/* we should hold the lock */
+	Assert(pg_atomic_read_u32(&lock->state) & LW_VAL_EXCLUSIVE);
+
+	/* Update the lock's value */
+	*valp = val;
+
+	/*
+	 * See if there are any LW_WAIT_UNTIL_FREE waiters that need to be woken
+	 * up.  They are always in the front of the queue.
+	 */
+	head = lock->head;
+
+	if (head != NULL && head->lwWaitMode == LW_WAIT_UNTIL_FREE)
 	{
-		/* Failed to get lock, so release interrupt holdoff */
-		RESUME_INTERRUPTS();
-		LOG_LWDEBUG("LWLockAcquireOrWait", lockid, "failed");
-		TRACE_POSTGRESQL_LWLOCK_WAIT_UNTIL_FREE_FAIL(lockid, mode);
+		proc = head;
+		next = proc->lwWaitLink;
+		while (next && next->lwWaitMode == LW_WAIT_UNTIL_FREE)
+		{
+			proc = next;
+			next = next->lwWaitLink;
+		}
+
+		/* proc is now the last PGPROC to be released */
+		lock->head = next;
+		proc->lwWaitLink = NULL;
 	}
 	else
+		head = NULL;
+
+	/* We are done updating shared state of the lock queue. */
+	SpinLockRelease(&lock->mutex);
+
+	/*
+	 * Awaken any waiters I removed from the queue.
+	 */
+	while (head != NULL)
 	{
-		/* Add lock to list of locks held by this backend */
-		held_lwlocks[num_held_lwlocks++] = lockid;
-		TRACE_POSTGRESQL_LWLOCK_WAIT_UNTIL_FREE(lockid, mode);
+		proc = head;
+		head = proc->lwWaitLink;
+		proc->lwWaitLink = NULL;
+		/* check comment in LWLockWakeup() about this barrier */
+		pg_write_barrier();
+		proc->lwWaiting = false;
+		PGSemaphoreUnlock(&proc->sem);
 	}
-
-	return !mustwait;
 }
 
+
 /*
  * LWLockRelease - release a previously acquired lock
  */
 void
 LWLockRelease(LWLockId lockid)
 {
-	volatile LWLock *lock = &(LWLockArray[lockid].lock);
-	PGPROC	   *head;
-	PGPROC	   *proc;
+	volatile LWLock *lock = GetLWLock(lockid);
+	LWLockMode	mode;
+	uint32		newstate;
+	bool		check_waiters;
 	int			i;
 
-	PRINT_LWDEBUG("LWLockRelease", lockid, lock);
-
 	/*
 	 * Remove lock from list of locks held.  Usually, but not always, it will
 	 * be the latest-acquired lock; so search array backwards.
 	 */
 	for (i = num_held_lwlocks; --i >= 0;)
 	{
-		if (lockid == held_lwlocks[i])
+		if (lockid == held_lwlocks[i].lockid)
 			break;
 	}
 	if (i < 0)
 		elog(ERROR, "lock %d is not held", (int) lockid);
+	mode = held_lwlocks[i].mode;
 	num_held_lwlocks--;
 	for (; i < num_held_lwlocks; i++)
 		held_lwlocks[i] = held_lwlocks[i + 1];
 
-	/* Acquire mutex.  Time spent holding mutex should be short! */
-	SpinLockAcquire(&lock->mutex);
+	PRINT_LWDEBUG("LWLockRelease", lockid, lock);
 
-	/* Release my hold on lock */
-	if (lock->exclusive > 0)
-		lock->exclusive--;
+	/*
+	 * Release my hold on lock, after that it can immediately be acquired by
+	 * others, even if we still have to wakeup other waiters.
+	 */
+	if (mode == LW_EXCLUSIVE)
+		newstate = pg_atomic_sub_fetch_u32(&lock->state, LW_VAL_EXCLUSIVE);
 	else
-	{
-		Assert(lock->shared > 0);
-		lock->shared--;
-	}
+		newstate = pg_atomic_sub_fetch_u32(&lock->state, LW_VAL_SHARED);
+
+	/* nobody else can have that kind of lock */
+	Assert(!(newstate & LW_VAL_EXCLUSIVE));
 
 	/*
 	 * See if I need to awaken any waiters.  If I released a non-last shared
@@ -767,78 +1543,23 @@ LWLockRelease(LWLockId lockid)
 	 * if someone has already awakened waiters that haven't yet acquired the
 	 * lock.
 	 */
-	head = lock->head;
-	if (head != NULL)
-	{
-		if (lock->exclusive == 0 && lock->shared == 0 && lock->releaseOK)
-		{
-			/*
-			 * Remove the to-be-awakened PGPROCs from the queue.
-			 */
-			bool		releaseOK = true;
-
-			proc = head;
-
-			/*
-			 * First wake up any backends that want to be woken up without
-			 * acquiring the lock.
-			 */
-			while (proc->lwWaitMode == LW_WAIT_UNTIL_FREE && proc->lwWaitLink)
-				proc = proc->lwWaitLink;
-
-			/*
-			 * If the front waiter wants exclusive lock, awaken him only.
-			 * Otherwise awaken as many waiters as want shared access.
-			 */
-			if (proc->lwWaitMode != LW_EXCLUSIVE)
-			{
-				while (proc->lwWaitLink != NULL &&
-					   proc->lwWaitLink->lwWaitMode != LW_EXCLUSIVE)
-				{
-					if (proc->lwWaitMode != LW_WAIT_UNTIL_FREE)
-						releaseOK = false;
-					proc = proc->lwWaitLink;
-				}
-			}
-			/* proc is now the last PGPROC to be released */
-			lock->head = proc->lwWaitLink;
-			proc->lwWaitLink = NULL;
-
-			/*
-			 * Prevent additional wakeups until retryer gets to run. Backends
-			 * that are just waiting for the lock to become free don't retry
-			 * automatically.
-			 */
-			if (proc->lwWaitMode != LW_WAIT_UNTIL_FREE)
-				releaseOK = false;
-
-			lock->releaseOK = releaseOK;
-		}
-		else
-		{
-			/* lock is still held, can't awaken anything */
-			head = NULL;
-		}
-	}
-
-	/* We are done updating shared state of the lock itself. */
-	SpinLockRelease(&lock->mutex);
-
-	TRACE_POSTGRESQL_LWLOCK_RELEASE(lockid);
+	check_waiters =
+		(newstate & (LW_FLAG_HAS_WAITERS | LW_FLAG_RELEASE_OK)) ==
+		(LW_FLAG_HAS_WAITERS | LW_FLAG_RELEASE_OK) &&
+		(newstate & LW_LOCK_MASK) == 0;
 
 	/*
-	 * Awaken any waiters I removed from the queue.
+	 * As waking up waiters requires the spinlock to be acquired, only do so
+	 * if necessary.
 	 */
-	while (head != NULL)
+	if (check_waiters)
 	{
-		LOG_LWDEBUG("LWLockRelease", lockid, "release waiter");
-		proc = head;
-		head = proc->lwWaitLink;
-		proc->lwWaitLink = NULL;
-		proc->lwWaiting = false;
-		PGSemaphoreUnlock(&proc->sem);
+		LOG_LWDEBUG("LWLockRelease", lockid, "releasing waiters");
+		LWLockWakeup(lock, lockid);
 	}
 
+	TRACE_POSTGRESQL_LWLOCK_RELEASE(lockid);
+
 	/*
 	 * Now okay to allow cancel/die interrupts.
 	 */
@@ -862,7 +1583,7 @@ LWLockReleaseAll(void)
 	{
 		HOLD_INTERRUPTS();		/* match the upcoming RESUME_INTERRUPTS */
 
-		LWLockRelease(held_lwlocks[num_held_lwlocks - 1]);
+		LWLockRelease(held_lwlocks[num_held_lwlocks - 1].lockid);
 	}
 }
 
@@ -880,7 +1601,7 @@ LWLockHeldByMe(LWLockId lockid)
 
 	for (i = 0; i < num_held_lwlocks; i++)
 	{
-		if (held_lwlocks[i] == lockid)
+		if (held_lwlocks[i].lockid == lockid)
 			return true;
 	}
 	return false;
@@ -123,6 +123,13 @@
  *
  *	SerializableXactHashLock
  *		- Protects both PredXact and SerializableXidHash.
+ *		- It is not partitioned: any rw-conflict can link any two
+ *			transactions, so the conflict graph has no natural partitions.
+ *			Instead the common paths avoid it.  A conflict-in check first
+ *			looks at the target's locks under the partition lock alone, and
+ *			takes this lock only if another transaction holds one of them.
+ *			A conflict-out check starts with a shared lock, and retakes it
+ *			exclusively only if there is a conflict or flag to record.
  *
  *
  * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
@@ -350,6 +357,10 @@ static SERIALIZABLEXACT *OldCommittedSxact;
 /* This configuration variable is used to set the predicate lock table size */
 int			max_predicate_locks_per_xact;		/* set by guc.c */
 
+/* These configuration variables set the lock promotion thresholds */
+int			max_predicate_locks_per_relation;	/* set by guc.c */
+int			max_predicate_locks_per_page;		/* set by guc.c */
+
 /*
  * This provides a list of objects in order to track transactions
  * participating in predicate locking.	Entries in the list are fixed size,
@@ -432,7 +443,7 @@ static void RestoreScratchTarget(bool lockheld);
 static void RemoveTargetIfNoLongerUsed(PREDICATELOCKTARGET *target,
 						   uint32 targettaghash);
 static void DeleteChildTargetLocks(const PREDICATELOCKTARGETTAG *newtargettag);
-static int	PredicateLockPromotionThreshold(const PREDICATELOCKTARGETTAG *tag);
+static int	MaxPredicateChildLocks(const PREDICATELOCKTARGETTAG *tag);
 static bool CheckAndPromotePredicateLockRequest(const PREDICATELOCKTARGETTAG *reqtag);
 static void DecrementParentLocks(const PREDICATELOCKTARGETTAG *targettag);
 static void CreatePredicateLock(const PREDICATELOCKTARGETTAG *targettag,
@@ -452,6 +463,9 @@ static void ReleaseOneSerializableXact(SERIALIZABLEXACT *sxact, bool partial,
 static bool XidIsConcurrent(TransactionId xid);
 static void CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag);
 static void FlagRWConflict(SERIALIZABLEXACT *reader, SERIALIZABLEXACT *writer);
+static void CountRWConflict(const PREDICATELOCKTARGETTAG *targettag,
+				SERIALIZABLEXACT *reader, SERIALIZABLEXACT *writer);
+static void CountSerializationFailure(void);
 static void OnConflict_CheckForSerializationFailure(const SERIALIZABLEXACT *reader,
 										SERIALIZABLEXACT *writer);
 
@@ -1178,6 +1192,8 @@ InitPredicateLocks(void)
 		PredXact->LastSxactCommitSeqNo = FirstNormalSerCommitSeqNo - 1;
 		PredXact->CanPartialClearThrough = 0;
 		PredXact->HavePartialClearedThrough = 0;
+		SpinLockInit(&PredXact->statsLock);
+		MemSet(&PredXact->stats, 0, sizeof(PredicateLockStats));
 		requestSize = mul_size((Size) max_table_size,
 							   PredXactListElementDataSize);
 		PredXact->element = ShmemAlloc(requestSize);
@@ -2120,28 +2136,32 @@ DeleteChildTargetLocks(const PREDICATELOCKTARGETTAG *newtargettag)
 }
 
 /*
- * Returns the promotion threshold for a given predicate lock
- * target. This is the number of descendant locks required to promote
- * to the specified tag. Note that the threshold includes non-direct
- * descendants, e.g. both tuples and pages for a relation lock.
+ * Returns the promotion limit for a given predicate lock target.  This is the
+ * max number of descendant locks allowed before promoting to the specified
+ * tag. Note that the limit includes non-direct descendants (e.g., both tuples
+ * and pages for a relation lock).
+ *
+ * Both limits are GUCs.  A negative max_pred_locks_per_relation means
+ * max_pred_locks_per_transaction divided by its absolute value, so that the
+ * default follows the size of the lock table.
  *
  * TODO SSI: We should do something more intelligent about what the
- * thresholds are, either making it proportional to the number of
- * tuples in a page & pages in a relation, or at least making it a
- * GUC. Currently the threshold is 3 for a page lock, and
- * max_pred_locks_per_transaction/2 for a relation lock, chosen
- * entirely arbitrarily (and without benchmarking).
+ * thresholds are, such as making them proportional to the number of
+ * tuples in a page & pages in a relation.
  */
 static int
-PredicateLockPromotionThreshold(const PREDICATELOCKTARGETTAG *tag)
+MaxPredicateChildLocks(const PREDICATELOCKTARGETTAG *tag)
 {
 	switch (GET_PREDICATELOCKTARGETTAG_TYPE(*tag))
 	{
 		case PREDLOCKTAG_RELATION:
-			return max_predicate_locks_per_xact / 2;
+			return max_predicate_locks_per_relation < 0
+				? (max_predicate_locks_per_xact
+				   / -max_predicate_locks_per_relation) - 1
+				: max_predicate_locks_per_relation;
 
 		case PREDLOCKTAG_PAGE:
-			return 3;
+			return max_predicate_locks_per_page;
 
 		case PREDLOCKTAG_TUPLE:
 
@@ -2196,8 +2216,7 @@ CheckAndPromotePredicateLockRequest(const PREDICATELOCKTARGETTAG *reqtag)
 		else
 			parentlock->childLocks++;
 
-		if (parentlock->childLocks >=
-			PredicateLockPromotionThreshold(&targettag))
+		if (parentlock->childLocks > MaxPredicateChildLocks(&targettag))
 		{
 			/*
 			 * We should promote to this parent lock. Continue to check its
@@ -2212,6 +2231,16 @@ CheckAndPromotePredicateLockRequest(const PREDICATELOCKTARGETTAG *reqtag)
 
 	if (promote)
 	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile PredXactListData *predxact = PredXact;
+
+		SpinLockAcquire(&predxact->statsLock);
+		if (GET_PREDICATELOCKTARGETTAG_TYPE(promotiontag) == PREDLOCKTAG_PAGE)
+			predxact->stats.pagePromotions++;
+		else
+			predxact->stats.relationPromotions++;
+		SpinLockRelease(&predxact->statsLock);
+
 		/* acquire coarsest ancestor eligible for promotion */
 		PredicateLockAcquire(&promotiontag);
 		return true;
@@ -3871,6 +3900,7 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	SERIALIZABLEXID *sxid;
 	SERIALIZABLEXACT *sxact;
 	HTSV_Result htsvResult;
+	LWLockMode	lockmode;
 
 	if (!SerializationNeededForRead(relation, snapshot))
 		return;
@@ -3878,6 +3908,7 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	/* Check if someone else has already decided that we need to die */
 	if (SxactIsDoomed(MySerializableXact))
 	{
+		CountSerializationFailure();
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -3949,7 +3980,15 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	 * Find sxact or summarized info for the top level xid.
 	 */
 	sxidtag.xid = xid;
-	LWLockAcquire(SerializableXactHashLock, LW_EXCLUSIVE);
+	/*
+	 * Most reads of recently written tuples turn out not to be conflicts, or
+	 * to be conflicts that are already recorded, and deciding that needs only
+	 * a shared lock.  Start with that, and come back with an exclusive lock
+	 * only if there is something to record.
+	 */
+	lockmode = LW_SHARED;
+retry:
+	LWLockAcquire(SerializableXactHashLock, lockmode);
 	sxid = (SERIALIZABLEXID *)
 		hash_search(SerializableXidHash, &sxidtag, HASH_FIND, NULL);
 	if (!sxid)
@@ -3967,21 +4006,36 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 				&& (!SxactIsReadOnly(MySerializableXact)
 					|| conflictCommitSeqNo
 					<= MySerializableXact->SeqNo.lastCommitBeforeSnapshot))
+			{
+				CountSerializationFailure();
 				ereport(ERROR,
 						(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 						 errmsg("could not serialize access due to read/write dependencies among transactions"),
 						 errdetail_internal("Reason code: Canceled on conflict out to old pivot %u.", xid),
 					  errhint("The transaction might succeed if retried.")));
+			}
 
 			if (SxactHasSummaryConflictIn(MySerializableXact)
 				|| !SHMQueueEmpty(&MySerializableXact->inConflicts))
+			{
+				CountSerializationFailure();
 				ereport(ERROR,
 						(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 						 errmsg("could not serialize access due to read/write dependencies among transactions"),
 						 errdetail_internal("Reason code: Canceled on identification as a pivot, with conflict out to old committed transaction %u.", xid),
 					  errhint("The transaction might succeed if retried.")));
+			}
 
-			MySerializableXact->flags |= SXACT_FLAG_SUMMARY_CONFLICT_OUT;
+			if (!SxactHasSummaryConflictOut(MySerializableXact))
+			{
+				if (lockmode == LW_SHARED)
+				{
+					LWLockRelease(SerializableXactHashLock);
+					lockmode = LW_EXCLUSIVE;
+					goto retry;
+				}
+				MySerializableXact->flags |= SXACT_FLAG_SUMMARY_CONFLICT_OUT;
+			}
 		}
 
 		/* It's not serializable or otherwise not important. */
@@ -4007,6 +4061,12 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	{
 		if (!SxactIsPrepared(sxact))
 		{
+			if (lockmode == LW_SHARED)
+			{
+				LWLockRelease(SerializableXactHashLock);
+				lockmode = LW_EXCLUSIVE;
+				goto retry;
+			}
 			sxact->flags |= SXACT_FLAG_DOOMED;
 			LWLockRelease(SerializableXactHashLock);
 			return;
@@ -4014,6 +4074,7 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 		else
 		{
 			LWLockRelease(SerializableXactHashLock);
+			CountSerializationFailure();
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4052,6 +4113,13 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 		return;
 	}
 
+	if (lockmode == LW_SHARED)
+	{
+		LWLockRelease(SerializableXactHashLock);
+		lockmode = LW_EXCLUSIVE;
+		goto retry;
+	}
+
 	/*
 	 * Flag the conflict.  But first, if this conflict creates a dangerous
 	 * structure, ereport an error.
@@ -4073,6 +4141,7 @@ CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag)
 	PREDICATELOCK *predlock;
 	PREDICATELOCK *mypredlock = NULL;
 	PREDICATELOCKTAG mypredlocktag;
+	bool		othersHoldLocks = false;
 
 	Assert(MySerializableXact != InvalidSerializableXact);
 
@@ -4093,6 +4162,29 @@ CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag)
 		return;
 	}
 
+	/*
+	 * Usually the only lock on a target we are writing, if any, is our own.
+	 * The partition lock is enough to find that out, and lets us skip
+	 * SerializableXactHashLock, which every serializable transaction needs,
+	 * when there can't be a conflict.
+	 */
+	predlock = (PREDICATELOCK *)
+		SHMQueueNext(&(target->predicateLocks),
+					 &(target->predicateLocks),
+					 offsetof(PREDICATELOCK, targetLink));
+	while (predlock)
+	{
+		if (predlock->tag.myXact != MySerializableXact)
+		{
+			othersHoldLocks = true;
+			break;
+		}
+		predlock = (PREDICATELOCK *)
+			SHMQueueNext(&(target->predicateLocks),
+						 &(predlock->targetLink),
+						 offsetof(PREDICATELOCK, targetLink));
+	}
+
 	/*
 	 * Each lock for an overlapping transaction represents a conflict: a
 	 * rw-dependency in to this transaction.
@@ -4101,7 +4193,8 @@ CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag)
 		SHMQueueNext(&(target->predicateLocks),
 					 &(target->predicateLocks),
 					 offsetof(PREDICATELOCK, targetLink));
-	LWLockAcquire(SerializableXactHashLock, LW_SHARED);
+	if (othersHoldLocks)
+		LWLockAcquire(SerializableXactHashLock, LW_SHARED);
 	while (predlock)
 	{
 		SHM_QUEUE  *predlocktargetlink;
@@ -4153,6 +4246,7 @@ CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag)
 											 sxact->finishedBefore))
 				&& !RWConflictExists(sxact, MySerializableXact))
 			{
+				CountRWConflict(targettag, sxact, MySerializableXact);
 				FlagRWConflict(sxact, MySerializableXact);
 			}
 
@@ -4162,7 +4256,8 @@ CheckTargetForConflictsIn(PREDICATELOCKTARGETTAG *targettag)
 
 		predlock = nextpredlock;
 	}
-	LWLockRelease(SerializableXactHashLock);
+	if (othersHoldLocks)
+		LWLockRelease(SerializableXactHashLock);
 	LWLockRelease(partitionLock);
 
 	/*
@@ -4253,11 +4348,14 @@ CheckForSerializableConflictIn(Relation relation, HeapTuple tuple,
 
 	/* Check if someone else has already decided that we need to die */
 	if (SxactIsDoomed(MySerializableXact))
+	{
+		CountSerializationFailure();
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
 				 errdetail_internal("Reason code: Canceled on identification as a pivot, during conflict in checking."),
 				 errhint("The transaction might succeed if retried.")));
+	}
 
 	/*
 	 * We're doing a write which might cause rw-conflicts now or later.
@@ -4361,7 +4459,8 @@ CheckTableForSerializableConflictIn(Relation relation)
 	LWLockAcquire(SerializablePredicateLockListLock, LW_EXCLUSIVE);
 	for (i = 0; i < NUM_PREDICATELOCK_PARTITIONS; i++)
 		LWLockAcquire(FirstPredicateLockMgrLock + i, LW_SHARED);
-	LWLockAcquire(SerializableXactHashLock, LW_SHARED);
+	/* flagging conflicts can set other transactions' flags */
+	LWLockAcquire(SerializableXactHashLock, LW_EXCLUSIVE);
 
 	/* Scan through target list */
 	hash_seq_init(&seqstat, PredicateLockTargetHash);
@@ -4397,6 +4496,8 @@ CheckTableForSerializableConflictIn(Relation relation)
 			if (predlock->tag.myXact != MySerializableXact
 			  && !RWConflictExists(predlock->tag.myXact, MySerializableXact))
 			{
+				CountRWConflict(&target->tag, predlock->tag.myXact,
+								MySerializableXact);
 				FlagRWConflict(predlock->tag.myXact, MySerializableXact);
 			}
 
@@ -4412,6 +4513,73 @@ CheckTableForSerializableConflictIn(Relation relation)
 }
 
 
+/*
+ * Count a rw-conflict found through a predicate lock on targettag, which is
+ * about to be flagged.  If the lock was coarser than a tuple lock, mark both
+ * transactions, so that a serialization failure of either one can be counted
+ * as possibly due to lock granularity.
+ *
+ * The caller must hold SerializableXactHashLock exclusively.
+ */
+static void
+CountRWConflict(const PREDICATELOCKTARGETTAG *targettag,
+				SERIALIZABLEXACT *reader, SERIALIZABLEXACT *writer)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile PredXactListData *predxact = PredXact;
+	PredicateLockTargetType type = GET_PREDICATELOCKTARGETTAG_TYPE(*targettag);
+
+	if (type != PREDLOCKTAG_TUPLE)
+	{
+		reader->flags |= SXACT_FLAG_COARSE_CONFLICT;
+		writer->flags |= SXACT_FLAG_COARSE_CONFLICT;
+	}
+
+	SpinLockAcquire(&predxact->statsLock);
+	if (type == PREDLOCKTAG_TUPLE)
+		predxact->stats.tupleConflicts++;
+	else if (type == PREDLOCKTAG_PAGE)
+		predxact->stats.pageConflicts++;
+	else
+		predxact->stats.relationConflicts++;
+	SpinLockRelease(&predxact->statsLock);
+}
+
+/*
+ * Count a serialization failure of our own transaction, which the caller is
+ * about to report.
+ */
+static void
+CountSerializationFailure(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile PredXactListData *predxact = PredXact;
+	bool		coarse;
+
+	coarse = (MySerializableXact->flags & SXACT_FLAG_COARSE_CONFLICT) != 0;
+
+	SpinLockAcquire(&predxact->statsLock);
+	predxact->stats.failures++;
+	if (coarse)
+		predxact->stats.coarseFailures++;
+	SpinLockRelease(&predxact->statsLock);
+}
+
+/*
+ * Return a copy of the cumulative predicate locking statistics.
+ */
+void
+GetPredicateLockStats(PredicateLockStats *stats)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile PredXactListData *predxact = PredXact;
+
+	SpinLockAcquire(&predxact->statsLock);
+	*stats = predxact->stats;
+	SpinLockRelease(&predxact->statsLock);
+}
+
+
 /*
  * Flag a rw-dependency between two serializable transactions.
  *
@@ -4590,6 +4758,7 @@ OnConflict_CheckForSerializationFailure(const SERIALIZABLEXACT *reader,
 		if (MySerializableXact == writer)
 		{
 			LWLockRelease(SerializableXactHashLock);
+			CountSerializationFailure();
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4602,6 +4771,7 @@ OnConflict_CheckForSerializationFailure(const SERIALIZABLEXACT *reader,
 
 			/* if we're not the writer, we have to be the reader */
 			Assert(MySerializableXact == reader);
+			CountSerializationFailure();
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4644,6 +4814,7 @@ PreCommit_CheckForSerializationFailure(void)
 	if (SxactIsDoomed(MySerializableXact))
 	{
 		LWLockRelease(SerializableXactHashLock);
+		CountSerializationFailure();
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4682,6 +4853,7 @@ PreCommit_CheckForSerializationFailure(void)
 					if (SxactIsPrepared(nearConflict->sxactOut))
 					{
 						LWLockRelease(SerializableXactHashLock);
+						CountSerializationFailure();
 						ereport(ERROR,
 								(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 								 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -39,6 +39,7 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "replication/syncrep.h"
 #include "storage/ipc.h"
@@ -86,6 +87,7 @@ static volatile DeadLockState deadlock_state = DS_NOT_YET_CHECKED;
 static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
+static Size FastPathLockShmemSize(void);
 
 
 /*
@@ -111,9 +113,30 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGXACT)));
 	size = add_size(size, mul_size(max_prepared_xacts, sizeof(PGXACT)));
 
+	/* fast-path lock arrays */
+	size = add_size(size, FastPathLockShmemSize());
+
 	return size;
 }
 
+/*
+ * Report shared-memory space needed for the fast-path lock arrays of all
+ * PGPROCs: a word of lock bits per group, plus the relation OIDs.
+ */
+static Size
+FastPathLockShmemSize(void)
+{
+	Size		size;
+
+	Assert(FastPathLockGroupsPerBackend > 0);
+
+	size = add_size(mul_size(FastPathLockGroupsPerBackend, sizeof(uint64)),
+					mul_size(FP_LOCK_SLOTS_PER_BACKEND, sizeof(Oid)));
+
+	return mul_size(MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts,
+					size);
+}
+
 /*
  * Report number of semaphores needed by InitProcGlobal.
  */
@@ -158,6 +181,7 @@ InitProcGlobal(void)
 {
 	PGPROC	   *procs;
 	PGXACT	   *pgxacts;
+	char	   *fpPtr;
 	int			i,
 				j;
 	bool		found;
@@ -180,6 +204,8 @@ InitProcGlobal(void)
 	ProcGlobal->startupBufferPinWaitBufId = -1;
 	ProcGlobal->walwriterLatch = NULL;
 	ProcGlobal->checkpointerLatch = NULL;
+	SpinLockInit(&ProcGlobal->procArrayGroupLock);
+	ProcGlobal->procArrayGroupFirst = NULL;
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -210,10 +236,27 @@ InitProcGlobal(void)
 	MemSet(pgxacts, 0, TotalProcs * sizeof(PGXACT));
 	ProcGlobal->allPgXact = pgxacts;
 
+	/*
+	 * Allocate the fast-path lock arrays.  Their size depends on
+	 * max_locks_per_transaction, so they can't be part of PGPROC itself.
+	 */
+	fpPtr = (char *) ShmemAlloc(FastPathLockShmemSize());
+	if (!fpPtr)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory")));
+	MemSet(fpPtr, 0, FastPathLockShmemSize());
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
 
+		/* Carve out this PGPROC's fast-path lock arrays */
+		procs[i].fpLockBits = (uint64 *) fpPtr;
+		fpPtr += FastPathLockGroupsPerBackend * sizeof(uint64);
+		procs[i].fpRelId = (Oid *) fpPtr;
+		fpPtr += FP_LOCK_SLOTS_PER_BACKEND * sizeof(Oid);
+
 		/*
 		 * Set up per-PGPROC semaphore, latch, and backendLock. Prepared xact
 		 * dummy PGPROCs don't need these though - they're never associated
@@ -223,7 +266,7 @@ InitProcGlobal(void)
 		{
 			PGSemaphoreCreate(&(procs[i].sem));
 			InitSharedLatch(&(procs[i].procLatch));
-			procs[i].backendLock = LWLockAssign();
+			procs[i].backendLock = LWLockAssignTranche(LWTRANCHE_PROC);
 		}
 		procs[i].pgprocno = i;
 
@@ -373,8 +416,11 @@ InitProcess(void)
 	MyProc->lwWaiting = false;
 	MyProc->lwWaitMode = 0;
 	MyProc->lwWaitLink = NULL;
+	MyProc->procArrayGroupMember = false;
+	MyProc->procArrayGroupNext = NULL;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
+	MyProc->wait_event_info = 0;
 #ifdef USE_ASSERT_CHECKING
 	if (assert_enabled)
 	{
@@ -392,6 +438,9 @@ InitProcess(void)
 	MyProc->syncRepState = SYNC_REP_NOT_WAITING;
 	SHMQueueElemInit(&(MyProc->syncRepLinks));
 
+	/* Report wait events into our PGPROC from now on */
+	pgstat_set_wait_event_storage(&MyProc->wait_event_info);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch.
 	 * Note that there's no particular need to do ResetLatch here.
@@ -536,8 +585,11 @@ InitAuxiliaryProcess(void)
 	MyProc->lwWaiting = false;
 	MyProc->lwWaitMode = 0;
 	MyProc->lwWaitLink = NULL;
+	MyProc->procArrayGroupMember = false;
+	MyProc->procArrayGroupNext = NULL;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
+	MyProc->wait_event_info = 0;
 #ifdef USE_ASSERT_CHECKING
 	if (assert_enabled)
 	{
@@ -549,6 +601,9 @@ InitAuxiliaryProcess(void)
 	}
 #endif
 
+	/* Report wait events into our PGPROC from now on */
+	pgstat_set_wait_event_storage(&MyProc->wait_event_info);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch.
 	 * Note that there's no particular need to do ResetLatch here.
@@ -670,6 +725,9 @@ LockErrorCleanup(void)
 
 	AbortStrongLockAcquire();
 
+	/* If we errored out of any kind of wait, we aren't waiting anymore */
+	pgstat_report_wait_end();
+
 	/* Nothing to do if we weren't waiting for a lock */
 	if (lockAwaited == NULL)
 		return;
@@ -800,10 +858,11 @@ ProcKill(int code, Datum arg)
 	LWLockReleaseAll();
 
 	/*
-	 * Clear MyProc first; then disown the process latch.  This is so that
-	 * signal handlers won't try to clear the process latch after it's no
-	 * longer ours.
+	 * Stop reporting wait events into our PGPROC, and clear MyProc; then
+	 * disown the process latch.  This is so that signal handlers won't try
+	 * to clear the process latch after it's no longer ours.
 	 */
+	pgstat_reset_wait_event_storage();
 	proc = MyProc;
 	MyProc = NULL;
 	DisownLatch(&proc->procLatch);
@@ -867,10 +926,11 @@ AuxiliaryProcKill(int code, Datum arg)
 	LWLockReleaseAll();
 
 	/*
-	 * Clear MyProc first; then disown the process latch.  This is so that
-	 * signal handlers won't try to clear the process latch after it's no
-	 * longer ours.
+	 * Stop reporting wait events into our PGPROC, and clear MyProc; then
+	 * disown the process latch.  This is so that signal handlers won't try
+	 * to clear the process latch after it's no longer ours.
 	 */
+	pgstat_reset_wait_event_storage();
 	proc = MyProc;
 	MyProc = NULL;
 	DisownLatch(&proc->procLatch);
@@ -1131,7 +1191,10 @@ ProcSleep(LOCALLOCK *locallock, LockMethod lockMethodTable)
 	 */
 	do
 	{
+		pgstat_report_wait_start(PG_WAIT_LOCK |
+								 locallock->tag.lock.locktag_type);
 		PGSemaphoreLock(&MyProc->sem, true);
+		pgstat_report_wait_end();
 
 		/*
 		 * waitStatus could change from STATUS_WAITING to something else
@@ -1439,8 +1502,38 @@ ProcLockWakeup(LockMethod lockMethodTable, LOCK *lock)
 void
 CheckDeadLock(void)
 {
+	LWLockId	partitionLock;
 	int			i;
 
+	/*
+	 * Locking every partition stalls all heavyweight lock traffic in the
+	 * cluster, and most lock waits that outlast deadlock_timeout are simply
+	 * long waits.  So first see, holding only the partition lock of the lock
+	 * we're waiting for, whether a deadlock is possible at all.
+	 */
+	partitionLock = LockHashPartitionLock(lockAwaited->hashcode);
+	LWLockAcquire(partitionLock, LW_SHARED);
+
+	/* Woken up in the interim?  See below. */
+	if (MyProc->links.prev == NULL ||
+		MyProc->links.next == NULL)
+	{
+		LWLockRelease(partitionLock);
+		return;
+	}
+
+	if (!DeadLockCheckNeeded(MyProc))
+	{
+		LWLockRelease(partitionLock);
+		deadlock_state = DS_NO_DEADLOCK;
+
+		/* Let ProcSleep log the wait, as below. */
+		if (log_lock_waits)
+			PGSemaphoreUnlock(&MyProc->sem);
+		return;
+	}
+	LWLockRelease(partitionLock);
+
 	/*
 	 * Acquire exclusive lock on the entire shared lock data structures. Must
 	 * grab LWLocks in partition-number order to avoid LWLock deadlock.
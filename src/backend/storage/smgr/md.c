@@ -34,6 +34,7 @@
 #include "storage/fd.h"
 #include "storage/bufmgr.h"
 #include "storage/relfilenode.h"
+#include "storage/relsizecache.h"
 #include "storage/smgr.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
@@ -185,6 +186,7 @@ static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
 			  BlockNumber segno, int oflags);
 static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 			 BlockNumber blkno, bool skipFsync, ExtensionBehavior behavior);
+static BlockNumber mdnblocks_uncached(SMgrRelation reln, ForkNumber forknum);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 		   MdfdVec *seg);
 
@@ -308,6 +310,10 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	pfree(path);
 
+	/* Forget any size cached for a previous user of this relfilenode */
+	if (!SmgrIsTemp(reln))
+		RelSizeCacheInvalidate(reln->smgr_rnode.node, forkNum);
+
 	reln->md_fd[forkNum] = _fdvec_alloc();
 
 	reln->md_fd[forkNum]->mdfd_vfd = fd;
@@ -373,7 +379,10 @@ mdunlink(RelFileNodeBackend rnode, ForkNumber forkNum, bool isRedo)
 	 * the "InvalidForkNumber = all forks" convention.
 	 */
 	if (!RelFileNodeBackendIsTemp(rnode))
+	{
 		ForgetRelationFsyncRequests(rnode.node, forkNum);
+		RelSizeCacheInvalidate(rnode.node, forkNum);
+	}
 
 	/* Now do the per-fork work */
 	if (forkNum == InvalidForkNumber)
@@ -536,6 +545,9 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	if (!skipFsync && !SmgrIsTemp(reln))
 		register_dirty_segment(reln, forknum, v);
 
+	if (!SmgrIsTemp(reln))
+		RelSizeCacheExtend(reln->smgr_rnode.node, forknum, blocknum + 1);
+
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
@@ -628,22 +640,44 @@ mdclose(SMgrRelation reln, ForkNumber forknum)
 }
 
 /*
- *	mdprefetch() -- Initiate asynchronous read of the specified block of a relation
+ *	mdprefetch() -- Initiate asynchronous read of the specified blocks of a relation
+ *
+ *		One request is issued per segment file touched.
  */
 void
-mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
+mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   BlockNumber nblocks)
 {
 #ifdef USE_PREFETCH
-	off_t		seekpos;
-	MdfdVec    *v;
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		BlockNumber segblocks;
+		MdfdVec    *v;
 
-	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+		segblocks = ((BlockNumber) RELSEG_SIZE) -
+			(blocknum % ((BlockNumber) RELSEG_SIZE));
+		segblocks = Min(segblocks, nblocks);
 
-	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+		/*
+		 * A prefetch is only a hint, so don't complain if the segment isn't
+		 * there.  WAL replay may ask for blocks of relations that it hasn't
+		 * created yet, or that are about to be dropped.
+		 */
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_RETURN_NULL);
+		if (v == NULL)
+			return;
 
-	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
-	(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ);
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ * segblocks);
+
+		blocknum += segblocks;
+		nblocks -= segblocks;
+	}
 #endif   /* USE_PREFETCH */
 }
 
@@ -714,6 +748,96 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdreadv() -- Read a run of consecutive blocks from a relation.
+ *
+ *		buffers[i] receives block blocknum + i.  Each segment file touched by
+ *		the run is read with a single FileReadV call.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		BlockNumber segblocks;
+		BlockNumber i;
+		MdfdVec    *v;
+
+		/* Don't let a single FileReadV call cross a segment boundary */
+		segblocks = ((BlockNumber) RELSEG_SIZE) -
+			(blocknum % ((BlockNumber) RELSEG_SIZE));
+		segblocks = Min(segblocks, nblocks);
+		segblocks = Min(segblocks, PG_MAX_READV_BUFFERS);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode,
+											reln->smgr_rnode.backend);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		nbytes = FileReadV(v->mdfd_vfd, buffers, segblocks, BLCKSZ);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode,
+										   reln->smgr_rnode.backend,
+										   nbytes,
+										   BLCKSZ * segblocks);
+
+		if (nbytes != BLCKSZ * segblocks)
+		{
+			BlockNumber badblock;
+
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+								blocknum, blocknum + segblocks - 1,
+								FilePathName(v->mdfd_vfd))));
+
+			/*
+			 * Short read: we hit EOF somewhere inside the run.  As in mdread,
+			 * that's an error unless zero_damaged_pages is ON or we are
+			 * InRecovery, in which case the missing blocks (including any
+			 * partially-read one) read as zeroes.
+			 */
+			badblock = nbytes / BLCKSZ;
+			if (zero_damaged_pages || InRecovery)
+			{
+				for (i = badblock; i < segblocks; i++)
+					MemSet(buffers[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								blocknum + badblock,
+								FilePathName(v->mdfd_vfd),
+								nbytes % BLCKSZ, BLCKSZ)));
+		}
+
+		blocknum += segblocks;
+		buffers += segblocks;
+		nblocks -= segblocks;
+	}
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -786,13 +910,39 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
+ *		For non-temp relations the answer normally comes from the shared
+ *		relation size cache, so unlike mdnblocks_uncached() this does not
+ *		guarantee that all active segments are open.
+ */
+BlockNumber
+mdnblocks(SMgrRelation reln, ForkNumber forknum)
+{
+	BlockNumber nblocks;
+	uint64		fillgen;
+
+	if (SmgrIsTemp(reln))
+		return mdnblocks_uncached(reln, forknum);
+
+	if (RelSizeCacheLookup(reln->smgr_rnode.node, forknum,
+						   &nblocks, &fillgen))
+		return nblocks;
+
+	nblocks = mdnblocks_uncached(reln, forknum);
+	RelSizeCacheFill(reln->smgr_rnode.node, forknum, nblocks, fillgen);
+
+	return nblocks;
+}
+
+/*
+ *	mdnblocks_uncached() -- Get the number of blocks from the file system.
+ *
  *		Important side effect: all active segments of the relation are opened
  *		and added to the mdfd_chain list.  If this routine has not been
  *		called, then only segments up to the last one actually touched
  *		are present in the chain.
  */
-BlockNumber
-mdnblocks(SMgrRelation reln, ForkNumber forknum)
+static BlockNumber
+mdnblocks_uncached(SMgrRelation reln, ForkNumber forknum)
 {
 	MdfdVec    *v = mdopen(reln, forknum, EXTENSION_FAIL);
 	BlockNumber nblocks;
@@ -861,10 +1011,10 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 	BlockNumber priorblocks;
 
 	/*
-	 * NOTE: mdnblocks makes sure we have opened all active segments, so that
-	 * truncation loop will get them all!
+	 * NOTE: mdnblocks_uncached makes sure we have opened all active segments,
+	 * so that truncation loop will get them all!
 	 */
-	curnblk = mdnblocks(reln, forknum);
+	curnblk = mdnblocks_uncached(reln, forknum);
 	if (nblocks > curnblk)
 	{
 		/* Bogus request ... but no complaint if InRecovery */
@@ -878,6 +1028,13 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 	if (nblocks == curnblk)
 		return;					/* no work */
 
+	/*
+	 * Forget the cached size while we work, so that nobody trusts it if we
+	 * fail partway through; it's set to the new size once we're done.
+	 */
+	if (!SmgrIsTemp(reln))
+		RelSizeCacheInvalidate(reln->smgr_rnode.node, forknum);
+
 	v = mdopen(reln, forknum, EXTENSION_FAIL);
 
 	priorblocks = 0;
@@ -938,6 +1095,9 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 		}
 		priorblocks += RELSEG_SIZE;
 	}
+
+	if (!SmgrIsTemp(reln))
+		RelSizeCacheSet(reln->smgr_rnode.node, forknum, nblocks);
 }
 
 /*
@@ -952,10 +1112,10 @@ mdimmedsync(SMgrRelation reln, ForkNumber forknum)
 	MdfdVec    *v;
 
 	/*
-	 * NOTE: mdnblocks makes sure we have opened all active segments, so that
-	 * fsync loop will get them all!
+	 * NOTE: mdnblocks_uncached makes sure we have opened all active segments,
+	 * so that fsync loop will get them all!
 	 */
-	mdnblocks(reln, forknum);
+	mdnblocks_uncached(reln, forknum);
 
 	v = mdopen(reln, forknum, EXTENSION_FAIL);
 
@@ -1733,9 +1893,11 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 			 * active segment are of size RELSEG_SIZE; therefore, pad them out
 			 * with zeroes if needed.  (This only matters if caller is
 			 * extending the relation discontiguously, but that can happen in
-			 * hash indexes.)
+			 * hash indexes.)  A caller that asked for NULL on a missing
+			 * segment doesn't want it created, though, recovery or not.
 			 */
-			if (behavior == EXTENSION_CREATE || InRecovery)
+			if (behavior == EXTENSION_CREATE ||
+				(InRecovery && behavior != EXTENSION_RETURN_NULL))
 			{
 				if (_mdnblocks(reln, forknum, v) < RELSEG_SIZE)
 				{
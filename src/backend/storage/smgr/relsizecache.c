@@ -0,0 +1,514 @@
+/*-------------------------------------------------------------------------
+ *
+ * relsizecache.c
+ *	  Shared-memory cache of relation fork sizes.
+ *
+ * mdnblocks() has to lseek(SEEK_END) on the last segment of a relation fork
+ * to find out how long it is.  The planner asks for the size of every
+ * relation it considers, so with many (e.g., inheritance-partitioned)
+ * tables those system calls can dominate planning time.  This module keeps
+ * the last known size of each fork in shared memory so that most calls can
+ * be answered without touching the file system.
+ *
+ * The cache is maintained by md.c: mdextend() advances a cached size,
+ * mdtruncate() replaces it, and mdcreate()/mdunlink() forget it.  Dropping
+ * or moving a database removes its files wholesale, so dbcommands.c calls
+ * RelSizeCacheDropDatabase() to forget all of that database's entries.
+ * Temporary relations are never cached; their files are private to one
+ * backend anyway.
+ *
+ * An entry is created lazily by the first mdnblocks() call that misses.
+ * Such a caller must measure the file without holding any lock, so a
+ * concurrent extension or truncation could make its measurement stale
+ * before it gets to store it.  To close that race, each partition of the
+ * cache keeps a change counter, which is advanced whenever the size of a
+ * fork that has no entry in that partition changes (or an entry is
+ * removed).  RelSizeCacheLookup() hands out the counter's value as a
+ * ticket, and RelSizeCacheFill() creates the entry only if the counter
+ * still has that value.  Since extension and truncation update the cache
+ * only after the file itself has been changed, any size change that the
+ * measurement might have missed is guaranteed to advance the counter.
+ * Nothing is entered before the size is known, so an error while
+ * measuring leaves nothing behind.
+ *
+ * The cache is divided into NUM_RELSIZECACHE_PARTITIONS independent hash
+ * tables, each protected by its own LWLock and selected by the hash of the
+ * entry's key, so that concurrent extensions of different relations
+ * seldom contend.  Each partition holds a fixed share of
+ * relsize_cache_entries, and also keeps its entries in an array of slots
+ * swept by a clock hand.  A new entry takes the first slot the hand finds
+ * free or holding an entry that hasn't been used since the hand last
+ * passed it; hits set an entry's referenced flag, and the hand clears the
+ * flags it passes over.  The hand's position persists, so the cost of
+ * finding a slot is O(1) when amortized over many insertions.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/smgr/relsizecache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "storage/lwlock.h"
+#include "storage/relsizecache.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+
+
+/* GUC variable: maximum number of cached fork sizes, 0 disables */
+int			relsize_cache_entries = 8192;
+
+/* hash table key */
+typedef struct RelSizeCacheTag
+{
+	RelFileNode rnode;			/* physical relation identifier */
+	ForkNumber	forknum;		/* fork within the relation */
+} RelSizeCacheTag;
+
+/* hash table entry */
+typedef struct RelSizeCacheEnt
+{
+	RelSizeCacheTag key;		/* hash key; must be first */
+	BlockNumber nblocks;		/* number of blocks in the fork */
+	bool		referenced;		/* used since the clock hand passed? */
+	int			slot;			/* index in the partition's slot array */
+} RelSizeCacheEnt;
+
+/* shared state of one partition, other than its hash table and slots */
+typedef struct RelSizeCachePartition
+{
+	uint64		changeCount;	/* see file header comments */
+	int			clockHand;		/* next slot to consider for replacement */
+} RelSizeCachePartition;
+
+/*
+ * To determine which partition a tag belongs to, compute its hash code with
+ * RelSizeCacheHashCode(), then apply RelSizeCacheHashPartition().
+ */
+#define RelSizeCacheHashCode(tag) \
+	tag_hash((void *) (tag), sizeof(RelSizeCacheTag))
+#define RelSizeCacheHashPartition(hashcode) \
+	((hashcode) % NUM_RELSIZECACHE_PARTITIONS)
+#define RelSizeCachePartitionLock(partition) \
+	((LWLockId) (FirstRelSizeCacheLock + (partition)))
+
+static HTAB *RelSizeCacheHash[NUM_RELSIZECACHE_PARTITIONS];
+static RelSizeCachePartition *RelSizeCacheCtl = NULL;
+
+/* each partition's slots; NULL means free */
+static RelSizeCacheEnt **RelSizeCacheSlots = NULL;
+
+#define RelSizeCacheEnabled()	(RelSizeCacheCtl != NULL)
+
+/* Number of entries each partition may hold */
+#define RelSizeCachePartitionEntries() \
+	((relsize_cache_entries + NUM_RELSIZECACHE_PARTITIONS - 1) / \
+	 NUM_RELSIZECACHE_PARTITIONS)
+
+#define RelSizeCachePartitionSlots(partition) \
+	(RelSizeCacheSlots + (partition) * RelSizeCachePartitionEntries())
+
+static void
+InitRelSizeCacheTag(RelSizeCacheTag *tag, RelFileNode rnode,
+					ForkNumber forknum)
+{
+	/* zero any padding so that tag_hash sees a deterministic key */
+	MemSet(tag, 0, sizeof(RelSizeCacheTag));
+	tag->rnode = rnode;
+	tag->forknum = forknum;
+}
+
+/*
+ * Run the partition's clock hand until it finds a slot for a new entry,
+ * evicting the slot's current entry if it has one.  Returns the slot's
+ * index.  Caller must hold the partition's lock exclusively.
+ *
+ * This terminates within two sweeps, since the first clears all referenced
+ * flags.
+ */
+static int
+RelSizeCacheClockSweep(int partition)
+{
+	RelSizeCachePartition *part = &RelSizeCacheCtl[partition];
+	RelSizeCacheEnt **slots = RelSizeCachePartitionSlots(partition);
+	int			nslots = RelSizeCachePartitionEntries();
+
+	for (;;)
+	{
+		int			slot = part->clockHand;
+		RelSizeCacheEnt *ent = slots[slot];
+
+		if (++part->clockHand >= nslots)
+			part->clockHand = 0;
+
+		if (ent == NULL)
+			return slot;
+		if (ent->referenced)
+		{
+			ent->referenced = false;
+			continue;
+		}
+
+		hash_search(RelSizeCacheHash[partition], (void *) &ent->key,
+					HASH_REMOVE, NULL);
+		slots[slot] = NULL;
+		return slot;
+	}
+}
+
+/*
+ * Enter a new entry for tag, evicting another one if the partition is full.
+ * Returns NULL if no entry could be made.  Caller must hold the partition's
+ * lock exclusively and have checked that no entry exists.
+ */
+static RelSizeCacheEnt *
+RelSizeCacheInsert(int partition, RelSizeCacheTag *tag, uint32 hashcode)
+{
+	RelSizeCacheEnt *ent;
+	int			slot;
+
+	slot = RelSizeCacheClockSweep(partition);
+
+	ent = (RelSizeCacheEnt *)
+		hash_search_with_hash_value(RelSizeCacheHash[partition],
+									(void *) tag, hashcode,
+									HASH_ENTER_NULL, NULL);
+	if (ent != NULL)
+	{
+		ent->referenced = true;
+		ent->slot = slot;
+		RelSizeCachePartitionSlots(partition)[slot] = ent;
+	}
+	return ent;
+}
+
+/*
+ * Remove an entry, freeing its slot.  Caller must hold the partition's lock
+ * exclusively.
+ */
+static void
+RelSizeCacheRemove(int partition, RelSizeCacheEnt *ent)
+{
+	RelSizeCachePartitionSlots(partition)[ent->slot] = NULL;
+	hash_search(RelSizeCacheHash[partition], (void *) &ent->key,
+				HASH_REMOVE, NULL);
+}
+
+
+/*
+ * Report shared-memory space needed by RelSizeCacheShmemInit
+ */
+Size
+RelSizeCacheShmemSize(void)
+{
+	Size		size = 0;
+
+	if (relsize_cache_entries <= 0)
+		return size;
+
+	size = add_size(size, MAXALIGN(mul_size(NUM_RELSIZECACHE_PARTITIONS,
+											sizeof(RelSizeCachePartition))));
+	size = add_size(size,
+					MAXALIGN(mul_size(mul_size(NUM_RELSIZECACHE_PARTITIONS,
+											   RelSizeCachePartitionEntries()),
+									  sizeof(RelSizeCacheEnt *))));
+	size = add_size(size,
+					mul_size(NUM_RELSIZECACHE_PARTITIONS,
+							 hash_estimate_size(RelSizeCachePartitionEntries(),
+												sizeof(RelSizeCacheEnt))));
+	return size;
+}
+
+/*
+ * Allocate and initialize the shared relation size cache
+ */
+void
+RelSizeCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+	int			i;
+
+	if (relsize_cache_entries <= 0)
+		return;
+
+	RelSizeCacheCtl = (RelSizeCachePartition *)
+		ShmemInitStruct("Relation Size Cache Data",
+						NUM_RELSIZECACHE_PARTITIONS *
+						sizeof(RelSizeCachePartition),
+						&found);
+	RelSizeCacheSlots = (RelSizeCacheEnt **)
+		ShmemInitStruct("Relation Size Cache Slots",
+						NUM_RELSIZECACHE_PARTITIONS *
+						RelSizeCachePartitionEntries() *
+						sizeof(RelSizeCacheEnt *),
+						&found);
+	if (!found)
+	{
+		for (i = 0; i < NUM_RELSIZECACHE_PARTITIONS; i++)
+		{
+			/* counters start at 1, since a zero ticket means "don't fill" */
+			RelSizeCacheCtl[i].changeCount = 1;
+			RelSizeCacheCtl[i].clockHand = 0;
+		}
+		MemSet(RelSizeCacheSlots, 0,
+			   NUM_RELSIZECACHE_PARTITIONS * RelSizeCachePartitionEntries() *
+			   sizeof(RelSizeCacheEnt *));
+	}
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(RelSizeCacheTag);
+	info.entrysize = sizeof(RelSizeCacheEnt);
+	info.hash = tag_hash;
+
+	for (i = 0; i < NUM_RELSIZECACHE_PARTITIONS; i++)
+	{
+		char		name[64];
+
+		snprintf(name, sizeof(name), "Relation Size Cache %d", i);
+		RelSizeCacheHash[i] = ShmemInitHash(name,
+											RelSizeCachePartitionEntries(),
+											RelSizeCachePartitionEntries(),
+											&info,
+											HASH_ELEM | HASH_FUNCTION);
+	}
+}
+
+/*
+ * RelSizeCacheLookup
+ *		Look up the cached size of a relation fork.
+ *
+ * Returns true and sets *nblocks if the size is known.  Otherwise, sets
+ * *fillgen to a ticket that the caller should pass to RelSizeCacheFill()
+ * together with the size it then measures; zero means the cache is
+ * disabled and RelSizeCacheFill() will do nothing.
+ */
+bool
+RelSizeCacheLookup(RelFileNode rnode, ForkNumber forknum,
+				   BlockNumber *nblocks, uint64 *fillgen)
+{
+	RelSizeCacheTag tag;
+	RelSizeCacheEnt *ent;
+	uint32		hashcode;
+	int			partition;
+	bool		found = false;
+
+	*fillgen = 0;
+	if (!RelSizeCacheEnabled())
+		return false;
+
+	InitRelSizeCacheTag(&tag, rnode, forknum);
+	hashcode = RelSizeCacheHashCode(&tag);
+	partition = RelSizeCacheHashPartition(hashcode);
+
+	LWLockAcquire(RelSizeCachePartitionLock(partition), LW_SHARED);
+	ent = (RelSizeCacheEnt *)
+		hash_search_with_hash_value(RelSizeCacheHash[partition],
+									(void *) &tag, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		*nblocks = ent->nblocks;
+
+		/*
+		 * Setting the flag while holding only a shared lock is safe enough:
+		 * the worst a race with an eviction sweep can do is to give the
+		 * entry one more or one less chance.
+		 */
+		if (!ent->referenced)
+			ent->referenced = true;
+		found = true;
+	}
+	else
+		*fillgen = RelSizeCacheCtl[partition].changeCount;
+	LWLockRelease(RelSizeCachePartitionLock(partition));
+
+	return found;
+}
+
+/*
+ * RelSizeCacheFill
+ *		Store a size measured after a failed RelSizeCacheLookup().
+ *
+ * The value is discarded if the fork's size may have changed since the
+ * lookup, as indicated by a change of the partition's change counter.
+ */
+void
+RelSizeCacheFill(RelFileNode rnode, ForkNumber forknum,
+				 BlockNumber nblocks, uint64 fillgen)
+{
+	RelSizeCacheTag tag;
+	RelSizeCacheEnt *ent;
+	uint32		hashcode;
+	int			partition;
+	bool		found;
+
+	if (!RelSizeCacheEnabled() || fillgen == 0)
+		return;
+
+	InitRelSizeCacheTag(&tag, rnode, forknum);
+	hashcode = RelSizeCacheHashCode(&tag);
+	partition = RelSizeCacheHashPartition(hashcode);
+
+	LWLockAcquire(RelSizeCachePartitionLock(partition), LW_EXCLUSIVE);
+	if (RelSizeCacheCtl[partition].changeCount == fillgen)
+	{
+		/* if someone else got there first, their value is as good as ours */
+		hash_search_with_hash_value(RelSizeCacheHash[partition],
+									(void *) &tag, hashcode,
+									HASH_FIND, &found);
+		if (!found)
+		{
+			ent = RelSizeCacheInsert(partition, &tag, hashcode);
+			if (ent != NULL)
+				ent->nblocks = nblocks;
+		}
+	}
+	LWLockRelease(RelSizeCachePartitionLock(partition));
+}
+
+/*
+ * RelSizeCacheExtend
+ *		Note that a relation fork is now at least nblocks long.
+ *
+ * Must be called after the file has been extended.  Nothing is cached if
+ * there was no entry already; the next mdnblocks() will create one.
+ */
+void
+RelSizeCacheExtend(RelFileNode rnode, ForkNumber forknum, BlockNumber nblocks)
+{
+	RelSizeCacheTag tag;
+	RelSizeCacheEnt *ent;
+	uint32		hashcode;
+	int			partition;
+
+	if (!RelSizeCacheEnabled())
+		return;
+
+	InitRelSizeCacheTag(&tag, rnode, forknum);
+	hashcode = RelSizeCacheHashCode(&tag);
+	partition = RelSizeCacheHashPartition(hashcode);
+
+	LWLockAcquire(RelSizeCachePartitionLock(partition), LW_EXCLUSIVE);
+	ent = (RelSizeCacheEnt *)
+		hash_search_with_hash_value(RelSizeCacheHash[partition],
+									(void *) &tag, hashcode,
+									HASH_FIND, NULL);
+	if (ent == NULL)
+		RelSizeCacheCtl[partition].changeCount++;
+	else if (nblocks > ent->nblocks)
+		ent->nblocks = nblocks;
+	LWLockRelease(RelSizeCachePartitionLock(partition));
+}
+
+/*
+ * RelSizeCacheSet
+ *		Record the exact size of a relation fork, e.g. after truncation.
+ *
+ * Must be called after the file has reached that size.
+ */
+void
+RelSizeCacheSet(RelFileNode rnode, ForkNumber forknum, BlockNumber nblocks)
+{
+	RelSizeCacheTag tag;
+	RelSizeCacheEnt *ent;
+	uint32		hashcode;
+	int			partition;
+
+	if (!RelSizeCacheEnabled())
+		return;
+
+	InitRelSizeCacheTag(&tag, rnode, forknum);
+	hashcode = RelSizeCacheHashCode(&tag);
+	partition = RelSizeCacheHashPartition(hashcode);
+
+	LWLockAcquire(RelSizeCachePartitionLock(partition), LW_EXCLUSIVE);
+	ent = (RelSizeCacheEnt *)
+		hash_search_with_hash_value(RelSizeCacheHash[partition],
+									(void *) &tag, hashcode,
+									HASH_FIND, NULL);
+	if (ent == NULL)
+	{
+		RelSizeCacheCtl[partition].changeCount++;
+		ent = RelSizeCacheInsert(partition, &tag, hashcode);
+	}
+	if (ent != NULL)
+		ent->nblocks = nblocks;
+	LWLockRelease(RelSizeCachePartitionLock(partition));
+}
+
+/*
+ * RelSizeCacheInvalidate
+ *		Forget the size of one fork, or of all forks if forknum is
+ *		InvalidForkNumber.
+ */
+void
+RelSizeCacheInvalidate(RelFileNode rnode, ForkNumber forknum)
+{
+	RelSizeCacheTag tag;
+	ForkNumber	fork;
+
+	if (!RelSizeCacheEnabled())
+		return;
+
+	for (fork = 0; fork <= MAX_FORKNUM; fork++)
+	{
+		RelSizeCacheEnt *ent;
+		uint32		hashcode;
+		int			partition;
+
+		if (forknum != InvalidForkNumber && fork != forknum)
+			continue;
+		InitRelSizeCacheTag(&tag, rnode, fork);
+		hashcode = RelSizeCacheHashCode(&tag);
+		partition = RelSizeCacheHashPartition(hashcode);
+
+		LWLockAcquire(RelSizeCachePartitionLock(partition), LW_EXCLUSIVE);
+		ent = (RelSizeCacheEnt *)
+			hash_search_with_hash_value(RelSizeCacheHash[partition],
+										(void *) &tag, hashcode,
+										HASH_FIND, NULL);
+		if (ent != NULL)
+			RelSizeCacheRemove(partition, ent);
+		RelSizeCacheCtl[partition].changeCount++;
+		LWLockRelease(RelSizeCachePartitionLock(partition));
+	}
+}
+
+/*
+ * RelSizeCacheDropDatabase
+ *		Forget the sizes of all relations belonging to a database.
+ *
+ * Used when a database's files are removed or moved as a whole, since the
+ * database OID (and with it, the relfilenodes) could later be reused.
+ */
+void
+RelSizeCacheDropDatabase(Oid dbid)
+{
+	HASH_SEQ_STATUS status;
+	RelSizeCacheEnt *ent;
+	int			partition;
+
+	if (!RelSizeCacheEnabled())
+		return;
+
+	for (partition = 0; partition < NUM_RELSIZECACHE_PARTITIONS; partition++)
+	{
+		HTAB	   *hashp = RelSizeCacheHash[partition];
+
+		LWLockAcquire(RelSizeCachePartitionLock(partition), LW_EXCLUSIVE);
+		hash_seq_init(&status, hashp);
+		while ((ent = (RelSizeCacheEnt *) hash_seq_search(&status)) != NULL)
+		{
+			if (ent->key.rnode.dbNode == dbid)
+				RelSizeCacheRemove(partition, ent);
+		}
+		RelSizeCacheCtl[partition].changeCount++;
+		LWLockRelease(RelSizeCachePartitionLock(partition));
+	}
+}
@@ -48,9 +48,11 @@ typedef struct f_smgr
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 						 BlockNumber blocknum, char *buffer, bool skipFsync);
 	void		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
-											  BlockNumber blocknum);
+								BlockNumber blocknum, BlockNumber nblocks);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 										  BlockNumber blocknum, char *buffer);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+						BlockNumber blocknum, char **buffers, BlockNumber nblocks);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 						 BlockNumber blocknum, char *buffer, bool skipFsync);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
@@ -66,7 +68,8 @@ typedef struct f_smgr
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
 	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdnblocks, mdtruncate, mdimmedsync,
+		mdprefetch, mdread, mdreadv, mdwrite, mdnblocks, mdtruncate,
+		mdimmedsync,
 		mdpreckpt, mdsync, mdpostckpt
 	}
 };
@@ -604,12 +607,18 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 }
 
 /*
- *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
+ *	smgrprefetch() -- Initiate asynchronous read of the specified blocks of a
+ *					  relation.
+ *
+ *		nblocks consecutive blocks starting at blocknum are requested; the
+ *		storage manager should try to cover them with a single request.
  */
 void
-smgrprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
+smgrprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 BlockNumber nblocks)
 {
-	(*(smgrsw[reln->smgr_which].smgr_prefetch)) (reln, forknum, blocknum);
+	(*(smgrsw[reln->smgr_which].smgr_prefetch)) (reln, forknum, blocknum,
+												 nblocks);
 }
 
 /*
@@ -627,6 +636,22 @@ smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	(*(smgrsw[reln->smgr_which].smgr_read)) (reln, forknum, blocknum, buffer);
 }
 
+/*
+ *	smgrreadv() -- read a run of consecutive blocks from a relation into
+ *				   the supplied buffers.
+ *
+ *		This is the multi-block equivalent of smgrread: buffers[i] receives
+ *		block blocknum + i.  The storage manager is free to satisfy the
+ *		request with fewer I/O calls than blocks.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_readv)) (reln, forknum, blocknum,
+											  buffers, nblocks);
+}
+
 /*
  *	smgrwrite() -- Write the supplied buffer out.
  *
@@ -3671,6 +3671,9 @@ PostgresMain(int argc, char *argv[],
 
 		/* Initialize MaxBackends (if under postmaster, was done already) */
 		InitializeMaxBackends();
+
+		/* Initialize size of fast-path lock cache. */
+		InitializeFastPathLocks();
 	}
 
 	/* Early initialization */
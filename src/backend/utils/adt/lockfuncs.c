@@ -71,6 +71,19 @@ VXIDGetDatum(BackendId bid, LocalTransactionId lxid)
 	return CStringGetTextDatum(vxidstr);
 }
 
+/*
+ * GetLockNameFromTagType - name of a LockTagType, as shown in pg_locks
+ *
+ * Also used to name heavyweight lock waits in pg_stat_activity.
+ */
+const char *
+GetLockNameFromTagType(uint16 locktag_type)
+{
+	if (locktag_type > LOCKTAG_LAST_TYPE)
+		return "???";
+	return LockTagTypeNames[locktag_type];
+}
+
 
 /*
  * pg_lock_status - produce a view with one row per held or awaited lock mode
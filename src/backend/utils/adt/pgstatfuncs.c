@@ -20,6 +20,7 @@
 #include "libpq/ip.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/predicate_internals.h"
 #include "utils/builtins.h"
 #include "utils/inet.h"
 #include "utils/timestamp.h"
@@ -36,6 +37,7 @@ extern Datum pg_stat_get_live_tuples(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_dead_tuples(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_blocks_fetched(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_blocks_hit(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_tuple_lock_waits(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_last_vacuum_time(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_last_autovacuum_time(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_last_analyze_time(PG_FUNCTION_ARGS);
@@ -98,6 +100,12 @@ extern Datum pg_stat_get_buf_written_backend(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_buf_fsync_backend(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_buf_alloc(PG_FUNCTION_ARGS);
 
+extern Datum pg_stat_get_slru(PG_FUNCTION_ARGS);
+
+extern Datum pg_stat_get_serializable(PG_FUNCTION_ARGS);
+
+extern Datum pg_stat_get_backend_memory(PG_FUNCTION_ARGS);
+
 extern Datum pg_stat_get_xact_numscans(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_xact_tuples_returned(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_xact_tuples_fetched(PG_FUNCTION_ARGS);
@@ -296,6 +304,21 @@ pg_stat_get_blocks_hit(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(result);
 }
 
+Datum
+pg_stat_get_tuple_lock_waits(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int64		result;
+	PgStat_StatTabEntry *tabentry;
+
+	if ((tabentry = pgstat_fetch_stat_tabentry(relid)) == NULL)
+		result = 0;
+	else
+		result = (int64) (tabentry->tuple_lock_waits);
+
+	PG_RETURN_INT64(result);
+}
+
 Datum
 pg_stat_get_last_vacuum_time(PG_FUNCTION_ARGS)
 {
@@ -517,7 +540,7 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 
 		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
-		tupdesc = CreateTemplateTupleDesc(14, false);
+		tupdesc = CreateTemplateTupleDesc(16, false);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "datid",
 						   OIDOID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "pid",
@@ -546,6 +569,10 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 						   TEXTOID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 14, "client_port",
 						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 15, "wait_event_type",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 16, "wait_event",
+						   TEXTOID, -1, 0);
 
 		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
 
@@ -597,9 +624,10 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 	if (funcctx->call_cntr < funcctx->max_calls)
 	{
 		/* for each row */
-		Datum		values[14];
-		bool		nulls[14];
+		Datum		values[16];
+		bool		nulls[16];
 		HeapTuple	tuple;
+		LocalPgBackendStatus *local_beentry;
 		PgBackendStatus *beentry;
 
 		MemSet(values, 0, sizeof(values));
@@ -608,14 +636,14 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 		if (*(int *) (funcctx->user_fctx) > 0)
 		{
 			/* Get specific pid slot */
-			beentry = pgstat_fetch_stat_beentry(*(int *) (funcctx->user_fctx));
+			local_beentry = pgstat_fetch_stat_local_beentry(*(int *) (funcctx->user_fctx));
 		}
 		else
 		{
 			/* Get the next one in the list */
-			beentry = pgstat_fetch_stat_beentry(funcctx->call_cntr + 1);		/* 1-based index */
+			local_beentry = pgstat_fetch_stat_local_beentry(funcctx->call_cntr + 1);	/* 1-based index */
 		}
-		if (!beentry)
+		if (!local_beentry)
 		{
 			int			i;
 
@@ -629,6 +657,8 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
 		}
 
+		beentry = &local_beentry->backendStatus;
+
 		/* Values available to all callers */
 		values[0] = ObjectIdGetDatum(beentry->st_databaseid);
 		values[1] = Int32GetDatum(beentry->st_procpid);
@@ -642,6 +672,8 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 		if (superuser() || beentry->st_userid == GetUserId())
 		{
 			SockAddr	zero_clientaddr;
+			const char *wait_event_type;
+			const char *wait_event;
 
 			switch (beentry->st_state)
 			{
@@ -757,6 +789,23 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 					nulls[13] = true;
 				}
 			}
+
+			/*
+			 * The wait event was read from the backend's PGPROC when our
+			 * snapshot of its status entry was taken, since it changes far
+			 * too often to go through the st_changecount protocol.
+			 */
+			wait_event_type =
+				pgstat_get_wait_event_type(local_beentry->wait_event_info);
+			wait_event = pgstat_get_wait_event(local_beentry->wait_event_info);
+			if (wait_event_type)
+				values[14] = CStringGetTextDatum(wait_event_type);
+			else
+				nulls[14] = true;
+			if (wait_event)
+				values[15] = CStringGetTextDatum(wait_event);
+			else
+				nulls[15] = true;
 		}
 		else
 		{
@@ -771,6 +820,8 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			nulls[11] = true;
 			nulls[12] = true;
 			nulls[13] = true;
+			nulls[14] = true;
+			nulls[15] = true;
 		}
 
 		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
@@ -1458,6 +1509,185 @@ pg_stat_get_buf_alloc(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(pgstat_fetch_global()->buf_alloc);
 }
 
+/*
+ * Returns statistics of the SLRUs, one row per SLRU
+ */
+Datum
+pg_stat_get_slru(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_SLRU_COLS	9
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	PgStat_SLRUStats *stats;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	stats = pgstat_fetch_slru();
+
+	for (i = 0; i < SLRU_NUM_ELEMENTS; i++)
+	{
+		PgStat_SLRUStats *stat = &stats[i];
+		Datum		values[PG_STAT_GET_SLRU_COLS];
+		bool		nulls[PG_STAT_GET_SLRU_COLS];
+
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(pgstat_slru_name(i));
+		values[1] = Int64GetDatum(stat->blocks_zeroed);
+		values[2] = Int64GetDatum(stat->blocks_hit);
+		values[3] = Int64GetDatum(stat->blocks_read);
+		values[4] = Int64GetDatum(stat->blocks_written);
+		values[5] = Int64GetDatum(stat->blocks_exists);
+		values[6] = Int64GetDatum(stat->flush);
+		values[7] = Int64GetDatum(stat->truncate);
+		if (stat->stat_reset_timestamp == 0)
+			nulls[8] = true;
+		else
+			values[8] = TimestampTzGetDatum(stat->stat_reset_timestamp);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the predicate locking statistics of serializable transactions
+ */
+Datum
+pg_stat_get_serializable(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_SERIALIZABLE_COLS	7
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_SERIALIZABLE_COLS];
+	bool		nulls[PG_STAT_GET_SERIALIZABLE_COLS];
+	PredicateLockStats stats;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	GetPredicateLockStats(&stats);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(stats.pagePromotions);
+	values[1] = Int64GetDatum(stats.relationPromotions);
+	values[2] = Int64GetDatum(stats.tupleConflicts);
+	values[3] = Int64GetDatum(stats.pageConflicts);
+	values[4] = Int64GetDatum(stats.relationConflicts);
+	values[5] = Int64GetDatum(stats.failures);
+	values[6] = Int64GetDatum(stats.coarseFailures);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Returns the memory allocated by each backend, and its high-water mark
+ */
+Datum
+pg_stat_get_backend_memory(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_BACKEND_MEMORY_COLS	3
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			num_backends;
+	int			curr_backend;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	num_backends = pgstat_fetch_stat_numbackends();
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		PgBackendStatus *beentry = pgstat_fetch_stat_beentry(curr_backend);
+		Datum		values[PG_STAT_GET_BACKEND_MEMORY_COLS];
+		bool		nulls[PG_STAT_GET_BACKEND_MEMORY_COLS];
+
+		if (beentry == NULL)
+			continue;
+
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = Int32GetDatum(beentry->st_procpid);
+
+		/* Values only available to same user or superuser */
+		if (superuser() || beentry->st_userid == GetUserId())
+		{
+			values[1] = Int64GetDatum((int64) beentry->st_memory.allocated);
+			values[2] = Int64GetDatum((int64) beentry->st_memory.peak);
+		}
+		else
+		{
+			nulls[1] = true;
+			nulls[2] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
 Datum
 pg_stat_get_xact_numscans(PG_FUNCTION_ARGS)
 {
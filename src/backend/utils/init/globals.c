@@ -99,6 +99,7 @@ int			CTimeZone = 0;
 bool		enableFsync = true;
 bool		allowSystemTableMods = false;
 int			work_mem = 1024;
+int			query_work_mem = 0;
 int			maintenance_work_mem = 16384;
 
 /*
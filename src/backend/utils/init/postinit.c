@@ -448,6 +448,40 @@ InitializeMaxBackends(void)
 		elog(ERROR, "too many backends configured");
 }
 
+/*
+ * Initialize the number of fast-path lock groups per backend.
+ *
+ * We allocate enough groups for max_locks_per_transaction slots, rounded up
+ * to a power of two groups, within [1, FP_LOCK_GROUPS_PER_BACKEND_MAX].
+ * The assumption is that a transaction that needs that many locks is likely
+ * to take most of them on relations, and those are exactly the locks we'd
+ * like to keep off the shared lock table.
+ *
+ * Like InitializeMaxBackends, this must be called before shared memory size
+ * is determined, and only by the postmaster and processes not under
+ * postmaster control; in EXEC_BACKEND builds the value is passed down to
+ * subprocesses via BackendParameters.
+ */
+void
+InitializeFastPathLocks(void)
+{
+	Assert(FastPathLockGroupsPerBackend == 0);
+
+	/* we need at least one group */
+	FastPathLockGroupsPerBackend = 1;
+
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX)
+	{
+		/* stop once we have enough slots for max_locks_per_transaction */
+		if (FP_LOCK_SLOTS_PER_BACKEND >= max_locks_per_xact)
+			break;
+
+		FastPathLockGroupsPerBackend *= 2;
+	}
+
+	Assert(FastPathLockGroupsPerBackend <= FP_LOCK_GROUPS_PER_BACKEND_MAX);
+}
+
 /*
  * Early initialization of a backend (either standalone or under postmaster).
  * This happens even before InitPostgres.
@@ -26,10 +26,16 @@
 #include <syslog.h>
 #endif
 
+#include "access/clog.h"
+#include "access/csnlog.h"
 #include "access/gin.h"
+#include "access/multixact.h"
+#include "access/slru.h"
+#include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
+#include "access/xlogprefetch.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
 #include "commands/prepare.h"
@@ -55,6 +61,7 @@
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/redoworker.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
 #include "replication/syncrep.h"
@@ -65,6 +72,8 @@
 #include "storage/fd.h"
 #include "storage/proc.h"
 #include "storage/predicate.h"
+#include "storage/relsizecache.h"
+#include "storage/sinvaladt.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
 #include "utils/builtins.h"
@@ -849,6 +858,25 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Compresses full-page writes written in WAL file."),
+			NULL
+		},
+		&wal_compression,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"adaptive_commit_delay", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Derives the delay before a group commit flush from measured flush times and commit rates."),
+			gettext_noop("When enabled, commit_siblings is ignored and commit_delay "
+						 "is the maximum delay; a commit_delay of zero still disables the delay.")
+		},
+		&adaptive_commit_delay,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"log_checkpoints", PGC_SIGHUP, LOGGING_WHAT,
 			gettext_noop("Logs each checkpoint."),
@@ -1720,6 +1748,19 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"query_work_mem", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for the workspaces of a whole query."),
+			gettext_noop("The sorts and hash tables of a query divide this "
+						 "much memory among themselves, each getting at "
+						 "most work_mem.  Zero disables the limit."),
+			GUC_UNIT_KB
+		},
+		&query_work_mem,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"maintenance_work_mem", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum memory to be used for maintenance operations."),
@@ -1853,6 +1894,95 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"relsize_cache_entries", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of relation fork sizes cached in shared memory."),
+			gettext_noop("Zero disables the cache.")
+		},
+		&relsize_cache_entries,
+		8192, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"clog_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for the commit log."),
+			gettext_noop("Zero sizes them based on shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&clog_buffers,
+		0, 0, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"subtrans_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for the subtransaction log."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&subtrans_buffers,
+		32, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+#ifdef USE_CSN_SNAPSHOTS
+	{
+		{"csnlog_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for the commit sequence number log."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&csnlog_buffers,
+		32, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+#endif
+
+	{
+		{"multixact_offset_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for multixact offsets."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offset_buffers,
+		8, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"multixact_member_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for multixact members."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_member_buffers,
+		16, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for the LISTEN/NOTIFY queue."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		8, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"sinval_queue_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared cache invalidation messages that can be queued."),
+			gettext_noop("Backends that fall further behind than this must reset all their caches. "
+						 "The value is rounded up to a power of 2.")
+		},
+		&sinval_queue_size,
+		16384, 4096, 1048576,
+		NULL, NULL, NULL
+	},
+
 #ifdef LOCK_DEBUG
 	{
 		{"trace_lock_oidmin", PGC_SUSET, DEVELOPER_OPTIONS,
@@ -1975,6 +2105,30 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_pred_locks_per_relation", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the maximum number of predicate-locked pages and tuples per relation."),
+			gettext_noop("If more than this total of pages and tuples in the same relation are locked "
+						 "by a connection, those locks are replaced by a relation-level lock. "
+						 "A negative value means max_pred_locks_per_transaction divided by "
+						 "its absolute value.")
+		},
+		&max_predicate_locks_per_relation,
+		-2, -INT_MAX, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_pred_locks_per_page", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the maximum number of predicate-locked tuples per page."),
+			gettext_noop("If more than this number of tuples on the same page are locked "
+						 "by a connection, those locks are replaced by a page-level lock.")
+		},
+		&max_predicate_locks_per_page,
+		2, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"authentication_timeout", PGC_SIGHUP, CONN_AUTH_SECURITY,
 			gettext_noop("Sets the maximum allowed time to complete client authentication."),
@@ -2054,6 +2208,17 @@ static struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"recovery_prefetch_distance", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Sets how far ahead of replay to look for blocks to prefetch during recovery."),
+			gettext_noop("Zero disables prefetching during recovery."),
+			GUC_UNIT_KB
+		},
+		&recovery_prefetch_distance,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("WAL writer sleep time between WAL flushes."),
@@ -2076,6 +2241,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"parallel_redo_workers", PGC_POSTMASTER, REPLICATION_STANDBY,
+			gettext_noop("Sets the number of processes used to replay WAL in parallel on a standby."),
+			gettext_noop("Zero replays all WAL in the startup process.")
+		},
+		&parallel_redo_workers,
+		0, 0, MAX_REDO_WORKERS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_sender_timeout", PGC_SIGHUP, REPLICATION_SENDING,
 			gettext_noop("Sets the maximum time to wait for WAL replication."),
@@ -2167,6 +2342,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"bgwriter_freelist_target", PGC_SIGHUP, RESOURCES_BGWRITER,
+			gettext_noop("Background writer minimum number of clean buffers to keep in the freelist."),
+			gettext_noop("Zero disables freelist mode.")
+		},
+		&bgwriter_freelist_target,
+		0, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"effective_io_concurrency",
 #ifdef USE_PREFETCH
@@ -417,6 +417,7 @@ AllocSetContextCreate(MemoryContext parent,
 					 errdetail("Failed while creating memory context \"%s\".",
 							   name)));
 		}
+		MemoryContextNoteAlloc(&context->header, blksize);
 		block->aset = context;
 		block->freeptr = ((char *) block) + ALLOC_BLOCKHDRSZ;
 		block->endptr = ((char *) block) + blksize;
@@ -501,6 +502,8 @@ AllocSetReset(MemoryContext context)
 		else
 		{
 			/* Normal case, release the block */
+			MemoryContextNoteFree(&set->header,
+								  block->endptr - ((char *) block));
 #ifdef CLOBBER_FREED_MEMORY
 			/* Wipe freed memory for debugging purposes */
 			memset(block, 0x7F, block->freeptr - ((char *) block));
@@ -544,6 +547,7 @@ AllocSetDelete(MemoryContext context)
 	{
 		AllocBlock	next = block->next;
 
+		MemoryContextNoteFree(&set->header, block->endptr - ((char *) block));
 #ifdef CLOBBER_FREED_MEMORY
 		/* Wipe freed memory for debugging purposes */
 		memset(block, 0x7F, block->freeptr - ((char *) block));
@@ -588,6 +592,7 @@ AllocSetAlloc(MemoryContext context, Size size)
 					 errdetail("Failed on request of size %lu.",
 							   (unsigned long) size)));
 		}
+		MemoryContextNoteAlloc(&set->header, blksize);
 		block->aset = set;
 		block->freeptr = block->endptr = ((char *) block) + blksize;
 
@@ -767,6 +772,7 @@ AllocSetAlloc(MemoryContext context, Size size)
 							   (unsigned long) size)));
 		}
 
+		MemoryContextNoteAlloc(&set->header, blksize);
 		block->aset = set;
 		block->freeptr = ((char *) block) + ALLOC_BLOCKHDRSZ;
 		block->endptr = ((char *) block) + blksize;
@@ -859,6 +865,7 @@ AllocSetFree(MemoryContext context, void *pointer)
 			set->blocks = block->next;
 		else
 			prevblock->next = block->next;
+		MemoryContextNoteFree(&set->header, block->endptr - ((char *) block));
 #ifdef CLOBBER_FREED_MEMORY
 		/* Wipe freed memory for debugging purposes */
 		memset(block, 0x7F, block->freeptr - ((char *) block));
@@ -940,6 +947,7 @@ AllocSetRealloc(MemoryContext context, void *pointer, Size size)
 		AllocBlock	prevblock = NULL;
 		Size		chksize;
 		Size		blksize;
+		Size		oldblksize;
 
 		while (block != NULL)
 		{
@@ -957,6 +965,7 @@ AllocSetRealloc(MemoryContext context, void *pointer, Size size)
 		/* Do the realloc */
 		chksize = MAXALIGN(size);
 		blksize = chksize + ALLOC_BLOCKHDRSZ + ALLOC_CHUNKHDRSZ;
+		oldblksize = block->endptr - ((char *) block);
 		block = (AllocBlock) realloc(block, blksize);
 		if (block == NULL)
 		{
@@ -967,6 +976,8 @@ AllocSetRealloc(MemoryContext context, void *pointer, Size size)
 					 errdetail("Failed on request of size %lu.",
 							   (unsigned long) size)));
 		}
+		MemoryContextNoteFree(&set->header, oldblksize);
+		MemoryContextNoteAlloc(&set->header, blksize);
 		block->freeptr = block->endptr = ((char *) block) + blksize;
 
 		/* Update pointers since block has likely been moved */
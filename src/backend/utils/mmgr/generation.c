@@ -0,0 +1,562 @@
+/*-------------------------------------------------------------------------
+ *
+ * generation.c
+ *	  Generational allocator definitions.
+ *
+ * Generation is a MemoryContext implementation for chunks that are freed
+ * in roughly the order they were allocated, or all together: tuples that
+ * live exactly as long as a batch of work, queue entries, and so on.  For
+ * such usage aset.c wastes memory rounding requests up to powers of 2, and
+ * its free lists, which can't be handed back to malloc(), never get reused.
+ *
+ * Chunks are carved sequentially out of malloc()'d blocks, with nothing
+ * but a free counter to track what's become of them afterwards.  pfree()
+ * just bumps the counter of the chunk's block, and when every chunk in a
+ * block has been freed, the whole block is returned to malloc() (or, if
+ * it's the block we're currently allocating from, recycled in place).  The
+ * space of individual freed chunks is never reused, so this is a poor fit
+ * for long-lived data with random lifetimes.
+ *
+ * Requests bigger than an eighth of the block size get a block of their
+ * own, as in aset.c, so that one large chunk doesn't waste the rest of a
+ * block or pin memory that would otherwise be freed.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/mmgr/generation.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "lib/ilist.h"
+#include "utils/memutils.h"
+
+
+/*
+ * GenerationBlock
+ *		A GenerationBlock is the unit of memory that is obtained by
+ *		generation.c from malloc().  It contains one or more chunks, laid
+ *		out one after the other following the block header.
+ */
+typedef struct GenerationBlock
+{
+	dlist_node	node;			/* link in the context's list of blocks */
+	int			nchunks;		/* number of chunks allocated in block */
+	int			nfree;			/* number of those that have been freed */
+	char	   *freeptr;		/* start of free space in this block */
+	char	   *endptr;			/* end of space in this block */
+} GenerationBlock;
+
+/*
+ * GenerationContext is a specialized implementation of MemoryContext.
+ */
+typedef struct GenerationContext
+{
+	MemoryContextData header;	/* Standard memory-context fields */
+	/* Allocation parameters for this context: */
+	Size		blockSize;		/* size of ordinary blocks */
+	Size		chunkLimit;		/* larger chunks get a block of their own */
+	/* Info about storage allocated in this context: */
+	GenerationBlock *block;		/* block we're allocating from, or NULL */
+	dlist_head	blocks;			/* all blocks, including dedicated ones */
+} GenerationContext;
+
+typedef GenerationContext *Generation;
+
+/*
+ * Each chunk starts with a pointer to its block, followed by the standard
+ * chunk header that mcxt.c expects to find right before the chunk's data
+ * (see StandardChunkHeader in memutils.h).
+ */
+#define GENERATION_BLOCKHDRSZ	MAXALIGN(sizeof(GenerationBlock))
+#define GENERATION_BLOCKLINKSZ	MAXALIGN(sizeof(GenerationBlock *))
+#define GENERATION_CHUNKHDRSZ	(GENERATION_BLOCKLINKSZ + STANDARDCHUNKHEADERSIZE)
+
+#define GenerationIsValid(set) PointerIsValid(set)
+
+#define GenerationChunkGetBlock(chk) \
+	(*(GenerationBlock **) (chk))
+#define GenerationChunkGetHeader(chk) \
+	((StandardChunkHeader *) (((char *) (chk)) + GENERATION_BLOCKLINKSZ))
+#define GenerationChunkGetPointer(chk) \
+	((void *) (((char *) (chk)) + GENERATION_CHUNKHDRSZ))
+#define GenerationPointerGetChunk(ptr) \
+	(((char *) (ptr)) - GENERATION_CHUNKHDRSZ)
+
+/*
+ * These functions implement the MemoryContext API for Generation contexts.
+ */
+static void *GenerationAlloc(MemoryContext context, Size size);
+static void GenerationFree(MemoryContext context, void *pointer);
+static void *GenerationRealloc(MemoryContext context, void *pointer, Size size);
+static void GenerationInit(MemoryContext context);
+static void GenerationReset(MemoryContext context);
+static void GenerationDelete(MemoryContext context);
+static Size GenerationGetChunkSpace(MemoryContext context, void *pointer);
+static bool GenerationIsEmpty(MemoryContext context);
+static void GenerationStats(MemoryContext context, int level);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+static void GenerationCheck(MemoryContext context);
+#endif
+
+static void GenerationFreeBlock(Generation set, GenerationBlock *block);
+
+/*
+ * This is the virtual function table for Generation contexts.
+ */
+static MemoryContextMethods GenerationMethods = {
+	GenerationAlloc,
+	GenerationFree,
+	GenerationRealloc,
+	GenerationInit,
+	GenerationReset,
+	GenerationDelete,
+	GenerationGetChunkSpace,
+	GenerationIsEmpty,
+	GenerationStats
+#ifdef MEMORY_CONTEXT_CHECKING
+	,GenerationCheck
+#endif
+};
+
+
+/*
+ * Public routines
+ */
+
+
+/*
+ * GenerationContextCreate
+ *		Create a new Generation context.
+ *
+ * parent: parent context, or NULL if top-level context
+ * name: name of context (for debugging --- string will be copied)
+ * blockSize: allocation block size
+ */
+MemoryContext
+GenerationContextCreate(MemoryContext parent,
+						const char *name,
+						Size blockSize)
+{
+	Generation	set;
+
+	/* the block must have room for at least a few useful chunks */
+	blockSize = MAXALIGN(blockSize);
+	if (blockSize < 1024)
+		blockSize = 1024;
+
+	/* Do the type-independent part of context creation */
+	set = (Generation) MemoryContextCreate(T_GenerationContext,
+										   sizeof(GenerationContext),
+										   &GenerationMethods,
+										   parent,
+										   name);
+
+	set->blockSize = blockSize;
+	set->chunkLimit = (blockSize - GENERATION_BLOCKHDRSZ) / 8;
+	set->block = NULL;
+	dlist_init(&set->blocks);
+
+	return (MemoryContext) set;
+}
+
+/*
+ * GenerationInit
+ *		Context-type-specific initialization routine.
+ */
+static void
+GenerationInit(MemoryContext context)
+{
+	/*
+	 * Since MemoryContextCreate already zeroed the context node, we don't
+	 * have to do anything here: GenerationContextCreate fills in the rest.
+	 */
+}
+
+/*
+ * GenerationReset
+ *		Frees all memory which is allocated in the given set.
+ */
+static void
+GenerationReset(MemoryContext context)
+{
+	Generation	set = (Generation) context;
+	dlist_mutable_iter miter;
+
+	AssertArg(GenerationIsValid(set));
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Check for corruption and leaks before freeing */
+	GenerationCheck(context);
+#endif
+
+	dlist_foreach_modify(miter, &set->blocks)
+	{
+		GenerationBlock *block = dlist_container(GenerationBlock, node,
+												 miter.cur);
+
+		GenerationFreeBlock(set, block);
+	}
+
+	set->block = NULL;
+}
+
+/*
+ * GenerationDelete
+ *		Frees all memory which is allocated in the given set, in preparation
+ *		for deletion of the set.  We simply call GenerationReset().
+ */
+static void
+GenerationDelete(MemoryContext context)
+{
+	GenerationReset(context);
+}
+
+/*
+ * GenerationAlloc
+ *		Returns pointer to allocated memory of given size; memory is added
+ *		to the set.
+ */
+static void *
+GenerationAlloc(MemoryContext context, Size size)
+{
+	Generation	set = (Generation) context;
+	GenerationBlock *block;
+	StandardChunkHeader *header;
+	char	   *chunk;
+	Size		chunk_size = MAXALIGN(size);
+	Size		required_size = chunk_size + GENERATION_CHUNKHDRSZ;
+
+	AssertArg(GenerationIsValid(set));
+
+	/*
+	 * If requested size exceeds the chunk limit, or there's no room for it
+	 * in the current block, allocate a new block.  A big chunk gets a block
+	 * of just the right size, which doesn't become the current block.
+	 */
+	block = set->block;
+	if (chunk_size > set->chunkLimit ||
+		block == NULL ||
+		(Size) (block->endptr - block->freeptr) < required_size)
+	{
+		Size		blksize;
+
+		if (chunk_size > set->chunkLimit)
+			blksize = GENERATION_BLOCKHDRSZ + required_size;
+		else
+			blksize = set->blockSize;
+
+		block = (GenerationBlock *) malloc(blksize);
+		if (block == NULL)
+		{
+			MemoryContextStats(TopMemoryContext);
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory"),
+					 errdetail("Failed on request of size %lu.",
+							   (unsigned long) size)));
+		}
+		MemoryContextNoteAlloc(&set->header, blksize);
+
+		block->nchunks = 0;
+		block->nfree = 0;
+		block->freeptr = ((char *) block) + GENERATION_BLOCKHDRSZ;
+		block->endptr = ((char *) block) + blksize;
+		dlist_push_head(&set->blocks, &block->node);
+
+		if (chunk_size <= set->chunkLimit)
+			set->block = block;
+	}
+
+	chunk = block->freeptr;
+	block->freeptr += required_size;
+	block->nchunks++;
+	Assert(block->freeptr <= block->endptr);
+
+	GenerationChunkGetBlock(chunk) = block;
+	header = GenerationChunkGetHeader(chunk);
+	header->context = context;
+	header->size = chunk_size;
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	header->requested_size = size;
+	/* set mark to catch clobber of "unused" space */
+	if (size < chunk_size)
+		((char *) GenerationChunkGetPointer(chunk))[size] = 0x7E;
+#endif
+
+	return GenerationChunkGetPointer(chunk);
+}
+
+/*
+ * GenerationFree
+ *		Update number of chunks freed in the block, and free the whole block
+ *		if that was the last live chunk in it.
+ */
+static void
+GenerationFree(MemoryContext context, void *pointer)
+{
+	Generation	set = (Generation) context;
+	char	   *chunk = GenerationPointerGetChunk(pointer);
+	GenerationBlock *block = GenerationChunkGetBlock(chunk);
+	StandardChunkHeader *header = GenerationChunkGetHeader(chunk);
+
+	AssertArg(GenerationIsValid(set));
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Test for someone scribbling on unused space in chunk */
+	if (header->requested_size < header->size)
+		if (((char *) pointer)[header->requested_size] != 0x7E)
+			elog(WARNING, "detected write past chunk end in %s %p",
+				 set->header.name, chunk);
+#endif
+
+#ifdef CLOBBER_FREED_MEMORY
+	/* Wipe freed memory for debugging purposes */
+	memset(pointer, 0x7F, header->size);
+#endif
+
+	block->nfree++;
+	Assert(block->nfree <= block->nchunks);
+
+	if (block->nfree < block->nchunks)
+		return;
+
+	/*
+	 * Everything in the block has been freed.  If it's the block we're
+	 * allocating from, just start over at its beginning; otherwise give it
+	 * back to malloc().
+	 */
+	if (block == set->block)
+	{
+		block->nchunks = 0;
+		block->nfree = 0;
+		block->freeptr = ((char *) block) + GENERATION_BLOCKHDRSZ;
+	}
+	else
+		GenerationFreeBlock(set, block);
+}
+
+/*
+ * GenerationRealloc
+ *		Returns new pointer to allocated memory of given size; this memory
+ *		is added to the set.  Memory associated with given pointer is copied
+ *		into the new memory, and the old memory is freed.
+ */
+static void *
+GenerationRealloc(MemoryContext context, void *pointer, Size size)
+{
+	Generation	set = (Generation) context;
+	StandardChunkHeader *header;
+	Size		oldsize;
+	void	   *newPointer;
+
+	AssertArg(GenerationIsValid(set));
+
+	header = GenerationChunkGetHeader(GenerationPointerGetChunk(pointer));
+	oldsize = header->size;
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Test for someone scribbling on unused space in chunk */
+	if (header->requested_size < oldsize)
+		if (((char *) pointer)[header->requested_size] != 0x7E)
+			elog(WARNING, "detected write past chunk end in %s %p",
+				 set->header.name, header);
+#endif
+
+	/*
+	 * Chunk sizes are aligned to power of 2 in aset.c, so there's often
+	 * slack space to grow into there.  Here chunks are only MAXALIGN'd, so
+	 * the old chunk can be reused only if the new size is no larger.
+	 */
+	if (oldsize >= size)
+	{
+#ifdef MEMORY_CONTEXT_CHECKING
+		header->requested_size = size;
+		/* set mark to catch clobber of "unused" space */
+		if (size < oldsize)
+			((char *) pointer)[size] = 0x7E;
+#endif
+		return pointer;
+	}
+
+	/* Normal case: allocate a new chunk, copy the data, free the old one */
+	newPointer = GenerationAlloc(context, size);
+	memcpy(newPointer, pointer, oldsize);
+	GenerationFree(context, pointer);
+
+	return newPointer;
+}
+
+/*
+ * GenerationGetChunkSpace
+ *		Given a currently-allocated chunk, determine the total space
+ *		it occupies (including all memory-allocation overhead).
+ */
+static Size
+GenerationGetChunkSpace(MemoryContext context, void *pointer)
+{
+	StandardChunkHeader *header;
+
+	header = GenerationChunkGetHeader(GenerationPointerGetChunk(pointer));
+
+	return header->size + GENERATION_CHUNKHDRSZ;
+}
+
+/*
+ * GenerationIsEmpty
+ *		Is a Generation context empty of any allocated space?
+ */
+static bool
+GenerationIsEmpty(MemoryContext context)
+{
+	Generation	set = (Generation) context;
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &set->blocks)
+	{
+		GenerationBlock *block = dlist_container(GenerationBlock, node,
+												 iter.cur);
+
+		if (block->nchunks > 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * GenerationStats
+ *		Displays stats about memory consumption of a Generation context.
+ */
+static void
+GenerationStats(MemoryContext context, int level)
+{
+	Generation	set = (Generation) context;
+	long		nblocks = 0;
+	long		nchunks = 0;
+	long		nfreechunks = 0;
+	long		totalspace = 0;
+	long		freespace = 0;
+	dlist_iter	iter;
+	int			i;
+
+	dlist_foreach(iter, &set->blocks)
+	{
+		GenerationBlock *block = dlist_container(GenerationBlock, node,
+												 iter.cur);
+
+		nblocks++;
+		nchunks += block->nchunks;
+		nfreechunks += block->nfree;
+		totalspace += block->endptr - ((char *) block);
+		freespace += block->endptr - block->freeptr;
+	}
+
+	for (i = 0; i < level; i++)
+		fprintf(stderr, "  ");
+
+	fprintf(stderr,
+			"%s: %lu total in %ld blocks; %lu free (%ld of %ld chunks freed); %lu used\n",
+			set->header.name, totalspace, nblocks, freespace, nfreechunks,
+			nchunks, totalspace - freespace);
+}
+
+/*
+ * GenerationFreeBlock
+ *		Unlink a block from the context and give it back to malloc().
+ */
+static void
+GenerationFreeBlock(Generation set, GenerationBlock *block)
+{
+	Size		blksize = block->endptr - ((char *) block);
+
+	dlist_delete(&block->node);
+	MemoryContextNoteFree(&set->header, blksize);
+#ifdef CLOBBER_FREED_MEMORY
+	/* Wipe freed memory for debugging purposes */
+	memset(block, 0x7F, blksize);
+#endif
+	free(block);
+}
+
+
+#ifdef MEMORY_CONTEXT_CHECKING
+
+/*
+ * GenerationCheck
+ *		Walk through chunks and check consistency of memory.
+ *
+ * Freed chunks aren't marked in any way, so unlike AllocSetCheck we check
+ * every chunk in a block, live or not; pfree() doesn't disturb the headers
+ * or the sentinel byte unless CLOBBER_FREED_MEMORY is defined.
+ *
+ * NOTE: report errors as WARNING, *not* ERROR or FATAL.  Otherwise you'll
+ * find yourself in an infinite loop when trouble occurs, because this
+ * routine will be entered again when elog cleanup tries to release memory!
+ */
+static void
+GenerationCheck(MemoryContext context)
+{
+	Generation	set = (Generation) context;
+	char	   *name = set->header.name;
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &set->blocks)
+	{
+		GenerationBlock *block = dlist_container(GenerationBlock, node,
+												 iter.cur);
+
+		if (block->nfree > block->nchunks)
+			elog(WARNING, "problem in Generation %s: block %p has %d chunks but %d are freed",
+				 name, block, block->nchunks, block->nfree);
+
+		if (block->freeptr > block->endptr)
+			elog(WARNING, "problem in Generation %s: free pointer past end of block %p",
+				 name, block);
+
+#ifndef CLOBBER_FREED_MEMORY
+		{
+			char	   *bpoz = ((char *) block) + GENERATION_BLOCKHDRSZ;
+			int			nchunks = 0;
+
+			while (bpoz < block->freeptr)
+			{
+				StandardChunkHeader *header = GenerationChunkGetHeader(bpoz);
+
+				if (GenerationChunkGetBlock(bpoz) != block)
+					elog(WARNING, "problem in Generation %s: bogus block link in block %p, chunk %p",
+						 name, block, bpoz);
+
+				if (header->context != context)
+					elog(WARNING, "problem in Generation %s: bogus context link in block %p, chunk %p",
+						 name, block, bpoz);
+
+				if (header->requested_size > header->size)
+					elog(WARNING, "problem in Generation %s: req size > alloc size for chunk %p in block %p",
+						 name, bpoz, block);
+
+				if (header->requested_size < header->size &&
+					((char *) GenerationChunkGetPointer(bpoz))[header->requested_size] != 0x7E)
+					elog(WARNING, "problem in Generation %s: detected write past chunk end in block %p, chunk %p",
+						 name, block, bpoz);
+
+				nchunks++;
+				bpoz += GENERATION_CHUNKHDRSZ + header->size;
+			}
+
+			if (nchunks != block->nchunks)
+				elog(WARNING, "problem in Generation %s: found %d chunks in block %p, expected %d",
+					 name, nchunks, block, block->nchunks);
+		}
+#endif
+	}
+}
+
+#endif   /* MEMORY_CONTEXT_CHECKING */
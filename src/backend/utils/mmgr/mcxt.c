@@ -52,6 +52,10 @@ MemoryContext CurTransactionContext = NULL;
 /* This is a transient link to the active portal's memory context: */
 MemoryContext PortalContext = NULL;
 
+/* Backend-wide memory accounting; see memutils.h */
+static BackendMemoryUsage LocalMemoryUsage;
+BackendMemoryUsage *MyMemoryUsage = &LocalMemoryUsage;
+
 static void MemoryContextStatsInternal(MemoryContext context, int level);
 
 
@@ -380,6 +384,62 @@ MemoryContextIsEmpty(MemoryContext context)
 	return (*context->methods->is_empty) (context);
 }
 
+/*
+ * MemoryContextMemAllocated
+ *		Return the amount of memory obtained from malloc() by the context,
+ *		and by all its descendants if recurse is true.
+ *
+ * This is cheap for a single context, but with recurse it has to visit
+ * every descendant.
+ */
+Size
+MemoryContextMemAllocated(MemoryContext context, bool recurse)
+{
+	Size		total = context->mem_allocated;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	if (recurse)
+	{
+		MemoryContext child;
+
+		for (child = context->firstchild;
+			 child != NULL;
+			 child = child->nextchild)
+			total += MemoryContextMemAllocated(child, true);
+	}
+
+	return total;
+}
+
+/*
+ * MemoryContextSetUsageStorage
+ *		Account backend-wide memory usage in *usage from now on.
+ *
+ * The current totals are carried over.  This is used by pgstat.c to publish
+ * our memory usage in our backend status entry.
+ */
+void
+MemoryContextSetUsageStorage(BackendMemoryUsage *usage)
+{
+	*usage = *MyMemoryUsage;
+	MyMemoryUsage = usage;
+}
+
+/*
+ * MemoryContextResetUsageStorage
+ *		Go back to accounting backend-wide memory usage in local storage.
+ *
+ * Must be called before the storage passed to MemoryContextSetUsageStorage
+ * goes away.
+ */
+void
+MemoryContextResetUsageStorage(void)
+{
+	LocalMemoryUsage = *MyMemoryUsage;
+	MyMemoryUsage = &LocalMemoryUsage;
+}
+
 /*
  * MemoryContextStats
  *		Print statistics about the named context and all its descendants.
@@ -544,6 +604,7 @@ MemoryContextCreate(NodeTag tag, Size size,
 	node->firstchild = NULL;
 	node->nextchild = NULL;
 	node->isReset = true;
+	node->mem_allocated = 0;
 	node->name = ((char *) node) + size;
 	strcpy(node->name, name);
 
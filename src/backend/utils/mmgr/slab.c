@@ -0,0 +1,573 @@
+/*-------------------------------------------------------------------------
+ *
+ * slab.c
+ *	  Slab allocator definitions.
+ *
+ * Slab is a MemoryContext implementation for contexts in which all chunks
+ * have the same size, fixed when the context is created.  That's a common
+ * pattern (hash table entries, skew buckets and the like), and one that
+ * aset.c handles rather badly: it rounds every request up to a power of 2,
+ * which can waste nearly half the memory, and it never gives memory back
+ * to malloc() until the whole context is reset.
+ *
+ * Memory is obtained from malloc() in blocks of blockSize bytes, each of
+ * which is carved into as many chunks as fit.  Freed chunks go on a per-block
+ * free list, and a block whose chunks have all been freed is handed back to
+ * malloc() right away.  To give blocks the best chance of becoming empty, new
+ * chunks are taken from the fullest block that has any free space left: the
+ * context keeps its blocks in lists by number of free chunks for that.
+ *
+ * Requests of any other size than the one the context was created for are
+ * rejected, and so is repalloc() to a different size.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/mmgr/slab.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "lib/ilist.h"
+#include "utils/memutils.h"
+
+
+/*
+ * SlabBlock
+ *		A SlabBlock is the unit of memory that is obtained by slab.c from
+ *		malloc().  Its chunks follow the header, at the next alignment
+ *		boundary.
+ */
+typedef struct SlabBlock
+{
+	dlist_node	node;			/* link in slab's freelist[nfree] */
+	int			nfree;			/* number of free chunks in this block */
+	char	   *firstfree;		/* first free chunk, or NULL */
+} SlabBlock;
+
+/*
+ * SlabContext is a specialized implementation of MemoryContext.
+ */
+typedef struct SlabContext
+{
+	MemoryContextData header;	/* Standard memory-context fields */
+	/* Allocation parameters for this context: */
+	Size		chunkSize;		/* chunk size requested by caller */
+	Size		fullChunkSize;	/* chunk size, including header */
+	Size		blockSize;		/* block size */
+	int			chunksPerBlock; /* number of chunks per block */
+	/* Info about storage allocated in this context: */
+	int			nblocks;		/* number of blocks allocated */
+	int			minFreeChunks;	/* least nfree of any block with free chunks,
+								 * or 0 if there are none */
+	/* blocks with exactly i free chunks are in freelist[i] */
+	dlist_head	freelist[1];	/* VARIABLE LENGTH ARRAY */
+} SlabContext;
+
+typedef SlabContext *Slab;
+
+/*
+ * Each chunk starts with a pointer to its block, followed by the standard
+ * chunk header that mcxt.c expects to find right before the chunk's data
+ * (see StandardChunkHeader in memutils.h).  While a chunk is free, the first
+ * bytes of its data hold the free-list link.
+ */
+#define SLAB_BLOCKHDRSZ		MAXALIGN(sizeof(SlabBlock))
+#define SLAB_BLOCKLINKSZ	MAXALIGN(sizeof(SlabBlock *))
+#define SLAB_CHUNKHDRSZ		(SLAB_BLOCKLINKSZ + STANDARDCHUNKHEADERSIZE)
+
+#define SlabIsValid(set) PointerIsValid(set)
+
+#define SlabBlockGetChunk(slab, block, idx) \
+	(((char *) (block)) + SLAB_BLOCKHDRSZ + (idx) * (slab)->fullChunkSize)
+#define SlabChunkGetBlock(chk) \
+	(*(SlabBlock **) (chk))
+#define SlabChunkGetHeader(chk) \
+	((StandardChunkHeader *) (((char *) (chk)) + SLAB_BLOCKLINKSZ))
+#define SlabChunkGetPointer(chk) \
+	((void *) (((char *) (chk)) + SLAB_CHUNKHDRSZ))
+#define SlabPointerGetChunk(ptr) \
+	(((char *) (ptr)) - SLAB_CHUNKHDRSZ)
+#define SlabChunkNextFree(chk) \
+	(*(char **) SlabChunkGetPointer(chk))
+
+/*
+ * These functions implement the MemoryContext API for Slab contexts.
+ */
+static void *SlabAlloc(MemoryContext context, Size size);
+static void SlabFree(MemoryContext context, void *pointer);
+static void *SlabRealloc(MemoryContext context, void *pointer, Size size);
+static void SlabInit(MemoryContext context);
+static void SlabReset(MemoryContext context);
+static void SlabDelete(MemoryContext context);
+static Size SlabGetChunkSpace(MemoryContext context, void *pointer);
+static bool SlabIsEmpty(MemoryContext context);
+static void SlabStats(MemoryContext context, int level);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+static void SlabCheck(MemoryContext context);
+#endif
+
+static int	SlabMinFreeChunks(Slab slab);
+
+/*
+ * This is the virtual function table for Slab contexts.
+ */
+static MemoryContextMethods SlabMethods = {
+	SlabAlloc,
+	SlabFree,
+	SlabRealloc,
+	SlabInit,
+	SlabReset,
+	SlabDelete,
+	SlabGetChunkSpace,
+	SlabIsEmpty,
+	SlabStats
+#ifdef MEMORY_CONTEXT_CHECKING
+	,SlabCheck
+#endif
+};
+
+
+/*
+ * Public routines
+ */
+
+
+/*
+ * SlabContextCreate
+ *		Create a new Slab context.
+ *
+ * parent: parent context, or NULL if top-level context
+ * name: name of context (for debugging --- string will be copied)
+ * blockSize: allocation block size
+ * chunkSize: allocation chunk size
+ */
+MemoryContext
+SlabContextCreate(MemoryContext parent,
+				  const char *name,
+				  Size blockSize,
+				  Size chunkSize)
+{
+	Slab		slab;
+	Size		fullChunkSize;
+	int			chunksPerBlock;
+	int			i;
+
+	/* the data area must be able to hold the free-list link, too */
+	fullChunkSize = SLAB_CHUNKHDRSZ + MAXALIGN(Max(chunkSize, sizeof(char *)));
+
+	if (blockSize < SLAB_BLOCKHDRSZ + fullChunkSize ||
+		blockSize - SLAB_BLOCKHDRSZ > INT_MAX)
+		elog(ERROR, "block size %lu for slab context \"%s\" is unsuitable for %lu-byte chunks",
+			 (unsigned long) blockSize, name, (unsigned long) chunkSize);
+	chunksPerBlock = (blockSize - SLAB_BLOCKHDRSZ) / fullChunkSize;
+
+	/* Do the type-independent part of context creation */
+	slab = (Slab) MemoryContextCreate(T_SlabContext,
+									  offsetof(SlabContext, freelist) +
+									  (chunksPerBlock + 1) * sizeof(dlist_head),
+									  &SlabMethods,
+									  parent,
+									  name);
+
+	slab->chunkSize = chunkSize;
+	slab->fullChunkSize = fullChunkSize;
+	slab->blockSize = blockSize;
+	slab->chunksPerBlock = chunksPerBlock;
+	slab->nblocks = 0;
+	slab->minFreeChunks = 0;
+	for (i = 0; i <= chunksPerBlock; i++)
+		dlist_init(&slab->freelist[i]);
+
+	return (MemoryContext) slab;
+}
+
+/*
+ * SlabInit
+ *		Context-type-specific initialization routine.
+ */
+static void
+SlabInit(MemoryContext context)
+{
+	/*
+	 * Since MemoryContextCreate already zeroed the context node, we don't
+	 * have to do anything here: SlabContextCreate fills in the rest.
+	 */
+}
+
+/*
+ * SlabReset
+ *		Frees all memory which is allocated in the given slab.
+ */
+static void
+SlabReset(MemoryContext context)
+{
+	Slab		slab = (Slab) context;
+	int			i;
+
+	AssertArg(SlabIsValid(slab));
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Check for corruption and leaks before freeing */
+	SlabCheck(context);
+#endif
+
+	for (i = 0; i <= slab->chunksPerBlock; i++)
+	{
+		dlist_mutable_iter miter;
+
+		dlist_foreach_modify(miter, &slab->freelist[i])
+		{
+			SlabBlock  *block = dlist_container(SlabBlock, node, miter.cur);
+
+			dlist_delete(miter.cur);
+			MemoryContextNoteFree(&slab->header, slab->blockSize);
+#ifdef CLOBBER_FREED_MEMORY
+			/* Wipe freed memory for debugging purposes */
+			memset(block, 0x7F, slab->blockSize);
+#endif
+			free(block);
+		}
+	}
+
+	slab->nblocks = 0;
+	slab->minFreeChunks = 0;
+}
+
+/*
+ * SlabDelete
+ *		Frees all memory which is allocated in the given slab, in preparation
+ *		for deletion of the slab.  We simply call SlabReset().
+ */
+static void
+SlabDelete(MemoryContext context)
+{
+	SlabReset(context);
+}
+
+/*
+ * SlabAlloc
+ *		Returns pointer to allocated memory of given size; memory is added
+ *		to the slab.
+ */
+static void *
+SlabAlloc(MemoryContext context, Size size)
+{
+	Slab		slab = (Slab) context;
+	SlabBlock  *block;
+	char	   *chunk;
+
+	AssertArg(SlabIsValid(slab));
+
+	if (size != slab->chunkSize)
+		elog(ERROR, "unexpected alloc chunk size %lu in slab context \"%s\" (expected %lu)",
+			 (unsigned long) size, slab->header.name,
+			 (unsigned long) slab->chunkSize);
+
+	/*
+	 * If there's no block with free space, make a new one, and put all its
+	 * chunks on its free list, in address order.
+	 */
+	if (slab->minFreeChunks == 0)
+	{
+		int			i;
+
+		block = (SlabBlock *) malloc(slab->blockSize);
+		if (block == NULL)
+		{
+			MemoryContextStats(TopMemoryContext);
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory"),
+					 errdetail("Failed on request of size %lu.",
+							   (unsigned long) size)));
+		}
+		MemoryContextNoteAlloc(&slab->header, slab->blockSize);
+
+		block->firstfree = NULL;
+		for (i = slab->chunksPerBlock - 1; i >= 0; i--)
+		{
+			StandardChunkHeader *header;
+
+			chunk = SlabBlockGetChunk(slab, block, i);
+			SlabChunkGetBlock(chunk) = block;
+			header = SlabChunkGetHeader(chunk);
+			header->context = context;
+			header->size = slab->fullChunkSize - SLAB_CHUNKHDRSZ;
+#ifdef MEMORY_CONTEXT_CHECKING
+			header->requested_size = 0; /* free */
+#endif
+			SlabChunkNextFree(chunk) = block->firstfree;
+			block->firstfree = chunk;
+		}
+		block->nfree = slab->chunksPerBlock;
+		dlist_push_head(&slab->freelist[block->nfree], &block->node);
+
+		slab->nblocks++;
+		slab->minFreeChunks = block->nfree;
+	}
+
+	/* Take the first free chunk of the fullest block that has one */
+	block = dlist_head_element(SlabBlock, node,
+							   &slab->freelist[slab->minFreeChunks]);
+	Assert(block->nfree == slab->minFreeChunks);
+
+	chunk = block->firstfree;
+	Assert(chunk != NULL && SlabChunkGetBlock(chunk) == block);
+	block->firstfree = SlabChunkNextFree(chunk);
+
+	/* The block now belongs on the list for one fewer free chunk */
+	dlist_delete(&block->node);
+	block->nfree--;
+	dlist_push_head(&slab->freelist[block->nfree], &block->node);
+
+	if (block->nfree > 0)
+		slab->minFreeChunks = block->nfree;
+	else if (dlist_is_empty(&slab->freelist[slab->minFreeChunks]))
+		slab->minFreeChunks = SlabMinFreeChunks(slab);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	SlabChunkGetHeader(chunk)->requested_size = size;
+	/* set mark to catch clobber of "unused" space */
+	if (size < SlabChunkGetHeader(chunk)->size)
+		((char *) SlabChunkGetPointer(chunk))[size] = 0x7E;
+#endif
+
+	return SlabChunkGetPointer(chunk);
+}
+
+/*
+ * SlabFree
+ *		Frees allocated memory; memory is removed from the slab.
+ */
+static void
+SlabFree(MemoryContext context, void *pointer)
+{
+	Slab		slab = (Slab) context;
+	char	   *chunk = SlabPointerGetChunk(pointer);
+	SlabBlock  *block = SlabChunkGetBlock(chunk);
+	int			oldnfree;
+
+	AssertArg(SlabIsValid(slab));
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Test for someone scribbling on unused space in chunk */
+	if (slab->chunkSize < SlabChunkGetHeader(chunk)->size)
+		if (((char *) pointer)[slab->chunkSize] != 0x7E)
+			elog(WARNING, "detected write past chunk end in %s %p",
+				 slab->header.name, chunk);
+	/* Reset requested_size to 0 in chunks that are on freelist */
+	SlabChunkGetHeader(chunk)->requested_size = 0;
+#endif
+
+#ifdef CLOBBER_FREED_MEMORY
+	/* Wipe freed memory for debugging purposes */
+	memset(pointer, 0x7F, SlabChunkGetHeader(chunk)->size);
+#endif
+
+	SlabChunkNextFree(chunk) = block->firstfree;
+	block->firstfree = chunk;
+
+	oldnfree = block->nfree++;
+	dlist_delete(&block->node);
+
+	if (block->nfree == slab->chunksPerBlock)
+	{
+		/* the block is empty, so give it back */
+		slab->nblocks--;
+		MemoryContextNoteFree(&slab->header, slab->blockSize);
+#ifdef CLOBBER_FREED_MEMORY
+		memset(block, 0x7F, slab->blockSize);
+#endif
+		free(block);
+		block = NULL;
+	}
+	else
+		dlist_push_head(&slab->freelist[block->nfree], &block->node);
+
+	if (block != NULL &&
+		(slab->minFreeChunks == 0 || block->nfree < slab->minFreeChunks))
+		slab->minFreeChunks = block->nfree;
+	else if (oldnfree == slab->minFreeChunks &&
+			 dlist_is_empty(&slab->freelist[oldnfree]))
+		slab->minFreeChunks = SlabMinFreeChunks(slab);
+}
+
+/*
+ * SlabRealloc
+ *		Since all chunks have the same size, the only realloc we can do is a
+ *		no-op one.
+ */
+static void *
+SlabRealloc(MemoryContext context, void *pointer, Size size)
+{
+	Slab		slab = (Slab) context;
+
+	AssertArg(SlabIsValid(slab));
+
+	if (size != slab->chunkSize)
+		elog(ERROR, "unexpected realloc chunk size %lu in slab context \"%s\" (expected %lu)",
+			 (unsigned long) size, slab->header.name,
+			 (unsigned long) slab->chunkSize);
+
+	return pointer;
+}
+
+/*
+ * SlabGetChunkSpace
+ *		Given a currently-allocated chunk, determine the total space
+ *		it occupies (including all memory-allocation overhead).
+ */
+static Size
+SlabGetChunkSpace(MemoryContext context, void *pointer)
+{
+	Slab		slab = (Slab) context;
+
+	return slab->fullChunkSize;
+}
+
+/*
+ * SlabIsEmpty
+ *		Is a slab empty of any allocated space?
+ */
+static bool
+SlabIsEmpty(MemoryContext context)
+{
+	Slab		slab = (Slab) context;
+
+	/* blocks are freed as soon as their last chunk is */
+	return slab->nblocks == 0;
+}
+
+/*
+ * SlabStats
+ *		Displays stats about memory consumption of a slab.
+ */
+static void
+SlabStats(MemoryContext context, int level)
+{
+	Slab		slab = (Slab) context;
+	long		nfreechunks = 0;
+	long		totalspace;
+	long		freespace;
+	int			i;
+
+	for (i = 1; i <= slab->chunksPerBlock; i++)
+	{
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &slab->freelist[i])
+			nfreechunks += i;
+	}
+
+	totalspace = (long) slab->nblocks * slab->blockSize;
+	freespace = totalspace -
+		((long) slab->nblocks * slab->chunksPerBlock - nfreechunks) *
+		slab->fullChunkSize;
+
+	for (i = 0; i < level; i++)
+		fprintf(stderr, "  ");
+
+	fprintf(stderr,
+			"%s: %lu total in %d blocks; %lu free (%ld chunks); %lu used\n",
+			slab->header.name, totalspace, slab->nblocks, freespace,
+			nfreechunks, totalspace - freespace);
+}
+
+/*
+ * SlabMinFreeChunks
+ *		Find the least number of free chunks of any block that has some.
+ */
+static int
+SlabMinFreeChunks(Slab slab)
+{
+	int			i;
+
+	for (i = 1; i <= slab->chunksPerBlock; i++)
+	{
+		if (!dlist_is_empty(&slab->freelist[i]))
+			return i;
+	}
+
+	return 0;
+}
+
+
+#ifdef MEMORY_CONTEXT_CHECKING
+
+/*
+ * SlabCheck
+ *		Walk through chunks and check consistency of memory.
+ *
+ * NOTE: report errors as WARNING, *not* ERROR or FATAL.  Otherwise you'll
+ * find yourself in an infinite loop when trouble occurs, because this
+ * routine will be entered again when elog cleanup tries to release memory!
+ */
+static void
+SlabCheck(MemoryContext context)
+{
+	Slab		slab = (Slab) context;
+	char	   *name = slab->header.name;
+	int			nblocks = 0;
+	int			i;
+
+	for (i = 0; i <= slab->chunksPerBlock; i++)
+	{
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &slab->freelist[i])
+		{
+			SlabBlock  *block = dlist_container(SlabBlock, node, iter.cur);
+			int			nfree = 0;
+			int			j;
+
+			nblocks++;
+
+			if (block->nfree != i)
+				elog(WARNING, "problem in slab %s: block %p is on free list %d but has %d free chunks",
+					 name, block, i, block->nfree);
+
+			for (j = 0; j < slab->chunksPerBlock; j++)
+			{
+				char	   *chunk = SlabBlockGetChunk(slab, block, j);
+				StandardChunkHeader *header = SlabChunkGetHeader(chunk);
+
+				if (SlabChunkGetBlock(chunk) != block)
+					elog(WARNING, "problem in slab %s: bogus block link in block %p, chunk %p",
+						 name, block, chunk);
+
+				if (header->requested_size == 0)
+				{
+					nfree++;
+					continue;
+				}
+
+				if (header->context != context)
+					elog(WARNING, "problem in slab %s: bogus context link in block %p, chunk %p",
+						 name, block, chunk);
+
+				if (header->requested_size < header->size &&
+					((char *) SlabChunkGetPointer(chunk))[header->requested_size] != 0x7E)
+					elog(WARNING, "problem in slab %s: detected write past chunk end in block %p, chunk %p",
+						 name, block, chunk);
+			}
+
+			if (nfree != block->nfree)
+				elog(WARNING, "problem in slab %s: block %p has %d free chunks, but %d are marked free",
+					 name, block, block->nfree, nfree);
+		}
+	}
+
+	if (nblocks != slab->nblocks)
+		elog(WARNING, "problem in slab %s: found %d blocks, expected %d",
+			 name, nblocks, slab->nblocks);
+}
+
+#endif   /* MEMORY_CONTEXT_CHECKING */
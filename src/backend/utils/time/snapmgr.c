@@ -266,6 +266,13 @@ SetTransactionSnapshot(Snapshot sourcesnap, TransactionId sourcexid)
 	CurrentSnapshot->takenDuringRecovery = sourcesnap->takenDuringRecovery;
 	/* NB: curcid should NOT be copied, it's a local matter */
 
+	/* the contents no longer match what GetSnapshotData computed */
+	CurrentSnapshot->snapXactCompletionCount = 0;
+#ifdef USE_CSN_SNAPSHOTS
+	/* an imported snapshot is interpreted using its xip arrays */
+	CurrentSnapshot->snapshotcsn = InvalidCommitSeqNo;
+#endif
+
 	/*
 	 * Now we have to fix what GetSnapshotData did with MyPgXact->xmin and
 	 * TransactionXmin.  There is a race condition: to make sure we are not
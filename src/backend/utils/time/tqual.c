@@ -58,6 +58,7 @@
 #include "postgres.h"
 
 #include "access/htup_details.h"
+#include "access/csnlog.h"
 #include "access/multixact.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
@@ -1588,6 +1589,38 @@ XidInMVCCSnapshot(TransactionId xid, Snapshot snapshot)
 	if (TransactionIdFollowsOrEquals(xid, snapshot->xmax))
 		return true;
 
+#ifdef USE_CSN_SNAPSHOTS
+
+	/*
+	 * If the snapshot has a commit sequence number, the xid was running as
+	 * of the snapshot unless it has committed with an older CSN.  That holds
+	 * for subxacts too, once their parent's CSN has been copied to them;
+	 * until then, they point us to the parent through pg_subtrans.
+	 */
+	if (snapshot->snapshotcsn != InvalidCommitSeqNo)
+	{
+		CommitSeqNo csn = CSNLogGetCommitSeqNo(xid);
+
+		if (csn == CommitSeqNoSubTrans)
+		{
+			xid = SubTransGetTopmostTransaction(xid);
+
+			/* as below, a parent < xmin is surely not in-progress */
+			if (TransactionIdPrecedes(xid, snapshot->xmin))
+				return false;
+			csn = CSNLogGetCommitSeqNo(xid);
+		}
+
+		/* CommitSeqNoFrozen means it committed before the last restart */
+		if (csn == CommitSeqNoFrozen)
+			return false;
+		if (CommitSeqNoIsNormal(csn) &&
+			NormalCommitSeqNoPrecedes(csn, snapshot->snapshotcsn))
+			return false;
+		return true;
+	}
+#endif
+
 	/*
 	 * Snapshot information is stored slightly differently in snapshots taken
 	 * during recovery.
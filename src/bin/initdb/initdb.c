@@ -186,6 +186,9 @@ const char *subdirs[] = {
 	"pg_serial",
 	"pg_snapshots",
 	"pg_subtrans",
+#ifdef USE_CSN_SNAPSHOTS
+	"pg_csnlog",
+#endif
 	"pg_twophase",
 	"pg_multixact/members",
 	"pg_multixact/offsets",
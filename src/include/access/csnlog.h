@@ -0,0 +1,36 @@
+/*
+ * csnlog.h
+ *
+ * Commit sequence number log manager
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/csnlog.h
+ */
+#ifndef CSNLOG_H
+#define CSNLOG_H
+
+#ifdef USE_CSN_SNAPSHOTS
+
+/* GUC variable: number of SLRU buffers to use for the CSN log */
+extern int	csnlog_buffers;
+
+extern void CSNLogPrepareCommitSeqNo(TransactionId xid);
+extern void CSNLogAssignCommitSeqNo(TransactionId xid);
+extern void CSNLogSetCommitSeqNo(TransactionId xid, CommitSeqNo csn);
+extern void CSNLogSetCommitSeqNoTree(int nsubxids, TransactionId *subxids,
+						 CommitSeqNo csn);
+extern CommitSeqNo CSNLogGetCommitSeqNo(TransactionId xid);
+
+extern Size CSNLOGShmemSize(void);
+extern void CSNLOGShmemInit(void);
+extern void StartupCSNLOG(TransactionId oldestActiveXID);
+extern void ShutdownCSNLOG(void);
+extern void CheckPointCSNLOG(void);
+extern void ExtendCSNLOG(TransactionId newestXact);
+extern void TruncateCSNLOG(TransactionId oldestXact);
+
+#endif   /* USE_CSN_SNAPSHOTS */
+
+#endif   /* CSNLOG_H */
@@ -145,6 +145,7 @@ extern HTSU_Result heap_lock_tuple(Relation relation, HeapTuple tuple,
 				CommandId cid, LockTupleMode mode, bool nowait,
 				bool follow_update,
 				Buffer *buffer, HeapUpdateFailureData *hufd);
+extern void heap_release_carried_tuple_lock(void);
 extern void heap_inplace_update(Relation relation, HeapTuple tuple);
 extern bool heap_freeze_tuple(HeapTupleHeader tuple, TransactionId cutoff_xid,
 				  TransactionId cutoff_multi);
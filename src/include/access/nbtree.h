@@ -523,6 +523,17 @@ typedef struct BTScanPosData
 	int			lastItem;		/* last valid index in items[] */
 	int			itemIndex;		/* current index in items[] */
 
+	/*
+	 * Heap prefetching state, used if the scan's xs_heap_prefetch is set (see
+	 * _bt_prefetch_heap).  prefetchItem is the next entry in items[] whose
+	 * heap block may need prefetching, and prefetchPages is how many heap
+	 * blocks we have prefetched ahead of the one last returned to the caller.
+	 */
+	int			prefetchItem;	/* next index in items[] to prefetch */
+	int			prefetchPages;	/* # of heap blocks prefetched ahead */
+	BlockNumber prefetchBlock;	/* heap block last prefetched */
+	BlockNumber heapBlock;		/* heap block of item last returned */
+
 	BTScanPosItem items[MaxIndexTuplesPerPage]; /* MUST BE LAST */
 } BTScanPosData;
 
@@ -575,6 +586,9 @@ typedef struct BTScanOpaqueData
 	 */
 	int			markItemIndex;	/* itemIndex, or -1 if not valid */
 
+	/* current heap prefetch distance, ramped up to target_prefetch_pages */
+	int			prefetchTarget;
+
 	/* keep these last in struct for efficiency */
 	BTScanPosData currPos;		/* current position data */
 	BTScanPosData markPos;		/* marked position, if any */
@@ -655,6 +669,7 @@ extern int32 _bt_compare(Relation rel, int keysz, ScanKey scankey,
 			Page page, OffsetNumber offnum);
 extern bool _bt_first(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_next(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_prefetch_heap(IndexScanDesc scan, ScanDirection dir);
 extern Buffer _bt_get_endpoint(Relation rel, uint32 level, bool rightmost);
 
 /*
@@ -19,6 +19,7 @@
 #include "access/htup_details.h"
 #include "access/itup.h"
 #include "access/tupdesc.h"
+#include "storage/bufmgr.h"
 
 
 typedef struct HeapScanDescData
@@ -47,6 +48,13 @@ typedef struct HeapScanDescData
 	/* NB: if rs_cbuf is not InvalidBuffer, we hold a pin on that buffer */
 	ItemPointerData rs_mctid;	/* marked scan position, if any */
 
+	/* read-ahead state for bulk-read scans (see heapgetpage) */
+	BlockNumber rs_rablock;		/* block # of next read-ahead buffer */
+	int			rs_raindex;		/* index of next read-ahead buffer */
+	int			rs_nrabufs;		/* number of read-ahead buffers left */
+	Buffer		rs_rabufs[MAX_BUFFERS_PER_READ];	/* pinned, if any */
+	BlockNumber rs_prefetchend;	/* end of blocks already prefetched */
+
 	/* these fields only used in page-at-a-time mode and for bitmap scans */
 	int			rs_cindex;		/* current tuple's index in vistuples */
 	int			rs_mindex;		/* marked tuple's saved index */
@@ -70,6 +78,8 @@ typedef struct IndexScanDescData
 	ScanKey		keyData;		/* array of index qualifier descriptors */
 	ScanKey		orderByData;	/* array of ordering op descriptors */
 	bool		xs_want_itup;	/* caller requests index tuples */
+	bool		xs_heap_prefetch;	/* caller wants AM to prefetch heap
+									 * blocks of upcoming TIDs */
 
 	/* signaling to index AM about killing index tuples */
 	bool		kill_prior_tuple;		/* last-returned tuple is dead */
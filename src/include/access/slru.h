@@ -36,6 +36,16 @@
  */
 #define SLRU_PAGES_PER_SEGMENT	32
 
+/*
+ * Number of buffer slots in each bank.  A page can only be stored in the
+ * bank its page number maps to, so this bounds the length of the linear
+ * searches in slru.c no matter how many buffers an SLRU has.
+ */
+#define SLRU_BANK_SIZE			16
+
+/* Upper limit for the *_buffers GUCs that size the individual SLRUs (1GB) */
+#define SLRU_MAX_BUFFERS		131072
+
 /*
  * Page status codes.  Note that these do not include the "dirty" bit.
  * page_dirty can be TRUE only in the VALID or WRITE_IN_PROGRESS states;
@@ -60,6 +70,13 @@ typedef struct SlruSharedData
 	/* Number of buffers managed by this SLRU structure */
 	int			num_slots;
 
+	/*
+	 * Buffers are divided into num_banks banks of bank_size slots each; the
+	 * last bank also gets any remainder
+	 */
+	int			num_banks;
+	int			bank_size;
+
 	/*
 	 * Arrays holding info for each buffer slot.  Page number is undefined
 	 * when status is EMPTY, as is page_lru_count.
@@ -117,6 +134,9 @@ typedef struct SlruCtlData
 	 */
 	bool		do_fsync;
 
+	/* Index of this SLRU in the statistics collector's SLRU counters */
+	int			stats_index;
+
 	/*
 	 * Decide which of two page numbers is "older" for truncation purposes. We
 	 * need to use comparison of TransactionIds here in order to do the right
@@ -58,6 +58,30 @@
 		(dest)--; \
 	} while ((dest) < FirstNormalTransactionId)
 
+/* ----------------
+ *		Special commit sequence numbers, see csnlog.c
+ * ----------------
+ */
+#define InvalidCommitSeqNo		((CommitSeqNo) 0)
+#define CommitSeqNoSubTrans		((CommitSeqNo) 1)
+#define CommitSeqNoFrozen		((CommitSeqNo) 2)
+#define FirstNormalCommitSeqNo	((CommitSeqNo) 3)
+
+#define CommitSeqNoIsNormal(csn)	((csn) >= FirstNormalCommitSeqNo)
+
+/* advance a CSN variable, handling wraparound correctly */
+#define CommitSeqNoAdvance(dest)	\
+	do { \
+		(dest)++; \
+		if ((dest) < FirstNormalCommitSeqNo) \
+			(dest) = FirstNormalCommitSeqNo; \
+	} while(0)
+
+/* compare two CSNs already known to be normal */
+#define NormalCommitSeqNoPrecedes(csn1, csn2) \
+	(AssertMacro(CommitSeqNoIsNormal(csn1) && CommitSeqNoIsNormal(csn2)), \
+	(int32) ((csn1) - (csn2)) < 0)
+
 /* compare two XIDs already known to be normal; this is a macro for speed */
 #define NormalTransactionIdPrecedes(id1, id2) \
 	(AssertMacro(TransactionIdIsNormal(id1) && TransactionIdIsNormal(id2)), \
@@ -123,6 +147,20 @@ typedef struct VariableCacheData
 	 */
 	TransactionId latestCompletedXid;	/* newest XID that has committed or
 										 * aborted */
+
+	/*
+	 * Number of top-level transactions with xids (i.e. which may have
+	 * modified the database) that completed in some form since the start of
+	 * the server.  GetSnapshotData() uses it to check whether a static
+	 * snapshot needs to be recomputed.  Zero (never matching any snapshot)
+	 * until the end of recovery.
+	 */
+	uint64		xactCompletionCount;
+
+#ifdef USE_CSN_SNAPSHOTS
+	CommitSeqNo nextCommitSeqNo;	/* CSN of the next transaction to commit;
+									 * protected by ProcArrayLock */
+#endif
 } VariableCacheData;
 
 typedef VariableCacheData *VariableCache;
@@ -47,7 +47,7 @@ typedef struct XLogRecord
 	RmgrId		xl_rmid;		/* resource manager for this record */
 	/* 2 bytes of padding here, initialize to zero */
 	XLogRecPtr	xl_prev;		/* ptr to previous record in log */
-	pg_crc32	xl_crc;			/* CRC for this record */
+	pg_crc32c	xl_crc;			/* CRC-32C for this record */
 
 	/* If MAXALIGN==8, there are 4 wasted bytes here */
 
@@ -189,7 +189,9 @@ extern bool XLogArchiveMode;
 extern char *XLogArchiveCommand;
 extern bool EnableHotStandby;
 extern bool fullPageWrites;
+extern bool wal_compression;
 extern bool log_checkpoints;
+extern bool adaptive_commit_delay;
 
 /* WAL levels */
 typedef enum WalLevel
@@ -289,6 +291,22 @@ extern void GetXLogReceiptTime(TimestampTz *rtime, bool *fromStream);
 extern XLogRecPtr GetXLogReplayRecPtr(TimeLineID *replayTLI);
 extern XLogRecPtr GetXLogInsertRecPtr(void);
 extern XLogRecPtr GetXLogWriteRecPtr(void);
+extern void GetXLogCompressionStats(uint64 *nblocks, uint64 *saved);
+
+/* Group commit statistics, as reported by GetXLogGroupCommitStats */
+typedef struct XLogGroupCommitStats
+{
+	uint64		flushes;		/* WAL flushes done by an XLogFlush leader */
+	uint64		requests;		/* XLogFlush calls that had to wait */
+	uint64		delays;			/* flushes delayed to gather more requests */
+	uint64		delayTime;		/* total time spent in such delays, usec */
+	double		avgFlushTime;	/* moving average of flush time, usec */
+	double		avgRequestInterval;		/* moving average of time between
+										 * requests, usec */
+	int			currentDelay;	/* adaptive delay that would be used now */
+} XLogGroupCommitStats;
+
+extern void GetXLogGroupCommitStats(XLogGroupCommitStats *stats);
 extern bool RecoveryIsPaused(void);
 extern void SetRecoveryPause(bool recoveryPause);
 extern TimestampTz GetLatestXTime(void);
@@ -31,5 +31,7 @@ extern Datum pg_is_xlog_replay_paused(PG_FUNCTION_ARGS);
 extern Datum pg_xlog_location_diff(PG_FUNCTION_ARGS);
 extern Datum pg_is_in_backup(PG_FUNCTION_ARGS);
 extern Datum pg_backup_start_time(PG_FUNCTION_ARGS);
+extern Datum pg_xlog_compression_stats(PG_FUNCTION_ARGS);
+extern Datum pg_xlog_group_commit_stats(PG_FUNCTION_ARGS);
 
 #endif   /* XLOG_FN_H */
@@ -37,6 +37,12 @@
  * XLOG record's CRC, either).  Hence, the amount of block data actually
  * present following the BkpBlock struct is BLCKSZ - hole_length bytes.
  *
+ * If wal_compression is enabled, the hole-free image may additionally be
+ * compressed with pglz.  In that case BKPBLOCK_COMPRESSED is set in flags,
+ * and the stored data is a PGLZ_Header followed by the compressed bytes,
+ * which decompress to BLCKSZ - hole_length bytes.  In either case block_len
+ * is the number of data bytes actually following the BkpBlock struct.
+ *
  * Note that we don't attempt to align either the BkpBlock struct or the
  * block's data.  So, the struct must be copied to aligned local storage
  * before use.
@@ -48,14 +54,18 @@ typedef struct BkpBlock
 	BlockNumber block;			/* block number */
 	uint16		hole_offset;	/* number of bytes before "hole" */
 	uint16		hole_length;	/* number of bytes in "hole" */
+	uint16		block_len;		/* number of data bytes following struct */
+	uint16		flags;			/* BKPBLOCK_xxx flags, see below */
 
 	/* ACTUAL BLOCK DATA FOLLOWS AT END OF STRUCT */
 } BkpBlock;
 
+#define BKPBLOCK_COMPRESSED		0x0001	/* block image is pglz-compressed */
+
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD075	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD077	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.h
+ *	  Declarations for prefetching of data blocks referenced by WAL
+ *	  during recovery.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/xlogprefetch.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPREFETCH_H
+#define XLOGPREFETCH_H
+
+#include "access/xlogdefs.h"
+
+/* GUC variable */
+extern int	recovery_prefetch_distance;
+
+typedef struct XLogPrefetcher XLogPrefetcher;
+
+extern XLogPrefetcher *XLogPrefetcherAllocate(void);
+extern void XLogPrefetcherFree(XLogPrefetcher *prefetcher);
+extern void XLogPrefetch(XLogPrefetcher *prefetcher, XLogRecPtr ReadRecPtr,
+			 XLogRecPtr EndRecPtr, TimeLineID tli);
+
+#endif   /* XLOGPREFETCH_H */
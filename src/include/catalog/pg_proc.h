@@ -2597,6 +2597,8 @@ DATA(insert OID = 1934 (  pg_stat_get_blocks_fetched	PGNSP PGUID 12 1 0 0 0 f f
 DESCR("statistics: number of blocks fetched");
 DATA(insert OID = 1935 (  pg_stat_get_blocks_hit		PGNSP PGUID 12 1 0 0 0 f f f f t f s 1 0 20 "26" _null_ _null_ _null_ _null_ pg_stat_get_blocks_hit _null_ _null_ _null_ ));
 DESCR("statistics: number of blocks found in cache");
+DATA(insert OID = 3181 (  pg_stat_get_tuple_lock_waits	PGNSP PGUID 12 1 0 0 0 f f f f t f s 1 0 20 "26" _null_ _null_ _null_ _null_ pg_stat_get_tuple_lock_waits _null_ _null_ _null_ ));
+DESCR("statistics: number of waits for row locks");
 DATA(insert OID = 2781 (  pg_stat_get_last_vacuum_time PGNSP PGUID 12 1 0 0 0 f f f f t f s 1 0 1184 "26" _null_ _null_ _null_ _null_	pg_stat_get_last_vacuum_time _null_ _null_ _null_ ));
 DESCR("statistics: last manual vacuum time for a table");
 DATA(insert OID = 2782 (  pg_stat_get_last_autovacuum_time PGNSP PGUID 12 1 0 0 0 f f f f t f s 1 0 1184 "26" _null_ _null_ _null_ _null_	pg_stat_get_last_autovacuum_time _null_ _null_ _null_ ));
@@ -2615,7 +2617,7 @@ DATA(insert OID = 3057 ( pg_stat_get_autoanalyze_count PGNSP PGUID 12 1 0 0 0 f
 DESCR("statistics: number of auto analyzes for a table");
 DATA(insert OID = 1936 (  pg_stat_get_backend_idset		PGNSP PGUID 12 1 100 0 0 f f f f t t s 0 0 23 "" _null_ _null_ _null_ _null_ pg_stat_get_backend_idset _null_ _null_ _null_ ));
 DESCR("statistics: currently active backend IDs");
-DATA(insert OID = 2022 (  pg_stat_get_activity			PGNSP PGUID 12 1 100 0 0 f f f f f t s 1 0 2249 "23" "{23,26,23,26,25,25,25,16,1184,1184,1184,1184,869,25,23}" "{i,o,o,o,o,o,o,o,o,o,o,o,o,o,o}" "{pid,datid,pid,usesysid,application_name,state,query,waiting,xact_start,query_start,backend_start,state_change,client_addr,client_hostname,client_port}" _null_ pg_stat_get_activity _null_ _null_ _null_ ));
+DATA(insert OID = 2022 (  pg_stat_get_activity			PGNSP PGUID 12 1 100 0 0 f f f f f t s 1 0 2249 "23" "{23,26,23,26,25,25,25,16,1184,1184,1184,1184,869,25,23,25,25}" "{i,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o}" "{pid,datid,pid,usesysid,application_name,state,query,waiting,xact_start,query_start,backend_start,state_change,client_addr,client_hostname,client_port,wait_event_type,wait_event}" _null_ pg_stat_get_activity _null_ _null_ _null_ ));
 DESCR("statistics: information about currently active backends");
 DATA(insert OID = 3099 (  pg_stat_get_wal_senders	PGNSP PGUID 12 1 10 0 0 f f f f f t s 0 0 2249 "" "{23,25,25,25,25,25,23,25}" "{o,o,o,o,o,o,o,o}" "{pid,state,sent_location,write_location,flush_location,replay_location,sync_priority,sync_state}" _null_ pg_stat_get_wal_senders _null_ _null_ _null_ ));
 DESCR("statistics: information about currently active replication");
@@ -2707,6 +2709,12 @@ DATA(insert OID = 3063 ( pg_stat_get_buf_fsync_backend PGNSP PGUID 12 1 0 0 0 f
 DESCR("statistics: number of backend buffer writes that did their own fsync");
 DATA(insert OID = 2859 ( pg_stat_get_buf_alloc			PGNSP PGUID 12 1 0 0 0 f f f f t f s 0 0 20 "" _null_ _null_ _null_ _null_ pg_stat_get_buf_alloc _null_ _null_ _null_ ));
 DESCR("statistics: number of buffer allocations");
+DATA(insert OID = 3178 (  pg_stat_get_slru			PGNSP PGUID 12 1 7 0 0 f f f f f t s 0 0 2249 "" "{25,20,20,20,20,20,20,20,1184}" "{o,o,o,o,o,o,o,o,o}" "{name,blks_zeroed,blks_hit,blks_read,blks_written,blks_exists,flushes,truncates,stats_reset}" _null_ pg_stat_get_slru _null_ _null_ _null_ ));
+DESCR("statistics: information about SLRU caches");
+DATA(insert OID = 3180 (  pg_stat_get_serializable		PGNSP PGUID 12 1 0 0 0 f f f f t f v 0 0 2249 "" "{20,20,20,20,20,20,20}" "{o,o,o,o,o,o,o}" "{page_promotions,relation_promotions,tuple_conflicts,page_conflicts,relation_conflicts,serialization_failures,coarse_serialization_failures}" _null_ pg_stat_get_serializable _null_ _null_ _null_ ));
+DESCR("statistics: predicate locking of serializable transactions");
+DATA(insert OID = 3182 (  pg_stat_get_backend_memory	PGNSP PGUID 12 1 100 0 0 f f f f f t s 0 0 2249 "" "{23,20,20}" "{o,o,o}" "{pid,mem_allocated,mem_peak}" _null_ pg_stat_get_backend_memory _null_ _null_ _null_ ));
+DESCR("statistics: memory allocated by each backend");
 
 DATA(insert OID = 2978 (  pg_stat_get_function_calls		PGNSP PGUID 12 1 0 0 0 f f f f t f s 1 0 20 "26" _null_ _null_ _null_ _null_ pg_stat_get_function_calls _null_ _null_ _null_ ));
 DESCR("statistics: number of function calls");
@@ -2988,6 +2996,10 @@ DATA(insert OID = 3821 ( pg_last_xlog_replay_location	PGNSP PGUID 12 1 0 0 0 f f
 DESCR("last xlog replay location");
 DATA(insert OID = 3830 ( pg_last_xact_replay_timestamp	PGNSP PGUID 12 1 0 0 0 f f f f t f v 0 0 1184 "" _null_ _null_ _null_ _null_ pg_last_xact_replay_timestamp _null_ _null_ _null_ ));
 DESCR("timestamp of last replay xact");
+DATA(insert OID = 3177 ( pg_xlog_compression_stats	PGNSP PGUID 12 1 0 0 0 f f f f t f v 0 0 2249 "" "{20,20}" "{o,o}" "{compressed_images,bytes_saved}" _null_ pg_xlog_compression_stats _null_ _null_ _null_ ));
+DESCR("statistics about compression of full-page images in WAL");
+DATA(insert OID = 3179 ( pg_xlog_group_commit_stats	PGNSP PGUID 12 1 0 0 0 f f f f t f v 0 0 2249 "" "{20,20,701,20,701,701,701,701}" "{o,o,o,o,o,o,o,o}" "{flushes,requests,avg_batch_size,delays,delay_time,avg_flush_time,avg_request_interval,current_delay}" _null_ pg_xlog_group_commit_stats _null_ _null_ _null_ ));
+DESCR("statistics about WAL group commit");
 
 DATA(insert OID = 3071 ( pg_xlog_replay_pause		PGNSP PGUID 12 1 0 0 0 f f f f t f v 0 0 2278 "" _null_ _null_ _null_ _null_ pg_xlog_replay_pause _null_ _null_ _null_ ));
 DESCR("pause xlog replay");
@@ -36,6 +36,11 @@
  * "hashCxt", while storage that is only wanted for the current batch is
  * allocated in the "batchCxt".  By resetting the batchCxt at the end of
  * each batch, we free all the per-batch storage reliably and without tedium.
+ * The batchCxt is a generation context (see utils/mmgr/generation.c): its
+ * contents all die together, except for tuple chunks that get freed when
+ * the batch is split, so there's no point paying for aset.c's power-of-2
+ * rounding.  The skew buckets, which are all the same size, live in a slab
+ * context "skewCxt" that is a child of the batchCxt.
  *
  * During first scan of inner relation, we get its tuples from executor.
  * If nbatch > 1 then tuples that don't belong in first batch get saved
@@ -54,6 +59,14 @@
  * inner batch file.  Subsequently, while reading either inner or outer batch
  * files, we might find tuples that no longer belong to the current batch;
  * if so, we just dump them out to the correct batch file.
+ *
+ * Similarly, while nbatch is still 1 we double the number of buckets
+ * whenever the average bucket load would exceed NTUP_PER_BUCKET, so that a
+ * low planner estimate doesn't leave us with long bucket chains.  Only the
+ * target ("optimal") count is tracked during the scan; the bucket array is
+ * rebuilt once the inner relation has been loaded, or when we first
+ * increase nbatch.  Since the batch number comes from the hash bits just
+ * above the bucket number, nbuckets can't change once nbatch > 1.
  * ----------------------------------------------------------------
  */
 
@@ -102,12 +115,44 @@ typedef struct HashSkewBucket
 #define SKEW_WORK_MEM_PERCENT  2
 #define SKEW_MIN_OUTER_FRACTION  0.01
 
+/*
+ * Tuples of the main hashtable are not palloc'd one at a time, but packed
+ * densely into large chunks, which are kept on a list.  That saves the
+ * per-tuple allocator overhead, and lets ExecHashIncreaseNumBatches and
+ * ExecHashIncreaseNumBuckets walk all the tuples sequentially rather than
+ * chasing bucket chains.  Tuples larger than HASH_CHUNK_THRESHOLD get a
+ * chunk of their own, so that they don't waste the rest of a regular one.
+ * (Skew tuples are still palloc'd individually, since they can be removed
+ * one bucket at a time; they are copied into chunks when their skew bucket
+ * is removed and they move to the main hashtable.)
+ */
+typedef struct HashMemoryChunkData
+{
+	int			ntuples;		/* number of tuples stored in this chunk */
+	Size		maxlen;			/* size of the chunk's data area */
+	Size		used;			/* number of data bytes already used */
+	struct HashMemoryChunkData *next;	/* next chunk in list, or NULL */
+	/* tuple data follows on a MAXALIGN boundary */
+} HashMemoryChunkData;
+
+typedef struct HashMemoryChunkData *HashMemoryChunk;
+
+#define HASH_CHUNK_SIZE			(32 * 1024L)
+#define HASH_CHUNK_HEADER_SIZE	MAXALIGN(sizeof(HashMemoryChunkData))
+#define HASH_CHUNK_THRESHOLD	(HASH_CHUNK_SIZE / 4)
+#define HASH_CHUNK_DATA(hc)		(((char *) (hc)) + HASH_CHUNK_HEADER_SIZE)
+
 
 typedef struct HashJoinTableData
 {
 	int			nbuckets;		/* # buckets in the in-memory hash table */
 	int			log2_nbuckets;	/* its log2 (nbuckets must be a power of 2) */
 
+	int			nbuckets_original;	/* # buckets when starting the first
+									 * hash */
+	int			nbuckets_optimal;	/* optimal # buckets (per batch) */
+	int			log2_nbuckets_optimal;	/* log2(nbuckets_optimal) */
+
 	/* buckets[i] is head of list of tuples in i'th in-memory bucket */
 	struct HashJoinTupleData **buckets;
 	/* buckets array is per-batch storage, as are all the tuples */
@@ -157,6 +202,10 @@ typedef struct HashJoinTableData
 
 	MemoryContext hashCxt;		/* context for whole-hash-join storage */
 	MemoryContext batchCxt;		/* context for this-batch-only storage */
+	MemoryContext skewCxt;		/* context for skew buckets, or NULL */
+
+	/* used for dense allocation of tuples (into linked chunks) */
+	HashMemoryChunk chunks;		/* one list for the whole batch */
 }	HashJoinTableData;
 
 #endif   /* HASHJOIN_H */
@@ -103,6 +103,14 @@
  */
 #define ALIGNOF_BUFFER	32
 
+/*
+ * Assumed cache line size.  This doesn't affect correctness, but is used to
+ * keep heavily contended items in shared memory (such as the predefined
+ * LWLocks) from sharing a cache line.  128 bytes allows for the adjacent-line
+ * prefetching done by many current x86 CPUs.
+ */
+#define PG_CACHE_LINE_SIZE		128
+
 /*
  * Disable UNIX sockets for certain operating systems.
  */
@@ -199,6 +207,14 @@
 #define USE_PPC_LWSYNC
 #endif
 
+/*
+ * Define this to make MVCC snapshots carry a commit sequence number, and
+ * decide visibility by looking up the CSN of each XID in pg_csnlog rather
+ * than by searching the snapshot's arrays of running XIDs.  See csnlog.c.
+ * Experimental.  Changing this requires an initdb, to create pg_csnlog.
+ */
+/* #define USE_CSN_SNAPSHOTS */
+
 /*
  *------------------------------------------------------------------------
  * The following symbols are for enabling debugging code, not for
@@ -16,6 +16,7 @@
 #include "libpq/pqcomm.h"
 #include "portability/instr_time.h"
 #include "utils/hsearch.h"
+#include "utils/memutils.h"
 #include "utils/relcache.h"
 
 
@@ -49,7 +50,8 @@ typedef enum StatMsgType
 	PGSTAT_MTYPE_FUNCPURGE,
 	PGSTAT_MTYPE_RECOVERYCONFLICT,
 	PGSTAT_MTYPE_TEMPFILE,
-	PGSTAT_MTYPE_DEADLOCK
+	PGSTAT_MTYPE_DEADLOCK,
+	PGSTAT_MTYPE_SLRU
 } StatMsgType;
 
 /* ----------
@@ -77,6 +79,10 @@ typedef int64 PgStat_Counter;
  * regardless of whether the transaction committed.  delta_live_tuples,
  * delta_dead_tuples, and changed_tuples are set depending on commit or abort.
  * Note that delta_live_tuples and delta_dead_tuples can be negative!
+ *
+ * tuple_lock_waits counts the times a backend had to sleep on the tuple
+ * lock for a row of the table; conflicts that resolve without waiting for
+ * the tuple lock itself aren't counted.
  * ----------
  */
 typedef struct PgStat_TableCounts
@@ -97,12 +103,15 @@ typedef struct PgStat_TableCounts
 
 	PgStat_Counter t_blocks_fetched;
 	PgStat_Counter t_blocks_hit;
+
+	PgStat_Counter t_tuple_lock_waits;
 } PgStat_TableCounts;
 
 /* Possible targets for resetting cluster-wide shared values */
 typedef enum PgStat_Shared_Reset_Target
 {
-	RESET_BGWRITER
+	RESET_BGWRITER,
+	RESET_SLRU
 } PgStat_Shared_Reset_Target;
 
 /* Possible object types for resetting single counters */
@@ -481,6 +490,25 @@ typedef struct PgStat_MsgDeadlock
 } PgStat_MsgDeadlock;
 
 
+/* ----------
+ * PgStat_MsgSLRU				Sent by a backend to update the statistics
+ *								of one SLRU.
+ * ----------
+ */
+typedef struct PgStat_MsgSLRU
+{
+	PgStat_MsgHdr m_hdr;
+	int			m_index;		/* which SLRU; see pgstat_slru_index() */
+	PgStat_Counter m_blocks_zeroed;
+	PgStat_Counter m_blocks_hit;
+	PgStat_Counter m_blocks_read;
+	PgStat_Counter m_blocks_written;
+	PgStat_Counter m_blocks_exists;
+	PgStat_Counter m_flush;
+	PgStat_Counter m_truncate;
+} PgStat_MsgSLRU;
+
+
 /* ----------
  * PgStat_Msg					Union over all possible messages.
  * ----------
@@ -504,6 +532,7 @@ typedef union PgStat_Msg
 	PgStat_MsgFuncpurge msg_funcpurge;
 	PgStat_MsgRecoveryConflict msg_recoveryconflict;
 	PgStat_MsgDeadlock msg_deadlock;
+	PgStat_MsgSLRU msg_slru;
 } PgStat_Msg;
 
 
@@ -515,7 +544,7 @@ typedef union PgStat_Msg
  * ------------------------------------------------------------
  */
 
-#define PGSTAT_FILE_FORMAT_ID	0x01A5BC9B
+#define PGSTAT_FILE_FORMAT_ID	0x01A5BC9E
 
 /* ----------
  * PgStat_StatDBEntry			The collector's data per database
@@ -582,6 +611,8 @@ typedef struct PgStat_StatTabEntry
 	PgStat_Counter blocks_fetched;
 	PgStat_Counter blocks_hit;
 
+	PgStat_Counter tuple_lock_waits;
+
 	TimestampTz vacuum_timestamp;		/* user initiated vacuum */
 	PgStat_Counter vacuum_count;
 	TimestampTz autovac_vacuum_timestamp;		/* autovacuum initiated */
@@ -628,6 +659,25 @@ typedef struct PgStat_GlobalStats
 } PgStat_GlobalStats;
 
 
+/*
+ * SLRU statistics kept in the stats collector.  There's one entry for each
+ * of the SLRUs named in pgstat.c, plus one for any others, in that order.
+ */
+#define SLRU_NUM_ELEMENTS	8
+
+typedef struct PgStat_SLRUStats
+{
+	PgStat_Counter blocks_zeroed;
+	PgStat_Counter blocks_hit;
+	PgStat_Counter blocks_read;
+	PgStat_Counter blocks_written;
+	PgStat_Counter blocks_exists;
+	PgStat_Counter flush;
+	PgStat_Counter truncate;
+	TimestampTz stat_reset_timestamp;
+} PgStat_SLRUStats;
+
+
 /* ----------
  * Backend states
  * ----------
@@ -643,6 +693,39 @@ typedef enum BackendState
 	STATE_DISABLED,
 } BackendState;
 
+/* ----------
+ * Wait events
+ *
+ * A wait event is a uint32 with the class of wait in the high-order byte and
+ * the event within that class in the low-order 16 bits; zero means "not
+ * waiting".  Each process advertises its current wait event in its PGPROC,
+ * where pg_stat_activity and other processes can read it at any time.
+ * ----------
+ */
+#define PG_WAIT_LWLOCK				0x01000000U
+#define PG_WAIT_LOCK				0x03000000U
+#define PG_WAIT_LATCH				0x05000000U
+#define PG_WAIT_IO					0x0A000000U
+
+#define PG_WAIT_CLASS_MASK			0xFF000000U
+#define PG_WAIT_EVENT_MASK			0x0000FFFFU
+
+/*
+ * The events of class PG_WAIT_LWLOCK are assigned by GetLWLockWaitEvent, and
+ * those of class PG_WAIT_LOCK are LockTagTypes.  The others are listed here.
+ */
+typedef enum WaitEventLatch
+{
+	WAIT_EVENT_LATCH = PG_WAIT_LATCH
+} WaitEventLatch;
+
+typedef enum WaitEventIO
+{
+	WAIT_EVENT_FILE_READ = PG_WAIT_IO,
+	WAIT_EVENT_FILE_WRITE,
+	WAIT_EVENT_FILE_SYNC
+} WaitEventIO;
+
 /* ----------
  * Shared-memory data structures
  * ----------
@@ -692,6 +775,9 @@ typedef struct PgBackendStatus
 	/* current state */
 	BackendState st_state;
 
+	/* memory allocated by this backend; updated without st_changecount */
+	BackendMemoryUsage st_memory;
+
 	/* application name; MUST be null-terminated */
 	char	   *st_appname;
 
@@ -699,6 +785,22 @@ typedef struct PgBackendStatus
 	char	   *st_activity;
 } PgBackendStatus;
 
+/* ----------
+ * LocalPgBackendStatus
+ *
+ * Our local copy of a backend's PgBackendStatus entry, together with values
+ * that are kept elsewhere in shared memory but read at the same time.
+ * ----------
+ */
+typedef struct LocalPgBackendStatus
+{
+	/* local copy of the backend's status entry */
+	PgBackendStatus backendStatus;
+
+	/* the backend's wait event, read from its PGPROC; 0 if not waiting */
+	uint32		wait_event_info;
+} LocalPgBackendStatus;
+
 /*
  * Working state needed to accumulate per-function-call timing statistics.
  */
@@ -733,6 +835,12 @@ extern char *pgstat_stat_filename;
  */
 extern PgStat_MsgBgWriter BgWriterStats;
 
+/*
+ * SLRU statistics counters are updated directly by slru.c, in whatever
+ * process touches the SLRU, and sent along with the other statistics
+ */
+extern PgStat_MsgSLRU SLRUStats[SLRU_NUM_ELEMENTS];
+
 /*
  * Updated by pgstat_count_buffer_*_time macros
  */
@@ -789,6 +897,8 @@ extern void pgstat_report_appname(const char *appname);
 extern void pgstat_report_xact_timestamp(TimestampTz tstamp);
 extern void pgstat_report_waiting(bool waiting);
 extern const char *pgstat_get_backend_current_activity(int pid, bool checkUser);
+extern const char *pgstat_get_wait_event_type(uint32 wait_event_info);
+extern const char *pgstat_get_wait_event(uint32 wait_event_info);
 extern const char *pgstat_get_crashed_backend_activity(int pid, char *buffer,
 									int buflen);
 
@@ -797,6 +907,23 @@ extern PgStat_BackendFunctionEntry *find_funcstat_entry(Oid func_id);
 
 extern void pgstat_initstats(Relation rel);
 
+/*
+ * Wait event reporting.  my_wait_event_info points into our PGPROC once we
+ * have one, and at a process-local dummy before that, so reporting is a
+ * single unconditional store and cheap enough to do around any wait that
+ * might take a while.  Waits don't nest: ending an inner wait reports the
+ * process as not waiting at all.
+ */
+extern PGDLLIMPORT uint32 *my_wait_event_info;
+
+#define pgstat_report_wait_start(wait_event_info) \
+	(*(volatile uint32 *) my_wait_event_info = (uint32) (wait_event_info))
+#define pgstat_report_wait_end() \
+	(*(volatile uint32 *) my_wait_event_info = 0)
+
+extern void pgstat_set_wait_event_storage(uint32 *wait_event_info);
+extern void pgstat_reset_wait_event_storage(void);
+
 /* nontransactional event counts are simple enough to inline */
 
 #define pgstat_count_heap_scan(rel)									\
@@ -834,6 +961,11 @@ extern void pgstat_initstats(Relation rel);
 		if ((rel)->pgstat_info != NULL)								\
 			(rel)->pgstat_info->t_counts.t_blocks_hit++;			\
 	} while (0)
+#define pgstat_count_tuple_lock_wait(rel)							\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_tuple_lock_waits++;		\
+	} while (0)
 #define pgstat_count_buffer_read_time(n)							\
 	(pgStatBlockReadTime += (n))
 #define pgstat_count_buffer_write_time(n)							\
@@ -862,6 +994,24 @@ extern void pgstat_twophase_postabort(TransactionId xid, uint16 info,
 
 extern void pgstat_send_bgwriter(void);
 
+extern int	pgstat_slru_index(const char *name);
+extern const char *pgstat_slru_name(int slru_idx);
+
+#define pgstat_count_slru_page_zeroed(idx) \
+	(SLRUStats[idx].m_blocks_zeroed++)
+#define pgstat_count_slru_page_hit(idx) \
+	(SLRUStats[idx].m_blocks_hit++)
+#define pgstat_count_slru_page_read(idx) \
+	(SLRUStats[idx].m_blocks_read++)
+#define pgstat_count_slru_page_written(idx) \
+	(SLRUStats[idx].m_blocks_written++)
+#define pgstat_count_slru_page_exists(idx) \
+	(SLRUStats[idx].m_blocks_exists++)
+#define pgstat_count_slru_flush(idx) \
+	(SLRUStats[idx].m_flush++)
+#define pgstat_count_slru_truncate(idx) \
+	(SLRUStats[idx].m_truncate++)
+
 /* ----------
  * Support functions for the SQL-callable functions to
  * generate the pgstat* views.
@@ -870,8 +1020,10 @@ extern void pgstat_send_bgwriter(void);
 extern PgStat_StatDBEntry *pgstat_fetch_stat_dbentry(Oid dbid);
 extern PgStat_StatTabEntry *pgstat_fetch_stat_tabentry(Oid relid);
 extern PgBackendStatus *pgstat_fetch_stat_beentry(int beid);
+extern LocalPgBackendStatus *pgstat_fetch_stat_local_beentry(int beid);
 extern PgStat_StatFuncEntry *pgstat_fetch_stat_funcentry(Oid funcid);
 extern int	pgstat_fetch_stat_numbackends(void);
 extern PgStat_GlobalStats *pgstat_fetch_global(void);
+extern PgStat_SLRUStats *pgstat_fetch_slru(void);
 
 #endif   /* PGSTAT_H */
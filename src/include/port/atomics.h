@@ -0,0 +1,296 @@
+/*-------------------------------------------------------------------------
+ *
+ * atomics.h
+ *	  Atomic operations on 32-bit integers in shared memory.
+ *
+ * This provides the small set of atomic read-modify-write operations that
+ * lock-free code in the backend needs: compare-and-exchange, exchange, and
+ * the fetch-and-add family.  Where configure found the __sync builtins for
+ * both compare-and-swap and fetch-and-add (HAVE_GCC__SYNC_INT32_CAS and
+ * HAVE_GCC__SYNC_INT32_FETCH_ADD) we use those; MSVC gets its Interlocked
+ * intrinsics.  Everywhere else each atomic variable carries its own
+ * spinlock, which is slow but correct, and keeps callers from having to
+ * care.
+ *
+ * All read-modify-write operations act as full memory barriers.
+ * pg_atomic_read_u32 and pg_atomic_write_u32 are not barriers at all; they
+ * only guarantee that the value is loaded or stored as a whole, and that the
+ * compiler doesn't cache it in a register.  Use the barriers in
+ * storage/barrier.h, which this file includes, when ordering matters.
+ *
+ * Atomic variables must be initialized with pg_atomic_init_u32 before being
+ * used by more than one process, and not otherwise assigned to directly.
+ *
+ * For an introduction to using memory barriers and atomics within the
+ * PostgreSQL backend, see src/backend/storage/lmgr/README.barrier
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/port/atomics.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+#include "storage/barrier.h"
+#include "storage/s_lock.h"
+
+#if defined(WIN32_ONLY_COMPILER)
+#define PG_HAVE_ATOMIC_U32_MSVC
+#elif defined(HAVE_GCC__SYNC_INT32_CAS) && defined(HAVE_GCC__SYNC_INT32_FETCH_ADD)
+#define PG_HAVE_ATOMIC_U32_GCC
+#else
+#define PG_HAVE_ATOMIC_U32_SIMULATION
+#endif
+
+typedef struct pg_atomic_uint32
+{
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+	slock_t		sema;			/* protects value */
+#endif
+	volatile uint32 value;
+} pg_atomic_uint32;
+
+#ifdef PG_HAVE_ATOMIC_U32_MSVC
+#include <intrin.h>
+#pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedExchangeAdd)
+#pragma intrinsic(_InterlockedAnd)
+#pragma intrinsic(_InterlockedOr)
+#endif
+
+/*
+ * The simulated operations need a real function call, so they live in
+ * src/backend/port/atomics.c whether or not we have inline functions.
+ */
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+extern void pg_atomic_init_u32_impl(volatile pg_atomic_uint32 *ptr, uint32 val);
+extern void pg_atomic_write_u32_impl(volatile pg_atomic_uint32 *ptr, uint32 val);
+extern bool pg_atomic_compare_exchange_u32_impl(volatile pg_atomic_uint32 *ptr,
+									uint32 *expected, uint32 newval);
+extern uint32 pg_atomic_fetch_add_u32_impl(volatile pg_atomic_uint32 *ptr,
+							 int32 add_);
+#endif
+
+/*
+ * We want the functions below to be inline; but if the compiler doesn't
+ * support that, fall back on providing them as regular functions.  See
+ * STATIC_IF_INLINE in c.h.
+ */
+#ifndef PG_USE_INLINE
+extern void pg_atomic_init_u32(volatile pg_atomic_uint32 *ptr, uint32 val);
+extern uint32 pg_atomic_read_u32(volatile pg_atomic_uint32 *ptr);
+extern void pg_atomic_write_u32(volatile pg_atomic_uint32 *ptr, uint32 val);
+extern bool pg_atomic_compare_exchange_u32(volatile pg_atomic_uint32 *ptr,
+							   uint32 *expected, uint32 newval);
+extern uint32 pg_atomic_exchange_u32(volatile pg_atomic_uint32 *ptr,
+					   uint32 newval);
+extern uint32 pg_atomic_fetch_add_u32(volatile pg_atomic_uint32 *ptr,
+						int32 add_);
+extern uint32 pg_atomic_fetch_sub_u32(volatile pg_atomic_uint32 *ptr,
+						int32 sub_);
+extern uint32 pg_atomic_fetch_and_u32(volatile pg_atomic_uint32 *ptr,
+						uint32 and_);
+extern uint32 pg_atomic_fetch_or_u32(volatile pg_atomic_uint32 *ptr,
+					   uint32 or_);
+extern uint32 pg_atomic_add_fetch_u32(volatile pg_atomic_uint32 *ptr,
+						int32 add_);
+extern uint32 pg_atomic_sub_fetch_u32(volatile pg_atomic_uint32 *ptr,
+						int32 sub_);
+#endif   /* !PG_USE_INLINE */
+
+#if defined(PG_USE_INLINE) || defined(ATOMICS_INCLUDE_DEFINITIONS)
+
+/*
+ * Initialize an atomic variable.  Has to be done before any concurrent
+ * access is possible.
+ */
+STATIC_IF_INLINE void
+pg_atomic_init_u32(volatile pg_atomic_uint32 *ptr, uint32 val)
+{
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+	pg_atomic_init_u32_impl(ptr, val);
+#else
+	ptr->value = val;
+#endif
+}
+
+/*
+ * Read the current value.  No barrier semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_read_u32(volatile pg_atomic_uint32 *ptr)
+{
+	return ptr->value;
+}
+
+/*
+ * Unconditionally overwrite the value.  No barrier semantics; use
+ * pg_atomic_exchange_u32 if the store has to be ordered.
+ *
+ * With simulated atomics the store has to take the variable's spinlock,
+ * or it could be lost under a concurrent compare-and-exchange or
+ * fetch-and-add, which store a value computed from the old one.
+ */
+STATIC_IF_INLINE void
+pg_atomic_write_u32(volatile pg_atomic_uint32 *ptr, uint32 val)
+{
+#ifdef PG_HAVE_ATOMIC_U32_SIMULATION
+	pg_atomic_write_u32_impl(ptr, val);
+#else
+	ptr->value = val;
+#endif
+}
+
+/*
+ * Atomically compare *ptr to *expected, and if equal store newval.
+ *
+ * Returns true if the store happened.  Either way, *expected is set to the
+ * value *ptr had beforehand, which saves a re-read in the usual CAS loop.
+ * Full barrier semantics.
+ */
+STATIC_IF_INLINE bool
+pg_atomic_compare_exchange_u32(volatile pg_atomic_uint32 *ptr,
+							   uint32 *expected, uint32 newval)
+{
+#if defined(PG_HAVE_ATOMIC_U32_GCC)
+	uint32		current;
+
+	current = __sync_val_compare_and_swap(&ptr->value, *expected, newval);
+	if (current == *expected)
+		return true;
+	*expected = current;
+	return false;
+#elif defined(PG_HAVE_ATOMIC_U32_MSVC)
+	uint32		current;
+
+	current = (uint32) _InterlockedCompareExchange((volatile long *) &ptr->value,
+												   (long) newval,
+												   (long) *expected);
+	if (current == *expected)
+		return true;
+	*expected = current;
+	return false;
+#else
+	return pg_atomic_compare_exchange_u32_impl(ptr, expected, newval);
+#endif
+}
+
+/*
+ * Atomically replace the value with newval, returning the old value.  Full
+ * barrier semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_exchange_u32(volatile pg_atomic_uint32 *ptr, uint32 newval)
+{
+#if defined(PG_HAVE_ATOMIC_U32_MSVC)
+	return (uint32) _InterlockedExchange((volatile long *) &ptr->value,
+										 (long) newval);
+#else
+	/*
+	 * __sync_lock_test_and_set is only an acquire barrier, so build this on
+	 * compare-and-exchange instead.
+	 */
+	uint32		old = ptr->value;
+
+	while (!pg_atomic_compare_exchange_u32(ptr, &old, newval))
+		 /* skip */ ;
+	return old;
+#endif
+}
+
+/*
+ * Atomically add add_ to the value, returning the old value.  Full barrier
+ * semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_fetch_add_u32(volatile pg_atomic_uint32 *ptr, int32 add_)
+{
+#if defined(PG_HAVE_ATOMIC_U32_GCC)
+	return __sync_fetch_and_add(&ptr->value, add_);
+#elif defined(PG_HAVE_ATOMIC_U32_MSVC)
+	return (uint32) _InterlockedExchangeAdd((volatile long *) &ptr->value,
+											(long) add_);
+#else
+	return pg_atomic_fetch_add_u32_impl(ptr, add_);
+#endif
+}
+
+/*
+ * Atomically subtract sub_ from the value, returning the old value.  Full
+ * barrier semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_fetch_sub_u32(volatile pg_atomic_uint32 *ptr, int32 sub_)
+{
+	return pg_atomic_fetch_add_u32(ptr, -sub_);
+}
+
+/*
+ * Atomically AND the value with and_, returning the old value.  Full
+ * barrier semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_fetch_and_u32(volatile pg_atomic_uint32 *ptr, uint32 and_)
+{
+#if defined(PG_HAVE_ATOMIC_U32_GCC)
+	return __sync_fetch_and_and(&ptr->value, and_);
+#elif defined(PG_HAVE_ATOMIC_U32_MSVC)
+	return (uint32) _InterlockedAnd((volatile long *) &ptr->value,
+									(long) and_);
+#else
+	uint32		old = ptr->value;
+
+	while (!pg_atomic_compare_exchange_u32(ptr, &old, old & and_))
+		 /* skip */ ;
+	return old;
+#endif
+}
+
+/*
+ * Atomically OR the value with or_, returning the old value.  Full barrier
+ * semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_fetch_or_u32(volatile pg_atomic_uint32 *ptr, uint32 or_)
+{
+#if defined(PG_HAVE_ATOMIC_U32_GCC)
+	return __sync_fetch_and_or(&ptr->value, or_);
+#elif defined(PG_HAVE_ATOMIC_U32_MSVC)
+	return (uint32) _InterlockedOr((volatile long *) &ptr->value,
+								   (long) or_);
+#else
+	uint32		old = ptr->value;
+
+	while (!pg_atomic_compare_exchange_u32(ptr, &old, old | or_))
+		 /* skip */ ;
+	return old;
+#endif
+}
+
+/*
+ * Atomically add add_ to the value, returning the new value.  Full barrier
+ * semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_add_fetch_u32(volatile pg_atomic_uint32 *ptr, int32 add_)
+{
+	return pg_atomic_fetch_add_u32(ptr, add_) + add_;
+}
+
+/*
+ * Atomically subtract sub_ from the value, returning the new value.  Full
+ * barrier semantics.
+ */
+STATIC_IF_INLINE uint32
+pg_atomic_sub_fetch_u32(volatile pg_atomic_uint32 *ptr, int32 sub_)
+{
+	return pg_atomic_fetch_add_u32(ptr, -sub_) - sub_;
+}
+
+#endif   /* PG_USE_INLINE || ATOMICS_INCLUDE_DEFINITIONS */
+
+#endif   /* ATOMICS_H */
@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * redoworker.h
+ *	  Exports from postmaster/redoworker.c.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ * src/include/postmaster/redoworker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _REDOWORKER_H
+#define _REDOWORKER_H
+
+#include "access/xlog.h"
+
+/* GUC options */
+extern int	parallel_redo_workers;
+
+extern Size RedoWorkerShmemSize(void);
+extern void RedoWorkerShmemInit(void);
+
+/* functions called by the startup process */
+extern void ParallelRedoStart(void);
+extern bool ParallelRedoDispatch(XLogRecPtr EndRecPtr, XLogRecord *record);
+extern void ParallelRedoDrain(void);
+extern void ParallelRedoShutdown(void);
+
+/* called by the postmaster */
+extern void RedoWorkerLaunchFailed(void);
+
+extern void RedoWorkerMain(void) __attribute__((noreturn));
+
+#endif   /* _REDOWORKER_H */
@@ -103,8 +103,10 @@ typedef struct buftag
  */
 #define BufTableHashPartition(hashcode) \
 	((hashcode) % NUM_BUFFER_PARTITIONS)
+#define BufMappingPartitionLockByIndex(i) \
+	((LWLockId) (FirstBufMappingLock + (i)))
 #define BufMappingPartitionLock(hashcode) \
-	((LWLockId) (FirstBufMappingLock + BufTableHashPartition(hashcode)))
+	BufMappingPartitionLockByIndex(BufTableHashPartition(hashcode))
 
 /*
  *	BufferDesc -- shared descriptor/state data for a single shared buffer.
@@ -189,6 +191,8 @@ extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 					 volatile BufferDesc *buf);
 
 extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
+extern int	StrategyFreeListLength(void);
+extern int	StrategyAdvanceClock(int nbuffers);
 extern void StrategyNotifyBgWriter(Latch *bgwriterLatch);
 
 extern Size StrategyShmemSize(void);
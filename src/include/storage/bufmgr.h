@@ -50,6 +50,7 @@ extern PGDLLIMPORT int NBuffers;
 extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
+extern int	bgwriter_freelist_target;
 extern bool track_io_timing;
 extern int	target_prefetch_pages;
 
@@ -65,6 +66,13 @@ extern PGDLLIMPORT int32 *LocalRefCount;
 /* special block number for ReadBuffer() */
 #define P_NEW	InvalidBlockNumber		/* grow the file to get a new page */
 
+/*
+ * Maximum number of blocks ReadBuffersExtended() reads in one call.  This is
+ * half of the 256kB ring used by the BAS_BULKREAD and BAS_VACUUM strategies,
+ * so that a whole run can be pinned without crowding the rest of the ring.
+ */
+#define MAX_BUFFERS_PER_READ	((128 * 1024) / BLCKSZ)
+
 /*
  * Buffer content lock modes (mode argument for LockBuffer())
  */
@@ -163,10 +171,17 @@ extern PGDLLIMPORT int32 *LocalRefCount;
  */
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 			   BlockNumber blockNum);
+extern void PrefetchBufferRange(Relation reln, ForkNumber forkNum,
+					BlockNumber blockNum, BlockNumber nblocks);
+extern void PrefetchBufferWithoutRelcache(RelFileNode rnode,
+							  ForkNumber forkNum, BlockNumber blockNum);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 				   BlockNumber blockNum, ReadBufferMode mode,
 				   BufferAccessStrategy strategy);
+extern void ReadBuffersExtended(Relation reln, ForkNumber forkNum,
+					BlockNumber blockNum, int nblocks, Buffer *buffers,
+					BufferAccessStrategy strategy);
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode,
 						  ForkNumber forkNum, BlockNumber blockNum,
 						  ReadBufferMode mode, BufferAccessStrategy strategy);
@@ -50,6 +50,11 @@ typedef char *FileName;
 
 typedef int File;
 
+/*
+ * Maximum number of chunks that FileReadV can fill in one call.
+ */
+#define PG_MAX_READV_BUFFERS	128
+
 
 /* GUC parameter */
 extern int	max_files_per_process;
@@ -70,6 +75,7 @@ extern File OpenTemporaryFile(bool interXact);
 extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, int amount);
 extern int	FileRead(File file, char *buffer, int amount);
+extern int	FileReadV(File file, char **buffers, int nbuffers, int amount);
 extern int	FileWrite(File file, char *buffer, int amount);
 extern int	FileSync(File file);
 extern off_t FileSeek(File file, off_t offset, int whence);
@@ -535,6 +535,7 @@ typedef struct xl_standby_lock
 
 extern xl_standby_lock *GetRunningTransactionLocks(int *nlocks);
 extern const char *GetLockmodeName(LOCKMETHODID lockmethodid, LOCKMODE mode);
+extern const char *GetLockNameFromTagType(uint16 locktag_type);
 
 extern void lock_twophase_recover(TransactionId xid, uint16 info,
 					  void *recdata, uint32 len);
@@ -545,6 +546,7 @@ extern void lock_twophase_postabort(TransactionId xid, uint16 info,
 extern void lock_twophase_standby_recover(TransactionId xid, uint16 info,
 							  void *recdata, uint32 len);
 
+extern bool DeadLockCheckNeeded(PGPROC *proc);
 extern DeadLockState DeadLockCheck(PGPROC *proc);
 extern PGPROC *GetBlockingAutoVacuumPgproc(void);
 extern void DeadLockReport(void) __attribute__((noreturn));
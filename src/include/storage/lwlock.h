@@ -21,7 +21,10 @@
  */
 
 /* Number of partitions of the shared buffer mapping hashtable */
-#define NUM_BUFFER_PARTITIONS  16
+#define NUM_BUFFER_PARTITIONS  128
+
+/* Number of WAL insertion locks (see xlog.c) */
+#define NUM_XLOGINSERT_LOCKS  8
 
 /* Number of partitions the shared lock tables are divided into */
 #define LOG2_NUM_LOCK_PARTITIONS  4
@@ -31,6 +34,10 @@
 #define LOG2_NUM_PREDICATELOCK_PARTITIONS  4
 #define NUM_PREDICATELOCK_PARTITIONS  (1 << LOG2_NUM_PREDICATELOCK_PARTITIONS)
 
+/* Number of partitions of the shared relation size cache */
+#define LOG2_NUM_RELSIZECACHE_PARTITIONS  4
+#define NUM_RELSIZECACHE_PARTITIONS  (1 << LOG2_NUM_RELSIZECACHE_PARTITIONS)
+
 /*
  * We have a number of predefined LWLocks, plus a bunch of LWLocks that are
  * dynamically assigned (e.g., for shared buffers).  The LWLock structures
@@ -53,7 +60,7 @@ typedef enum LWLockId
 	ProcArrayLock,
 	SInvalReadLock,
 	SInvalWriteLock,
-	WALInsertLock,
+	WALBufMappingLock,
 	WALWriteLock,
 	ControlFileLock,
 	CheckpointLock,
@@ -79,18 +86,50 @@ typedef enum LWLockId
 	SerializablePredicateLockListLock,
 	OldSerXidLock,
 	SyncRepLock,
+	RedoExtendLock,
+#ifdef USE_CSN_SNAPSHOTS
+	CSNLogControlLock,
+#endif
 	/* Individual lock IDs end here */
 	FirstBufMappingLock,
 	FirstLockMgrLock = FirstBufMappingLock + NUM_BUFFER_PARTITIONS,
 	FirstPredicateLockMgrLock = FirstLockMgrLock + NUM_LOCK_PARTITIONS,
 
+	FirstWALInsertLock = FirstPredicateLockMgrLock + NUM_PREDICATELOCK_PARTITIONS,
+
+	FirstRelSizeCacheLock = FirstWALInsertLock + NUM_XLOGINSERT_LOCKS,
+
 	/* must be last except for MaxDynamicLWLock: */
-	NumFixedLWLocks = FirstPredicateLockMgrLock + NUM_PREDICATELOCK_PARTITIONS,
+	NumFixedLWLocks = FirstRelSizeCacheLock + NUM_RELSIZECACHE_PARTITIONS,
 
 	MaxDynamicLWLock = 1000000000
 } LWLockId;
 
 
+/*
+ * Every LWLock belongs to a tranche, a group of locks that serve the same
+ * purpose, which is used to name the lock in wait event reports.  The
+ * individually named locks above make up LWTRANCHE_MAIN; each of them is
+ * reported under its own name, and the locks of any other tranche are
+ * reported collectively under the tranche's name.  Locks assigned by
+ * LWLockAssign belong to LWTRANCHE_EXTENSION.
+ */
+typedef enum LWLockTranche
+{
+	LWTRANCHE_MAIN,
+	LWTRANCHE_BUFFER_MAPPING,
+	LWTRANCHE_LOCK_MANAGER,
+	LWTRANCHE_PREDICATE_LOCK_MANAGER,
+	LWTRANCHE_WAL_INSERT,
+	LWTRANCHE_RELSIZE_CACHE,
+	LWTRANCHE_BUFFER_CONTENT,
+	LWTRANCHE_BUFFER_IO,
+	LWTRANCHE_PROC,
+	LWTRANCHE_SLRU_BUFFERS,
+	LWTRANCHE_EXTENSION,
+	LWTRANCHE_NUM				/* must be last */
+} LWLockTranche;
+
 typedef enum LWLockMode
 {
 	LW_EXCLUSIVE,
@@ -106,9 +145,14 @@ extern bool Trace_lwlocks;
 #endif
 
 extern LWLockId LWLockAssign(void);
+extern LWLockId LWLockAssignTranche(LWLockTranche tranche);
 extern void LWLockAcquire(LWLockId lockid, LWLockMode mode);
 extern bool LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode);
 extern bool LWLockAcquireOrWait(LWLockId lockid, LWLockMode mode);
+extern bool LWLockAcquireWithVar(LWLockId lockid, uint64 *valptr, uint64 val);
+extern bool LWLockWaitForVar(LWLockId lockid, uint64 *valptr, uint64 oldval,
+				 uint64 *newval);
+extern void LWLockUpdateVar(LWLockId lockid, uint64 *valptr, uint64 val);
 extern void LWLockRelease(LWLockId lockid);
 extern void LWLockReleaseAll(void);
 extern bool LWLockHeldByMe(LWLockId lockid);
@@ -119,4 +163,7 @@ extern void CreateLWLocks(void);
 
 extern void RequestAddinLWLocks(int n);
 
+extern uint32 GetLWLockWaitEvent(LWLockId lockid);
+extern const char *GetLWLockIdentifier(uint16 eventId);
+
 #endif   /* LWLOCK_H */
@@ -15,6 +15,7 @@
 #define PREDICATE_INTERNALS_H
 
 #include "storage/lock.h"
+#include "storage/spin.h"
 
 /*
  * Commit number.
@@ -123,6 +124,11 @@ typedef struct SERIALIZABLEXACT
 #define SXACT_FLAG_RO_UNSAFE			0x00000100
 #define SXACT_FLAG_SUMMARY_CONFLICT_IN	0x00000200
 #define SXACT_FLAG_SUMMARY_CONFLICT_OUT 0x00000400
+/*
+ * The transaction has a rw-conflict that was found through a page or
+ * relation lock rather than a tuple lock, so it might be a false positive.
+ */
+#define SXACT_FLAG_COARSE_CONFLICT		0x00000800
 
 /*
  * The following types are used to provide an ad hoc list for holding
@@ -142,6 +148,25 @@ typedef struct PredXactListElementData *PredXactListElement;
 #define PredXactListElementDataSize \
 		((Size)MAXALIGN(sizeof(PredXactListElementData)))
 
+/*
+ * Cumulative counts of predicate locking events since server start, shown in
+ * the pg_stat_serializable view.  Conflicts are counted by the granularity of
+ * the lock target through which they were found; those found on a page or a
+ * relation, often as a result of promotion, include the false positives.
+ * coarseFailures counts the serialization failures of transactions that had
+ * at least one such conflict.
+ */
+typedef struct PredicateLockStats
+{
+	int64		pagePromotions;
+	int64		relationPromotions;
+	int64		tupleConflicts;
+	int64		pageConflicts;
+	int64		relationConflicts;
+	int64		failures;
+	int64		coarseFailures;
+} PredicateLockStats;
+
 typedef struct PredXactListData
 {
 	SHM_QUEUE	availableList;
@@ -174,6 +199,13 @@ typedef struct PredXactListData
 	SERIALIZABLEXACT *OldCommittedSxact;		/* shared copy of dummy sxact */
 
 	PredXactListElement element;
+
+	/*
+	 * Statistics are bumped from paths that hold no lock, or only a partition
+	 * lock, so they get a spinlock of their own.
+	 */
+	slock_t		statsLock;
+	PredicateLockStats stats;
 }	PredXactListData;
 
 typedef struct PredXactListData *PredXactList;
@@ -474,5 +506,6 @@ typedef struct TwoPhasePredicateRecord
  * locking internals.
  */
 extern PredicateLockData *GetPredicateLockStatusData(void);
+extern void GetPredicateLockStats(PredicateLockStats *stats);
 
 #endif   /* PREDICATE_INTERNALS_H */
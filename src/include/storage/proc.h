@@ -18,6 +18,7 @@
 #include "storage/latch.h"
 #include "storage/lock.h"
 #include "storage/pg_sema.h"
+#include "storage/spin.h"
 
 /*
  * Each backend advertises up to PGPROC_MAX_CACHED_SUBXIDS TransactionIds
@@ -47,12 +48,24 @@ struct XidCache
 #define		PROC_VACUUM_STATE_MASK (0x0E)
 
 /*
- * We allow a small number of "weak" relation locks (AccesShareLock,
- * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
- * rather than the main lock table.  This eases contention on the lock
- * manager LWLocks.  See storage/lmgr/README for additional details.
+ * We allow a limited number of "weak" relation locks (AccessShareLock,
+ * RowShareLock, RowExclusiveLock) to be recorded in arrays hanging off the
+ * PGPROC structure rather than in the main lock table.  This eases contention
+ * on the lock manager LWLocks.  See storage/lmgr/README for additional
+ * details.
+ *
+ * The slots are divided into groups of FP_LOCK_SLOTS_PER_GROUP, and each
+ * relation can only use the slots of the group its OID hashes to, so that
+ * looking up a relation never has to scan more than one group.  The number of
+ * groups is derived from max_locks_per_transaction at postmaster start; see
+ * InitializeFastPathLocks.
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+extern PGDLLIMPORT int FastPathLockGroupsPerBackend;
+
+#define		FP_LOCK_GROUPS_PER_BACKEND_MAX	1024
+#define		FP_LOCK_SLOTS_PER_GROUP		16	/* don't change, see lock.c */
+#define		FP_LOCK_SLOTS_PER_BACKEND \
+	(FP_LOCK_SLOTS_PER_GROUP * FastPathLockGroupsPerBackend)
 
 /*
  * Each backend has a PGPROC struct in shared memory.  There is also a list of
@@ -103,6 +116,15 @@ struct PGPROC
 	uint8		lwWaitMode;		/* lwlock mode being waited for */
 	struct PGPROC *lwWaitLink;	/* next waiter for same LW lock */
 
+	/*
+	 * Info about group XID clearing at transaction end, if this process is
+	 * waiting for another backend to clear its XID in the ProcArray.  See
+	 * ProcArrayGroupClearXid().
+	 */
+	bool		procArrayGroupMember;	/* true if waiting in the group */
+	struct PGPROC *procArrayGroupNext;	/* next member of the group */
+	TransactionId procArrayGroupMemberXid;	/* latestXid to report */
+
 	/* Info about lock the process is currently waiting for, if any. */
 	/* waitLock and waitProcLock are NULL if not currently waiting. */
 	LOCK	   *waitLock;		/* Lock object we're sleeping on ... */
@@ -121,6 +143,13 @@ struct PGPROC
 	int			syncRepState;	/* wait state for sync rep */
 	SHM_QUEUE	syncRepLinks;	/* list link if process is in syncrep queue */
 
+	/*
+	 * What the process is waiting for right now, or 0; see PG_WAIT_* in
+	 * pgstat.h.  Written only by the owning process, without any locking, and
+	 * read by anyone.
+	 */
+	uint32		wait_event_info;
+
 	/*
 	 * All PROCLOCK objects for locks held or awaited by this backend are
 	 * linked into one of these lists, according to the partition number of
@@ -134,8 +163,9 @@ struct PGPROC
 	LWLockId	backendLock;	/* protects the fields below */
 
 	/* Lock manager data, recording fast-path locks taken by this backend. */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND];		/* slots for rel oids */
+	uint64	   *fpLockBits;		/* lock modes held for each fast-path slot,
+								 * one word per group */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
@@ -202,6 +232,10 @@ typedef struct PROC_HDR
 	int			startupProcPid;
 	/* Buffer id of the buffer that Startup process waits for pin on, or -1 */
 	int			startupBufferPinWaitBufId;
+	/* Protects procArrayGroupFirst */
+	slock_t		procArrayGroupLock;
+	/* First backend waiting for its XID to be cleared, or NULL */
+	PGPROC	   *procArrayGroupFirst;
 } PROC_HDR;
 
 extern PROC_HDR *ProcGlobal;
@@ -214,9 +248,11 @@ extern PGPROC *PreparedXactProcs;
  *
  * Background writer, checkpointer and WAL writer run during normal operation.
  * Startup process and WAL receiver also consume 2 slots, but WAL writer is
- * launched only after startup has exited, so we only need 4 slots.
+ * launched only after startup has exited, so we only need 4 slots, plus
+ * one for each possible parallel redo worker.
  */
-#define NUM_AUXILIARY_PROCS		4
+#define MAX_REDO_WORKERS		16
+#define NUM_AUXILIARY_PROCS		(4 + MAX_REDO_WORKERS)
 
 
 /* configurable options */
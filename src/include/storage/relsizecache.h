@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * relsizecache.h
+ *	  POSTGRES shared relation size cache definitions.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/relsizecache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef RELSIZECACHE_H
+#define RELSIZECACHE_H
+
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* GUC variable */
+extern int	relsize_cache_entries;
+
+extern Size RelSizeCacheShmemSize(void);
+extern void RelSizeCacheShmemInit(void);
+
+extern bool RelSizeCacheLookup(RelFileNode rnode, ForkNumber forknum,
+				   BlockNumber *nblocks, uint64 *fillgen);
+extern void RelSizeCacheFill(RelFileNode rnode, ForkNumber forknum,
+				 BlockNumber nblocks, uint64 fillgen);
+extern void RelSizeCacheExtend(RelFileNode rnode, ForkNumber forknum,
+				   BlockNumber nblocks);
+extern void RelSizeCacheSet(RelFileNode rnode, ForkNumber forknum,
+				BlockNumber nblocks);
+extern void RelSizeCacheInvalidate(RelFileNode rnode, ForkNumber forknum);
+extern void RelSizeCacheDropDatabase(Oid dbid);
+
+#endif   /* RELSIZECACHE_H */
@@ -81,6 +81,42 @@ extern PGDLLIMPORT MemoryContext CurTransactionContext;
 extern PGDLLIMPORT MemoryContext PortalContext;
 
 
+/*
+ * Memory obtained from malloc() by all the memory contexts of this backend,
+ * and the most there has been at any one time.  Once we have a backend status
+ * entry, pgstat.c points MyMemoryUsage into it so that other backends can see
+ * our usage; until then, and after it's gone, it points to local storage.
+ */
+typedef struct BackendMemoryUsage
+{
+	Size		allocated;		/* bytes currently allocated */
+	Size		peak;			/* high-water mark of allocated */
+} BackendMemoryUsage;
+
+extern PGDLLIMPORT BackendMemoryUsage *MyMemoryUsage;
+
+/*
+ * Context-type-specific code must call these whenever it gets a block of
+ * memory from malloc() or gives one back, so that the accounting above and
+ * in MemoryContextData.mem_allocated stays accurate.  They're deliberately
+ * cheap, since they run for every block.
+ */
+#define MemoryContextNoteAlloc(context, size) \
+	do { \
+		(context)->mem_allocated += (size); \
+		MyMemoryUsage->allocated += (size); \
+		if (MyMemoryUsage->allocated > MyMemoryUsage->peak) \
+			MyMemoryUsage->peak = MyMemoryUsage->allocated; \
+	} while (0)
+
+#define MemoryContextNoteFree(context, size) \
+	do { \
+		Assert((context)->mem_allocated >= (size)); \
+		(context)->mem_allocated -= (size); \
+		MyMemoryUsage->allocated -= (size); \
+	} while (0)
+
+
 /*
  * Memory-context-type-independent functions in mcxt.c
  */
@@ -97,6 +133,9 @@ extern MemoryContext GetMemoryChunkContext(void *pointer);
 extern MemoryContext MemoryContextGetParent(MemoryContext context);
 extern bool MemoryContextIsEmpty(MemoryContext context);
 extern void MemoryContextStats(MemoryContext context);
+extern Size MemoryContextMemAllocated(MemoryContext context, bool recurse);
+extern void MemoryContextSetUsageStorage(BackendMemoryUsage *usage);
+extern void MemoryContextResetUsageStorage(void);
 
 #ifdef MEMORY_CONTEXT_CHECKING
 extern void MemoryContextCheck(MemoryContext context);
@@ -141,4 +180,20 @@ extern MemoryContext AllocSetContextCreate(MemoryContext parent,
 #define ALLOCSET_SMALL_INITSIZE  (1 * 1024)
 #define ALLOCSET_SMALL_MAXSIZE	 (8 * 1024)
 
+/* slab.c */
+extern MemoryContext SlabContextCreate(MemoryContext parent,
+				  const char *name,
+				  Size blockSize,
+				  Size chunkSize);
+
+#define SLAB_DEFAULT_BLOCK_SIZE		(8 * 1024)
+#define SLAB_LARGE_BLOCK_SIZE		(8 * 1024 * 1024)
+
+/* generation.c */
+extern MemoryContext GenerationContextCreate(MemoryContext parent,
+						const char *name,
+						Size blockSize);
+
+#define GENERATION_DEFAULT_BLOCK_SIZE	(32 * 1024)
+
 #endif   /* MEMUTILS_H */
@@ -57,6 +57,44 @@ do { \
 extern CRCDLLIMPORT const uint32 pg_crc32_table[];
 
 
+/*
+ * CRC-32C (Castagnoli polynomial), used for WAL records.  Unlike the CRC
+ * above, this is the standard reflected CRC-32C, so that it can be computed
+ * with the crc32 instruction that x86 processors provide as part of SSE 4.2.
+ * The implementation lives in src/port/pg_crc32c.c; on x86 it checks at
+ * runtime whether the instruction is available, and otherwise falls back to
+ * a Slicing-by-8 software implementation.
+ */
+typedef uint32 pg_crc32c;
+
+/* Initialize a CRC accumulator */
+#define INIT_CRC32C(crc) ((crc) = 0xFFFFFFFF)
+
+/* Finish a CRC calculation */
+#define FIN_CRC32C(crc) ((crc) ^= 0xFFFFFFFF)
+
+/* Accumulate some (more) bytes into a CRC */
+#define COMP_CRC32C(crc, data, len) \
+	((crc) = pg_comp_crc32c((crc), (data), (len)))
+
+/* Check for equality of two CRCs */
+#define EQ_CRC32C(c1, c2) ((c1) == (c2))
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define USE_SSE42_CRC32C_WITH_RUNTIME_CHECK
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#define USE_SSE42_CRC32C_WITH_RUNTIME_CHECK
+#endif
+
+extern pg_crc32c pg_comp_crc32c_sb8(pg_crc32c crc, const void *data, size_t len);
+
+#ifdef USE_SSE42_CRC32C_WITH_RUNTIME_CHECK
+extern CRCDLLIMPORT pg_crc32c (*pg_comp_crc32c) (pg_crc32c crc, const void *data, size_t len);
+#else
+#define pg_comp_crc32c(crc, data, len) pg_comp_crc32c_sb8(crc, data, len)
+#endif
+
+
 #ifdef PROVIDE_64BIT_CRC
 
 /*
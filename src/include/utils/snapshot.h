@@ -62,6 +62,24 @@ typedef struct SnapshotData
 	CommandId	curcid;			/* in my xact, CID < curcid are visible */
 	uint32		active_count;	/* refcount on ActiveSnapshot stack */
 	uint32		regd_count;		/* refcount on RegisteredSnapshotList */
+
+	/*
+	 * The transaction completion count at the time GetSnapshotData() built
+	 * this snapshot.  Allows to avoid re-computing static snapshots when no
+	 * transactions completed since the last GetSnapshotData().
+	 */
+	uint64		snapXactCompletionCount;
+
+#ifdef USE_CSN_SNAPSHOTS
+
+	/*
+	 * ShmemVariableCache->nextCommitSeqNo when the snapshot was taken; XIDs
+	 * with an older CSN are visible.  InvalidCommitSeqNo if the snapshot must
+	 * be interpreted using the xip arrays (taken during recovery, or
+	 * imported).
+	 */
+	CommitSeqNo snapshotcsn;
+#endif
 } SnapshotData;
 
 /*
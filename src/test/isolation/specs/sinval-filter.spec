@@ -0,0 +1,27 @@
+# Check that invalidations still reach the backends that need them
+#
+# Shared invalidation messages are only delivered to backends of the
+# database they concern, except for shared catalogs, which concern every
+# backend.  s1 caches a table's definition, and the fact that a role does
+# not exist; s2 then changes both, and s1 must see the changes.
+
+setup
+{
+  CREATE TABLE sinval_t (a int);
+}
+
+teardown
+{
+  DROP TABLE sinval_t;
+  DROP ROLE sinval_role;
+}
+
+session "s1"
+step "s1read"	{ SELECT * FROM sinval_t; }
+step "s1role"	{ SELECT has_table_privilege('sinval_role', 'sinval_t', 'SELECT'); }
+
+session "s2"
+step "s2alter"	{ ALTER TABLE sinval_t ADD COLUMN b int; }
+step "s2role"	{ CREATE ROLE sinval_role; GRANT SELECT ON sinval_t TO sinval_role; }
+
+permutation "s1read" "s1role" "s2alter" "s2role" "s1read" "s1role"
@@ -0,0 +1,36 @@
+# Snapshot stability test
+#
+# A REPEATABLE READ transaction must keep seeing the same data while other
+# transactions, some with subtransactions, commit around it.  This matters
+# most when built with USE_CSN_SNAPSHOTS: a transaction's commit sequence
+# number must become visible to new snapshots at the same moment it leaves
+# the ProcArray, or rows would appear or vanish within one snapshot.
+
+setup
+{
+  CREATE TABLE snap (id int PRIMARY KEY, val int);
+  INSERT INTO snap VALUES (1, 0), (2, 0);
+}
+
+teardown
+{
+  DROP TABLE snap;
+}
+
+session "s1"
+setup		{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "r1"	{ SELECT sum(val) AS total, count(*) AS n FROM snap; }
+step "c1"	{ COMMIT; }
+
+session "s2"
+setup		{ BEGIN; }
+step "u2"	{ UPDATE snap SET val = val + 1 WHERE id = 1; }
+step "sp2"	{ SAVEPOINT a; INSERT INTO snap VALUES (3, 10); RELEASE SAVEPOINT a; }
+step "c2"	{ COMMIT; }
+
+session "s3"
+step "i3"	{ INSERT INTO snap VALUES (4, 100); }
+step "r3"	{ SELECT sum(val) AS total, count(*) AS n FROM snap; }
+
+permutation "r1" "u2" "sp2" "r1" "c2" "r1" "i3" "r1" "r3" "c1"
+permutation "u2" "sp2" "r1" "c2" "i3" "r1" "c1" "r3"
@@ -0,0 +1,50 @@
+# Check that n_tup_lock_waits counts sleeps in the tuple lock queue
+#
+# s1 updates a row and s2 queues behind it, holding the row's tuple lock.
+# s3 then has to wait for the tuple lock, which is what gets counted; it
+# gives up on lock_timeout, since the tester can't track two blocked steps.
+# The s3sleep step makes s3 send its statistics on its next idle.
+
+setup
+{
+ CREATE TABLE lockwait (id int PRIMARY KEY, v int);
+ INSERT INTO lockwait VALUES (1, 0);
+
+ CREATE FUNCTION wait_for_lock_waits() RETURNS bigint AS $$
+ DECLARE
+   waits bigint;
+ BEGIN
+   -- give up after 30 seconds
+   FOR i IN 1 .. 300 LOOP
+     SELECT n_tup_lock_waits INTO waits
+       FROM pg_stat_user_tables WHERE relname = 'lockwait';
+     EXIT WHEN waits > 0;
+     PERFORM pg_sleep(0.1);
+     PERFORM pg_stat_clear_snapshot();
+   END LOOP;
+   RETURN waits;
+ END
+ $$ LANGUAGE plpgsql;
+}
+
+teardown
+{
+ DROP TABLE lockwait;
+ DROP FUNCTION wait_for_lock_waits();
+}
+
+session "s1"
+setup		{ BEGIN; }
+step "s1u"	{ UPDATE lockwait SET v = v + 1 WHERE id = 1; }
+step "s1c"	{ COMMIT; }
+
+session "s2"
+step "s2u"	{ UPDATE lockwait SET v = v + 1 WHERE id = 1; }
+
+session "s3"
+setup		{ SET lock_timeout = 500; }
+step "s3u"	{ UPDATE lockwait SET v = v + 1 WHERE id = 1; }
+step "s3sleep"	{ SELECT pg_sleep(1.0); }
+step "s3check"	{ SELECT wait_for_lock_waits() AS lock_waits; }
+
+permutation "s1u" "s2u" "s3u" "s1c" "s3sleep" "s3check"
@@ -0,0 +1,47 @@
+# Check that pg_stat_activity shows what a blocked backend is waiting for
+#
+# s2 blocks on s1's transaction.  The wait event is set just before s2
+# sleeps, a moment after its lock request shows up in pg_locks, so s3
+# polls for it briefly.
+
+setup
+{
+ CREATE TABLE waitev (id int PRIMARY KEY, v int);
+ INSERT INTO waitev VALUES (1, 0);
+
+ CREATE FUNCTION wait_for_wait_event(querytext text,
+   OUT wait_event_type text, OUT wait_event text) AS $$
+ BEGIN
+   -- give up after 30 seconds
+   FOR i IN 1 .. 300 LOOP
+     SELECT a.wait_event_type, a.wait_event
+       INTO wait_event_type, wait_event
+       FROM pg_stat_activity a
+      WHERE a.query = querytext AND a.state = 'active';
+     EXIT WHEN wait_event IS NOT NULL;
+     PERFORM pg_sleep(0.1);
+     PERFORM pg_stat_clear_snapshot();
+   END LOOP;
+ END
+ $$ LANGUAGE plpgsql;
+}
+
+teardown
+{
+ DROP TABLE waitev;
+ DROP FUNCTION wait_for_wait_event(text);
+}
+
+session "s1"
+setup		{ BEGIN; }
+step "s1u"	{ UPDATE waitev SET v = v + 1 WHERE id = 1; }
+step "s1c"	{ COMMIT; }
+
+session "s2"
+step "s2u"	{ UPDATE waitev SET v = v + 10 WHERE id = 1; }
+
+session "s3"
+step "s3w"	{ SELECT * FROM wait_for_wait_event('UPDATE waitev SET v = v + 10 WHERE id = 1;'); }
+step "s3r"	{ SELECT v FROM waitev; }
+
+permutation "s1u" "s2u" "s3w" "s1c" "s3r"
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# pgbench_select_scaling.sh
+#
+# Measure how read-only pgbench throughput (pgbench -S) scales with the
+# number of clients, for one or more installations.  This is the benchmark
+# for buffer mapping and LWLock contention: with a data set that fits in
+# shared_buffers, every transaction is a handful of buffer mapping lookups
+# and content-lock acquisitions, so any lock that doesn't scale shows up as
+# a flattening curve.
+#
+# Usage: pgbench_select_scaling.sh BINDIR [BINDIR ...]
+#
+# Each BINDIR is the bin directory of an installation, e.g. one built from
+# the tree before a change and one after.  For each, a scratch cluster is
+# created, initialized at SCALE, and measured at every client count in
+# CLIENTS.  Output is one line per run: BINDIR, clients, tps.
+#
+# Environment: SCALE (default 100), CLIENTS (default "1 2 4 8 16 32 64 128"),
+# DURATION in seconds (default 60), PORT (default 5499), SHARED_BUFFERS
+# (default 4GB).  Run on an otherwise idle machine with at least as many
+# cores as the largest client count, and repeat to gauge the noise.
+
+SCALE=${SCALE:-100}
+CLIENTS=${CLIENTS:-"1 2 4 8 16 32 64 128"}
+DURATION=${DURATION:-60}
+PORT=${PORT:-5499}
+SHARED_BUFFERS=${SHARED_BUFFERS:-4GB}
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 BINDIR [BINDIR ...]" >&2
+	exit 1
+fi
+
+for bindir in "$@"; do
+	data=`mktemp -d ${TMPDIR:-/tmp}/pgbench_scaling.XXXXXX` || exit 1
+
+	"$bindir/initdb" -D "$data" >/dev/null || exit 1
+	"$bindir/pg_ctl" -D "$data" -w -l "$data/server.log" \
+		-o "-p $PORT -c shared_buffers=$SHARED_BUFFERS -c max_connections=300 -c checkpoint_segments=64" \
+		start >/dev/null || exit 1
+
+	"$bindir/createdb" -p $PORT bench
+	"$bindir/pgbench" -p $PORT -i -s $SCALE bench >/dev/null 2>&1
+
+	# warm the cache so that the runs measure lookups, not reads
+	"$bindir/pgbench" -p $PORT -S -T 30 -c 8 -j 8 bench >/dev/null 2>&1
+
+	for c in $CLIENTS; do
+		tps=`"$bindir/pgbench" -p $PORT -S -M prepared -T $DURATION -c $c -j $c bench 2>/dev/null |
+			sed -n 's/^tps = \([0-9.]*\) (excluding.*/\1/p'`
+		echo "$bindir $c $tps"
+	done
+
+	"$bindir/pg_ctl" -D "$data" -w stop -m fast >/dev/null
+	rm -rf "$data"
+done
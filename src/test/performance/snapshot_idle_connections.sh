@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# snapshot_idle_connections.sh
+#
+# Measure read-only pgbench throughput (pgbench -S) while many idle
+# connections are open, for one or more installations.  This is the
+# benchmark for snapshot reuse in GetSnapshotData: every idle backend still
+# has an entry in the proc array, so without reuse each snapshot taken by
+# the pgbench clients has to scan past all of them, and throughput falls as
+# the idle count grows.
+#
+# Usage: snapshot_idle_connections.sh BINDIR [BINDIR ...]
+#
+# Each BINDIR is the bin directory of an installation, e.g. one built from
+# the tree before snapshot reuse and one after; there is no switch to turn
+# reuse off, so comparing two builds is the only way to measure it.  For
+# each, a scratch cluster is created and initialized at SCALE, then
+# measured at every client count in CLIENTS, first with no idle
+# connections and then with IDLE of them.  Output is one line per run:
+# BINDIR, idle connections, clients, tps.
+#
+# Environment: IDLE (default 1000), SCALE (default 100), CLIENTS (default
+# "1 8 32 64"), DURATION in seconds (default 60), PORT (default 5499),
+# SHARED_BUFFERS (default 4GB).  The machine needs enough process and file
+# descriptor headroom for IDLE extra backends and psql processes.  Run on
+# an otherwise idle machine, and repeat to gauge the noise.
+
+IDLE=${IDLE:-1000}
+SCALE=${SCALE:-100}
+CLIENTS=${CLIENTS:-"1 8 32 64"}
+DURATION=${DURATION:-60}
+PORT=${PORT:-5499}
+SHARED_BUFFERS=${SHARED_BUFFERS:-4GB}
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 BINDIR [BINDIR ...]" >&2
+	exit 1
+fi
+
+run_clients()
+{
+	for c in $CLIENTS; do
+		tps=`"$bindir/pgbench" -p $PORT -S -M prepared -T $DURATION -c $c -j $c bench 2>/dev/null |
+			sed -n 's/^tps = \([0-9.]*\) (excluding.*/\1/p'`
+		echo "$bindir $1 $c $tps"
+	done
+}
+
+for bindir in "$@"; do
+	data=`mktemp -d ${TMPDIR:-/tmp}/snapshot_idle.XXXXXX` || exit 1
+	maxconn=`expr $IDLE + 200`
+
+	"$bindir/initdb" -D "$data" >/dev/null || exit 1
+	"$bindir/pg_ctl" -D "$data" -w -l "$data/server.log" \
+		-o "-p $PORT -c shared_buffers=$SHARED_BUFFERS -c max_connections=$maxconn -c checkpoint_segments=64" \
+		start >/dev/null || exit 1
+
+	"$bindir/createdb" -p $PORT bench
+	"$bindir/pgbench" -p $PORT -i -s $SCALE bench >/dev/null 2>&1
+
+	# warm the cache so that the runs measure snapshots, not reads
+	"$bindir/pgbench" -p $PORT -S -T 30 -c 8 -j 8 bench >/dev/null 2>&1
+
+	run_clients 0
+
+	# Open the idle connections.  Each psql waits for input on a FIFO that
+	# we hold open for writing, so it stays connected and idle until we
+	# close it.
+	fifo="$data/idle.fifo"
+	mkfifo "$fifo" || exit 1
+	i=0
+	while [ $i -lt $IDLE ]; do
+		"$bindir/psql" -X -q -p $PORT -f "$fifo" bench >/dev/null 2>&1 &
+		i=`expr $i + 1`
+	done
+	exec 3>"$fifo"
+
+	# wait until they have all connected
+	n=0
+	tries=0
+	while [ "$n" -lt $IDLE ]; do
+		tries=`expr $tries + 1`
+		if [ $tries -gt 300 ]; then
+			echo "only $n of $IDLE idle connections opened, see $data/server.log" >&2
+			exit 1
+		fi
+		sleep 1
+		n=`"$bindir/psql" -X -A -t -p $PORT -c "SELECT count(*) - 1 FROM pg_stat_activity WHERE datname = 'bench'" bench`
+	done
+
+	run_clients $IDLE
+
+	# EOF on the FIFO makes the idle sessions exit
+	exec 3>&-
+	wait
+
+	"$bindir/pg_ctl" -D "$data" -w stop -m fast >/dev/null
+	rm -rf "$data"
+done
@@ -0,0 +1,30 @@
+--
+-- Test the statistics kept for adaptive_commit_delay
+--
+
+SET synchronous_commit = on;
+CREATE TABLE gc_test (a int);
+
+-- flush requests aren't tracked unless adaptive delays are in effect
+SET adaptive_commit_delay = off;
+CREATE TEMP TABLE prevgc AS SELECT * FROM pg_xlog_group_commit_stats();
+INSERT INTO gc_test VALUES (1);
+INSERT INTO gc_test VALUES (2);
+SELECT s.requests = p.requests AS unchanged
+  FROM pg_xlog_group_commit_stats() s, prevgc p;
+
+-- they are once adaptive_commit_delay is on and commit_delay is nonzero;
+-- commit_delay, in microseconds, also caps the delay, in milliseconds
+SET adaptive_commit_delay = on;
+SET commit_delay = 10;
+DELETE FROM prevgc;
+INSERT INTO prevgc SELECT * FROM pg_xlog_group_commit_stats();
+INSERT INTO gc_test VALUES (3);
+INSERT INTO gc_test VALUES (4);
+SELECT s.requests > p.requests AS counted,
+       s.current_delay <= 0.01 AS capped
+  FROM pg_xlog_group_commit_stats() s, prevgc p;
+RESET commit_delay;
+RESET adaptive_commit_delay;
+
+DROP TABLE gc_test;
@@ -0,0 +1,36 @@
+--
+-- Test dividing query_work_mem among the plan nodes of a query
+--
+
+-- report how each sort in a query was done
+CREATE FUNCTION sort_methods(query text) RETURNS SETOF text AS $$
+DECLARE
+  ln text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF) ' || query LOOP
+    IF ln ~ 'Sort Method' THEN
+      RETURN NEXT substring(ln FROM 'Sort Method: ([a-z]+)');
+    END IF;
+  END LOOP;
+END
+$$ LANGUAGE plpgsql;
+
+SET work_mem = '4MB';
+
+-- both sorts fit in work_mem
+SELECT sort_methods('SELECT * FROM (SELECT g FROM generate_series(1, 10000) g
+                      ORDER BY g DESC) s ORDER BY g');
+
+-- a budget that's ample for the whole query changes nothing
+SET query_work_mem = '64MB';
+SELECT sort_methods('SELECT * FROM (SELECT g FROM generate_series(1, 10000) g
+                      ORDER BY g DESC) s ORDER BY g');
+
+-- but a small one is split between the sorts, and they spill to disk
+SET query_work_mem = '256kB';
+SELECT sort_methods('SELECT * FROM (SELECT g FROM generate_series(1, 10000) g
+                      ORDER BY g DESC) s ORDER BY g');
+
+RESET query_work_mem;
+RESET work_mem;
+DROP FUNCTION sort_methods(text);
@@ -27,6 +27,10 @@ SELECT t.seq_scan, t.seq_tup_read, t.idx_scan, t.idx_tup_fetch,
        pg_catalog.pg_statio_user_tables AS b
  WHERE t.relname='tenk2' AND b.relname='tenk2';
 
+CREATE TEMP TABLE prevslru AS
+SELECT blks_hit + blks_read AS blks
+  FROM pg_catalog.pg_stat_slru WHERE name = 'clog';
+
 -- function to wait for counters to advance
 create function wait_for_stats() returns void as $$
 declare
@@ -81,4 +85,12 @@ SELECT st.heap_blks_read + st.heap_blks_hit >= pr.heap_blks + cl.relpages,
   FROM pg_statio_user_tables AS st, pg_class AS cl, prevstats AS pr
  WHERE st.relname='tenk2' AND cl.relname='tenk2';
 
+-- pg_stat_slru has a row for each SLRU, plus one for all others
+SELECT name FROM pg_stat_slru ORDER BY name;
+
+-- the transactions committed above looked up the commit log
+SELECT st.blks_hit + st.blks_read > pr.blks
+  FROM pg_stat_slru AS st, prevslru AS pr
+ WHERE st.name = 'clog';
+
 -- End of Stats Test
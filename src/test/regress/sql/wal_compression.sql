@@ -0,0 +1,29 @@
+--
+-- Test compression of full-page images in WAL
+--
+
+CREATE TABLE walcomp (id int, filler text) WITH (fillfactor = 50);
+INSERT INTO walcomp SELECT g, repeat('x', 400) FROM generate_series(1, 1000) g;
+
+-- nothing is compressed while wal_compression is off
+SET wal_compression = off;
+CREATE TEMP TABLE prevcomp AS SELECT * FROM pg_xlog_compression_stats();
+CHECKPOINT;
+UPDATE walcomp SET id = id + 1;
+SELECT s.compressed_images = p.compressed_images AS unchanged
+  FROM pg_xlog_compression_stats() s, prevcomp p;
+
+-- the first change to each page after a checkpoint logs a compressed image
+SET wal_compression = on;
+DELETE FROM prevcomp;
+INSERT INTO prevcomp SELECT * FROM pg_xlog_compression_stats();
+CHECKPOINT;
+UPDATE walcomp SET id = id - 1;
+SELECT s.compressed_images > p.compressed_images AS compressed,
+       s.bytes_saved > p.bytes_saved AS saved
+  FROM pg_xlog_compression_stats() s, prevcomp p;
+RESET wal_compression;
+
+SELECT count(*), sum(id), min(filler) = max(filler) AS same_filler FROM walcomp;
+
+DROP TABLE walcomp;